@@ -0,0 +1,49 @@
+//
+//  LSThreadPoolBenchmark.h
+//  Lightstreamer Thread Pool Library Benchmarks
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief LSThreadPoolBenchmark measures the scheduling throughput and allocation cost of LSThreadPool.
+ <br/> Many producers schedule empty calls on pools of different sizes, for each of the available
+ queue kinds, and the resulting throughput is printed as a table on the standard output.
+ */
+@interface LSThreadPoolBenchmark : NSObject
+
+
+#pragma mark -
+#pragma mark Running
+
+/**
+ @brief Runs the throughput scaling benchmark.
+ @param taskCount The total number of calls scheduled for each combination of queue kind, pool size and number of producers.
+ */
++ (void) runThroughputBenchmarkWithTaskCount:(NSUInteger)taskCount;
+
+/**
+ @brief Runs the allocation benchmark, comparing heap allocations per call of block invocations and of functions with context.
+ <br/> Allocations are counted by wrapping the functions of the default malloc zone, and include those of pool threads.
+ @param taskCount The total number of calls scheduled for each scheduling method.
+ */
++ (void) runAllocationBenchmarkWithTaskCount:(NSUInteger)taskCount;
+
+
+@end
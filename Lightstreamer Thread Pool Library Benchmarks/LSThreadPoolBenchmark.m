@@ -0,0 +1,278 @@
+//
+//  LSThreadPoolBenchmark.m
+//  Lightstreamer Thread Pool Library Benchmarks
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSThreadPoolBenchmark.h"
+#import "LSThreadPoolLib.h"
+
+#import <stdatomic.h>
+
+#if defined(__APPLE__)
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#endif
+
+#define WARM_UP_TASK_COUNT                                (10000)
+#define COMPLETION_TIMEOUT                                 (60.0)
+
+#define ALLOCATION_POOL_SIZE                                  (4)
+
+
+#pragma mark -
+#pragma mark Allocation counting
+
+static atomic_ulong __allocationCount;
+
+#if defined(__APPLE__)
+
+static void *(*__originalMalloc)(malloc_zone_t *zone, size_t size);
+static void *(*__originalCalloc)(malloc_zone_t *zone, size_t count, size_t size);
+static void *(*__originalRealloc)(malloc_zone_t *zone, void *ptr, size_t size);
+
+static void *countingMalloc(malloc_zone_t *zone, size_t size) {
+    atomic_fetch_add_explicit(&__allocationCount, 1, memory_order_relaxed);
+    return __originalMalloc(zone, size);
+}
+
+static void *countingCalloc(malloc_zone_t *zone, size_t count, size_t size) {
+    atomic_fetch_add_explicit(&__allocationCount, 1, memory_order_relaxed);
+    return __originalCalloc(zone, count, size);
+}
+
+static void *countingRealloc(malloc_zone_t *zone, void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&__allocationCount, 1, memory_order_relaxed);
+    return __originalRealloc(zone, ptr, size);
+}
+
+static BOOL installAllocationCounter(void) {
+    if (__originalMalloc)
+        return YES;
+    
+    // The default zone is read-only, it must be unprotected to swap its functions
+    malloc_zone_t *zone= malloc_default_zone();
+    if (vm_protect(mach_task_self(), (vm_address_t) zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS)
+        return NO;
+    
+    __originalMalloc= zone->malloc;
+    __originalCalloc= zone->calloc;
+    __originalRealloc= zone->realloc;
+    
+    zone->malloc= countingMalloc;
+    zone->calloc= countingCalloc;
+    zone->realloc= countingRealloc;
+    
+    vm_protect(mach_task_self(), (vm_address_t) zone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+    
+    return YES;
+}
+
+#else // !defined(__APPLE__)
+
+// Malloc zones are specific to Apple platforms
+static BOOL installAllocationCounter(void) {
+    return NO;
+}
+
+#endif // defined(__APPLE__)
+
+
+#pragma mark -
+#pragma mark Benchmark function
+
+typedef struct {
+    atomic_ulong completed;
+    unsigned long total;
+    dispatch_semaphore_t done;
+} LSBenchmarkCounter;
+
+static void countCompletion(void *context) {
+    LSBenchmarkCounter *counter= (LSBenchmarkCounter *) context;
+    
+    if (atomic_fetch_add_explicit(&counter->completed, 1, memory_order_relaxed) + 1 == counter->total)
+        dispatch_semaphore_signal(counter->done);
+}
+
+
+#pragma mark -
+#pragma mark LSThreadPoolBenchmark extension
+
+@interface LSThreadPoolBenchmark ()
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (NSTimeInterval) timeTaskCount:(NSUInteger)taskCount onPool:(LSThreadPool *)pool producers:(NSUInteger)producers;
++ (double) allocationsPerTaskWithCount:(NSUInteger)taskCount onPool:(LSThreadPool *)pool functions:(BOOL)functions;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSThreadPoolBenchmark implementation
+
+@implementation LSThreadPoolBenchmark
+
+
+#pragma mark -
+#pragma mark Running
+
++ (void) runThroughputBenchmarkWithTaskCount:(NSUInteger)taskCount {
+    NSArray<NSNumber *> *queueOptions= @[@(LSThreadPoolOptionNone), @(LSThreadPoolOptionRingBufferQueue)];
+    NSArray<NSString *> *queueNames= @[@"array+condition", @"ring buffer"];
+    NSArray<NSNumber *> *poolSizes= @[@1, @2, @4, @8, @16];
+    NSArray<NSNumber *> *producerCounts= @[@1, @4, @16];
+
+    printf("\nLSThreadPool throughput, %lu empty tasks per run (tasks/sec)\n\n", (unsigned long) taskCount);
+    printf("%-16s %8s %10s %14s\n", "queue", "threads", "producers", "throughput");
+
+    for (NSUInteger i= 0; i < queueOptions.count; i++) {
+        LSThreadPoolOptions options= queueOptions[i].unsignedIntegerValue;
+
+        for (NSNumber *poolSize in poolSizes) {
+            for (NSNumber *producers in producerCounts) {
+                @autoreleasepool {
+                    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"Benchmark" size:poolSize.unsignedIntegerValue options:options];
+
+                    // Warm up, so that all threads are created before measuring
+                    [self timeTaskCount:WARM_UP_TASK_COUNT onPool:pool producers:producers.unsignedIntegerValue];
+
+                    NSTimeInterval elapsed= [self timeTaskCount:taskCount onPool:pool producers:producers.unsignedIntegerValue];
+
+                    printf("%-16s %8lu %10lu %14.0f\n",
+                           queueNames[i].UTF8String,
+                           poolSize.unsignedLongValue,
+                           producers.unsignedLongValue,
+                           (elapsed > 0.0) ? (taskCount / elapsed) : 0.0);
+
+                    [pool dispose];
+                }
+            }
+        }
+    }
+
+    printf("\n");
+}
+
++ (void) runAllocationBenchmarkWithTaskCount:(NSUInteger)taskCount {
+    if (!installAllocationCounter()) {
+        printf("Allocation counter could not be installed, allocation benchmark skipped\n");
+        return;
+    }
+    
+    printf("\nLSThreadPool allocations, %lu empty tasks per run on %d threads (allocations/task)\n\n", (unsigned long) taskCount, ALLOCATION_POOL_SIZE);
+    printf("%-24s %16s\n", "scheduling", "allocations");
+    
+    NSArray<NSString *> *modeNames= @[@"block invocation", @"function+context"];
+    for (NSUInteger i= 0; i < modeNames.count; i++) {
+        @autoreleasepool {
+            LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"Allocation benchmark" size:ALLOCATION_POOL_SIZE];
+            
+            // Warm up, so that threads, buffers and free lists are in place before counting
+            [self allocationsPerTaskWithCount:WARM_UP_TASK_COUNT onPool:pool functions:(i == 1)];
+            
+            double allocations= [self allocationsPerTaskWithCount:taskCount onPool:pool functions:(i == 1)];
+            
+            printf("%-24s %16.3f\n", modeNames[i].UTF8String, allocations);
+            
+            [pool dispose];
+        }
+    }
+    
+    printf("\n");
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (NSTimeInterval) timeTaskCount:(NSUInteger)taskCount onPool:(LSThreadPool *)pool producers:(NSUInteger)producers {
+    atomic_ulong *completed= malloc(sizeof(atomic_ulong));
+    atomic_init(completed, 0);
+
+    dispatch_semaphore_t done= dispatch_semaphore_create(0);
+    NSUInteger tasksPerProducer= taskCount / producers;
+    NSUInteger total= tasksPerProducer * producers;
+
+    LSInvocationBlock task= ^{
+        if (atomic_fetch_add_explicit(completed, 1, memory_order_relaxed) + 1 == total)
+            dispatch_semaphore_signal(done);
+    };
+
+    NSDate *begin= [NSDate date];
+
+    // Producers run concurrently on GCD threads
+    dispatch_apply(producers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+        @autoreleasepool {
+            for (NSUInteger j= 0; j < tasksPerProducer; j++)
+                [pool scheduleInvocationForBlock:task];
+        }
+    });
+
+    long timedOut= dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, (int64_t) (COMPLETION_TIMEOUT * NSEC_PER_SEC)));
+    NSTimeInterval elapsed= [[NSDate date] timeIntervalSinceDate:begin];
+
+    if (timedOut)
+        printf("Warning: run timed out with %lu of %lu tasks completed\n", atomic_load(completed), (unsigned long) total);
+
+    // Late tasks may still reference the counter if the run timed out
+    if (!timedOut)
+        free(completed);
+
+    return timedOut ? 0.0 : elapsed;
+}
+
++ (double) allocationsPerTaskWithCount:(NSUInteger)taskCount onPool:(LSThreadPool *)pool functions:(BOOL)functions {
+    LSBenchmarkCounter *counter= malloc(sizeof(LSBenchmarkCounter));
+    atomic_init(&counter->completed, 0);
+    counter->total= taskCount;
+    counter->done= dispatch_semaphore_create(0);
+    
+    LSInvocationBlock task= ^{
+        countCompletion(counter);
+    };
+    
+    unsigned long before= atomic_load(&__allocationCount);
+    
+    @autoreleasepool {
+        for (NSUInteger j= 0; j < taskCount; j++) {
+            if (functions)
+                [pool scheduleFunction:countCompletion context:counter];
+            else
+                [pool scheduleInvocationForBlock:task];
+        }
+    }
+    
+    long timedOut= dispatch_semaphore_wait(counter->done, dispatch_time(DISPATCH_TIME_NOW, (int64_t) (COMPLETION_TIMEOUT * NSEC_PER_SEC)));
+    
+    unsigned long allocations= atomic_load(&__allocationCount) - before;
+    
+    if (timedOut)
+        printf("Warning: run timed out with %lu of %lu tasks completed\n", atomic_load(&counter->completed), (unsigned long) taskCount);
+    
+    // Late tasks may still reference the counter if the run timed out
+    if (!timedOut)
+        free(counter);
+    
+    return (double) allocations / (double) taskCount;
+}
+
+
+@end
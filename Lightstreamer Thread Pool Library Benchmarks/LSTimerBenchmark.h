@@ -0,0 +1,52 @@
+//
+//  LSTimerBenchmark.h
+//  Lightstreamer Thread Pool Library Benchmarks
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief LSTimerBenchmark measures the scheduling throughput and the fire lateness of LSTimerThread.
+ <br/> Each run uses a new timer thread, so that its counters and histogram only reflect the run. Results are
+ printed as tables on the standard output. Only Foundation and libdispatch are used, so it runs on Linux under GNUstep too.
+ */
+@interface LSTimerBenchmark : NSObject
+
+
+#pragma mark -
+#pragma mark Running
+
+/**
+ @brief Runs the throughput benchmark: schedules the specified number of timers, far in the future, then schedules and
+ cancels more timers while those are pending, and finally cancels them all.
+ @param timerCounts The numbers of pending timers to run with.
+ */
++ (void) runThroughputBenchmarkWithTimerCounts:(nonnull NSArray<NSNumber *> *)timerCounts;
+
+/**
+ @brief Runs the lateness benchmark: schedules the specified number of timers spread over a time window, each busy for the
+ specified callback cost, and reports the percentiles of their fire lateness. Each combination is run with calls made on the
+ timer thread and with calls handed to a callback pool.
+ @param timerCounts The numbers of timers to run with.
+ @param callbackCosts The durations of the callbacks to run with, in seconds.
+ */
++ (void) runLatenessBenchmarkWithTimerCounts:(nonnull NSArray<NSNumber *> *)timerCounts callbackCosts:(nonnull NSArray<NSNumber *> *)callbackCosts;
+
+
+@end
@@ -0,0 +1,200 @@
+//
+//  LSTimerBenchmark.m
+//  Lightstreamer Thread Pool Library Benchmarks
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimerBenchmark.h"
+#import "LSThreadPoolLib.h"
+#import "LSMonotonicClock.h"
+
+#import <stdatomic.h>
+
+#define FAR_DELAY                                          (3600.0)
+#define FAR_DELAY_SPREAD_MSECS                            (100000)
+#define CHURN_COUNT                                       (100000)
+
+#define LATENESS_START_DELAY                                 (1.0)
+#define LATENESS_WINDOW                                      (2.0)
+#define LATENESS_POOL_SIZE                                     (4)
+#define COMPLETION_TIMEOUT                                 (120.0)
+
+
+#pragma mark -
+#pragma mark Benchmark callback
+
+typedef struct {
+    atomic_ulong completed;
+    unsigned long total;
+    uint64_t cost;
+    dispatch_semaphore_t done;
+} LSTimerBenchmarkCounter;
+
+static void spinAndCount(LSTimerBenchmarkCounter *counter) {
+    
+    // Busy wait, a sleep would not keep the thread occupied
+    if (counter->cost) {
+        uint64_t end= LSMonotonicNanoseconds() + counter->cost;
+        while (LSMonotonicNanoseconds() < end);
+    }
+    
+    if (atomic_fetch_add_explicit(&counter->completed, 1, memory_order_relaxed) + 1 == counter->total)
+        dispatch_semaphore_signal(counter->done);
+}
+
+
+#pragma mark -
+#pragma mark LSTimerBenchmark extension
+
+@interface LSTimerBenchmark ()
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (void) measureLatenessWithTimerCount:(NSUInteger)timerCount callbackCost:(NSTimeInterval)callbackCost callbackPool:(LSThreadPool *)callbackPool;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSTimerBenchmark implementation
+
+@implementation LSTimerBenchmark
+
+
+#pragma mark -
+#pragma mark Running
+
++ (void) runThroughputBenchmarkWithTimerCounts:(NSArray<NSNumber *> *)timerCounts {
+    printf("\nLSTimerThread throughput, %d schedule+cancel pairs of churn per run (operations/sec)\n\n", CHURN_COUNT);
+    printf("%10s %14s %14s %14s\n", "timers", "schedule", "churn", "cancel");
+    
+    for (NSNumber *timerCount in timerCounts) {
+        @autoreleasepool {
+            NSUInteger count= timerCount.unsignedIntegerValue;
+            LSTimerThread *timer= [[LSTimerThread alloc] initWithName:@"Timer benchmark"];
+            NSMutableArray<LSTimerToken *> *tokens= [[NSMutableArray alloc] initWithCapacity:count];
+            
+            LSInvocationBlock block= ^{};
+            
+            // Timers are spread over many slots, so that all levels of the wheel are used
+            uint64_t begin= LSMonotonicNanoseconds();
+            for (NSUInteger i= 0; i < count; i++)
+                [tokens addObject:[timer performBlock:block afterDelay:FAR_DELAY + (i % FAR_DELAY_SPREAD_MSECS) / 1000.0]];
+            
+            uint64_t scheduled= LSMonotonicNanoseconds();
+            
+            for (NSUInteger i= 0; i < CHURN_COUNT; i++) {
+                @autoreleasepool {
+                    LSTimerToken *token= [timer performBlock:block afterDelay:FAR_DELAY + (i % FAR_DELAY_SPREAD_MSECS) / 1000.0];
+                    [token cancel];
+                }
+            }
+            
+            uint64_t churned= LSMonotonicNanoseconds();
+            
+            for (LSTimerToken *token in tokens)
+                [token cancel];
+            
+            uint64_t cancelled= LSMonotonicNanoseconds();
+            
+            printf("%10lu %14.0f %14.0f %14.0f\n",
+                   (unsigned long) count,
+                   count / ((scheduled - begin) / 1000000000.0),
+                   (2 * CHURN_COUNT) / ((churned - scheduled) / 1000000000.0),
+                   count / ((cancelled - churned) / 1000000000.0));
+            
+            if (timer.pendingCount != 0)
+                printf("Warning: %lu timers still pending after cancellation\n", (unsigned long) timer.pendingCount);
+            
+            [timer dispose];
+        }
+    }
+    
+    printf("\n");
+}
+
++ (void) runLatenessBenchmarkWithTimerCounts:(NSArray<NSNumber *> *)timerCounts callbackCosts:(NSArray<NSNumber *> *)callbackCosts {
+    printf("\nLSTimerThread fire lateness, timers spread over %.1f s (milliseconds)\n\n", LATENESS_WINDOW);
+    printf("%10s %10s %8s %10s %10s %10s %10s\n", "timers", "cost (us)", "calls", "p50", "p99", "p99.9", "max");
+    
+    for (NSNumber *timerCount in timerCounts) {
+        for (NSNumber *callbackCost in callbackCosts) {
+            @autoreleasepool {
+                [self measureLatenessWithTimerCount:timerCount.unsignedIntegerValue callbackCost:callbackCost.doubleValue callbackPool:nil];
+                
+                LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"Timer benchmark callbacks" size:LATENESS_POOL_SIZE];
+                [self measureLatenessWithTimerCount:timerCount.unsignedIntegerValue callbackCost:callbackCost.doubleValue callbackPool:pool];
+                
+                [pool dispose];
+            }
+        }
+    }
+    
+    printf("\n");
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (void) measureLatenessWithTimerCount:(NSUInteger)timerCount callbackCost:(NSTimeInterval)callbackCost callbackPool:(LSThreadPool *)callbackPool {
+    LSTimerBenchmarkCounter *counter= malloc(sizeof(LSTimerBenchmarkCounter));
+    atomic_init(&counter->completed, 0);
+    counter->total= timerCount;
+    counter->cost= (uint64_t) (callbackCost * 1000000000.0);
+    counter->done= dispatch_semaphore_create(0);
+    
+    LSTimerThread *timer= [[LSTimerThread alloc] initWithName:@"Timer benchmark"];
+    timer.callbackPool= callbackPool;
+    
+    LSInvocationBlock block= ^{
+        spinAndCount(counter);
+    };
+    
+    @autoreleasepool {
+        for (NSUInteger i= 0; i < timerCount; i++)
+            [timer performBlock:block afterDelay:LATENESS_START_DELAY + (LATENESS_WINDOW * i) / timerCount];
+    }
+    
+    long timedOut= dispatch_semaphore_wait(counter->done, dispatch_time(DISPATCH_TIME_NOW, (int64_t) ((LATENESS_START_DELAY + LATENESS_WINDOW + COMPLETION_TIMEOUT) * NSEC_PER_SEC)));
+    
+    if (timedOut)
+        printf("Warning: run timed out with %lu of %lu timers fired\n", atomic_load(&counter->completed), (unsigned long) timerCount);
+    
+    LSHistogram *lateness= timer.fireLateness;
+    
+    printf("%10lu %10.1f %8s %10.3f %10.3f %10.3f %10.3f\n",
+           (unsigned long) timerCount,
+           callbackCost * 1000000.0,
+           callbackPool ? "pool" : "thread",
+           [lateness valueAtPercentile:50.0] * 1000.0,
+           [lateness valueAtPercentile:99.0] * 1000.0,
+           [lateness valueAtPercentile:99.9] * 1000.0,
+           lateness.max * 1000.0);
+    
+    [timer dispose];
+    
+    // Late timers may still reference the counter if the run timed out
+    if (!timedOut)
+        free(counter);
+}
+
+
+@end
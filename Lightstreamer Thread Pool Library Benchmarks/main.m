@@ -0,0 +1,54 @@
+//
+//  main.m
+//  Lightstreamer Thread Pool Library Benchmarks
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSThreadPoolBenchmark.h"
+#import "LSTimerBenchmark.h"
+
+#define DEFAULT_TASK_COUNT                              (1000000)
+
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+        NSUInteger taskCount= DEFAULT_TASK_COUNT;
+        if (argc > 1)
+            taskCount= (NSUInteger) strtoul(argv[1], NULL, 10);
+
+        // Optional suite selection, both run by default
+        const char *suite= (argc > 2) ? argv[2] : "all";
+        BOOL runPool= ((strcmp(suite, "all") == 0) || (strcmp(suite, "pool") == 0));
+        BOOL runTimers= ((strcmp(suite, "all") == 0) || (strcmp(suite, "timers") == 0));
+
+        if (runPool) {
+            [LSThreadPoolBenchmark runThroughputBenchmarkWithTaskCount:taskCount];
+            [LSThreadPoolBenchmark runAllocationBenchmarkWithTaskCount:taskCount];
+        }
+
+        if (runTimers) {
+            NSArray<NSNumber *> *timerCounts= @[@10000, @100000, @1000000];
+
+            [LSTimerBenchmark runThroughputBenchmarkWithTimerCounts:timerCounts];
+            [LSTimerBenchmark runLatenessBenchmarkWithTimerCounts:timerCounts callbackCosts:@[@0.0, @0.000001, @0.00001]];
+        }
+    }
+
+    return 0;
+}
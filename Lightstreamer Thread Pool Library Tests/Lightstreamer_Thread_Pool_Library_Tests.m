@@ -21,26 +21,117 @@
 #import <XCTest/XCTest.h>
 
 #import "LSThreadPoolLib.h"
+#import "LSLog+Internals.h"
+#import "LSURLDispatcher+Internals.h"
+#import "LSURLDispatchOperation+Internals.h"
+#import "LSURLEndPoint.h"
+
+#import <stdatomic.h>
 
 #define THREAD_POOL_TEST_COUNT                              (100)
 #define THREAD_POOL_TEST_MAX_COUNT_DELAY_MSECS              (200)
 #define THREAD_POOL_TEST_SEMAPHORE_NOTIFY_DELAY_MSECS      (1000)
 
+#define RING_BUFFER_TEST_SIZE                                 (4)
+#define RING_BUFFER_TEST_PRODUCERS                            (8)
+#define RING_BUFFER_TEST_COUNT                              (500)
+#define RING_BUFFER_TEST_TIMEOUT                             (30.0)
+
+#define WORK_STEALING_TEST_DEPTH                             (12)
+#define WORK_STEALING_TEST_TIMEOUT                           (30.0)
+
+#define PRIORITY_TEST_COUNT                                  (10)
+
+#define ELASTIC_TEST_CORE_SIZE                                (2)
+#define ELASTIC_TEST_MAX_SIZE                                 (4)
+#define ELASTIC_TEST_IDLE_TIMEOUT                             (0.5)
+
+#define FUTURE_TEST_COUNT                                    (10)
+#define FUTURE_TEST_TIMEOUT                                  (10.0)
+
+#define BOUNDED_QUEUE_TEST_CAPACITY                           (2)
+
+#define SERIAL_EXECUTOR_TEST_KEYS                            (50)
+#define SERIAL_EXECUTOR_TEST_COUNT                           (40)
+
+#define METRICS_TEST_COUNT                                  (100)
+#define METRICS_TEST_SIZE                                     (4)
+
+#define SHUTDOWN_TEST_COUNT                                  (10)
+#define SHUTDOWN_TEST_TIMEOUT                                (10.0)
+
+#define FUNCTION_TEST_COUNT                               (10000)
+#define FUNCTION_TEST_TIMEOUT                                (10.0)
+
+#define BATCH_TEST_COUNT                                    (100)
+#define BATCH_TEST_SIZE                                      (16)
+
+#define PLACEMENT_TEST_STACK_SIZE                        (512 * 1024)
+#define PLACEMENT_TEST_COUNT                                 (20)
+#define PLACEMENT_TEST_TIMEOUT                               (10.0)
+
+#define DELAYED_TEST_DELAY                                    (0.2)
+#define DELAYED_TEST_PERIOD                                  (0.05)
+#define DELAYED_TEST_RUNS                                      (3)
+
 #define TIMER_TEST_COUNT                                     (20)
 #define TIMER_TEST_INITIAL_DELAY                              (0.6)
 #define TIMER_TEST_INCREMENTAL_DELAY_MIN                      (0.3)
 #define TIMER_TEST_INCREMENTAL_DELAY_MAX                      (0.9)
 
+#define TIMER_WHEEL_TEST_COUNT                             (10000)
+#define TIMER_WHEEL_TEST_DELAY                                (0.3)
+
+#define TIMER_TOKEN_TEST_COUNT                               (10)
+#define TIMER_TOKEN_TEST_DELAY                                (0.2)
+
+#define HEARTBEAT_TEST_COUNT                                (1000)
+#define HEARTBEAT_TEST_PERIOD                                (0.2)
+#define HEARTBEAT_TEST_LEEWAY                                (0.1)
+#define HEARTBEAT_TEST_DURATION                              (1.0)
+
+#define CALLBACK_POOL_TEST_SHARDS                             (4)
+#define CALLBACK_POOL_TEST_SLOW_DELAY                         (0.1)
+#define CALLBACK_POOL_TEST_SLOW_DURATION                      (0.5)
+#define CALLBACK_POOL_TEST_FAST_DELAY                        (0.15)
+
+#define TIMER_COUNTERS_TEST_COUNT                            (10)
+#define TIMER_COUNTERS_TEST_DELAY                            (0.1)
+
+#define ASYNC_LOG_TEST_THREADS                                (4)
+#define ASYNC_LOG_TEST_COUNT                               (1000)
+#define ASYNC_LOG_TEST_BUFFER_SIZE                           (16)
+
+#define TRACE_TEST_COUNT                                     (20)
+#define TRACE_TEST_TIMER_DELAY                             (0.05)
+
 #define URL_DISPATCHER_TEST_URL                              (@"http://support.apple.com/downloads/DL1581/en_US/OSXUpdCombo10.8.2.dmg")
 #define URL_DISPATCHER_TEST_COUNT                            (20)
 #define URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES            (10000)
 #define URL_DISPATCHER_TEST_TIMEOUT                          (10.0)
 
+#define URL_ADMISSION_TEST_URL                               (@"http://127.0.0.1:1/")
+#define URL_ADMISSION_TEST_COUNT                                (8)
+#define URL_ADMISSION_TEST_TIMEOUT                            (5.0)
+
+#define URL_END_POINT_TEST_HOSTS                               (16)
+#define URL_END_POINT_TEST_LOOKUPS                            (256)
+#define URL_END_POINT_TEST_OPERATIONS                         (256)
+#define URL_END_POINT_TEST_LIMIT                                (2)
+
+
+#pragma mark -
+#pragma mark Function for function scheduling test
+
+static void incrementCounter(void *context) {
+    atomic_fetch_add_explicit((atomic_uint *) context, 1, memory_order_relaxed);
+}
+
 
 #pragma mark -
 #pragma mark Lightstreamer_Thread_Pool_Library_Tests declaration
 
-@interface Lightstreamer_Thread_Pool_Library_Tests : XCTestCase <LSURLDispatchDelegate> {
+@interface Lightstreamer_Thread_Pool_Library_Tests : XCTestCase <LSURLDispatchDelegate, LSLogDelegate> {
     LSThreadPool *_threadPool;
     
     NSUInteger _count;
@@ -51,6 +142,11 @@
     NSMutableDictionary<NSNumber *, NSNumber *> *_timerInvocations;
     
     NSMutableDictionary<NSString *, NSMutableData *> *_downloads;
+    NSMutableArray<LSURLDispatchOperation *> *_finishedOperations;
+    
+    NSMutableArray<NSString *> *_typedArguments;
+    
+    NSMutableArray<NSString *> *_logLines;
 }
 
 
@@ -60,6 +156,21 @@
 - (void) saveInvocationTime:(NSNumber *)number;
 
 
+#pragma mark -
+#pragma mark Callback for work stealing test
+
+- (void) splitWorkOnPool:(LSThreadPool *)pool depth:(NSUInteger)depth;
+
+
+#pragma mark -
+#pragma mark Callbacks for typed arguments test
+
+- (void) saveInteger:(NSInteger)value;
+- (void) saveDouble:(double)value;
+- (void) savePointedInteger:(NSInteger *)pointer;
+- (void) saveString:(NSString *)string withString:(NSString *)otherString;
+
+
 @end
 
 
@@ -154,190 +265,1577 @@
     XCTAssertTrue(_count == THREAD_POOL_TEST_COUNT, @"Not all invocations have been performed (count: %lu)", (unsigned long) _count);
 }
 
-#if !TARGET_OS_SIMULATOR
-
 /**
- @brief This test will schedule different calls at random intervals and check they are actually executed when expected.
- <br/> NOTE: It is skipped on iOS and tvOS since they seem to have timers with much worse resolution than macOS (even in the simulator).
+ @brief This test will block all the threads of a ring buffer pool while 8 producers schedule 500 calls each,
+ more than the ring can hold, so that calls in excess spill to the overflow.
+ <br/> Then it releases the threads and checks that every call has been run exactly once.
  */
-- (void) testTimer {
+- (void) testRingBufferQueue {
     [LSLog disableAllSourceTypes];
-    [LSLog enableSourceType:LOG_SRC_TIMER];
     
-    // Instantiate the timer and wait for the thread to start
-    [LSTimerThread sharedTimer];
-    [NSThread sleepForTimeInterval:0.1];
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Ring buffer test" size:RING_BUFFER_TEST_SIZE options:LSThreadPoolOptionRingBufferQueue];
     
-    _timerBegin= [NSDate date];
-    _timerInvocations= [NSMutableDictionary dictionary];
+    NSCondition *gate= [[NSCondition alloc] init];
+    __block BOOL released= NO;
     
-    NSTimeInterval delay= TIMER_TEST_INITIAL_DELAY;
-    NSMutableArray<NSNumber *> *expectedDelays= [NSMutableArray array];
+    for (int i= 0; i < RING_BUFFER_TEST_SIZE; i++) {
+        [pool scheduleInvocationForBlock:^{
+            [gate lock];
+            
+            while (!released)
+                [gate wait];
+            
+            [gate unlock];
+        }];
+    }
     
-    NSLog(@"Scheduling %d delayed invocations...", TIMER_TEST_COUNT);
+    // One counter per call, so that a call run twice or never is spotted
+    atomic_uint *counters= calloc(RING_BUFFER_TEST_PRODUCERS * RING_BUFFER_TEST_COUNT, sizeof(atomic_uint));
     
-    for (int i= 0; i < TIMER_TEST_COUNT; i++) {
-        [expectedDelays addObject:@([[NSDate date] timeIntervalSinceDate:_timerBegin] + delay)];
-        
-        switch (i % 2) {
-            case 0: {
-                [[LSTimerThread sharedTimer] performBlock:^{
-
-                    [self saveInvocationTime:@(i)];
-                
-                } afterDelay:delay];
-                break;
-            }
-                
-            case 1: {
-                [[LSTimerThread sharedTimer] performSelector:@selector(saveInvocationTime:)
-                                                    onTarget:self
-                                                  withObject:@(i)
-                                                  afterDelay:delay];
-                break;
-            }
-        }
-        
-        int random= 0;
-        int result= SecRandomCopyBytes(kSecRandomDefault, sizeof(random), (uint8_t *) &random);
-        if (result == 0)
-            delay += TIMER_TEST_INCREMENTAL_DELAY_MIN + ((double) (ABS(random) % (int)((TIMER_TEST_INCREMENTAL_DELAY_MAX - TIMER_TEST_INCREMENTAL_DELAY_MIN) * 1000.0))) / 1000.0;
-        else
-            delay += (TIMER_TEST_INCREMENTAL_DELAY_MIN + TIMER_TEST_INCREMENTAL_DELAY_MAX) / 2.0;
-    }
+    dispatch_apply(RING_BUFFER_TEST_PRODUCERS, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+        for (int i= 0; i < RING_BUFFER_TEST_COUNT; i++)
+            [pool scheduleFunction:incrementCounter context:(void *) &counters[producer * RING_BUFFER_TEST_COUNT + i]];
+    });
     
-    // Get the last expected delay and wait for it
-    NSNumber *lastExpectedDelay= expectedDelays.lastObject;
-    NSTimeInterval wait= lastExpectedDelay.doubleValue + TIMER_TEST_INCREMENTAL_DELAY_MIN;
+    // Threads are blocked, hence all calls are still queued, well beyond the ring capacity
+    NSUInteger queueSize= pool.queueSize;
+    XCTAssertTrue(queueSize >= RING_BUFFER_TEST_PRODUCERS * RING_BUFFER_TEST_COUNT, @"Wrong queue size (size: %lu)", (unsigned long) queueSize);
     
-    NSLog(@"Scheduled %d delayed invocations, waiting %.1f secs...", TIMER_TEST_COUNT, wait);
+    [gate lock];
+    released= YES;
+    [gate broadcast];
+    [gate unlock];
     
-    [NSThread sleepForTimeInterval:wait];
+    [pool shutdown];
+    XCTAssertTrue([pool awaitTerminationWithTimeout:RING_BUFFER_TEST_TIMEOUT], @"Pool did not terminate");
     
-    for (int i= 0; i < TIMER_TEST_COUNT; i++) {
-        NSNumber *expectedDelay= expectedDelays[i];
-        NSNumber *actualDelay= _timerInvocations[@(i)];
-        
-        XCTAssertEqualWithAccuracy([expectedDelay doubleValue], [actualDelay doubleValue], 0.05);
+    NSUInteger wrongCount= 0;
+    for (int i= 0; i < RING_BUFFER_TEST_PRODUCERS * RING_BUFFER_TEST_COUNT; i++) {
+        if (atomic_load(&counters[i]) != 1)
+            wrongCount++;
     }
+    
+    free(counters);
+    
+    XCTAssertTrue(wrongCount == 0, @"Calls not run exactly once (count: %lu)", (unsigned long) wrongCount);
 }
 
-#endif // !TARGET_OS_SIMULATOR
-
 /**
- @brief This test will run many concurrent downloads of the same file. Each download will terminate after 10 KB has been received.
- <br/> You can monitor the pool size and thread execution on the console. Short requests are used to download the data. Consider
- that some of the requests may genuinely timeout due to network conditions, these requests are not counted to check if the test
- succeeded.
+ @brief This test will recursively split a job in two halves, down to a specified depth, on a work stealing thread pool.
+ <br/> Each leaf adds 1 to a counter, the last one unlocks a semaphore. Halves are scheduled from within the pool, hence
+ they go to the local deques of threads and are stolen by idle threads.
  */
-- (void) testURLDispatcher {
+- (void) testWorkStealing {
     [LSLog disableAllSourceTypes];
-    [LSLog enableSourceType:LOG_SRC_URL_DISPATCHER];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
     
-    _count= 0;
-    _failedCount= 0;
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"WorkStealingTest" size:4 options:LSThreadPoolOptionWorkStealing];
     
-    _downloads= [[NSMutableDictionary alloc] init];
+    _count= 0;
     
     _semaphore= [[NSCondition alloc] init];
     [_semaphore lock];
     
-    // Use a download long enough
-    NSURL *url= [NSURL URLWithString:URL_DISPATCHER_TEST_URL];
-    NSMutableURLRequest *req= [NSMutableURLRequest requestWithURL:url];
-    [req setTimeoutInterval:URL_DISPATCHER_TEST_TIMEOUT];
+    [pool scheduleInvocationForBlock:^{
+        [self splitWorkOnPool:pool depth:WORK_STEALING_TEST_DEPTH];
+    }];
     
-    for (int i= 0; i < URL_DISPATCHER_TEST_COUNT; i++)
-        [[LSURLDispatcher sharedDispatcher] dispatchShortRequest:req delegate:self];
+    NSLog(@"TestWorkStealing: job scheduled, waiting...");
     
-    NSLog(@"TestThreadPool: operations dispatched, waiting...");
+    BOOL signaled= YES;
+    while (signaled && (_count < (1 << WORK_STEALING_TEST_DEPTH)))
+        signaled= [_semaphore waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:WORK_STEALING_TEST_TIMEOUT]];
     
-    [_semaphore wait];
     [_semaphore unlock];
     
     _semaphore= nil;
     
-    NSUInteger sum= 0;
-    for (NSMutableData *download in _downloads.allValues)
-        sum += download.length;
+    [pool dispose];
     
-    XCTAssertTrue(sum > _count * URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES, @"Downloads total does not sum up to required mininum (sum: %lu, minimum: %lu)", (unsigned long) sum, (unsigned long) _count * URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES);
+    XCTAssertTrue(_count == (1 << WORK_STEALING_TEST_DEPTH), @"Not all leaves have been performed (count: %lu)", (unsigned long) _count);
 }
 
-#pragma mark -
-#pragma mark Callback for timer test
+/**
+ @brief This test will fill the queue of a single-thread pool with calls of low and high priority, while the thread is busy.
+ <br/> Once the thread is released, all the high priority calls must be executed before the low priority ones.
+ */
+- (void) testPriorities {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
+    
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"PriorityTest" size:1];
+    
+    // Keep the only thread busy until the queue has been filled
+    NSCondition *gate= [[NSCondition alloc] init];
+    __block BOOL released= NO;
+    
+    [pool scheduleInvocationForBlock:^{
+        [gate lock];
+        while (!released)
+            [gate wait];
+        [gate unlock];
+    }];
+    
+    NSMutableArray<NSNumber *> *order= [[NSMutableArray alloc] initWithCapacity:2 * PRIORITY_TEST_COUNT];
+    for (int i= 0; i < PRIORITY_TEST_COUNT; i++) {
+        [pool scheduleInvocationForBlock:^{
+            @synchronized (order) {
+                [order addObject:@(LSThreadPoolPriorityLow)];
+            }
+        } priority:LSThreadPoolPriorityLow];
+        
+        [pool scheduleInvocationForBlock:^{
+            @synchronized (order) {
+                [order addObject:@(LSThreadPoolPriorityHigh)];
+            }
+        } priority:LSThreadPoolPriorityHigh];
+    }
+    
+    XCTAssertTrue([pool queueSizeForPriority:LSThreadPoolPriorityLow] == PRIORITY_TEST_COUNT, @"Wrong low priority queue size");
+    XCTAssertTrue([pool queueSizeForPriority:LSThreadPoolPriorityHigh] == PRIORITY_TEST_COUNT, @"Wrong high priority queue size");
+    XCTAssertTrue([pool queueSizeForPriority:LSThreadPoolPriorityNormal] == 0, @"Wrong normal priority queue size");
+    
+    LSInvocation *last= [pool scheduleInvocationForBlock:^{} priority:LSThreadPoolPriorityLow];
 
-- (void) saveInvocationTime:(NSNumber *)number {
-    _timerInvocations[number]= @([[NSDate date] timeIntervalSinceDate:_timerBegin]);
+    [gate lock];
+    released= YES;
+    [gate broadcast];
+    [gate unlock];
+    
+    [last waitForCompletion];
+    
+    [pool dispose];
+    
+    XCTAssertTrue(order.count == 2 * PRIORITY_TEST_COUNT, @"Not all calls have been performed");
+    for (NSUInteger i= 0; i < order.count; i++) {
+        LSThreadPoolPriority expected= (i < PRIORITY_TEST_COUNT) ? LSThreadPoolPriorityHigh : LSThreadPoolPriorityLow;
+        XCTAssertTrue(order[i].unsignedIntegerValue == expected, @"Call %lu performed out of priority order", (unsigned long) i);
+    }
 }
 
-
-#pragma mark -
-#pragma mark Methods of LSURLDispatchDelegate
-
-- (void) dispatchOperation:(LSURLDispatchOperation *)operation willSendRequestForAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge {
-    [challenge.sender performDefaultHandlingForAuthenticationChallenge:challenge];
+/**
+ @brief This test will prestart the core threads of a pool, grow it up to its max size with blocking calls,
+ then check that once idle it shrinks back to its core size, and not below.
+ */
+- (void) testElasticSizing {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
+    
+    LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:ELASTIC_TEST_MAX_SIZE];
+    configuration.coreSize= ELASTIC_TEST_CORE_SIZE;
+    configuration.idleTimeout= ELASTIC_TEST_IDLE_TIMEOUT;
+    
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"ElasticTest" configuration:configuration];
+    
+    NSUInteger started= [pool prestartCoreThreads];
+    XCTAssertTrue(started == ELASTIC_TEST_CORE_SIZE, @"Wrong number of prestarted threads (started: %lu)", (unsigned long) started);
+    XCTAssertTrue(pool.currentSize == ELASTIC_TEST_CORE_SIZE, @"Wrong pool size after prestart (size: %lu)", (unsigned long) pool.currentSize);
+    
+    // Give the prestarted threads time to park
+    [NSThread sleepForTimeInterval:0.1];
+    
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] initWithCapacity:ELASTIC_TEST_MAX_SIZE];
+    for (int i= 0; i < ELASTIC_TEST_MAX_SIZE; i++) {
+        [invocations addObject:[pool scheduleInvocationForBlock:^{
+            [NSThread sleepForTimeInterval:0.2];
+        }]];
+    }
+    
+    XCTAssertTrue(pool.currentSize == ELASTIC_TEST_MAX_SIZE, @"Pool did not grow to max size (size: %lu)", (unsigned long) pool.currentSize);
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    // Wait for threads in excess to retire
+    [NSThread sleepForTimeInterval:4.0 * ELASTIC_TEST_IDLE_TIMEOUT];
+    
+    XCTAssertTrue(pool.currentSize == ELASTIC_TEST_CORE_SIZE, @"Pool did not shrink to core size (size: %lu)", (unsigned long) pool.currentSize);
+    
+    [pool dispose];
 }
 
-- (void) dispatchOperation:(LSURLDispatchOperation *)operation didReceiveResponse:(NSURLResponse *)response {}
-
-- (void) dispatchOperation:(LSURLDispatchOperation *)operation didReceiveData:(NSData *)data {
+/**
+ @brief This test will schedule a number of futures, transform their results with continuations and combine them.
+ <br/> It also checks that a failing stage propagates its error down the chain, and that waiting for an invocation returns.
+ */
+- (void) testFutures {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
     
-    // Get a key for the operation
-    NSString *opKey= [NSString stringWithFormat:@"%p", operation];
-    BOOL finished= NO;
-
-    NSUInteger downloaded= 0;
-    @synchronized (self) {
+    NSMutableArray<LSFuture *> *futures= [[NSMutableArray alloc] initWithCapacity:FUTURE_TEST_COUNT];
+    for (int i= 0; i < FUTURE_TEST_COUNT; i++) {
+        LSFuture *future= [[_threadPool scheduleFutureForBlock:^id {
+            return @(i);
+            
+        }] then:^id (NSNumber *result) {
+            return @(result.intValue * 2);
+            
+        } onPool:_threadPool];
         
-        // Get current download for this operation
-        NSMutableData *download= _downloads[opKey];
-        if (!download) {
-            download= [[NSMutableData alloc] init];
+        [futures addObject:future];
+    }
+    
+    LSFuture *all= [LSFuture whenAll:futures];
+    XCTAssertTrue([all waitForCompletionWithTimeout:FUTURE_TEST_TIMEOUT], @"Combined future did not complete");
+    XCTAssertFalse(all.failed, @"Combined future failed with error: %@", all.error);
+    
+    NSArray<NSNumber *> *results= all.result;
+    for (int i= 0; i < FUTURE_TEST_COUNT; i++)
+        XCTAssertTrue(results[i].intValue == i * 2, @"Wrong result at index %d", i);
+    
+    // A failing stage skips the following ones
+    __block BOOL skippedStageCalled= NO;
+    LSFuture *failed= [[[_threadPool scheduleFutureForBlock:^id {
+        @throw [NSException exceptionWithName:@"FutureTestException" reason:@"Failing on purpose" userInfo:nil];
+        
+    }] then:^id (id result) {
+        skippedStageCalled= YES;
+        return result;
+        
+    } onPool:_threadPool] then:^id (id result) {
+        skippedStageCalled= YES;
+        return result;
+        
+    } onPool:nil];
+    
+    XCTAssertTrue([failed waitForCompletionWithTimeout:FUTURE_TEST_TIMEOUT], @"Failing future did not complete");
+    XCTAssertTrue(failed.failed, @"Failing future did not fail");
+    XCTAssertTrue(failed.error.code == LS_FUTURE_ERROR_CODE_EXCEPTION, @"Wrong error code");
+    XCTAssertFalse(skippedStageCalled, @"Stage following a failure has been called");
+    
+    // Waiting for a plain invocation must return
+    LSInvocation *invocation= [_threadPool scheduleInvocationForBlock:^{
+        [NSThread sleepForTimeInterval:0.1];
+    }];
+    
+    [invocation waitForCompletion];
+}
 
-            _downloads[opKey]= download;
+/**
+ @brief This test will fill the bounded queue of a pool while its only thread is busy, and check that further calls
+ are rejected with an error, and that the oldest calls are dropped in favor of newer ones with the drop-oldest policy,
+ function calls included.
+ */
+- (void) testBoundedQueue {
+    [LSLog disableAllSourceTypes];
+    
+    for (int round= 0; round < 2; round++) {
+        LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:1];
+        configuration.queueCapacity= BOUNDED_QUEUE_TEST_CAPACITY;
+        configuration.queueFullPolicy= (round == 0) ? LSThreadPoolQueueFullPolicyFail : LSThreadPoolQueueFullPolicyDropOldest;
+        
+        LSThreadPool *pool= [LSThreadPool poolWithName:@"Bounded queue test" configuration:configuration];
+        
+        // Keep the only thread busy until released
+        NSCondition *gate= [[NSCondition alloc] init];
+        __block BOOL started= NO;
+        __block BOOL released= NO;
+        
+        [pool scheduleInvocationForBlock:^{
+            [gate lock];
+            
+            started= YES;
+            [gate broadcast];
+            
+            while (!released)
+                [gate wait];
+            
+            [gate unlock];
+        }];
+        
+        [gate lock];
+        while (!started)
+            [gate wait];
+        [gate unlock];
+        
+        // Fill the queue, then go beyond
+        NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] init];
+        for (int i= 0; i < BOUNDED_QUEUE_TEST_CAPACITY + 1; i++)
+            [invocations addObject:[pool scheduleInvocationForBlock:^{}]];
+        
+        if (round == 0) {
+            XCTAssertTrue(invocations.lastObject.error.code == LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL, @"Call in excess has not been rejected");
+            XCTAssertTrue(pool.rejectedCount == 1, @"Wrong rejected count (count: %lu)", (unsigned long) pool.rejectedCount);
+            
+        } else {
+            XCTAssertTrue(invocations.firstObject.error.code == LS_THREAD_POOL_ERROR_CODE_DROPPED, @"Oldest call has not been dropped");
+            XCTAssertTrue(pool.droppedCount == 1, @"Wrong dropped count (count: %lu)", (unsigned long) pool.droppedCount);
         }
         
-        // Append data if we haven't reached the limit
-        if (download.length < URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES) {
-            [download appendData:data];
-
-            downloaded= download.length;
+        // Function calls take the place of queued invocations, then drop each other
+        atomic_uint counter;
+        atomic_init(&counter, 0);
+        
+        if (round == 1) {
+            for (int i= 0; i < BOUNDED_QUEUE_TEST_CAPACITY + 1; i++)
+                XCTAssertTrue([pool scheduleFunction:incrementCounter context:(void *) &counter], @"Function not scheduled");
             
-            // If we have reached the limit count the operation as finished
-            if (downloaded >= URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES) {
-                [operation cancel];
-                _count++;
-            }
+            XCTAssertTrue(pool.droppedCount == BOUNDED_QUEUE_TEST_CAPACITY + 2, @"Wrong dropped count (count: %lu)", (unsigned long) pool.droppedCount);
         }
-    
-        if (_failedCount + _count == URL_DISPATCHER_TEST_COUNT)
-            finished= YES;
-    }
-    
-    if (downloaded)
-        NSLog(@"Operation %p: downloaded: %lu bytes (count: %lu, failed count: %lu)", operation, (unsigned long) downloaded, (unsigned long) _count, (unsigned long) _failedCount);
-
-    if (finished) {
         
-        // Notifiy end of downloads
-        [_semaphore lock];
-        [_semaphore signal];
-        [_semaphore unlock];
+        [gate lock];
+        released= YES;
+        [gate broadcast];
+        [gate unlock];
+        
+        // Every call completes, either performed or rejected
+        for (LSInvocation *invocation in invocations)
+            [invocation waitForCompletion];
+        
+        [pool shutdown];
+        XCTAssertTrue([pool awaitTerminationWithTimeout:FUNCTION_TEST_TIMEOUT], @"Pool did not terminate");
+        
+        if (round == 1) {
+            unsigned int count= atomic_load(&counter);
+            XCTAssertTrue(count == BOUNDED_QUEUE_TEST_CAPACITY, @"Wrong number of functions run (count: %u)", count);
+        }
     }
 }
 
-- (void) dispatchOperation:(LSURLDispatchOperation *)operation didFailWithError:(NSError *)error {
-    NSLog(@"Operation %p: download failed with error: %@ (count: %lu, failed count: %lu)", operation, error, (unsigned long) _count, (unsigned long) _failedCount);
-
-    BOOL finished= NO;
+/**
+ @brief This test will chain continuations on a pool with a full bounded queue, and check that continuations rejected
+ or dropped by the pool are still called, so that the derived futures complete while the pool thread is busy.
+ */
+- (void) testFutureContinuationRejection {
+    [LSLog disableAllSourceTypes];
     
-    @synchronized (self) {
-        _failedCount++;
-        
-        if (_failedCount + _count == URL_DISPATCHER_TEST_COUNT)
-            finished= YES;
-    }
+    LSFuture *source= [LSFuture futureWithResult:@(1)];
+    
+    for (int round= 0; round < 2; round++) {
+        LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:1];
+        configuration.queueCapacity= 1;
+        configuration.queueFullPolicy= (round == 0) ? LSThreadPoolQueueFullPolicyFail : LSThreadPoolQueueFullPolicyDropOldest;
+        
+        LSThreadPool *pool= [LSThreadPool poolWithName:@"Future continuation rejection test" configuration:configuration];
+        
+        // Keep the only thread busy until released
+        NSCondition *gate= [[NSCondition alloc] init];
+        __block BOOL started= NO;
+        __block BOOL released= NO;
+        
+        [pool scheduleInvocationForBlock:^{
+            [gate lock];
+            
+            started= YES;
+            [gate broadcast];
+            
+            while (!released)
+                [gate wait];
+            
+            [gate unlock];
+        }];
+        
+        [gate lock];
+        while (!started)
+            [gate wait];
+        [gate unlock];
+        
+        LSFuture *derived= nil;
+        if (round == 0) {
+            
+            // The queue is full, the continuation is rejected
+            [pool scheduleInvocationForBlock:^{}];
+            
+            derived= [source then:^id (NSNumber *result) {
+                return @(result.intValue * 2);
+                
+            } onPool:pool];
+            
+        } else {
+            
+            // The continuation fills the queue, then it is dropped by a newer call
+            derived= [source then:^id (NSNumber *result) {
+                return @(result.intValue * 2);
+                
+            } onPool:pool];
+            
+            [pool scheduleInvocationForBlock:^{}];
+        }
+        
+        XCTAssertTrue([derived waitForCompletionWithTimeout:FUTURE_TEST_TIMEOUT], @"Derived future did not complete");
+        XCTAssertFalse(derived.failed, @"Derived future failed with error: %@", derived.error);
+        XCTAssertTrue([derived.result intValue] == 2, @"Wrong derived result");
+        
+        [gate lock];
+        released= YES;
+        [gate broadcast];
+        [gate unlock];
+        
+        [pool dispose];
+    }
+}
+
+/**
+ @brief This test will schedule calls for a number of keys on a serial executor, and check that calls with the same key
+ never overlap and run in the order they have been scheduled, and that keys are released once their calls are done.
+ */
+- (void) testSerialExecutor {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
+    
+    LSSerialExecutor *executor= [LSSerialExecutor executorWithPool:_threadPool];
+    
+    // Per-key state, touched by calls of its key only
+    NSMutableArray<NSMutableArray<NSNumber *> *> *sequences= [[NSMutableArray alloc] initWithCapacity:SERIAL_EXECUTOR_TEST_KEYS];
+    for (int key= 0; key < SERIAL_EXECUTOR_TEST_KEYS; key++)
+        [sequences addObject:[[NSMutableArray alloc] init]];
+    
+    __block BOOL overlapped= NO;
+    
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] init];
+    for (int i= 0; i < SERIAL_EXECUTOR_TEST_COUNT; i++) {
+        for (int key= 0; key < SERIAL_EXECUTOR_TEST_KEYS; key++) {
+            NSMutableArray<NSNumber *> *sequence= sequences[key];
+            
+            [invocations addObject:[executor scheduleInvocationForKey:@(key) block:^{
+                NSUInteger count= sequence.count;
+                [sequence addObject:@(i)];
+                
+                // Give calls of the same key a chance to overlap
+                [NSThread sleepForTimeInterval:0.0001];
+                
+                if (sequence.count != count + 1)
+                    overlapped= YES;
+            }]];
+        }
+    }
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    XCTAssertFalse(overlapped, @"Calls with the same key overlapped");
+    
+    for (int key= 0; key < SERIAL_EXECUTOR_TEST_KEYS; key++) {
+        NSArray<NSNumber *> *sequence= sequences[key];
+        
+        XCTAssertTrue(sequence.count == SERIAL_EXECUTOR_TEST_COUNT, @"Wrong number of calls for key %d", key);
+        for (int i= 0; i < sequence.count; i++)
+            XCTAssertTrue(sequence[i].intValue == i, @"Call out of order for key %d", key);
+    }
+    
+    // Keys are released as soon as their last call completes
+    for (int i= 0; (i < 100) && (executor.activeKeyCount > 0); i++)
+        [NSThread sleepForTimeInterval:0.01];
+    
+    XCTAssertTrue(executor.activeKeyCount == 0, @"Keys not released (count: %lu)", (unsigned long) executor.activeKeyCount);
+}
+
+/**
+ @brief This test will run a number of calls, some of them failing, on a pool with metrics enabled, and check
+ the counters and histograms of its metrics snapshot.
+ */
+- (void) testMetrics {
+    [LSLog disableAllSourceTypes];
+    
+    LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:METRICS_TEST_SIZE];
+    configuration.metricsEnabled= YES;
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Metrics test" configuration:configuration];
+    
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] initWithCapacity:METRICS_TEST_COUNT];
+    for (int i= 0; i < METRICS_TEST_COUNT; i++) {
+        [invocations addObject:[pool scheduleInvocationForBlock:^{
+            [NSThread sleepForTimeInterval:0.001];
+            
+            if (i % 10 == 0)
+                @throw [NSException exceptionWithName:@"MetricsTestException" reason:@"Failing on purpose" userInfo:nil];
+        }]];
+    }
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    LSThreadPoolMetrics *metrics= pool.metrics;
+    XCTAssertNotNil(metrics, @"Metrics not available");
+    
+    XCTAssertTrue(metrics.submittedCount == METRICS_TEST_COUNT, @"Wrong submitted count (count: %llu)", metrics.submittedCount);
+    XCTAssertTrue(metrics.completedCount == METRICS_TEST_COUNT - METRICS_TEST_COUNT / 10, @"Wrong completed count (count: %llu)", metrics.completedCount);
+    XCTAssertTrue(metrics.failedCount == METRICS_TEST_COUNT / 10, @"Wrong failed count (count: %llu)", metrics.failedCount);
+    XCTAssertTrue((metrics.threadsCreatedCount > 0) && (metrics.threadsCreatedCount <= METRICS_TEST_SIZE), @"Wrong threads created count (count: %llu)", metrics.threadsCreatedCount);
+    
+    XCTAssertTrue(metrics.executionTime.count == METRICS_TEST_COUNT, @"Wrong execution time count");
+    XCTAssertTrue(metrics.queueWait.count == METRICS_TEST_COUNT, @"Wrong queue wait count");
+    XCTAssertTrue([metrics.executionTime valueAtPercentile:50.0] >= 0.001 * 0.875, @"Median execution time too short");
+    XCTAssertTrue([metrics.executionTime valueAtPercentile:100.0] == metrics.executionTime.max, @"Max execution time mismatch");
+    
+    // Metrics are off by default
+    XCTAssertNil(_threadPool.metrics, @"Metrics available though not enabled");
+    
+    [pool dispose];
+}
+
+/**
+ @brief This test will shut down a pool gracefully, checking that queued calls are run, and then shut down
+ another pool discarding its queue, checking that queued calls are cancelled and never run.
+ */
+- (void) testShutdown {
+    [LSLog disableAllSourceTypes];
+    
+    // Graceful shutdown: queued calls are run
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Shutdown test" size:2];
+    
+    __block int runCount= 0;
+    NSObject *runCountLock= [[NSObject alloc] init];
+    
+    for (int i= 0; i < SHUTDOWN_TEST_COUNT; i++) {
+        [pool scheduleInvocationForBlock:^{
+            [NSThread sleepForTimeInterval:0.01];
+            
+            @synchronized (runCountLock) {
+                runCount++;
+            }
+        }];
+    }
+    
+    [pool shutdown];
+    XCTAssertTrue(pool.shutDown, @"Pool not shut down");
+    XCTAssertThrows([pool scheduleInvocationForBlock:^{}], @"Call accepted after shutdown");
+    
+    XCTAssertTrue([pool awaitTerminationWithTimeout:SHUTDOWN_TEST_TIMEOUT], @"Pool did not terminate");
+    XCTAssertTrue(runCount == SHUTDOWN_TEST_COUNT, @"Queued calls not run (count: %d)", runCount);
+    
+    // Immediate shutdown: queued calls are cancelled
+    pool= [LSThreadPool poolWithName:@"Shutdown now test" size:1];
+    
+    NSCondition *gate= [[NSCondition alloc] init];
+    __block BOOL started= NO;
+    __block BOOL released= NO;
+    
+    [pool scheduleInvocationForBlock:^{
+        [gate lock];
+        
+        started= YES;
+        [gate broadcast];
+        
+        while (!released)
+            [gate wait];
+        
+        [gate unlock];
+    }];
+    
+    [gate lock];
+    while (!started)
+        [gate wait];
+    [gate unlock];
+    
+    __block BOOL queuedCallRun= NO;
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] initWithCapacity:SHUTDOWN_TEST_COUNT];
+    for (int i= 0; i < SHUTDOWN_TEST_COUNT; i++) {
+        [invocations addObject:[pool scheduleInvocationForBlock:^{
+            queuedCallRun= YES;
+        }]];
+    }
+    
+    // A single call may be cancelled while queued
+    XCTAssertTrue([invocations.firstObject cancel], @"Queued call not cancelled");
+    XCTAssertTrue(invocations.firstObject.cancelled, @"Cancelled call not marked as such");
+    XCTAssertTrue(invocations.firstObject.error.code == LS_INVOCATION_ERROR_CODE_CANCELLED, @"Wrong error code of cancelled call");
+    XCTAssertFalse([invocations.firstObject cancel], @"Call cancelled twice");
+    
+    NSArray<LSInvocation *> *cancelled= [pool shutdownNow];
+    XCTAssertTrue(cancelled.count == SHUTDOWN_TEST_COUNT - 1, @"Wrong number of cancelled calls (count: %lu)", (unsigned long) cancelled.count);
+    
+    [gate lock];
+    released= YES;
+    [gate broadcast];
+    [gate unlock];
+    
+    XCTAssertTrue([pool awaitTerminationWithTimeout:SHUTDOWN_TEST_TIMEOUT], @"Pool did not terminate");
+    XCTAssertFalse(queuedCallRun, @"Cancelled call has been run");
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+}
+
+/**
+ @brief This test will schedule calls with two object arguments and with integer, double and pointer
+ arguments, and check each method receives its arguments intact.
+ */
+- (void) testTypedArguments {
+    _typedArguments= [[NSMutableArray alloc] init];
+    
+    NSInteger pointed= 42;
+    
+    NSArray<LSInvocation *> *invocations= @[
+        [_threadPool scheduleInvocationForTarget:self selector:@selector(saveString:withString:) withObject:@"first" withObject:@"second"],
+        [_threadPool scheduleInvocationForTarget:self selector:@selector(saveInteger:) withInteger:-7],
+        [_threadPool scheduleInvocationForTarget:self selector:@selector(saveDouble:) withDouble:0.25],
+        [_threadPool scheduleInvocationForTarget:self selector:@selector(savePointedInteger:) withPointer:&pointed]
+    ];
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    NSSet<NSString *> *expected= [NSSet setWithArray:@[@"first,second", @"-7", @"0.25", @"42"]];
+    
+    @synchronized (_typedArguments) {
+        XCTAssertTrue([[NSSet setWithArray:_typedArguments] isEqualToSet:expected], @"Wrong arguments received: %@", _typedArguments);
+    }
+    
+    XCTAssertTrue([invocations.firstObject.secondArgument isEqual:@"second"], @"Wrong second argument of invocation");
+}
+
+/**
+ @brief This test will schedule 10000 plain C functions, each adding 1 to a shared counter, then shut down
+ the pool gracefully and check that all of them have been run.
+ */
+- (void) testFunctionScheduling {
+    [LSLog disableAllSourceTypes];
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Function test" size:4];
+    
+    atomic_uint counter;
+    atomic_init(&counter, 0);
+    
+    for (int i= 0; i < FUNCTION_TEST_COUNT; i++)
+        XCTAssertTrue([pool scheduleFunction:incrementCounter context:(void *) &counter], @"Function not scheduled");
+    
+    [pool shutdown];
+    XCTAssertThrows([pool scheduleFunction:incrementCounter context:(void *) &counter], @"Function accepted after shutdown");
+    
+    XCTAssertTrue([pool awaitTerminationWithTimeout:FUNCTION_TEST_TIMEOUT], @"Pool did not terminate");
+    
+    unsigned int count= atomic_load(&counter);
+    XCTAssertTrue(count == FUNCTION_TEST_COUNT, @"Wrong number of functions run (count: %u)", count);
+}
+
+/**
+ @brief This test will block the only thread of a pool while 100 calls are queued, then release it and check
+ that the calls have been taken from the queue in batches, and all of them have been run.
+ */
+- (void) testBatchedDequeue {
+    [LSLog disableAllSourceTypes];
+    
+    LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:1];
+    configuration.batchSize= BATCH_TEST_SIZE;
+    configuration.autoreleaseDrainInterval= 0.01;
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Batch test" configuration:configuration];
+    
+    NSCondition *gate= [[NSCondition alloc] init];
+    __block BOOL released= NO;
+    
+    [pool scheduleInvocationForBlock:^{
+        [gate lock];
+        
+        while (!released)
+            [gate wait];
+        
+        [gate unlock];
+    }];
+    
+    __block int runCount= 0;
+    NSObject *runCountLock= [[NSObject alloc] init];
+    
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] initWithCapacity:BATCH_TEST_COUNT];
+    for (int i= 0; i < BATCH_TEST_COUNT; i++) {
+        [invocations addObject:[pool scheduleInvocationForBlock:^{
+            @synchronized (runCountLock) {
+                runCount++;
+            }
+        }]];
+    }
+    
+    [gate lock];
+    released= YES;
+    [gate broadcast];
+    [gate unlock];
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    XCTAssertTrue(runCount == BATCH_TEST_COUNT, @"Not all calls have been run (count: %d)", runCount);
+    
+    double averageBatchSize= pool.averageBatchSize;
+    XCTAssertTrue((averageBatchSize > 1.0) && (averageBatchSize <= BATCH_TEST_SIZE), @"Wrong average batch size (size: %f)", averageBatchSize);
+    // The blocking call, then full batches for the queued ones
+    uint64_t batchCount= pool.batchCount;
+    XCTAssertTrue(batchCount <= 1 + (BATCH_TEST_COUNT + BATCH_TEST_SIZE - 1) / BATCH_TEST_SIZE, @"Calls not taken in full batches (count: %llu)", batchCount);
+    
+    [pool dispose];
+}
+
+/**
+ @brief This test will run calls on a pool with a custom stack size, scheduling policy and pinned threads, checking
+ the stack size is applied, and then on a pool partitioned by NUMA node, checking all calls are run.
+ */
+- (void) testThreadPlacement {
+    [LSLog disableAllSourceTypes];
+    
+    LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:2];
+    configuration.stackSize= PLACEMENT_TEST_STACK_SIZE;
+    configuration.schedulingPolicy= LSThreadPoolSchedulingPolicyBatch;
+    configuration.pinsThreadsToCPUs= YES;
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Placement test" configuration:configuration];
+    
+    __block NSUInteger stackSize= 0;
+    [[pool scheduleInvocationForBlock:^{
+        stackSize= [NSThread currentThread].stackSize;
+    }] waitForCompletion];
+    
+    XCTAssertTrue(stackSize == PLACEMENT_TEST_STACK_SIZE, @"Wrong stack size (size: %lu)", (unsigned long) stackSize);
+    
+    [pool dispose];
+    
+    // Partitioned pool: one partition per node, at least one
+    LSPartitionedThreadPool *partitionedPool= [LSPartitionedThreadPool poolWithName:@"Partitioned test" configuration:[LSThreadPoolConfiguration configurationWithMaxSize:2]];
+    XCTAssertTrue(partitionedPool.partitions.count > 0, @"No partitions");
+    
+    __block int runCount= 0;
+    NSObject *runCountLock= [[NSObject alloc] init];
+    
+    for (int i= 0; i < PLACEMENT_TEST_COUNT; i++) {
+        [partitionedPool scheduleInvocationForBlock:^{
+            @synchronized (runCountLock) {
+                runCount++;
+            }
+        }];
+    }
+    
+    [partitionedPool shutdown];
+    XCTAssertTrue([partitionedPool awaitTerminationWithTimeout:PLACEMENT_TEST_TIMEOUT], @"Partitioned pool did not terminate");
+    XCTAssertTrue(runCount == PLACEMENT_TEST_COUNT, @"Not all calls have been run (count: %d)", runCount);
+}
+
+/**
+ @brief This test will schedule delayed calls on a pool, checking one is not run before its delay and another one
+ is never run once cancelled, then a periodic call, checking it runs repeatedly and no more after cancellation.
+ */
+- (void) testDelayedScheduling {
+    [LSLog disableAllSourceTypes];
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Delayed test" size:2];
+    
+    NSDate *start= [NSDate date];
+    __block NSTimeInterval elapsed= 0.0;
+    
+    LSInvocation *invocation= [pool scheduleInvocationForBlock:^{
+        elapsed= -[start timeIntervalSinceNow];
+    } afterDelay:DELAYED_TEST_DELAY];
+    
+    __block BOOL cancelledRun= NO;
+    LSInvocation *cancelled= [pool scheduleInvocationForBlock:^{
+        cancelledRun= YES;
+    } afterDelay:DELAYED_TEST_DELAY / 2.0];
+    
+    XCTAssertTrue(pool.delayedQueueSize == 2, @"Wrong delayed queue size (size: %lu)", (unsigned long) pool.delayedQueueSize);
+    XCTAssertTrue([cancelled cancel], @"Delayed call not cancelled");
+    
+    [invocation waitForCompletion];
+    
+    XCTAssertTrue(elapsed >= DELAYED_TEST_DELAY, @"Delayed call run too early (elapsed: %f)", elapsed);
+    XCTAssertFalse(cancelledRun, @"Cancelled call has been run");
+    
+    // Periodic call
+    __block int runCount= 0;
+    NSObject *runCountLock= [[NSObject alloc] init];
+    
+    LSPeriodicInvocation *periodic= [pool scheduleInvocationForBlock:^{
+        @synchronized (runCountLock) {
+            runCount++;
+        }
+    } initialDelay:0.0 fixedRate:DELAYED_TEST_PERIOD];
+    
+    [NSThread sleepForTimeInterval:DELAYED_TEST_PERIOD * (DELAYED_TEST_RUNS + 1)];
+    
+    XCTAssertTrue([periodic cancel], @"Periodic call not cancelled");
+    [periodic waitForCompletion];
+    
+    int count= 0;
+    @synchronized (runCountLock) {
+        count= runCount;
+    }
+    
+    XCTAssertTrue(count >= DELAYED_TEST_RUNS, @"Periodic call not run repeatedly (count: %d)", count);
+    XCTAssertTrue(periodic.executionCount == (NSUInteger) count, @"Wrong execution count (count: %lu)", (unsigned long) periodic.executionCount);
+    
+    [NSThread sleepForTimeInterval:DELAYED_TEST_PERIOD * 2];
+    
+    @synchronized (runCountLock) {
+        XCTAssertTrue(runCount == count, @"Periodic call run after cancellation (count: %d)", runCount);
+    }
+    
+    [pool dispose];
+}
+
+#if !TARGET_OS_SIMULATOR
+
+/**
+ @brief This test will schedule different calls at random intervals and check they are actually executed when expected.
+ <br/> NOTE: It is skipped on iOS and tvOS since they seem to have timers with much worse resolution than macOS (even in the simulator).
+ */
+- (void) testTimer {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_TIMER];
+    
+    // Instantiate the timer and wait for the thread to start
+    [LSTimerThread sharedTimer];
+    [NSThread sleepForTimeInterval:0.1];
+    
+    _timerBegin= [NSDate date];
+    _timerInvocations= [NSMutableDictionary dictionary];
+    
+    NSTimeInterval delay= TIMER_TEST_INITIAL_DELAY;
+    NSMutableArray<NSNumber *> *expectedDelays= [NSMutableArray array];
+    
+    NSLog(@"Scheduling %d delayed invocations...", TIMER_TEST_COUNT);
+    
+    for (int i= 0; i < TIMER_TEST_COUNT; i++) {
+        [expectedDelays addObject:@([[NSDate date] timeIntervalSinceDate:_timerBegin] + delay)];
+        
+        switch (i % 2) {
+            case 0: {
+                [[LSTimerThread sharedTimer] performBlock:^{
+
+                    [self saveInvocationTime:@(i)];
+                
+                } afterDelay:delay];
+                break;
+            }
+                
+            case 1: {
+                [[LSTimerThread sharedTimer] performSelector:@selector(saveInvocationTime:)
+                                                    onTarget:self
+                                                  withObject:@(i)
+                                                  afterDelay:delay];
+                break;
+            }
+        }
+        
+        int random= 0;
+        int result= SecRandomCopyBytes(kSecRandomDefault, sizeof(random), (uint8_t *) &random);
+        if (result == 0)
+            delay += TIMER_TEST_INCREMENTAL_DELAY_MIN + ((double) (ABS(random) % (int)((TIMER_TEST_INCREMENTAL_DELAY_MAX - TIMER_TEST_INCREMENTAL_DELAY_MIN) * 1000.0))) / 1000.0;
+        else
+            delay += (TIMER_TEST_INCREMENTAL_DELAY_MIN + TIMER_TEST_INCREMENTAL_DELAY_MAX) / 2.0;
+    }
+    
+    // Get the last expected delay and wait for it
+    NSNumber *lastExpectedDelay= expectedDelays.lastObject;
+    NSTimeInterval wait= lastExpectedDelay.doubleValue + TIMER_TEST_INCREMENTAL_DELAY_MIN;
+    
+    NSLog(@"Scheduled %d delayed invocations, waiting %.1f secs...", TIMER_TEST_COUNT, wait);
+    
+    [NSThread sleepForTimeInterval:wait];
+    
+    for (int i= 0; i < TIMER_TEST_COUNT; i++) {
+        NSNumber *expectedDelay= expectedDelays[i];
+        NSNumber *actualDelay= _timerInvocations[@(i)];
+        
+        XCTAssertEqualWithAccuracy([expectedDelay doubleValue], [actualDelay doubleValue], 0.05);
+    }
+}
+
+#endif // !TARGET_OS_SIMULATOR
+
+/**
+ @brief This test will set many timers on the same target, cancel half of them by argument, and check
+ only the others are fired.
+ */
+- (void) testTimerCancellation {
+    [LSLog disableAllSourceTypes];
+    
+    LSTimerThread *timer= [LSTimerThread sharedTimer];
+    
+    _timerBegin= [NSDate date];
+    _timerInvocations= [NSMutableDictionary dictionary];
+    
+    for (int i= 0; i < TIMER_WHEEL_TEST_COUNT; i++)
+        [timer performSelector:@selector(saveInvocationTime:) onTarget:self withObject:@(i) afterDelay:TIMER_WHEEL_TEST_DELAY + (i % 100) / 1000.0];
+    
+    for (int i= 0; i < TIMER_WHEEL_TEST_COUNT; i += 2)
+        [timer cancelPreviousPerformRequestsWithTarget:self selector:@selector(saveInvocationTime:) object:@(i)];
+    
+    [NSThread sleepForTimeInterval:TIMER_WHEEL_TEST_DELAY * 3];
+    
+    XCTAssertTrue(_timerInvocations.count == TIMER_WHEEL_TEST_COUNT / 2, @"Wrong number of timers fired (count: %lu)", (unsigned long) _timerInvocations.count);
+    
+    for (int i= 0; i < TIMER_WHEEL_TEST_COUNT; i++) {
+        NSNumber *actualDelay= _timerInvocations[@(i)];
+        
+        if (i % 2 == 0) {
+            XCTAssertNil(actualDelay, @"Cancelled timer fired (timer: %d)", i);
+            
+        } else {
+            XCTAssertNotNil(actualDelay, @"Timer not fired (timer: %d)", i);
+            XCTAssertTrue(actualDelay.doubleValue >= TIMER_WHEEL_TEST_DELAY, @"Timer fired too early (timer: %d, delay: %f)", i, actualDelay.doubleValue);
+        }
+    }
+}
+
+/**
+ @brief This test will set two identical timers and cancel one by its token, checking only the other one fires,
+ then set a group of timers and cancel the group, checking none of them fires.
+ */
+- (void) testTimerTokens {
+    [LSLog disableAllSourceTypes];
+    
+    LSTimerThread *timer= [LSTimerThread sharedTimer];
+    
+    _timerBegin= [NSDate date];
+    _timerInvocations= [NSMutableDictionary dictionary];
+    
+    LSTimerToken *firstToken= [timer performSelector:@selector(saveInvocationTime:) onTarget:self withObject:@(0) afterDelay:TIMER_TOKEN_TEST_DELAY];
+    LSTimerToken *secondToken= [timer performSelector:@selector(saveInvocationTime:) onTarget:self withObject:@(1) afterDelay:TIMER_TOKEN_TEST_DELAY];
+    
+    XCTAssertTrue([firstToken cancel], @"Timer not cancelled");
+    XCTAssertFalse([firstToken cancel], @"Timer cancelled twice");
+    XCTAssertTrue(firstToken.cancelled, @"Timer not marked as cancelled");
+    
+    // Group of timers
+    LSTimerGroup *group= [LSTimerGroup group];
+    __block int groupFiredCount= 0;
+    
+    for (int i= 0; i < TIMER_TOKEN_TEST_COUNT; i++) {
+        [timer performBlock:^{
+            groupFiredCount++;
+        } afterDelay:TIMER_TOKEN_TEST_DELAY group:group];
+    }
+    
+    XCTAssertTrue(group.count == TIMER_TOKEN_TEST_COUNT, @"Wrong group count (count: %lu)", (unsigned long) group.count);
+    
+    NSUInteger cancelledCount= [group cancel];
+    XCTAssertTrue(cancelledCount == TIMER_TOKEN_TEST_COUNT, @"Wrong number of timers cancelled (count: %lu)", (unsigned long) cancelledCount);
+    XCTAssertTrue(group.count == 0, @"Group not empty after cancellation (count: %lu)", (unsigned long) group.count);
+    
+    [NSThread sleepForTimeInterval:TIMER_TOKEN_TEST_DELAY * 3];
+    
+    XCTAssertNil(_timerInvocations[@(0)], @"Cancelled timer fired");
+    XCTAssertNotNil(_timerInvocations[@(1)], @"Timer not fired");
+    XCTAssertTrue(secondToken.fired, @"Timer not marked as fired");
+    XCTAssertFalse([secondToken cancel], @"Fired timer cancelled");
+    XCTAssertTrue(groupFiredCount == 0, @"Cancelled group timers fired (count: %d)", groupFiredCount);
+}
+
+/**
+ @brief This test will set many repeating timers at a fixed rate with a leeway, check they are fired
+ with far fewer wakeups of the timer thread, then cancel them and check they stop.
+ */
+- (void) testRepeatingTimers {
+    [LSLog disableAllSourceTypes];
+    
+    LSTimerThread *timer= [LSTimerThread sharedTimer];
+    NSMutableArray<LSTimerToken *> *tokens= [NSMutableArray arrayWithCapacity:HEARTBEAT_TEST_COUNT];
+    
+    // Fired only by the timer thread
+    __block NSUInteger firedCount= 0;
+    
+    NSUInteger wakeUpCountBefore= timer.wakeUpCount;
+    
+    for (int i= 0; i < HEARTBEAT_TEST_COUNT; i++) {
+        LSTimerToken *token= [timer performBlock:^{
+            firedCount++;
+        } initialDelay:HEARTBEAT_TEST_PERIOD fixedRate:HEARTBEAT_TEST_PERIOD leeway:HEARTBEAT_TEST_LEEWAY];
+        
+        [tokens addObject:token];
+    }
+    
+    [NSThread sleepForTimeInterval:HEARTBEAT_TEST_DURATION];
+    
+    NSUInteger wakeUpCount= timer.wakeUpCount - wakeUpCountBefore;
+    
+    for (LSTimerToken *token in tokens)
+        XCTAssertTrue([token cancel], @"Repeating timer not cancelled");
+    
+    // Let runs already firing complete
+    [NSThread sleepForTimeInterval:HEARTBEAT_TEST_LEEWAY];
+    
+    NSUInteger cancelledFiredCount= firedCount;
+    
+    XCTAssertTrue(cancelledFiredCount >= HEARTBEAT_TEST_COUNT * 2, @"Too few runs of repeating timers (count: %lu)", (unsigned long) cancelledFiredCount);
+    XCTAssertTrue(wakeUpCount * 10 < cancelledFiredCount, @"Repeating timers not coalesced (wake ups: %lu, runs: %lu)", (unsigned long) wakeUpCount, (unsigned long) cancelledFiredCount);
+    XCTAssertTrue(tokens[0].repeating, @"Timer not marked as repeating");
+    XCTAssertTrue(tokens[0].fireCount > 1, @"Repeating timer fired once only (count: %lu)", (unsigned long) tokens[0].fireCount);
+    
+    [NSThread sleepForTimeInterval:HEARTBEAT_TEST_PERIOD * 3];
+    
+    XCTAssertTrue(firedCount == cancelledFiredCount, @"Cancelled repeating timers fired (count: %lu)", (unsigned long) (firedCount - cancelledFiredCount));
+}
+
+/**
+ @brief This test will set a slow and a fast timer on a sharded timer with a callback pool, and check the fast one
+ is not delayed by the slow one, then check cancellation by target reaches the shard of the target.
+ <br/> It also checks that a one-shot timer is still fired when its callback pool rejects it.
+ */
+- (void) testTimerCallbackPool {
+    [LSLog disableAllSourceTypes];
+    
+    LSShardedTimerThread *timer= [LSShardedTimerThread timerWithName:@"CallbackPoolTest" shardCount:CALLBACK_POOL_TEST_SHARDS];
+    timer.callbackPool= _threadPool;
+    
+    XCTAssertTrue(timer.shards.count == CALLBACK_POOL_TEST_SHARDS, @"Wrong number of shards (count: %lu)", (unsigned long) timer.shards.count);
+    XCTAssertTrue([timer shardForOwner:self] == [timer shardForOwner:self], @"Owner assigned to different shards");
+    
+    NSDate *begin= [NSDate date];
+    __block NSTimeInterval fastDelay= 0.0;
+    
+    // The same owner puts both timers on the same shard
+    [timer performBlock:^{
+        [NSThread sleepForTimeInterval:CALLBACK_POOL_TEST_SLOW_DURATION];
+    } afterDelay:CALLBACK_POOL_TEST_SLOW_DELAY owner:self];
+    
+    [timer performBlock:^{
+        fastDelay= [[NSDate date] timeIntervalSinceDate:begin];
+    } afterDelay:CALLBACK_POOL_TEST_FAST_DELAY owner:self];
+    
+    _timerInvocations= [NSMutableDictionary dictionary];
+    
+    [timer performSelector:@selector(saveInvocationTime:) onTarget:self withObject:@(0) afterDelay:CALLBACK_POOL_TEST_FAST_DELAY];
+    [timer cancelPreviousPerformRequestsWithTarget:self];
+    
+    [NSThread sleepForTimeInterval:CALLBACK_POOL_TEST_SLOW_DELAY + CALLBACK_POOL_TEST_SLOW_DURATION * 2];
+    
+    XCTAssertTrue(fastDelay >= CALLBACK_POOL_TEST_FAST_DELAY, @"Fast timer not fired or fired too early (delay: %f)", fastDelay);
+    XCTAssertTrue(fastDelay < CALLBACK_POOL_TEST_SLOW_DELAY + CALLBACK_POOL_TEST_SLOW_DURATION, @"Fast timer delayed by slow timer (delay: %f)", fastDelay);
+    XCTAssertTrue(_timerInvocations.count == 0, @"Cancelled timer fired");
+    XCTAssertTrue(timer.fireLateness.count == 2, @"Wrong number of fire lateness samples (count: %llu)", (unsigned long long) timer.fireLateness.count);
+    
+    [timer dispose];
+    
+    // A one-shot timer rejected by a full pool is still made
+    LSThreadPoolConfiguration *configuration= [LSThreadPoolConfiguration configurationWithMaxSize:1];
+    configuration.queueCapacity= 1;
+    configuration.queueFullPolicy= LSThreadPoolQueueFullPolicyFail;
+    
+    LSThreadPool *pool= [LSThreadPool poolWithName:@"Callback pool rejection test" configuration:configuration];
+    
+    NSCondition *gate= [[NSCondition alloc] init];
+    __block BOOL started= NO;
+    __block BOOL released= NO;
+    
+    [pool scheduleInvocationForBlock:^{
+        [gate lock];
+        
+        started= YES;
+        [gate broadcast];
+        
+        while (!released)
+            [gate wait];
+        
+        [gate unlock];
+    }];
+    
+    [gate lock];
+    while (!started)
+        [gate wait];
+    [gate unlock];
+    
+    [pool scheduleInvocationForBlock:^{}];
+    
+    LSTimerThread *rejectingTimer= [[LSTimerThread alloc] initWithName:@"CallbackPoolRejectionTest"];
+    rejectingTimer.callbackPool= pool;
+    
+    __block BOOL fired= NO;
+    [rejectingTimer performBlock:^{
+        fired= YES;
+    } afterDelay:CALLBACK_POOL_TEST_FAST_DELAY];
+    
+    [NSThread sleepForTimeInterval:CALLBACK_POOL_TEST_FAST_DELAY * 4];
+    
+    XCTAssertTrue(fired, @"Timer rejected by the pool not fired");
+    
+    [gate lock];
+    released= YES;
+    [gate broadcast];
+    [gate unlock];
+    
+    [rejectingTimer dispose];
+    [pool dispose];
+}
+
+/**
+ @brief This test will set some timers on a new timer thread, cancel half of them, and check the pending,
+ fired and cancelled counters along the way.
+ */
+- (void) testTimerCounters {
+    [LSLog disableAllSourceTypes];
+    
+    LSTimerThread *timer= [[LSTimerThread alloc] initWithName:@"CountersTest"];
+    NSMutableArray<LSTimerToken *> *tokens= [NSMutableArray arrayWithCapacity:TIMER_COUNTERS_TEST_COUNT];
+    
+    for (int i= 0; i < TIMER_COUNTERS_TEST_COUNT; i++)
+        [tokens addObject:[timer performBlock:^{} afterDelay:TIMER_COUNTERS_TEST_DELAY]];
+    
+    XCTAssertTrue(timer.pendingCount == TIMER_COUNTERS_TEST_COUNT, @"Wrong pending count (count: %lu)", (unsigned long) timer.pendingCount);
+    
+    for (int i= 0; i < TIMER_COUNTERS_TEST_COUNT; i += 2)
+        [tokens[i] cancel];
+    
+    XCTAssertTrue(timer.pendingCount == TIMER_COUNTERS_TEST_COUNT / 2, @"Wrong pending count after cancellation (count: %lu)", (unsigned long) timer.pendingCount);
+    XCTAssertTrue(timer.cancelledCount == TIMER_COUNTERS_TEST_COUNT / 2, @"Wrong cancelled count (count: %llu)", (unsigned long long) timer.cancelledCount);
+    
+    [NSThread sleepForTimeInterval:TIMER_COUNTERS_TEST_DELAY * 3];
+    
+    XCTAssertTrue(timer.pendingCount == 0, @"Wrong pending count after firing (count: %lu)", (unsigned long) timer.pendingCount);
+    XCTAssertTrue(timer.firedCount == TIMER_COUNTERS_TEST_COUNT / 2, @"Wrong fired count (count: %llu)", (unsigned long long) timer.firedCount);
+    XCTAssertTrue(timer.maxFireLateness == timer.fireLateness.max, @"Max fire lateness differs from histogram");
+    
+    [timer dispose];
+}
+
+/**
+ @brief This test will log many lines from concurrent threads in asynchronous mode, with a small buffer that blocks
+ when full, and check all lines are delivered after a flush, in order for each thread.
+ */
+- (void) testAsynchronousLog {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_THREAD_POOL];
+    
+    _logLines= [NSMutableArray array];
+    [LSLog setDelegate:self];
+    
+    [LSLog enableAsynchronousModeWithBufferSize:ASYNC_LOG_TEST_BUFFER_SIZE overflowPolicy:LSLogOverflowPolicyBlock];
+    XCTAssertTrue([LSLog isAsynchronousModeEnabled], @"Asynchronous mode not enabled");
+    
+    dispatch_apply(ASYNC_LOG_TEST_THREADS, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+        for (int i= 0; i < ASYNC_LOG_TEST_COUNT; i++)
+            [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"AsyncLogTest %lu %d", (unsigned long) thread, i];
+    });
+    
+    [LSLog flush];
+    
+    NSMutableDictionary<NSString *, NSNumber *> *lastIndexes= [NSMutableDictionary dictionary];
+    NSUInteger lineCount= 0;
+    
+    for (NSString *line in _logLines) {
+        NSRange marker= [line rangeOfString:@"AsyncLogTest "];
+        if (marker.location == NSNotFound)
+            continue;
+        
+        NSArray<NSString *> *fields= [[line substringFromIndex:NSMaxRange(marker)] componentsSeparatedByString:@" "];
+        NSNumber *lastIndex= lastIndexes[fields[0]];
+        
+        XCTAssertTrue((!lastIndex) || (lastIndex.intValue < fields[1].intValue), @"Lines of the same thread out of order (line: %@)", line);
+        lastIndexes[fields[0]]= @(fields[1].intValue);
+        
+        lineCount++;
+    }
+    
+    XCTAssertTrue(lineCount == ASYNC_LOG_TEST_THREADS * ASYNC_LOG_TEST_COUNT, @"Wrong number of lines delivered (count: %lu)", (unsigned long) lineCount);
+    
+    [LSLog disableAsynchronousMode];
+    [LSLog setDelegate:nil];
+    [LSLog disableAllSourceTypes];
+    
+    XCTAssertFalse([LSLog isAsynchronousModeEnabled], @"Asynchronous mode not disabled");
+}
+
+/**
+ @brief This test will trace calls of a thread pool and timers, some fired and some cancelled, and check the export is
+ a valid Chrome trace with all their slices.
+ */
+- (void) testTracing {
+    [LSLog disableAllSourceTypes];
+    
+    [LSTrace startTracing];
+    XCTAssertTrue([LSTrace isTracing], @"Tracing not started");
+    
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:@"TracingTest" size:2];
+    LSTimerThread *timer= [[LSTimerThread alloc] initWithName:@"TracingTest"];
+    
+    NSMutableArray<LSInvocation *> *invocations= [NSMutableArray arrayWithCapacity:TRACE_TEST_COUNT];
+    for (int i= 0; i < TRACE_TEST_COUNT; i++)
+        [invocations addObject:[pool scheduleInvocationForBlock:^{}]];
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation waitForCompletion];
+    
+    [timer performBlock:^{} afterDelay:TRACE_TEST_TIMER_DELAY];
+    [[timer performBlock:^{} afterDelay:TRACE_TEST_TIMER_DELAY * 10] cancel];
+    
+    [NSThread sleepForTimeInterval:TRACE_TEST_TIMER_DELAY * 4];
+    
+    [LSTrace stopTracing];
+    XCTAssertFalse([LSTrace isTracing], @"Tracing not stopped");
+    
+    NSError *error= nil;
+    NSDictionary *trace= [NSJSONSerialization JSONObjectWithData:[LSTrace chromeTraceData] options:0 error:&error];
+    XCTAssertTrue(trace != nil, @"Trace is not valid JSON (error: %@)", error);
+    
+    // Other tests may have left threads running, hence counts are checked as lower bounds
+    NSUInteger queuedCount= 0;
+    NSUInteger startedCount= 0;
+    NSUInteger finishedCount= 0;
+    NSUInteger timerEndCount= 0;
+    
+    for (NSDictionary *event in trace[@"traceEvents"]) {
+        NSString *phase= event[@"ph"];
+        NSString *category= event[@"cat"];
+        
+        if ([category isEqualToString:@"call"]) {
+            if ([phase isEqualToString:@"b"])
+                queuedCount++;
+            else if ([phase isEqualToString:@"B"])
+                startedCount++;
+            else if ([phase isEqualToString:@"E"])
+                finishedCount++;
+            
+        } else if ([category isEqualToString:@"timer"] && [phase isEqualToString:@"e"]) {
+            timerEndCount++;
+        }
+    }
+    
+    XCTAssertTrue(queuedCount >= TRACE_TEST_COUNT, @"Wrong number of enqueued calls (count: %lu)", (unsigned long) queuedCount);
+    XCTAssertTrue(startedCount >= TRACE_TEST_COUNT, @"Wrong number of started calls (count: %lu)", (unsigned long) startedCount);
+    XCTAssertTrue(finishedCount >= TRACE_TEST_COUNT, @"Wrong number of finished calls (count: %lu)", (unsigned long) finishedCount);
+    XCTAssertTrue(timerEndCount >= 2, @"Wrong number of fired or cancelled timers (count: %lu)", (unsigned long) timerEndCount);
+    XCTAssertTrue([LSTrace droppedEventCount] == 0, @"Events dropped (count: %llu)", (unsigned long long) [LSTrace droppedEventCount]);
+    
+    [LSTrace clear];
+    XCTAssertTrue([LSTrace eventCount] == 0, @"Events not cleared (count: %lu)", (unsigned long) [LSTrace eventCount]);
+    
+    [timer dispose];
+    [pool dispose];
+}
+
+/**
+ @brief This test will run many concurrent downloads of the same file. Each download will terminate after 10 KB has been received.
+ <br/> You can monitor the pool size and thread execution on the console. Short requests are used to download the data. Consider
+ that some of the requests may genuinely timeout due to network conditions, these requests are not counted to check if the test
+ succeeded.
+ */
+- (void) testURLDispatcher {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_URL_DISPATCHER];
+    
+    _count= 0;
+    _failedCount= 0;
+    
+    _downloads= [[NSMutableDictionary alloc] init];
+    
+    _semaphore= [[NSCondition alloc] init];
+    [_semaphore lock];
+    
+    // Use a download long enough
+    NSURL *url= [NSURL URLWithString:URL_DISPATCHER_TEST_URL];
+    NSMutableURLRequest *req= [NSMutableURLRequest requestWithURL:url];
+    [req setTimeoutInterval:URL_DISPATCHER_TEST_TIMEOUT];
+    
+    for (int i= 0; i < URL_DISPATCHER_TEST_COUNT; i++)
+        [[LSURLDispatcher sharedDispatcher] dispatchShortRequest:req delegate:self];
+    
+    NSLog(@"TestThreadPool: operations dispatched, waiting...");
+    
+    [_semaphore wait];
+    [_semaphore unlock];
+    
+    _semaphore= nil;
+    
+    NSUInteger sum= 0;
+    for (NSMutableData *download in _downloads.allValues)
+        sum += download.length;
+    
+    XCTAssertTrue(sum > _count * URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES, @"Downloads total does not sum up to required mininum (sum: %lu, minimum: %lu)", (unsigned long) sum, (unsigned long) _count * URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES);
+}
+
+/**
+ @brief This test will run concurrent synchronous requests to a closed port of the same end-point, with a single
+ connection per end-point. Requests in excess wait their turn in the queue of the end-point, and are handed the
+ connection as soon as the previous one fails: all of them must complete.
+ */
+- (void) testURLDispatcherAdmission {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_URL_DISPATCHER];
+    
+    LSURLDispatcher *dispatcher= [[LSURLDispatcher alloc] initWithMaxRequestsPerEndPoint:1 maxLongRunningRequestsPerEndPoint:1];
+    
+    NSMutableURLRequest *req= [NSMutableURLRequest requestWithURL:[NSURL URLWithString:URL_ADMISSION_TEST_URL]];
+    [req setTimeoutInterval:URL_ADMISSION_TEST_TIMEOUT];
+    
+    __block NSUInteger completedCount= 0;
+    
+    dispatch_apply(URL_ADMISSION_TEST_COUNT, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        NSError *error= nil;
+        [dispatcher dispatchSynchronousRequest:req returningResponse:NULL error:&error delegate:nil];
+        
+        @synchronized (self) {
+            completedCount++;
+        }
+    });
+    
+    XCTAssertTrue(completedCount == URL_ADMISSION_TEST_COUNT, @"Wrong number of completed requests (count: %lu)", (unsigned long) completedCount);
+    
+    [dispatcher dispose];
+    [LSLog disableAllSourceTypes];
+}
+
+/**
+ @brief This test will take the only connection of an end-point, then dispatch a short and a long request that wait
+ for it, and cancel them while pending: both must be notified as finished, and the long request must no more be counted.
+ */
+- (void) testURLDispatcherPendingCancellation {
+    [LSLog disableAllSourceTypes];
+    [LSLog enableSourceType:LOG_SRC_URL_DISPATCHER];
+    
+    LSURLDispatcher *dispatcher= [[LSURLDispatcher alloc] initWithMaxRequestsPerEndPoint:1 maxLongRunningRequestsPerEndPoint:1];
+    
+    NSURL *url= [NSURL URLWithString:URL_ADMISSION_TEST_URL];
+    NSMutableURLRequest *req= [NSMutableURLRequest requestWithURL:url];
+    [req setTimeoutInterval:URL_ADMISSION_TEST_TIMEOUT];
+    
+    _finishedOperations= [[NSMutableArray alloc] init];
+    
+    // A first request to the closed port fails soon, then its connection is kept busy
+    LSURLDispatchOperation *firstOp= [dispatcher dispatchShortRequest:req delegate:self];
+    LSURLEndPoint *endPoint= firstOp.urlEndPoint;
+    
+    NSDate *limit= [NSDate dateWithTimeIntervalSinceNow:URL_ADMISSION_TEST_TIMEOUT];
+    BOOL acquired= NO;
+    while ((!(acquired= [endPoint acquireConnectionWithLimit:1])) && ([limit timeIntervalSinceNow] > 0.0))
+        [NSThread sleepForTimeInterval:0.01];
+    
+    XCTAssertTrue(acquired, @"Connection of end-point not freed");
+    
+    LSURLDispatchOperation *shortOp= [dispatcher dispatchShortRequest:req delegate:self];
+    LSURLDispatchOperation *longOp= [dispatcher dispatchLongRequest:req delegate:self];
+    
+    XCTAssertTrue(endPoint.pendingCount == 2, @"Wrong pending count (count: %lu)", (unsigned long) endPoint.pendingCount);
+    XCTAssertTrue([dispatcher countOfRunningLongRequestsToURL:url] == 1, @"Long request not counted");
+    
+    [shortOp cancel];
+    [longOp cancel];
+    
+    XCTAssertTrue(endPoint.pendingCount == 0, @"Wrong pending count after cancellation (count: %lu)", (unsigned long) endPoint.pendingCount);
+    XCTAssertTrue([dispatcher countOfRunningLongRequestsToURL:url] == 0, @"Long request still counted after cancellation");
+    
+    // Finish notifications are delivered asynchronously
+    limit= [NSDate dateWithTimeIntervalSinceNow:URL_ADMISSION_TEST_TIMEOUT];
+    BOOL notified= NO;
+    while ([limit timeIntervalSinceNow] > 0.0) {
+        @synchronized (self) {
+            notified= ([_finishedOperations indexOfObjectIdenticalTo:shortOp] != NSNotFound) &&
+                      ([_finishedOperations indexOfObjectIdenticalTo:longOp] != NSNotFound);
+        }
+        
+        if (notified)
+            break;
+        
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    
+    XCTAssertTrue(notified, @"Cancelled operations not notified as finished");
+    
+    // Give the connection back, with no operation waiting the count goes down
+    [dispatcher connectionDidFreeForEndPoint:endPoint];
+    
+    XCTAssertTrue(endPoint.connectionCount == 0, @"Wrong connection count (count: %lu)", (unsigned long) endPoint.connectionCount);
+    
+    _finishedOperations= nil;
+    
+    [dispatcher dispose];
+    [LSLog disableAllSourceTypes];
+}
+
+/**
+ @brief This test will look up end-points of many hosts from concurrent threads, and check that the same host and port
+ always give the same end-point, while different ports give different ones.
+ <br/> Then it will run many operations through a single end-point from concurrent threads, with no network involved, and
+ check that the connection count stays within the limit while connections are handed over to pending operations, that
+ every operation gets its turn, and that counts go back to zero.
+ */
+- (void) testURLEndPoints {
+    [LSLog disableAllSourceTypes];
+    
+    LSURLDispatcher *dispatcher= [[LSURLDispatcher alloc] initWithMaxRequestsPerEndPoint:URL_END_POINT_TEST_LIMIT maxLongRunningRequestsPerEndPoint:1];
+    
+    // Hosts are spread over different shards, each one must be interned once
+    NSMutableArray<LSURLEndPoint *> *endPoints= [[NSMutableArray alloc] initWithCapacity:URL_END_POINT_TEST_HOSTS];
+    for (int i= 0; i < URL_END_POINT_TEST_HOSTS; i++)
+        [endPoints addObject:[dispatcher endPointForHost:[NSString stringWithFormat:@"host%d.test", i] port:80]];
+    
+    __block BOOL mismatched= NO;
+    
+    dispatch_apply(URL_END_POINT_TEST_LOOKUPS, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        int host= (int) (i % URL_END_POINT_TEST_HOSTS);
+        
+        LSURLEndPoint *byHost= [dispatcher endPointForHost:[NSString stringWithFormat:@"host%d.test", host] port:80];
+        LSURLEndPoint *byURL= [dispatcher endPointForURL:[NSURL URLWithString:[NSString stringWithFormat:@"http://host%d.test/path", host]]];
+        
+        if ((byHost != endPoints[host]) || (byURL != endPoints[host])) {
+            @synchronized (self) {
+                mismatched= YES;
+            }
+        }
+    });
+    
+    XCTAssertFalse(mismatched, @"Same host and port gave different end-points");
+    
+    LSURLEndPoint *otherPort= [dispatcher endPointForHost:@"host0.test" port:81];
+    XCTAssertTrue(otherPort != endPoints[0], @"Different ports gave the same end-point");
+    XCTAssertFalse([otherPort.name isEqualToString:endPoints[0].name], @"Different ports gave the same end-point name");
+    
+    // Operations are never started, they just take and give back connections
+    LSURLEndPoint *endPoint= endPoints[0];
+    NSURLRequest *req= [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://host0.test/path"]];
+    
+    NSMutableArray<LSURLDispatchOperation *> *operations= [[NSMutableArray alloc] initWithCapacity:URL_END_POINT_TEST_OPERATIONS];
+    for (int i= 0; i < URL_END_POINT_TEST_OPERATIONS; i++)
+        [operations addObject:[[LSURLDispatchOperation alloc] initWithDispatcher:dispatcher session:nil request:req endPoint:endPoint delegate:self gatherData:NO isLong:NO]];
+    
+    __block NSUInteger runCount= 0;
+    __block BOOL exceeded= NO;
+    
+    dispatch_apply(URL_END_POINT_TEST_OPERATIONS, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        LSURLDispatchOperation *op= operations[i];
+        
+        // A waiting operation is run by whoever frees a connection
+        if (![endPoint acquireConnectionWithLimit:URL_END_POINT_TEST_LIMIT]) {
+            op= [endPoint enqueuePendingOperation:op limit:URL_END_POINT_TEST_LIMIT];
+            if (!op)
+                return;
+        }
+        
+        while (op) {
+            NSUInteger connectionCount= endPoint.connectionCount;
+            
+            @synchronized (self) {
+                runCount++;
+                
+                if ((connectionCount == 0) || (connectionCount > URL_END_POINT_TEST_LIMIT))
+                    exceeded= YES;
+            }
+            
+            // The connection passes to the next operation waiting, if any
+            op= [endPoint releaseConnectionWithLimit:URL_END_POINT_TEST_LIMIT];
+        }
+    });
+    
+    XCTAssertTrue(runCount == URL_END_POINT_TEST_OPERATIONS, @"Wrong number of operations run (count: %lu)", (unsigned long) runCount);
+    XCTAssertFalse(exceeded, @"Connection count out of bounds while holding a connection");
+    XCTAssertTrue(endPoint.connectionCount == 0, @"Wrong connection count (count: %lu)", (unsigned long) endPoint.connectionCount);
+    XCTAssertTrue(endPoint.pendingCount == 0, @"Wrong pending count (count: %lu)", (unsigned long) endPoint.pendingCount);
+    
+    [dispatcher dispose];
+}
+
+#pragma mark -
+#pragma mark Callback for timer test
+
+- (void) saveInvocationTime:(NSNumber *)number {
+    _timerInvocations[number]= @([[NSDate date] timeIntervalSinceDate:_timerBegin]);
+}
+
+
+#pragma mark -
+#pragma mark Callback for work stealing test
+
+- (void) splitWorkOnPool:(LSThreadPool *)pool depth:(NSUInteger)depth {
+    if (depth == 0) {
+        
+        // Leaf: update count and notify
+        [_semaphore lock];
+        
+        _count++;
+        
+        [_semaphore signal];
+        [_semaphore unlock];
+        return;
+    }
+    
+    // Split in two halves
+    for (int i= 0; i < 2; i++) {
+        [pool scheduleInvocationForBlock:^{
+            [self splitWorkOnPool:pool depth:depth - 1];
+        }];
+    }
+}
+
+
+#pragma mark -
+#pragma mark Callbacks for typed arguments test
+
+- (void) saveInteger:(NSInteger)value {
+    @synchronized (_typedArguments) {
+        [_typedArguments addObject:[NSString stringWithFormat:@"%ld", (long) value]];
+    }
+}
+
+- (void) saveDouble:(double)value {
+    @synchronized (_typedArguments) {
+        [_typedArguments addObject:[NSString stringWithFormat:@"%g", value]];
+    }
+}
+
+- (void) savePointedInteger:(NSInteger *)pointer {
+    @synchronized (_typedArguments) {
+        [_typedArguments addObject:[NSString stringWithFormat:@"%ld", (long) *pointer]];
+    }
+}
+
+- (void) saveString:(NSString *)string withString:(NSString *)otherString {
+    @synchronized (_typedArguments) {
+        [_typedArguments addObject:[NSString stringWithFormat:@"%@,%@", string, otherString]];
+    }
+}
+
+
+#pragma mark -
+#pragma mark Methods of LSURLDispatchDelegate
+
+- (void) dispatchOperation:(LSURLDispatchOperation *)operation willSendRequestForAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge {
+    [challenge.sender performDefaultHandlingForAuthenticationChallenge:challenge];
+}
+
+- (void) dispatchOperation:(LSURLDispatchOperation *)operation didReceiveResponse:(NSURLResponse *)response {}
+
+- (void) dispatchOperation:(LSURLDispatchOperation *)operation didReceiveData:(NSData *)data {
+    
+    // Get a key for the operation
+    NSString *opKey= [NSString stringWithFormat:@"%p", operation];
+    BOOL finished= NO;
+
+    NSUInteger downloaded= 0;
+    @synchronized (self) {
+        
+        // Get current download for this operation
+        NSMutableData *download= _downloads[opKey];
+        if (!download) {
+            download= [[NSMutableData alloc] init];
+
+            _downloads[opKey]= download;
+        }
+        
+        // Append data if we haven't reached the limit
+        if (download.length < URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES) {
+            [download appendData:data];
+
+            downloaded= download.length;
+            
+            // If we have reached the limit count the operation as finished
+            if (downloaded >= URL_DISPATCHER_TEST_MAX_DOWNLOAD_BYTES) {
+                [operation cancel];
+                _count++;
+            }
+        }
+    
+        if (_failedCount + _count == URL_DISPATCHER_TEST_COUNT)
+            finished= YES;
+    }
+    
+    if (downloaded)
+        NSLog(@"Operation %p: downloaded: %lu bytes (count: %lu, failed count: %lu)", operation, (unsigned long) downloaded, (unsigned long) _count, (unsigned long) _failedCount);
+
+    if (finished) {
+        
+        // Notifiy end of downloads
+        [_semaphore lock];
+        [_semaphore signal];
+        [_semaphore unlock];
+    }
+}
+
+- (void) dispatchOperation:(LSURLDispatchOperation *)operation didFailWithError:(NSError *)error {
+    NSLog(@"Operation %p: download failed with error: %@ (count: %lu, failed count: %lu)", operation, error, (unsigned long) _count, (unsigned long) _failedCount);
+
+    BOOL finished= NO;
+    
+    @synchronized (self) {
+        _failedCount++;
+        
+        if (_failedCount + _count == URL_DISPATCHER_TEST_COUNT)
+            finished= YES;
+    }
     
     if (finished) {
         
@@ -348,7 +1846,23 @@
     }
 }
 
-- (void) dispatchOperationDidFinish:(LSURLDispatchOperation *)operation {}
+- (void) dispatchOperationDidFinish:(LSURLDispatchOperation *)operation {
+    @synchronized (self) {
+        [_finishedOperations addObject:operation];
+    }
+}
+
+
+#pragma mark -
+#pragma mark Methods of LSLogDelegate
+
+- (void) appendLogLine:(NSString *)logLine {
+    [_logLines addObject:logLine];
+}
+
+- (void) appendLogLines:(NSArray<NSString *> *)logLines {
+    [_logLines addObjectsFromArray:logLines];
+}
 
 
 @end
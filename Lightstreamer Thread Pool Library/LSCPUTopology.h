@@ -0,0 +1,59 @@
+//
+//  LSCPUTopology.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief Describes the processors of the host and their NUMA nodes. <b>This class should not be used directly</b>.
+ <br/> On Linux the topology is read from <code>/sys/devices/system</code>. On other platforms, or if it can't
+ be read, all processors are reported as belonging to a single node.
+ @see LSThreadPoolConfiguration, LSPartitionedThreadPool.
+ */
+@interface LSCPUTopology : NSObject
+
+
+#pragma mark -
+#pragma mark Topology (for internal use only)
+
+/**
+ @brief The indexes of online processors.
+ */
++ (nonnull NSIndexSet *) onlineCPUs;
+
+/**
+ @brief The indexes of processors of each NUMA node, one set per node, in order of node.
+ <br/> Nodes with no processors, such as memory-only nodes, are not included. Never empty.
+ */
++ (nonnull NSArray<NSIndexSet *> *) numaNodeCPUs;
+
+/**
+ @brief The numbers of the NUMA nodes reported by <code>numaNodeCPUs</code>, in the same order.
+ <br/> Node numbers may have gaps, hence they may differ from the indexes of the array.
+ */
++ (nonnull NSArray<NSNumber *> *) numaNodeIDs;
+
+/**
+ @brief The index of the processor the calling thread is running on, or -1 if it can't be determined.
+ */
++ (NSInteger) currentCPU;
+
+
+@end
@@ -0,0 +1,200 @@
+//
+//  LSCPUTopology.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+// Needed for sched_getcpu, must come before any system header
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#import "LSCPUTopology.h"
+
+#if defined(__linux__)
+#import <sched.h>
+#endif
+
+#define SYS_ONLINE_CPUS_PATH                               (@"/sys/devices/system/cpu/online")
+#define SYS_NUMA_NODES_PATH                                (@"/sys/devices/system/node")
+#define SYS_ONLINE_NUMA_NODES_PATH                         (@"/sys/devices/system/node/online")
+#define SYS_NUMA_NODE_CPUS_PATH_FORMAT                     (@"/sys/devices/system/node/node%lu/cpulist")
+
+
+#pragma mark -
+#pragma mark LSCPUTopology extension
+
+@interface LSCPUTopology ()
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (NSIndexSet *) cpuListAtPath:(NSString *)path;
++ (NSIndexSet *) onlineNUMANodes;
++ (void) loadNUMANodesIntoCPUs:(NSArray<NSIndexSet *> **)nodeCPUs IDs:(NSArray<NSNumber *> **)nodeIDs;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSCPUTopology implementation
+
+@implementation LSCPUTopology
+
+
+#pragma mark -
+#pragma mark Topology
+
++ (NSIndexSet *) onlineCPUs {
+    static NSIndexSet *__onlineCPUs= nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSIndexSet *cpus= [self cpuListAtPath:SYS_ONLINE_CPUS_PATH];
+        
+        if (!cpus.count)
+            cpus= [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, MAX([NSProcessInfo processInfo].activeProcessorCount, 1))];
+        
+        __onlineCPUs= cpus;
+    });
+    
+    return __onlineCPUs;
+}
+
++ (NSArray<NSIndexSet *> *) numaNodeCPUs {
+    NSArray<NSIndexSet *> *nodeCPUs= nil;
+    [self loadNUMANodesIntoCPUs:&nodeCPUs IDs:NULL];
+    
+    return nodeCPUs;
+}
+
++ (NSArray<NSNumber *> *) numaNodeIDs {
+    NSArray<NSNumber *> *nodeIDs= nil;
+    [self loadNUMANodesIntoCPUs:NULL IDs:&nodeIDs];
+    
+    return nodeIDs;
+}
+
++ (NSInteger) currentCPU {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
++ (void) loadNUMANodesIntoCPUs:(NSArray<NSIndexSet *> **)nodeCPUs IDs:(NSArray<NSNumber *> **)nodeIDs {
+    static NSArray<NSIndexSet *> *__numaNodeCPUs= nil;
+    static NSArray<NSNumber *> *__numaNodeIDs= nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSMutableArray<NSIndexSet *> *nodes= [[NSMutableArray alloc] init];
+        NSMutableArray<NSNumber *> *ids= [[NSMutableArray alloc] init];
+        
+        // Node numbers may have gaps, e.g. after hot-unplug
+        [[self onlineNUMANodes] enumerateIndexesUsingBlock:^(NSUInteger node, BOOL *stop) {
+            NSIndexSet *cpus= [self cpuListAtPath:[NSString stringWithFormat:SYS_NUMA_NODE_CPUS_PATH_FORMAT, (unsigned long) node]];
+            
+            // Memory-only nodes (e.g. CXL, HBM or PMEM) have an empty CPU list
+            if (!cpus.count)
+                return;
+            
+            [nodes addObject:cpus];
+            [ids addObject:@(node)];
+        }];
+        
+        if (!nodes.count) {
+            [nodes addObject:[self onlineCPUs]];
+            [ids addObject:@(0)];
+        }
+        
+        __numaNodeCPUs= [nodes copy];
+        __numaNodeIDs= [ids copy];
+    });
+    
+    if (nodeCPUs)
+        *nodeCPUs= __numaNodeCPUs;
+    
+    if (nodeIDs)
+        *nodeIDs= __numaNodeIDs;
+}
+
++ (NSIndexSet *) onlineNUMANodes {
+#if defined(__linux__)
+    
+    // The node list has the same format of CPU lists
+    NSIndexSet *nodes= [self cpuListAtPath:SYS_ONLINE_NUMA_NODES_PATH];
+    if (nodes)
+        return nodes;
+    
+    // Fall back to the node directories
+    NSMutableIndexSet *nodeDirs= [[NSMutableIndexSet alloc] init];
+    for (NSString *entry in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:SYS_NUMA_NODES_PATH error:nil]) {
+        if (![entry hasPrefix:@"node"] || (entry.length == 4))
+            continue;
+        
+        NSString *number= [entry substringFromIndex:4];
+        if ([number rangeOfCharacterFromSet:[[NSCharacterSet decimalDigitCharacterSet] invertedSet]].location != NSNotFound)
+            continue;
+        
+        [nodeDirs addIndex:(NSUInteger) number.integerValue];
+    }
+    
+    return nodeDirs;
+    
+#else
+    return [NSIndexSet indexSet];
+#endif
+}
+
++ (NSIndexSet *) cpuListAtPath:(NSString *)path {
+#if defined(__linux__)
+    NSString *list= [NSString stringWithContentsOfFile:path encoding:NSASCIIStringEncoding error:nil];
+    if (!list)
+        return nil;
+    
+    // The list is made of comma-separated CPUs or ranges, e.g. "0-3,8-11"
+    NSMutableIndexSet *cpus= [[NSMutableIndexSet alloc] init];
+    for (NSString *item in [list componentsSeparatedByString:@","]) {
+        NSString *trimmed= [item stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        if (!trimmed.length)
+            continue;
+        
+        NSArray<NSString *> *bounds= [trimmed componentsSeparatedByString:@"-"];
+        NSUInteger first= (NSUInteger) bounds[0].integerValue;
+        NSUInteger last= (bounds.count > 1) ? (NSUInteger) bounds[1].integerValue : first;
+        
+        if (last >= first)
+            [cpus addIndexesInRange:NSMakeRange(first, last - first + 1)];
+    }
+    
+    return cpus;
+    
+#else
+    return nil;
+#endif
+}
+
+
+@end
@@ -0,0 +1,55 @@
+//
+//  LSFunctionRecord.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+#import "LSThreadPool.h"
+
+
+/**
+ @brief A call to a C function scheduled with <code>scheduleFunction:context:</code> of LSThreadPool. <b>This type should not be used directly</b>.
+ <br/> Records are recycled: they are taken from a free list of the scheduling thread and given back to a free list of
+ the executing thread. Free lists exchange records in batches through a shared depot, so that in steady state
+ scheduling a call allocates nothing, whichever thread schedules it and whichever thread runs it.
+ */
+typedef struct LSFunctionRecord {
+    LSThreadPoolFunction function;
+    void *context;
+    
+    // Time the record has been enqueued, on the monotonic clock, or 0 if not tracked
+    uint64_t enqueueTime;
+    
+    // Next record in the queue, or in the free list
+    struct LSFunctionRecord *next;
+    
+    // Used by the first record of a batch in the depot only
+    struct LSFunctionRecord *nextBatch;
+    NSUInteger batchCount;
+} LSFunctionRecord;
+
+
+/**
+ @brief Takes a record from the free list of the calling thread, refilling it from the depot, or allocating a new batch, if empty.
+ */
+LSFunctionRecord * _Nonnull LSFunctionRecordAcquire(void);
+
+/**
+ @brief Gives a record back to the free list of the calling thread, moving a batch to the depot if the list grows too long.
+ */
+void LSFunctionRecordRelease(LSFunctionRecord * _Nonnull record);
@@ -0,0 +1,160 @@
+//
+//  LSFunctionRecord.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSFunctionRecord.h"
+
+#import <pthread.h>
+
+#define RECORD_BATCH_SIZE                                    (64)
+
+
+#pragma mark -
+#pragma mark Free lists
+
+typedef struct {
+    LSFunctionRecord *head;
+    NSUInteger count;
+} LSFunctionRecordCache;
+
+// Batches of free records shared by all threads, linked through their first record
+static LSFunctionRecord *__depot= NULL;
+static pthread_mutex_t __depotLock= PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t __cacheKey;
+static pthread_once_t __cacheKeyOnce= PTHREAD_ONCE_INIT;
+
+
+static void LSFunctionRecordDepotPush(LSFunctionRecord *batch, NSUInteger count) {
+    batch->batchCount= count;
+    
+    pthread_mutex_lock(&__depotLock);
+    
+    batch->nextBatch= __depot;
+    __depot= batch;
+    
+    pthread_mutex_unlock(&__depotLock);
+}
+
+static LSFunctionRecord *LSFunctionRecordDepotPop(void) {
+    pthread_mutex_lock(&__depotLock);
+    
+    LSFunctionRecord *batch= __depot;
+    if (batch)
+        __depot= batch->nextBatch;
+    
+    pthread_mutex_unlock(&__depotLock);
+    
+    return batch;
+}
+
+static void LSFunctionRecordCacheDestroy(void *value) {
+    LSFunctionRecordCache *cache= value;
+    
+    // Records of an exiting thread go back to the depot
+    if (cache->head)
+        LSFunctionRecordDepotPush(cache->head, cache->count);
+    
+    free(cache);
+}
+
+static void LSFunctionRecordCacheKeyCreate(void) {
+    pthread_key_create(&__cacheKey, LSFunctionRecordCacheDestroy);
+}
+
+static inline LSFunctionRecordCache *LSFunctionRecordCurrentCache(void) {
+    pthread_once(&__cacheKeyOnce, LSFunctionRecordCacheKeyCreate);
+    
+    LSFunctionRecordCache *cache= pthread_getspecific(__cacheKey);
+    if (!cache) {
+        
+        // Once per thread
+        cache= calloc(1, sizeof(LSFunctionRecordCache));
+        pthread_setspecific(__cacheKey, cache);
+    }
+    
+    return cache;
+}
+
+static void LSFunctionRecordCacheRefill(LSFunctionRecordCache *cache) {
+    LSFunctionRecord *batch= LSFunctionRecordDepotPop();
+    if (batch) {
+        cache->head= batch;
+        cache->count= batch->batchCount;
+        return;
+    }
+    
+    // Depot is empty: records in flight have grown, allocate a new batch. Records are never
+    // freed, their number is bounded by the peak of calls scheduled and not yet run
+    LSFunctionRecord *records= calloc(RECORD_BATCH_SIZE, sizeof(LSFunctionRecord));
+    if (!records)
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:@"Can't allocate function records"
+                                     userInfo:nil];
+    
+    for (NSUInteger i= 0; i < RECORD_BATCH_SIZE - 1; i++)
+        records[i].next= &records[i + 1];
+    
+    cache->head= records;
+    cache->count= RECORD_BATCH_SIZE;
+}
+
+
+#pragma mark -
+#pragma mark Record recycling
+
+LSFunctionRecord *LSFunctionRecordAcquire(void) {
+    LSFunctionRecordCache *cache= LSFunctionRecordCurrentCache();
+    if (!cache->head)
+        LSFunctionRecordCacheRefill(cache);
+    
+    LSFunctionRecord *record= cache->head;
+    cache->head= record->next;
+    cache->count--;
+    
+    record->next= NULL;
+    
+    return record;
+}
+
+void LSFunctionRecordRelease(LSFunctionRecord *record) {
+    LSFunctionRecordCache *cache= LSFunctionRecordCurrentCache();
+    
+    record->function= NULL;
+    record->context= NULL;
+    record->enqueueTime= 0;
+    
+    record->next= cache->head;
+    cache->head= record;
+    cache->count++;
+    
+    // Threads that mostly run calls scheduled by others give records back in batches
+    if (cache->count < 2 * RECORD_BATCH_SIZE)
+        return;
+    
+    LSFunctionRecord *batch= cache->head;
+    LSFunctionRecord *last= batch;
+    for (NSUInteger i= 1; i < RECORD_BATCH_SIZE; i++)
+        last= last->next;
+    
+    cache->head= last->next;
+    cache->count -= RECORD_BATCH_SIZE;
+    last->next= NULL;
+    
+    LSFunctionRecordDepotPush(batch, RECORD_BATCH_SIZE);
+}
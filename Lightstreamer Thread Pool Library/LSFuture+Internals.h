@@ -0,0 +1,36 @@
+//
+//  LSFuture+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSFuture.h"
+
+
+#pragma mark -
+#pragma mark LSFuture Internals category
+
+@interface LSFuture (Internals)
+
+
+#pragma mark -
+#pragma mark Completion (for internal use only)
+
+- (void) completeWithBlock:(LSFutureBlock)block;
+
+
+@end
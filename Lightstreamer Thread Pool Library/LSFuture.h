@@ -0,0 +1,209 @@
+//
+//  LSFuture.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSThreadPool;
+
+
+/**
+ @brief Error domain of errors produced by an LSFuture.
+ */
+#define LS_FUTURE_ERROR_DOMAIN                             (@"LSFutureDomain")
+
+/**
+ @brief Error code of a future failed due to an exception raised by its computation.
+ <br/> The exception is available in the error's user info, with key <code>LS_FUTURE_EXCEPTION_KEY</code>.
+ */
+#define LS_FUTURE_ERROR_CODE_EXCEPTION                     (-1801)
+
+/**
+ @brief User info key of the exception that made a future fail.
+ */
+#define LS_FUTURE_EXCEPTION_KEY                            (@"LSFutureException")
+
+
+/**
+ @brief Type used to characterize blocks computing the result of an LSFuture.
+ <br/> The block may return another LSFuture: in this case the result is taken from the returned future when it completes.
+ */
+typedef id _Nullable (^LSFutureBlock)(void);
+
+/**
+ @brief Type used to characterize blocks that transform the result of an LSFuture into the result of a derived one.
+ <br/> The block may return another LSFuture: in this case the result is taken from the returned future when it completes.
+ */
+typedef id _Nullable (^LSFutureContinuationBlock)(id _Nullable result);
+
+/**
+ @brief Type used to characterize blocks to be called when an LSFuture completes.
+ <br/> Exactly one of <code>result</code> and <code>error</code> is meaningful: <code>error</code> is <code>nil</code> if the future succeeded.
+ */
+typedef void (^LSFutureCompletionBlock)(id _Nullable result, NSError * _Nullable error);
+
+
+/**
+ @brief LSFuture represents the eventual result of a computation, such as a call scheduled with LSThreadPool.
+ <br/> A future completes only once, either with a result (possibly <code>nil</code>) or with an error.
+ <br/> Continuations may be attached without blocking: they are scheduled on the specified thread pool
+ when the future completes, or run immediately if it has already completed. Waiting for completion
+ is possible but should be avoided from inside a thread pool, as it keeps a thread of the pool busy.
+ */
+@interface LSFuture : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates a pending LSFuture, to be completed with <code>completeWithResult:</code> or <code>failWithError:</code>.
+ @return The created future.
+ */
++ (nonnull LSFuture *) future;
+
+/**
+ @brief Creates an LSFuture already completed with the specified result.
+ @param result The result of the future. A <code>nil</code> is accepted.
+ @return The created future.
+ */
++ (nonnull LSFuture *) futureWithResult:(nullable id)result;
+
+/**
+ @brief Creates an LSFuture already failed with the specified error.
+ @param error The error of the future.
+ @return The created future.
+ @throws NSException If the error is <code>nil</code>.
+ */
++ (nonnull LSFuture *) futureWithError:(nonnull NSError *)error;
+
+
+#pragma mark -
+#pragma mark Completion
+
+/**
+ @brief Completes the future with the specified result, if it is still pending.
+ @param result The result of the future. A <code>nil</code> is accepted.
+ @return <code>YES</code> if the future has been completed by this call, <code>NO</code> if it was already completed.
+ */
+- (BOOL) completeWithResult:(nullable id)result;
+
+/**
+ @brief Completes the future with the specified error, if it is still pending.
+ @param error The error of the future.
+ @return <code>YES</code> if the future has been completed by this call, <code>NO</code> if it was already completed.
+ @throws NSException If the error is <code>nil</code>.
+ */
+- (BOOL) failWithError:(nonnull NSError *)error;
+
+
+#pragma mark -
+#pragma mark Continuations
+
+/**
+ @brief Creates a derived future whose result is computed from the result of this future.
+ <br/> When this future succeeds, the block is scheduled on the specified thread pool and its return value
+ becomes the result of the derived future. When this future fails, the block is not called and the derived
+ future fails with the same error. If the block raises an exception, the derived future fails.
+ @param block The block computing the result of the derived future.
+ @param pool The thread pool where the block is scheduled. If <code>nil</code>, the block is called
+ on the thread that completes this future. If the pool has been disposed of, the block is called
+ on the thread that completes this future, too.
+ @return The derived future.
+ @throws NSException If the block is <code>nil</code>.
+ */
+- (nonnull LSFuture *) then:(nonnull LSFutureContinuationBlock)block onPool:(nullable LSThreadPool *)pool;
+
+/**
+ @brief Adds a block to be called when the future completes, successfully or not.
+ @param block The block to be called.
+ @param pool The thread pool where the block is scheduled. If <code>nil</code>, the block is called
+ on the thread that completes this future. If the pool has been disposed of, the block is called
+ on the thread that completes this future, too.
+ @throws NSException If the block is <code>nil</code>.
+ */
+- (void) onComplete:(nonnull LSFutureCompletionBlock)block onPool:(nullable LSThreadPool *)pool;
+
+
+#pragma mark -
+#pragma mark Combinators
+
+/**
+ @brief Creates a future that succeeds when all the specified futures succeed, or fails as soon as one of them fails.
+ @param futures The futures to be combined.
+ @return The combined future. Its result is an array with the results of the specified futures,
+ in the same order, where <code>nil</code> results are replaced by <code>NSNull</code>.
+ @throws NSException If the futures array is <code>nil</code>.
+ */
++ (nonnull LSFuture *) whenAll:(nonnull NSArray<LSFuture *> *)futures;
+
+/**
+ @brief Creates a future that completes as soon as any of the specified futures completes, with the same result or error.
+ @param futures The futures to be combined.
+ @return The combined future.
+ @throws NSException If the futures array is <code>nil</code> or empty.
+ */
++ (nonnull LSFuture *) whenAny:(nonnull NSArray<LSFuture *> *)futures;
+
+
+#pragma mark -
+#pragma mark Completion monitoring
+
+/**
+ @brief Waits for the future to complete.
+ <br/> Puts the calling thread on wait until the future has been completed.
+ */
+- (void) waitForCompletion;
+
+/**
+ @brief Waits for the future to complete, up to the specified timeout.
+ @param timeout The maximum time to wait, in seconds.
+ @return <code>YES</code> if the future has been completed, <code>NO</code> if the timeout expired.
+ */
+- (BOOL) waitForCompletionWithTimeout:(NSTimeInterval)timeout;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief Tells if the future has been completed, successfully or not.
+ */
+@property (nonatomic, readonly) BOOL completed;
+
+/**
+ @brief Tells if the future has been completed with an error.
+ */
+@property (nonatomic, readonly) BOOL failed;
+
+/**
+ @brief The result of the future.
+ <br/> Is <code>nil</code> if the future is still pending or has failed.
+ */
+@property (nonatomic, readonly, nullable) id result;
+
+/**
+ @brief The error of the future.
+ <br/> Is <code>nil</code> if the future is still pending or has succeeded.
+ */
+@property (nonatomic, readonly, nullable) NSError *error;
+
+
+@end
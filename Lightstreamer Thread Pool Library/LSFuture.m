@@ -0,0 +1,408 @@
+//
+//  LSFuture.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSFuture.h"
+#import "LSFuture+Internals.h"
+#import "LSThreadPool.h"
+#import "LSThreadPool+Internals.h"
+#import "LSInvocation.h"
+#import "LSInvocation+Internals.h"
+#import "LSLog.h"
+#import "LSLog+Internals.h"
+
+
+#pragma mark -
+#pragma mark LSFuture extension
+
+@interface LSFuture () {
+    NSCondition *_monitor;
+    
+    BOOL _completed;
+    id _result;
+    NSError *_error;
+    
+    NSMutableArray<LSFutureCompletionBlock> *_continuations;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) completeWithResult:(id)result error:(NSError *)error;
+
++ (void) callBlock:(LSFutureCompletionBlock)block withResult:(id)result error:(NSError *)error onPool:(LSThreadPool *)pool;
++ (NSError *) errorWithException:(NSException *)exception;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSFuture implementation
+
+@implementation LSFuture
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSFuture *) future {
+    LSFuture *future= [[LSFuture alloc] init];
+    
+    return future;
+}
+
++ (LSFuture *) futureWithResult:(id)result {
+    LSFuture *future= [[LSFuture alloc] init];
+    [future completeWithResult:result];
+    
+    return future;
+}
+
++ (LSFuture *) futureWithError:(NSError *)error {
+    LSFuture *future= [[LSFuture alloc] init];
+    [future failWithError:error];
+    
+    return future;
+}
+
+- (instancetype) init {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _monitor= [[NSCondition alloc] init];
+        _continuations= [[NSMutableArray alloc] init];
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Completion
+
+- (BOOL) completeWithResult:(id)result {
+    return [self completeWithResult:result error:nil];
+}
+
+- (BOOL) failWithError:(NSError *)error {
+    if (!error)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Error can't be nil"
+                                     userInfo:nil];
+    
+    return [self completeWithResult:nil error:error];
+}
+
+
+#pragma mark -
+#pragma mark Continuations
+
+- (LSFuture *) then:(LSFutureContinuationBlock)block onPool:(LSThreadPool *)pool {
+    if (!block)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Block can't be nil"
+                                     userInfo:nil];
+    
+    LSFuture *derived= [[LSFuture alloc] init];
+    
+    [self onComplete:^(id result, NSError *error) {
+        if (error)
+            [derived failWithError:error];
+        else
+            [derived completeWithBlock:^id {
+                return block(result);
+            }];
+        
+    } onPool:pool];
+    
+    return derived;
+}
+
+- (void) onComplete:(LSFutureCompletionBlock)block onPool:(LSThreadPool *)pool {
+    if (!block)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Block can't be nil"
+                                     userInfo:nil];
+    
+    LSFutureCompletionBlock continuation= ^(id result, NSError *error) {
+        [LSFuture callBlock:block withResult:result error:error onPool:pool];
+    };
+    
+    id result= nil;
+    NSError *error= nil;
+    
+    [_monitor lock];
+    
+    if (!_completed) {
+        [_continuations addObject:[continuation copy]];
+        
+        [_monitor unlock];
+        return;
+    }
+    
+    result= _result;
+    error= _error;
+    
+    [_monitor unlock];
+    
+    // Already completed, call it now
+    continuation(result, error);
+}
+
+
+#pragma mark -
+#pragma mark Combinators
+
++ (LSFuture *) whenAll:(NSArray<LSFuture *> *)futures {
+    if (!futures)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Futures can't be nil"
+                                     userInfo:nil];
+    
+    if (futures.count == 0)
+        return [LSFuture futureWithResult:@[]];
+    
+    LSFuture *combined= [[LSFuture alloc] init];
+    
+    NSMutableArray *results= [[NSMutableArray alloc] initWithCapacity:futures.count];
+    for (NSUInteger i= 0; i < futures.count; i++)
+        [results addObject:[NSNull null]];
+    
+    __block NSUInteger remaining= futures.count;
+    
+    [futures enumerateObjectsUsingBlock:^(LSFuture *future, NSUInteger idx, BOOL *stop) {
+        [future onComplete:^(id result, NSError *error) {
+            if (error) {
+                [combined failWithError:error];
+                return;
+            }
+            
+            BOOL done= NO;
+            @synchronized (results) {
+                if (result)
+                    results[idx]= result;
+                
+                remaining--;
+                done= (remaining == 0);
+            }
+            
+            if (done)
+                [combined completeWithResult:[results copy]];
+            
+        } onPool:nil];
+    }];
+    
+    return combined;
+}
+
++ (LSFuture *) whenAny:(NSArray<LSFuture *> *)futures {
+    if (futures.count == 0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Futures can't be nil or empty"
+                                     userInfo:nil];
+    
+    LSFuture *combined= [[LSFuture alloc] init];
+    
+    for (LSFuture *future in futures) {
+        [future onComplete:^(id result, NSError *error) {
+            
+            // Only the first one succeeds
+            [combined completeWithResult:result error:error];
+            
+        } onPool:nil];
+    }
+    
+    return combined;
+}
+
+
+#pragma mark -
+#pragma mark Completion monitoring
+
+- (void) waitForCompletion {
+    [_monitor lock];
+    
+    while (!_completed)
+        [_monitor wait];
+    
+    [_monitor unlock];
+}
+
+- (BOOL) waitForCompletionWithTimeout:(NSTimeInterval)timeout {
+    NSDate *limit= [NSDate dateWithTimeIntervalSinceNow:timeout];
+    
+    [_monitor lock];
+    
+    while (!_completed) {
+        if (![_monitor waitUntilDate:limit])
+            break;
+    }
+    
+    BOOL completed= _completed;
+    
+    [_monitor unlock];
+    
+    return completed;
+}
+
+
+#pragma mark -
+#pragma mark Completion (for internal use only)
+
+- (void) completeWithBlock:(LSFutureBlock)block {
+    id result= nil;
+    
+    @try {
+        result= block();
+        
+    } @catch (NSException *e) {
+        [self failWithError:[LSFuture errorWithException:e]];
+        return;
+    }
+    
+    if ([result isKindOfClass:[LSFuture class]]) {
+        
+        // Chained future, complete when it completes
+        [(LSFuture *) result onComplete:^(id chainedResult, NSError *chainedError) {
+            [self completeWithResult:chainedResult error:chainedError];
+            
+        } onPool:nil];
+        
+    } else
+        [self completeWithResult:result error:nil];
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) completeWithResult:(id)result error:(NSError *)error {
+    NSArray<LSFutureCompletionBlock> *continuations= nil;
+    
+    [_monitor lock];
+    
+    if (_completed) {
+        [_monitor unlock];
+        return NO;
+    }
+    
+    _completed= YES;
+    _result= result;
+    _error= error;
+    
+    continuations= _continuations;
+    _continuations= nil;
+    
+    [_monitor broadcast];
+    [_monitor unlock];
+    
+    // Continuations are called outside of the lock
+    for (LSFutureCompletionBlock continuation in continuations)
+        continuation(result, error);
+    
+    return YES;
+}
+
++ (void) callBlock:(LSFutureCompletionBlock)block withResult:(id)result error:(NSError *)error onPool:(LSThreadPool *)pool {
+    if (pool) {
+        @try {
+            LSInvocation *invocation= [LSInvocation invocationWithBlock:^{
+                block(result, error);
+            }];
+            
+            // A continuation rejected or cancelled by the pool is called on the rejecting
+            // thread, otherwise the derived future would never complete
+            invocation.rejectionHandler= ^(NSError *rejectionError) {
+                [LSFuture callBlock:block withResult:result error:error onPool:nil];
+            };
+            
+            [pool scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
+            
+            return;
+            
+        } @catch (NSException *e) {
+            [LSLog sourceType:LOG_SRC_THREAD_POOL source:pool log:@"can't schedule future continuation, calling it on current thread: %@ (user info: %@)", e, e.userInfo];
+        }
+    }
+    
+    @try {
+        block(result, error);
+        
+    } @catch (NSException *e) {
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:pool log:@"exception caught while calling future continuation: %@ (user info: %@)", e, e.userInfo];
+    }
+}
+
++ (NSError *) errorWithException:(NSException *)exception {
+    NSError *error= [NSError errorWithDomain:LS_FUTURE_ERROR_DOMAIN
+                                        code:LS_FUTURE_ERROR_CODE_EXCEPTION
+                                    userInfo:@{NSLocalizedDescriptionKey: (exception.reason ?: exception.name),
+                                               LS_FUTURE_EXCEPTION_KEY: exception}];
+    
+    return error;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic completed;
+
+- (BOOL) completed {
+    [_monitor lock];
+    BOOL completed= _completed;
+    [_monitor unlock];
+    
+    return completed;
+}
+
+@dynamic failed;
+
+- (BOOL) failed {
+    [_monitor lock];
+    BOOL failed= (_error != nil);
+    [_monitor unlock];
+    
+    return failed;
+}
+
+@dynamic result;
+
+- (id) result {
+    [_monitor lock];
+    id result= _result;
+    [_monitor unlock];
+    
+    return result;
+}
+
+@dynamic error;
+
+- (NSError *) error {
+    [_monitor lock];
+    NSError *error= _error;
+    [_monitor unlock];
+    
+    return error;
+}
+
+
+@end
@@ -0,0 +1,38 @@
+//
+//  LSHistogram+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSHistogram.h"
+
+
+#pragma mark -
+#pragma mark LSHistogram Internals category
+
+@interface LSHistogram (Internals)
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+/**
+ @brief Initializes the histogram with <code>LS_HISTOGRAM_BUCKETS</code> bucket counts, the sum and the maximum of the durations, in nanoseconds.
+ */
+- (instancetype) initWithBucketCounts:(const uint64_t *)bucketCounts sum:(uint64_t)sum max:(uint64_t)max;
+
+
+@end
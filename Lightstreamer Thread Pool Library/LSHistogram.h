@@ -0,0 +1,120 @@
+//
+//  LSHistogram.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief Number of linear sub-buckets each power of two is split into, as a power of two.
+ <br/> With 3 bits, each bucket spans at most 1/8 of its lower bound, i.e. values are known within 12.5%.
+ */
+#define LS_HISTOGRAM_SUB_BUCKET_BITS                        (3)
+#define LS_HISTOGRAM_SUB_BUCKETS                           (1 << LS_HISTOGRAM_SUB_BUCKET_BITS)
+
+/**
+ @brief The highest power of two tracked, in nanoseconds. Larger values are counted in the last bucket.
+ <br/> 2^40 nanoseconds are about 18 minutes.
+ */
+#define LS_HISTOGRAM_MAX_EXPONENT                           (40)
+
+/**
+ @brief Total number of buckets of an LSHistogram.
+ */
+#define LS_HISTOGRAM_BUCKETS                               ((LS_HISTOGRAM_MAX_EXPONENT - LS_HISTOGRAM_SUB_BUCKET_BITS + 2) * LS_HISTOGRAM_SUB_BUCKETS)
+
+
+/**
+ @brief Returns the bucket of an LSHistogram a value in nanoseconds is counted in.
+ <br/> Values below <code>LS_HISTOGRAM_SUB_BUCKETS</code> have a bucket each, larger values are grouped by
+ power of two, and each power of two is split in <code>LS_HISTOGRAM_SUB_BUCKETS</code> linear sub-buckets.
+ */
+static inline NSUInteger LSHistogramBucketForValue(uint64_t value) {
+    if (value < LS_HISTOGRAM_SUB_BUCKETS)
+        return (NSUInteger) value;
+    
+    int exponent= 63 - __builtin_clzll(value);
+    if (exponent > LS_HISTOGRAM_MAX_EXPONENT)
+        return LS_HISTOGRAM_BUCKETS - 1;
+    
+    NSUInteger subBucket= (NSUInteger) (value >> (exponent - LS_HISTOGRAM_SUB_BUCKET_BITS)) - LS_HISTOGRAM_SUB_BUCKETS;
+    
+    return (exponent - LS_HISTOGRAM_SUB_BUCKET_BITS + 1) * LS_HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+/**
+ @brief Returns the lowest value in nanoseconds counted in the specified bucket of an LSHistogram.
+ */
+static inline uint64_t LSHistogramLowerBoundForBucket(NSUInteger bucket) {
+    if (bucket < LS_HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+    
+    NSUInteger exponent= bucket / LS_HISTOGRAM_SUB_BUCKETS + LS_HISTOGRAM_SUB_BUCKET_BITS - 1;
+    NSUInteger subBucket= bucket % LS_HISTOGRAM_SUB_BUCKETS;
+    
+    return ((uint64_t) (LS_HISTOGRAM_SUB_BUCKETS + subBucket)) << (exponent - LS_HISTOGRAM_SUB_BUCKET_BITS);
+}
+
+
+/**
+ @brief LSHistogram is an immutable log-linear histogram of durations, as collected by an LSThreadPool with metrics enabled.
+ <br/> Durations are counted in buckets whose width grows with the value, so that any duration from nanoseconds
+ to minutes is known within 12.5% using a small, fixed amount of memory.
+ @see LSThreadPoolMetrics.
+ */
+@interface LSHistogram : NSObject
+
+
+#pragma mark -
+#pragma mark Statistics
+
+/**
+ @brief Returns the duration, in seconds, below which the specified percentage of the counted durations fall.
+ <br/> The result is the upper bound of the bucket where the percentile falls, capped to the maximum duration.
+ @param percentile The percentile, between 0.0 and 100.0, e.g. 99.0 for the p99.
+ @return The duration at the percentile, or 0.0 if nothing has been counted.
+ */
+- (NSTimeInterval) valueAtPercentile:(double)percentile;
+
+/**
+ @brief Returns the number of durations counted in the specified bucket.
+ @see LSHistogramLowerBoundForBucket().
+ */
+- (uint64_t) countForBucket:(NSUInteger)bucket;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The number of counted durations.
+ */
+@property (nonatomic, readonly) uint64_t count;
+
+/**
+ @brief The mean of the counted durations, in seconds, or 0.0 if nothing has been counted.
+ */
+@property (nonatomic, readonly) NSTimeInterval mean;
+
+/**
+ @brief The longest counted duration, in seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval max;
+
+
+@end
@@ -0,0 +1,122 @@
+//
+//  LSHistogram.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSHistogram.h"
+#import "LSHistogram+Internals.h"
+
+#define NSECS_PER_SEC                                      (1000000000.0)
+
+
+#pragma mark -
+#pragma mark LSHistogram extension
+
+@interface LSHistogram () {
+    uint64_t _bucketCounts[LS_HISTOGRAM_BUCKETS];
+    
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _max;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSHistogram implementation
+
+@implementation LSHistogram
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithBucketCounts:(const uint64_t *)bucketCounts sum:(uint64_t)sum max:(uint64_t)max {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _count= 0;
+        for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++) {
+            _bucketCounts[bucket]= bucketCounts[bucket];
+            _count += bucketCounts[bucket];
+        }
+        
+        _sum= sum;
+        _max= max;
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Statistics
+
+- (NSTimeInterval) valueAtPercentile:(double)percentile {
+    if (!_count)
+        return 0.0;
+    
+    // Rank of the percentile, at least the first counted duration
+    uint64_t rank= (uint64_t) ceil((MIN(MAX(percentile, 0.0), 100.0) / 100.0) * (double) _count);
+    rank= MAX(rank, 1);
+    
+    uint64_t cumulative= 0;
+    for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++) {
+        cumulative += _bucketCounts[bucket];
+        if (cumulative < rank)
+            continue;
+        
+        uint64_t upperBound= (bucket < LS_HISTOGRAM_BUCKETS - 1) ? LSHistogramLowerBoundForBucket(bucket + 1) - 1 : _max;
+        
+        return ((double) MIN(upperBound, _max)) / NSECS_PER_SEC;
+    }
+    
+    return ((double) _max) / NSECS_PER_SEC;
+}
+
+- (uint64_t) countForBucket:(NSUInteger)bucket {
+    if (bucket >= LS_HISTOGRAM_BUCKETS)
+        return 0;
+    
+    return _bucketCounts[bucket];
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize count= _count;
+
+@dynamic mean;
+
+- (NSTimeInterval) mean {
+    if (!_count)
+        return 0.0;
+    
+    return (((double) _sum) / (double) _count) / NSECS_PER_SEC;
+}
+
+@dynamic max;
+
+- (NSTimeInterval) max {
+    return ((double) _max) / NSECS_PER_SEC;
+}
+
+
+@end
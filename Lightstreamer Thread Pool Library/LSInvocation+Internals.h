@@ -37,15 +37,67 @@
 + (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector delay:(NSTimeInterval)delay;
 + (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector argument:(id)argument;
 + (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector argument:(id)argument delay:(NSTimeInterval)delay;
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector argument:(id)argument secondArgument:(id)secondArgument;
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector integerArgument:(NSInteger)argument;
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector doubleArgument:(double)argument;
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector pointerArgument:(void *)argument;
 
 - (instancetype) initWithBlock:(LSInvocationBlock)block delay:(NSTimeInterval)delay;
 - (instancetype) initWithTarget:(id)target selector:(SEL)selector argument:(id)argument delay:(NSTimeInterval)delay;
 
 
+#pragma mark -
+#pragma mark Execution (for internal use only)
+
+/**
+ @brief Marks the invocation as started, so that it can no more be cancelled or rejected.
+ @return YES if the invocation must be performed, NO if it has been cancelled or rejected.
+ */
+- (BOOL) beginPerforming;
+
+/**
+ @brief Brings a started invocation back to pending, so that it can be performed again. Used by periodic invocations.
+ @return YES if the invocation is pending again, NO if it was not started.
+ */
+- (BOOL) rearm;
+
+- (void) perform;
+
+
 #pragma mark -
 #pragma mark Completion monitoring (for internal use only)
 
 - (void) completed;
+- (void) rejectWithError:(NSError *)error;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+/**
+ @brief Time the invocation has been enqueued, on the monotonic clock, or 0 if not tracked.
+ */
+@property (nonatomic, assign) uint64_t enqueueTime;
+
+/**
+ @brief Time the invocation is due, on the monotonic clock, if scheduled with a delay.
+ */
+@property (nonatomic, assign) uint64_t deadline;
+
+/**
+ @brief Set when the enqueue of the invocation has been traced, so that a discard ends its queue wait in the trace.
+ */
+@property (nonatomic, assign) BOOL enqueueTraced;
+
+/**
+ @brief If the invocation is an LSPeriodicInvocation, checked by threads to reschedule it instead of completing it.
+ */
+@property (nonatomic, assign) BOOL periodic;
+
+/**
+ @brief Called when the invocation is rejected, before waiting threads are woken up.
+ */
+@property (nonatomic, copy) void (^rejectionHandler)(NSError *error);
 
 
 @end
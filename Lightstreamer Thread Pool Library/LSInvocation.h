@@ -21,6 +21,17 @@
 #import <Foundation/Foundation.h>
 
 
+/**
+ @brief Error domain of errors produced by an LSInvocation.
+ */
+#define LS_INVOCATION_ERROR_DOMAIN                         (@"LSInvocationDomain")
+
+/**
+ @brief Error code of a scheduled call cancelled before it started.
+ */
+#define LS_INVOCATION_ERROR_CODE_CANCELLED                 (-1701)
+
+
 /**
  @brief Type used to characterize blocks that can be scheduled for call with LSThreadPool.
  */
@@ -29,7 +40,7 @@ typedef void (^LSInvocationBlock)(void);
 
 /**
  @brief LSInvocation describes a scheduled call, such as the target and selector, block or delay.
- <br/> Provides a service to wait for its completion.
+ <br/> Provides services to wait for its completion and to cancel it while it's still waiting to be executed.
  */
 @interface LSInvocation : NSObject
 
@@ -44,6 +55,19 @@ typedef void (^LSInvocationBlock)(void);
 - (void) waitForCompletion;
 
 
+#pragma mark -
+#pragma mark Cancellation
+
+/**
+ @brief Cancels the scheduled call, if it has not started yet.
+ <br/> A cancelled call is never executed and is considered completed, with an <code>error</code> of code
+ <code>LS_INVOCATION_ERROR_CODE_CANCELLED</code>. Cancellation takes constant time: the call is left in the
+ queue of the thread pool and skipped when its turn comes.
+ @return YES if the call has been cancelled, NO if it had already started, completed, or been rejected.
+ */
+- (BOOL) cancel;
+
+
 #pragma mark -
 #pragma mark Properties
 
@@ -71,11 +95,28 @@ typedef void (^LSInvocationBlock)(void);
  */
 @property (nonatomic, readonly, nullable) id argument;
 
+/**
+ @brief The second argument of the selector to be called with this scheduled call.
+ <br/> May be nil. Scalar arguments are not exposed.
+ */
+@property (nonatomic, readonly, nullable) id secondArgument;
+
 /**
  @brief The delay to be waited for before executing the scheduled call.
  <br/> NOTE: used internally by the LSTimerThread.
  */
 @property (nonatomic, readonly) NSTimeInterval delay;
 
+/**
+ @brief An eventual error, if the scheduled call has been cancelled or rejected by a thread pool with a bounded queue.
+ <br/> A cancelled or rejected call is never executed, and is considered completed.
+ */
+@property (nonatomic, readonly, nullable) NSError *error;
+
+/**
+ @brief If the scheduled call has been cancelled, either with <code>cancel</code> or by shutting down its thread pool.
+ */
+@property (nonatomic, readonly) BOOL cancelled;
+
 
 @end
@@ -19,7 +19,21 @@
 //
 
 #import "LSInvocation.h"
+#import "LSInvocation+Internals.h"
+#import "LSTrace+Internals.h"
 
+#import <stdatomic.h>
+
+#define INVOCATION_STATE_PENDING                           (0)
+#define INVOCATION_STATE_STARTED                           (1)
+#define INVOCATION_STATE_DISCARDED                         (2)
+
+#define INVOCATION_ARGUMENTS_NONE                          (0)
+#define INVOCATION_ARGUMENTS_OBJECT                        (1)
+#define INVOCATION_ARGUMENTS_TWO_OBJECTS                   (2)
+#define INVOCATION_ARGUMENTS_INTEGER                       (3)
+#define INVOCATION_ARGUMENTS_DOUBLE                        (4)
+#define INVOCATION_ARGUMENTS_POINTER                       (5)
 
 
 #pragma mark -
@@ -29,15 +43,43 @@
 	id _target;
 	SEL _selector;
 	id _argument;
+	id _secondArgument;
 	NSTimeInterval _delay;
 	
+	// Resolved once at creation, so that performing needs no lookup
+	IMP _imp;
+	int _argumentKind;
+	
+	// Scalar arguments are stored as they are, with no boxing
+	NSInteger _integerArgument;
+	double _doubleArgument;
+	void *_pointerArgument;
+	
 	LSInvocationBlock _block;
 	
 	NSCondition *_completionMonitor;
 	BOOL _completed;
+	
+	uint64_t _enqueueTime;
+	uint64_t _deadline;
+	BOOL _enqueueTraced;
+	BOOL _periodic;
+	
+	// Pending invocations may be started, or discarded by cancellation or rejection, but not both
+	atomic_int _state;
+	BOOL _cancelled;
+	
+	NSError *_error;
+	void (^_rejectionHandler)(NSError *error);
 }
 
 
+#pragma mark -
+#pragma mark Internals
+
+- (void) discardWithError:(NSError *)error;
+
+
 @end
 
 
@@ -116,6 +158,62 @@
 	return invocation;
 }
 
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector argument:(id)argument secondArgument:(id)secondArgument {
+	if (!selector)
+		@throw [NSException exceptionWithName:NSInvalidArgumentException
+									   reason:@"Selector can't be nil"
+									 userInfo:nil];
+	
+    // Target is checked in the LSInvocatoin initializer
+	LSInvocation *invocation= [[LSInvocation alloc] initWithTarget:target selector:selector argument:argument delay:0.0];
+	invocation->_secondArgument= secondArgument;
+	invocation->_argumentKind= INVOCATION_ARGUMENTS_TWO_OBJECTS;
+	
+	return invocation;
+}
+
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector integerArgument:(NSInteger)argument {
+	if (!selector)
+		@throw [NSException exceptionWithName:NSInvalidArgumentException
+									   reason:@"Selector can't be nil"
+									 userInfo:nil];
+	
+    // Target is checked in the LSInvocatoin initializer
+	LSInvocation *invocation= [[LSInvocation alloc] initWithTarget:target selector:selector argument:nil delay:0.0];
+	invocation->_integerArgument= argument;
+	invocation->_argumentKind= INVOCATION_ARGUMENTS_INTEGER;
+	
+	return invocation;
+}
+
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector doubleArgument:(double)argument {
+	if (!selector)
+		@throw [NSException exceptionWithName:NSInvalidArgumentException
+									   reason:@"Selector can't be nil"
+									 userInfo:nil];
+	
+    // Target is checked in the LSInvocatoin initializer
+	LSInvocation *invocation= [[LSInvocation alloc] initWithTarget:target selector:selector argument:nil delay:0.0];
+	invocation->_doubleArgument= argument;
+	invocation->_argumentKind= INVOCATION_ARGUMENTS_DOUBLE;
+	
+	return invocation;
+}
+
++ (LSInvocation *) invocationWithTarget:(id)target selector:(SEL)selector pointerArgument:(void *)argument {
+	if (!selector)
+		@throw [NSException exceptionWithName:NSInvalidArgumentException
+									   reason:@"Selector can't be nil"
+									 userInfo:nil];
+	
+    // Target is checked in the LSInvocatoin initializer
+	LSInvocation *invocation= [[LSInvocation alloc] initWithTarget:target selector:selector argument:nil delay:0.0];
+	invocation->_pointerArgument= argument;
+	invocation->_argumentKind= INVOCATION_ARGUMENTS_POINTER;
+	
+	return invocation;
+}
+
 - (instancetype) initWithBlock:(LSInvocationBlock)block delay:(NSTimeInterval)delay {
 	if ((self = [super init])) {
 		
@@ -127,6 +225,8 @@
 
 		_block= [block copy];
         _delay= delay;
+		
+		atomic_init(&_state, INVOCATION_STATE_PENDING);
 	}
 	
 	return self;
@@ -145,46 +245,164 @@
 		_selector= selector;
 		_argument= argument;
 		_delay= delay;
+		
+		// Find method implementation once, it is called directly when performing
+		if (selector)
+			_imp= [target methodForSelector:selector];
+		
+		// Selectors with no colon take no arguments, the others take the (possibly nil) argument
+		_argumentKind= (selector && strchr(sel_getName(selector), ':')) ? INVOCATION_ARGUMENTS_OBJECT : INVOCATION_ARGUMENTS_NONE;
+		
+		atomic_init(&_state, INVOCATION_STATE_PENDING);
 	}
 	
 	return self;
 }
 
 
+#pragma mark -
+#pragma mark Execution (for internal use only)
+
+- (BOOL) beginPerforming {
+	int expected= INVOCATION_STATE_PENDING;
+	
+	return atomic_compare_exchange_strong_explicit(&_state, &expected, INVOCATION_STATE_STARTED, memory_order_acq_rel, memory_order_acquire);
+}
+
+- (BOOL) rearm {
+	int expected= INVOCATION_STATE_STARTED;
+	
+	return atomic_compare_exchange_strong_explicit(&_state, &expected, INVOCATION_STATE_PENDING, memory_order_acq_rel, memory_order_acquire);
+}
+
+- (void) perform {
+	if (_target) {
+		if (!_imp)
+			return;
+		
+		// Call the cached method implementation with the proper signature
+		switch (_argumentKind) {
+			case INVOCATION_ARGUMENTS_OBJECT:
+				((void (*)(id, SEL, id)) _imp)(_target, _selector, _argument);
+				break;
+				
+			case INVOCATION_ARGUMENTS_TWO_OBJECTS:
+				((void (*)(id, SEL, id, id)) _imp)(_target, _selector, _argument, _secondArgument);
+				break;
+				
+			case INVOCATION_ARGUMENTS_INTEGER:
+				((void (*)(id, SEL, NSInteger)) _imp)(_target, _selector, _integerArgument);
+				break;
+				
+			case INVOCATION_ARGUMENTS_DOUBLE:
+				((void (*)(id, SEL, double)) _imp)(_target, _selector, _doubleArgument);
+				break;
+				
+			case INVOCATION_ARGUMENTS_POINTER:
+				((void (*)(id, SEL, void *)) _imp)(_target, _selector, _pointerArgument);
+				break;
+				
+			case INVOCATION_ARGUMENTS_NONE:
+			default:
+				((void (*)(id, SEL)) _imp)(_target, _selector);
+				break;
+		}
+		
+	} else if (_block) {
+		_block();
+	}
+}
+
+
 #pragma mark -
 #pragma mark Completion monitoring (for custom use)
 
 - (void) waitForCompletion {
-	BOOL toBeReleased= NO;
+	NSCondition *completionMonitor= nil;
 
 	@synchronized (self) {
 		if (_completed)
 			return;
 
-		if (!_completionMonitor) {
+		if (!_completionMonitor)
 			_completionMonitor= [[NSCondition alloc] init];
-			toBeReleased= YES;
-		}
+		
+		completionMonitor= _completionMonitor;
 	}
 	
-	[_completionMonitor lock];
-	[_completionMonitor wait];
-	[_completionMonitor unlock];
+	// Check the flag under the monitor lock, or the broadcast may be lost
+	[completionMonitor lock];
+	while (!_completed)
+		[completionMonitor wait];
+	[completionMonitor unlock];
+}
+
+- (void) rejectWithError:(NSError *)error {
+	int expected= INVOCATION_STATE_PENDING;
+	if (!atomic_compare_exchange_strong_explicit(&_state, &expected, INVOCATION_STATE_DISCARDED, memory_order_acq_rel, memory_order_acquire))
+		return;
 	
-	if (toBeReleased)
-		_completionMonitor= nil;
+	[self discardWithError:error];
 }
 
 - (void) completed {
+	NSCondition *completionMonitor= nil;
+
 	@synchronized (self) {
 		_completed= YES;
+		
+		completionMonitor= _completionMonitor;
 	}
 	
-	if (_completionMonitor) {
-		[_completionMonitor lock];
-		[_completionMonitor broadcast];
-		[_completionMonitor unlock];
+	if (completionMonitor) {
+		[completionMonitor lock];
+		[completionMonitor broadcast];
+		[completionMonitor unlock];
+	}
+}
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+- (BOOL) cancel {
+	int expected= INVOCATION_STATE_PENDING;
+	if (!atomic_compare_exchange_strong_explicit(&_state, &expected, INVOCATION_STATE_DISCARDED, memory_order_acq_rel, memory_order_acquire))
+		return NO;
+	
+	@synchronized (self) {
+		_cancelled= YES;
+	}
+	
+	[self discardWithError:[NSError errorWithDomain:LS_INVOCATION_ERROR_DOMAIN
+											   code:LS_INVOCATION_ERROR_CODE_CANCELLED
+										   userInfo:@{NSLocalizedDescriptionKey: @"Call cancelled before it started"}]];
+	
+	return YES;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (void) discardWithError:(NSError *)error {
+	void (^rejectionHandler)(NSError *error)= nil;
+	
+	@synchronized (self) {
+		_error= error;
+		
+		rejectionHandler= _rejectionHandler;
+		_rejectionHandler= nil;
 	}
+	
+	if (rejectionHandler)
+		rejectionHandler(error);
+	
+	// Close the queue wait opened by the enqueue, traced even if tracing stops meanwhile
+	if (_enqueueTraced)
+		LSTraceRecordEvent(LSTraceEventTypeCallDiscarded, (__bridge const void *) self, NULL, 0);
+	
+	[self completed];
 }
 
 
@@ -195,6 +413,51 @@
 @synthesize target= _target;
 @synthesize selector= _selector;
 @synthesize argument= _argument;
+@synthesize secondArgument= _secondArgument;
+
+@dynamic enqueueTime;
+
+- (uint64_t) enqueueTime {
+	return _enqueueTime;
+}
+
+- (void) setEnqueueTime:(uint64_t)enqueueTime {
+	_enqueueTime= enqueueTime;
+}
+
+@synthesize deadline= _deadline;
+@synthesize enqueueTraced= _enqueueTraced;
+@synthesize periodic= _periodic;
+
+@dynamic rejectionHandler;
+
+- (void (^)(NSError *)) rejectionHandler {
+	@synchronized (self) {
+		return _rejectionHandler;
+	}
+}
+
+- (void) setRejectionHandler:(void (^)(NSError *))rejectionHandler {
+	@synchronized (self) {
+		_rejectionHandler= [rejectionHandler copy];
+	}
+}
+
+@dynamic error;
+
+- (NSError *) error {
+	@synchronized (self) {
+		return _error;
+	}
+}
+
+@dynamic cancelled;
+
+- (BOOL) cancelled {
+	@synchronized (self) {
+		return _cancelled;
+	}
+}
 
 
 @end
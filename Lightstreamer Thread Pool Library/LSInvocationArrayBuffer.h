@@ -0,0 +1,40 @@
+//
+//  LSInvocationArrayBuffer.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSInvocationBuffer.h"
+
+
+/**
+ @brief An unbounded invocation buffer based on a mutable array protected by a lock.
+ <b>This class should not be used directly</b>.
+ @see LSInvocationQueue.
+ */
+@interface LSInvocationArrayBuffer : NSObject <LSInvocationBuffer>
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) init NS_DESIGNATED_INITIALIZER;
+
+
+@end
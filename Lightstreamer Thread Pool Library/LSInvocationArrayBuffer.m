@@ -0,0 +1,129 @@
+//
+//  LSInvocationArrayBuffer.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSInvocationArrayBuffer.h"
+#import "LSInvocation.h"
+
+#import <pthread.h>
+
+
+#pragma mark -
+#pragma mark LSInvocationArrayBuffer extension
+
+@interface LSInvocationArrayBuffer () {
+    NSMutableArray<LSInvocation *> *_invocations;
+    pthread_mutex_t _lock;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSInvocationArrayBuffer implementation
+
+@implementation LSInvocationArrayBuffer
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) init {
+    if ((self = [super init])) {
+
+        // Initialization
+        _invocations= [[NSMutableArray alloc] init];
+
+        pthread_mutex_init(&_lock, NULL);
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark -
+#pragma mark Buffer operations
+
+- (void) addInvocation:(LSInvocation *)invocation {
+    pthread_mutex_lock(&_lock);
+
+    [_invocations addObject:invocation];
+
+    pthread_mutex_unlock(&_lock);
+}
+
+- (LSInvocation *) removeFirstInvocation {
+    LSInvocation *invocation= nil;
+
+    pthread_mutex_lock(&_lock);
+
+    if (_invocations.count > 0) {
+        invocation= _invocations[0];
+
+        [_invocations removeObjectAtIndex:0];
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return invocation;
+}
+
+- (NSUInteger) removeFirstInvocations:(NSUInteger)maxCount intoBatch:(NSMutableArray<LSInvocation *> *)batch {
+    NSUInteger count= 0;
+
+    pthread_mutex_lock(&_lock);
+
+    // A whole batch for a single lock round-trip
+    count= MIN(maxCount, _invocations.count);
+    for (NSUInteger i= 0; i < count; i++)
+        [batch addObject:_invocations[i]];
+
+    if (count > 0)
+        [_invocations removeObjectsInRange:NSMakeRange(0, count)];
+
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic count;
+
+- (NSUInteger) count {
+    NSUInteger count= 0;
+
+    pthread_mutex_lock(&_lock);
+
+    count= _invocations.count;
+
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+
+@end
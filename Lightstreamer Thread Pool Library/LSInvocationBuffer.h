@@ -0,0 +1,54 @@
+//
+//  LSInvocationBuffer.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSInvocation;
+
+
+/**
+ @brief Storage backend of an LSInvocationQueue. <b>This protocol should not be used directly</b>.
+ <br/> Implementations must be thread safe and keep invocations in first-in-first-out order.
+ @see LSInvocationQueue.
+ */
+@protocol LSInvocationBuffer <NSObject>
+
+
+#pragma mark -
+#pragma mark Buffer operations (for internal use only)
+
+- (void) addInvocation:(nonnull LSInvocation *)invocation;
+- (nullable LSInvocation *) removeFirstInvocation;
+
+/**
+ @brief Moves up to <code>maxCount</code> invocations, in order, to the end of the batch.
+ @return The number of invocations moved.
+ */
+- (NSUInteger) removeFirstInvocations:(NSUInteger)maxCount intoBatch:(nonnull NSMutableArray<LSInvocation *> *)batch;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly) NSUInteger count;
+
+
+@end
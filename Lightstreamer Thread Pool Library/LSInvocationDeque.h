@@ -0,0 +1,63 @@
+//
+//  LSInvocationDeque.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSInvocation;
+
+
+/**
+ @brief The local deque of an LSThreadPoolThread when work stealing is enabled. <b>This class should not be used directly</b>.
+ <br/> The owner thread pushes and pops invocations at the tail (last-in-first-out, for cache locality),
+ while other threads steal invocations from the head (first-in-first-out).
+ @see LSInvocationQueue.
+ */
+@interface LSInvocationDeque : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) init NS_DESIGNATED_INITIALIZER;
+
+
+#pragma mark -
+#pragma mark Deque operations (for internal use only)
+
+- (void) pushInvocation:(nonnull LSInvocation *)invocation;
+- (nullable LSInvocation *) popInvocation;
+- (nullable LSInvocation *) stealInvocation;
+
+- (nonnull NSArray<LSInvocation *> *) removeAllInvocations;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ @brief Used by the owner thread only, to spread steal attempts across peers.
+ */
+@property (nonatomic, assign) NSUInteger stealCursor;
+
+
+@end
@@ -0,0 +1,151 @@
+//
+//  LSInvocationDeque.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSInvocationDeque.h"
+#import "LSInvocation.h"
+
+#import <stdatomic.h>
+#import <pthread.h>
+
+
+#pragma mark -
+#pragma mark LSInvocationDeque extension
+
+@interface LSInvocationDeque () {
+    NSMutableArray<LSInvocation *> *_invocations;
+    pthread_mutex_t _lock;
+
+    atomic_size_t _count;
+    NSUInteger _stealCursor;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSInvocationDeque implementation
+
+@implementation LSInvocationDeque
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) init {
+    if ((self = [super init])) {
+
+        // Initialization
+        _invocations= [[NSMutableArray alloc] init];
+        pthread_mutex_init(&_lock, NULL);
+
+        atomic_init(&_count, 0);
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark -
+#pragma mark Deque operations
+
+- (void) pushInvocation:(LSInvocation *)invocation {
+    pthread_mutex_lock(&_lock);
+
+    [_invocations addObject:invocation];
+    atomic_fetch_add_explicit(&_count, 1, memory_order_relaxed);
+
+    pthread_mutex_unlock(&_lock);
+}
+
+- (LSInvocation *) popInvocation {
+
+    // Avoid taking the lock when there's nothing to pop
+    if (atomic_load_explicit(&_count, memory_order_relaxed) == 0)
+        return nil;
+
+    LSInvocation *invocation= nil;
+
+    pthread_mutex_lock(&_lock);
+
+    invocation= _invocations.lastObject;
+    if (invocation) {
+        [_invocations removeLastObject];
+        atomic_fetch_sub_explicit(&_count, 1, memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return invocation;
+}
+
+- (LSInvocation *) stealInvocation {
+
+    // Avoid taking the lock when there's nothing to steal
+    if (atomic_load_explicit(&_count, memory_order_relaxed) == 0)
+        return nil;
+
+    LSInvocation *invocation= nil;
+
+    pthread_mutex_lock(&_lock);
+
+    invocation= _invocations.firstObject;
+    if (invocation) {
+        [_invocations removeObjectAtIndex:0];
+        atomic_fetch_sub_explicit(&_count, 1, memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return invocation;
+}
+
+- (NSArray<LSInvocation *> *) removeAllInvocations {
+    NSArray<LSInvocation *> *invocations= nil;
+
+    pthread_mutex_lock(&_lock);
+
+    invocations= [_invocations copy];
+    [_invocations removeAllObjects];
+    atomic_store_explicit(&_count, 0, memory_order_relaxed);
+
+    pthread_mutex_unlock(&_lock);
+
+    return invocations;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic count;
+
+- (NSUInteger) count {
+    return atomic_load_explicit(&_count, memory_order_relaxed);
+}
+
+@synthesize stealCursor= _stealCursor;
+
+
+@end
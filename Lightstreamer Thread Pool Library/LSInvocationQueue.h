@@ -0,0 +1,171 @@
+//
+//  LSInvocationQueue.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSInvocationBuffer.h"
+#import "LSFunctionRecord.h"
+
+
+@class LSInvocation;
+@class LSInvocationDeque;
+@class LSThreadParker;
+
+
+/**
+ @brief Number of priority lanes of the queue, from the lowest (0) to the highest.
+ */
+#define LS_INVOCATION_QUEUE_LANES                          (3)
+
+/**
+ @brief The lane of invocations with no specified priority, also used for local deques.
+ */
+#define LS_INVOCATION_QUEUE_DEFAULT_LANE                   (1)
+
+
+/**
+ @brief The invocation queue shared by an LSThreadPool and its threads. <b>This class should not be used directly</b>.
+ <br/> Invocations are stored in one LSInvocationBuffer per priority lane. Threads with nothing to do spin briefly,
+ then push their own LSThreadParker on a stack of idle threads and park. Producers pop the most recently parked
+ thread and wake up exactly that one, and do nothing if no thread is idle.
+ <br/> Lanes are drained from the highest to the lowest. A lower lane that has been skipped for longer than its aging
+ interval is served first, so that lower priorities can't be starved.
+ <br/> When a capacity is specified, producers must reserve a slot before enqueuing in a lane. Slots are released
+ when invocations are dequeued, and producers waiting for a slot are woken up only if there are any.
+ <br/> When work stealing is enabled, each thread registers its own LSInvocationDeque: a thread looks for invocations
+ in its local deque first, then in the shared buffer, and finally steals them from the deques of other threads.
+ <br/> Delayed invocations are kept in a min-heap ordered by deadline, and are dequeued before any lane as soon as
+ they are due. While some are pending, one of the idle threads acts as timekeeper and parks only until the earliest
+ deadline. Producers of an earlier deadline wake up the timekeeper, so that it parks again with the new one.
+ @see LSThreadPool.
+ */
+@interface LSInvocationQueue : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+/**
+ @brief Initializes the queue with the specified buffers, one per lane, from the lowest to the highest.
+ */
+- (nonnull instancetype) initWithBuffers:(nonnull NSArray<id <LSInvocationBuffer>> *)buffers capacity:(NSUInteger)capacity workStealing:(BOOL)workStealing NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+
+#pragma mark -
+#pragma mark Queue operations (for internal use only)
+
+/**
+ @brief Adds the invocation to the queue and wakes up an idle thread, if any.
+ @return YES if an idle thread has been woken up, NO if no thread was idle.
+ */
+- (BOOL) enqueueInvocation:(nonnull LSInvocation *)invocation lane:(NSUInteger)lane;
+- (BOOL) enqueueInvocation:(nonnull LSInvocation *)invocation toLocalDeque:(nonnull LSInvocationDeque *)deque;
+
+/**
+ @brief Adds the function record to the default lane and wakes up an idle thread, if any. The slot, if bounded, must have been reserved.
+ @return YES if an idle thread has been woken up, NO if no thread was idle.
+ */
+- (BOOL) enqueueFunctionRecord:(nonnull LSFunctionRecord *)record;
+
+/**
+ @brief Adds the invocation to the delayed invocations, to be dequeued when its deadline is due. Delayed invocations don't take slots.
+ <br/> If its deadline is the earliest, the timekeeper (or any idle thread, if none) is woken up to park again until it.
+ */
+- (void) enqueueDelayedInvocation:(nonnull LSInvocation *)invocation;
+
+/**
+ @brief Looks for an invocation or a function record. If a function record is found, it is returned in <code>record</code> and the result is <code>nil</code>.
+ */
+- (nullable LSInvocation *) dequeueInvocationWithLocalDeque:(nullable LSInvocationDeque *)deque functionRecord:(LSFunctionRecord * _Nullable * _Nonnull)record;
+
+/**
+ @brief Looks for an invocation or a function record, spinning and then parking with the specified parker if none is available.
+ @param date The date when to give up waiting. If <code>nil</code>, waits until something is available or the queue is disposed of.
+ */
+- (nullable LSInvocation *) dequeueInvocationWithLocalDeque:(nullable LSInvocationDeque *)deque functionRecord:(LSFunctionRecord * _Nullable * _Nonnull)record parker:(nonnull LSThreadParker *)parker waitingUntilDate:(nullable NSDate *)date;
+
+/**
+ @brief Moves more invocations of the highest non-empty lane to the batch, taken all at once from its buffer.
+ <br/> No more than the fair share of the lane is taken, i.e. its count divided by the number of threads, so that
+ other threads are not left with nothing to do. Nothing is taken while a lower lane is waiting to be aged.
+ @return The number of invocations moved to the batch.
+ */
+- (NSUInteger) dequeueInvocationsIntoBatch:(nonnull NSMutableArray<LSInvocation *> *)batch maxCount:(NSUInteger)maxCount threadCount:(NSUInteger)threadCount;
+
+/**
+ @brief Wakes up all idle threads and all producers waiting for a slot. Waiting producers fail to reserve it.
+ <br/> Invocations still in the queue may be dequeued, but threads don't park any more once it's empty.
+ */
+- (void) dispose;
+
+/**
+ @brief Removes all invocations from the lanes and local deques, releasing their slots, followed by delayed invocations. Pending function records are dropped.
+ */
+- (nonnull NSArray<LSInvocation *> *) removeAllInvocations;
+
+/**
+ @brief Removes all delayed invocations, leaving the lanes untouched.
+ */
+- (nonnull NSArray<LSInvocation *> *) removeAllDelayedInvocations;
+
+/**
+ @brief The count of invocations in the specified lane. The default lane includes invocations in local deques and function records.
+ */
+- (NSUInteger) countForLane:(NSUInteger)lane;
+
+
+#pragma mark -
+#pragma mark Bounded queue (for internal use only)
+
+/**
+ @brief Reserves a slot for an invocation to be enqueued in a lane. Always succeeds if the queue is unbounded.
+ @return YES if the slot has been reserved, NO if the queue is full.
+ */
+- (BOOL) reserveSlot;
+- (BOOL) reserveSlotWaitingUntilDate:(nonnull NSDate *)date;
+
+/**
+ @brief Removes the oldest invocation of the lowest non-empty lane, releasing its slot.
+ <br/> Function records of the default lane are removed once its invocations are over: in this case
+ the record is returned through <code>record</code>, and it is up to the caller to release it.
+ */
+- (nullable LSInvocation *) removeOldestInvocationOrFunctionRecord:(LSFunctionRecord * _Nullable * _Nonnull)record;
+
+
+#pragma mark -
+#pragma mark Work stealing (for internal use only)
+
+- (void) registerLocalDeque:(nonnull LSInvocationDeque *)deque;
+- (void) unregisterLocalDeque:(nonnull LSInvocationDeque *)deque;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSUInteger delayedCount;
+@property (nonatomic, readonly) BOOL workStealing;
+@property (nonatomic, readonly) NSUInteger capacity;
+@property (nonatomic, readonly) BOOL disposed;
+
+
+@end
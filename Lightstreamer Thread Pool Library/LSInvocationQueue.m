@@ -0,0 +1,961 @@
+//
+//  LSInvocationQueue.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSInvocationQueue.h"
+#import "LSInvocation.h"
+#import "LSInvocation+Internals.h"
+#import "LSInvocationDeque.h"
+#import "LSThreadParker.h"
+#import "LSFunctionRecord.h"
+#import "LSMonotonicClock.h"
+#import "LSTrace+Internals.h"
+
+#import <stdatomic.h>
+#import <pthread.h>
+
+#define LOW_LANE_AGING_INTERVAL_NSECS                      (500000000ULL)
+#define DEFAULT_LANE_AGING_INTERVAL_NSECS                  (100000000ULL)
+
+#define IDLE_SPIN_NSECS                                        (50000ULL)
+#define IDLE_SPIN_RELAX_COUNT                                     (64)
+
+
+static inline void LSCPURelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__arm64__) || defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+
+#pragma mark -
+#pragma mark LSInvocationQueue extension
+
+@interface LSInvocationQueue () {
+    id <LSInvocationBuffer> _buffers[LS_INVOCATION_QUEUE_LANES];
+    BOOL _workStealing;
+    
+    // Counts are incremented before adding and decremented after removing,
+    // so they never fall below the actual number of queued invocations
+    atomic_size_t _laneCounts[LS_INVOCATION_QUEUE_LANES];
+    
+    // Function records, an intrusive FIFO belonging to the default lane
+    LSFunctionRecord *_functionHead;
+    LSFunctionRecord *_functionTail;
+    pthread_mutex_t _functionLock;
+    atomic_size_t _functionCount;
+    
+    // Whether function records or invocations come first in the default lane, alternating
+    atomic_bool _functionTurn;
+    
+    // Time since a non-empty lane has been skipped in favor of a higher one, 0 if not skipped
+    atomic_uint_fast64_t _starvingSince[LS_INVOCATION_QUEUE_LANES];
+    uint64_t _agingIntervals[LS_INVOCATION_QUEUE_LANES];
+
+    // Parkers of idle threads, last parked on top
+    NSMutableArray<LSThreadParker *> *_idleWorkers;
+    pthread_mutex_t _idleLock;
+    atomic_uint _idleCount;
+    
+    // Delayed invocations, a min-heap ordered by deadline
+    NSMutableArray<LSInvocation *> *_delayed;
+    pthread_mutex_t _delayedLock;
+    atomic_size_t _delayedCount;
+    atomic_uint_fast64_t _earliestDeadline;
+    
+    // The idle thread parked until the earliest deadline, if any (guarded by _idleLock)
+    LSThreadParker *_timekeeper;
+    
+    uint64_t _spinNanoseconds;
+    
+    NSUInteger _capacity;
+    atomic_size_t _reservedSlots;
+    
+    NSCondition *_spaceMonitor;
+    atomic_uint _waitingProducers;
+    
+    atomic_bool _disposed;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) wakeUpIdleWorker;
+- (BOOL) removeIdleWorker:(LSThreadParker *)parker;
+- (LSInvocation *) findInvocationWithLocalDeque:(LSInvocationDeque *)deque functionRecord:(LSFunctionRecord **)record;
+- (LSFunctionRecord *) pollFunctionRecord;
+- (LSInvocation *) pollDueInvocation;
+- (BOOL) becomeTimekeeper:(LSThreadParker *)parker;
+- (void) resignTimekeeper:(LSThreadParker *)parker;
+- (LSInvocation *) stealInvocationForLocalDeque:(LSInvocationDeque *)deque;
+
+- (LSInvocation *) pollLane:(NSUInteger)lane;
+- (void) markLanesBelowAsSkipped:(NSUInteger)lane;
+
+- (void) releaseSlot;
+- (void) releaseSlots:(NSUInteger)count;
+
+
+#pragma mark -
+#pragma mark Properties
+
+@property (atomic, copy) NSArray<LSInvocationDeque *> *localDeques;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSInvocationQueue implementation
+
+@implementation LSInvocationQueue
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithBuffers:(NSArray<id <LSInvocationBuffer>> *)buffers capacity:(NSUInteger)capacity workStealing:(BOOL)workStealing {
+    if ((self = [super init])) {
+
+        // Initialization
+        if (buffers.count != LS_INVOCATION_QUEUE_LANES)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Buffers must be exactly one per lane"
+                                         userInfo:nil];
+        
+        for (NSUInteger lane= 0; lane < LS_INVOCATION_QUEUE_LANES; lane++) {
+            _buffers[lane]= buffers[lane];
+            
+            atomic_init(&_laneCounts[lane], 0);
+            atomic_init(&_starvingSince[lane], 0);
+            _agingIntervals[lane]= 0;
+        }
+        
+        _agingIntervals[0]= LOW_LANE_AGING_INTERVAL_NSECS;
+        _agingIntervals[LS_INVOCATION_QUEUE_DEFAULT_LANE]= DEFAULT_LANE_AGING_INTERVAL_NSECS;
+        
+        _workStealing= workStealing;
+        
+        _functionHead= NULL;
+        _functionTail= NULL;
+        pthread_mutex_init(&_functionLock, NULL);
+        atomic_init(&_functionCount, 0);
+        atomic_init(&_functionTurn, false);
+
+        self.localDeques= @[];
+
+        _idleWorkers= [[NSMutableArray alloc] init];
+        pthread_mutex_init(&_idleLock, NULL);
+        atomic_init(&_idleCount, 0);
+        
+        _delayed= [[NSMutableArray alloc] init];
+        pthread_mutex_init(&_delayedLock, NULL);
+        atomic_init(&_delayedCount, 0);
+        atomic_init(&_earliestDeadline, UINT64_MAX);
+        _timekeeper= nil;
+        
+        // Spinning is pointless if there's no other processor to produce invocations
+        _spinNanoseconds= ([NSProcessInfo processInfo].activeProcessorCount > 1) ? IDLE_SPIN_NSECS : 0;
+        
+        _capacity= capacity;
+        atomic_init(&_reservedSlots, 0);
+        
+        _spaceMonitor= [[NSCondition alloc] init];
+        atomic_init(&_waitingProducers, 0);
+        
+        atomic_init(&_disposed, false);
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_idleLock);
+    pthread_mutex_destroy(&_functionLock);
+    pthread_mutex_destroy(&_delayedLock);
+    
+    // Records left behind go back to the free lists
+    while (_functionHead) {
+        LSFunctionRecord *record= _functionHead;
+        _functionHead= record->next;
+        
+        LSFunctionRecordRelease(record);
+    }
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSInvocationQueue"
+                                 userInfo:nil];
+}
+
+
+#pragma mark -
+#pragma mark Queue operations
+
+- (BOOL) enqueueInvocation:(LSInvocation *)invocation lane:(NSUInteger)lane {
+    if (lane >= LS_INVOCATION_QUEUE_LANES)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Invalid lane"
+                                     userInfo:@{@"lane": @(lane)}];
+    
+    atomic_fetch_add_explicit(&_laneCounts[lane], 1, memory_order_relaxed);
+    [_buffers[lane] addInvocation:invocation];
+
+    return [self wakeUpIdleWorker];
+}
+
+- (BOOL) enqueueInvocation:(LSInvocation *)invocation toLocalDeque:(LSInvocationDeque *)deque {
+    [deque pushInvocation:invocation];
+
+    // An idle thread, if any, will steal it
+    return [self wakeUpIdleWorker];
+}
+
+- (BOOL) enqueueFunctionRecord:(LSFunctionRecord *)record {
+    record->next= NULL;
+    
+    atomic_fetch_add_explicit(&_functionCount, 1, memory_order_relaxed);
+    
+    pthread_mutex_lock(&_functionLock);
+    
+    if (_functionTail)
+        _functionTail->next= record;
+    else
+        _functionHead= record;
+    
+    _functionTail= record;
+    
+    pthread_mutex_unlock(&_functionLock);
+    
+    return [self wakeUpIdleWorker];
+}
+
+- (void) enqueueDelayedInvocation:(LSInvocation *)invocation {
+    uint64_t deadline= invocation.deadline;
+    BOOL earliest= NO;
+    
+    pthread_mutex_lock(&_delayedLock);
+    
+    // Sift up from the bottom of the heap
+    NSUInteger index= _delayed.count;
+    [_delayed addObject:invocation];
+    
+    while (index > 0) {
+        NSUInteger parent= (index - 1) / 2;
+        if (_delayed[parent].deadline <= deadline)
+            break;
+        
+        [_delayed exchangeObjectAtIndex:index withObjectAtIndex:parent];
+        index= parent;
+    }
+    
+    if (index == 0) {
+        atomic_store_explicit(&_earliestDeadline, deadline, memory_order_relaxed);
+        earliest= YES;
+    }
+    
+    atomic_fetch_add_explicit(&_delayedCount, 1, memory_order_relaxed);
+    
+    pthread_mutex_unlock(&_delayedLock);
+    
+    // Later deadlines are already covered by the timekeeper
+    if (!earliest)
+        return;
+    
+    // Pairs with the fence in dequeueInvocationWithLocalDeque:parker:waitingUntilDate:,
+    // either we see the idle thread or the idle thread sees the new deadline
+    atomic_thread_fence(memory_order_seq_cst);
+    
+    LSThreadParker *timekeeper= nil;
+    
+    pthread_mutex_lock(&_idleLock);
+    timekeeper= _timekeeper;
+    pthread_mutex_unlock(&_idleLock);
+    
+    // The timekeeper stays on the idle stack, it will just park again with the new deadline
+    if (timekeeper)
+        [timekeeper unpark];
+    else
+        [self wakeUpIdleWorker];
+}
+
+- (LSInvocation *) dequeueInvocationWithLocalDeque:(LSInvocationDeque *)deque functionRecord:(LSFunctionRecord **)record {
+    return [self findInvocationWithLocalDeque:deque functionRecord:record];
+}
+
+- (LSInvocation *) dequeueInvocationWithLocalDeque:(LSInvocationDeque *)deque functionRecord:(LSFunctionRecord **)record parker:(LSThreadParker *)parker waitingUntilDate:(NSDate *)date {
+    LSInvocation *invocation= [self findInvocationWithLocalDeque:deque functionRecord:record];
+    if (invocation || *record)
+        return invocation;
+    
+    // Spin for a while before parking, so that back-to-back
+    // invocations are picked up without paying a wakeup
+    if (_spinNanoseconds) {
+        uint64_t spinEnd= LSMonotonicNanoseconds() + _spinNanoseconds;
+        
+        do {
+            for (int i= 0; i < IDLE_SPIN_RELAX_COUNT; i++)
+                LSCPURelax();
+            
+            invocation= [self findInvocationWithLocalDeque:deque functionRecord:record];
+            if (invocation || *record)
+                return invocation;
+            
+        } while (LSMonotonicNanoseconds() < spinEnd);
+    }
+    
+    // A permit left over from a previous wakeup must not cut the park short
+    [parker clearPermit];
+    
+    pthread_mutex_lock(&_idleLock);
+    
+    [_idleWorkers addObject:parker];
+    atomic_fetch_add_explicit(&_idleCount, 1, memory_order_relaxed);
+    
+    pthread_mutex_unlock(&_idleLock);
+
+    // Pairs with the fence in wakeUpIdleWorker and dispose, either the
+    // producer sees us idle or we see its invocation (or the disposal)
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // Check again now that producers can see we are idle
+    invocation= [self findInvocationWithLocalDeque:deque functionRecord:record];
+    BOOL found= (invocation || *record);
+    BOOL timekeeper= NO;
+    
+    if ((!found) && (!atomic_load_explicit(&_disposed, memory_order_relaxed))) {
+        NSDate *parkDate= date;
+        
+        // With delayed invocations pending, one idle thread parks only until the earliest is due
+        if ((atomic_load_explicit(&_delayedCount, memory_order_relaxed) > 0) && [self becomeTimekeeper:parker]) {
+            timekeeper= YES;
+            
+            uint64_t deadline= atomic_load_explicit(&_earliestDeadline, memory_order_relaxed);
+            uint64_t now= LSMonotonicNanoseconds();
+            
+            NSDate *dueDate= [NSDate dateWithTimeIntervalSinceNow:(deadline > now) ? ((double) (deadline - now) / 1000000000.0) : 0.0];
+            if ((!parkDate) || ([dueDate compare:parkDate] == NSOrderedAscending))
+                parkDate= dueDate;
+        }
+        
+        [parker parkUntilDate:parkDate];
+    }
+    
+    // If we are no more on the stack, a producer has popped us
+    BOOL wokenUp= ![self removeIdleWorker:parker];
+    
+    if (timekeeper)
+        [self resignTimekeeper:parker];
+
+    if (!found) {
+        invocation= [self findInvocationWithLocalDeque:deque functionRecord:record];
+        
+    } else if (wokenUp) {
+        
+        // We have been woken up for an invocation, but found another
+        // one on our own: pass the wakeup on to another idle thread
+        [self wakeUpIdleWorker];
+    }
+    
+    // If we are leaving to do some work, another idle thread must keep time in our place
+    if (timekeeper && (invocation || *record) && (atomic_load_explicit(&_delayedCount, memory_order_relaxed) > 0))
+        [self wakeUpIdleWorker];
+
+    return invocation;
+}
+
+- (NSUInteger) dequeueInvocationsIntoBatch:(NSMutableArray<LSInvocation *> *)batch maxCount:(NSUInteger)maxCount threadCount:(NSUInteger)threadCount {
+    
+    // Skipped lanes must be served one invocation at a time, or aging would be delayed
+    for (NSUInteger lane= 0; lane < LS_INVOCATION_QUEUE_LANES - 1; lane++) {
+        if (atomic_load_explicit(&_starvingSince[lane], memory_order_relaxed) != 0)
+            return 0;
+    }
+    
+    for (NSUInteger lane= LS_INVOCATION_QUEUE_LANES; lane > 0; lane--) {
+        NSUInteger count= atomic_load_explicit(&_laneCounts[lane - 1], memory_order_relaxed);
+        if (count == 0)
+            continue;
+        
+        // Take no more than our fair share, leaving the rest to other threads
+        NSUInteger share= count / MAX(threadCount, 1);
+        NSUInteger removed= [_buffers[lane - 1] removeFirstInvocations:MIN(maxCount, share) intoBatch:batch];
+        if (removed == 0)
+            return 0;
+        
+        atomic_fetch_sub_explicit(&_laneCounts[lane - 1], removed, memory_order_relaxed);
+        
+        if (_capacity)
+            [self releaseSlots:removed];
+        
+        [self markLanesBelowAsSkipped:lane - 1];
+        return removed;
+    }
+    
+    return 0;
+}
+
+- (void) dispose {
+    atomic_store_explicit(&_disposed, true, memory_order_relaxed);
+    
+    // Pairs with the fence in dequeueInvocationWithLocalDeque:parker:waitingUntilDate:
+    atomic_thread_fence(memory_order_seq_cst);
+    
+    NSArray<LSThreadParker *> *idleWorkers= nil;
+    
+    pthread_mutex_lock(&_idleLock);
+    
+    idleWorkers= [_idleWorkers copy];
+    [_idleWorkers removeAllObjects];
+    atomic_store_explicit(&_idleCount, 0, memory_order_relaxed);
+    
+    pthread_mutex_unlock(&_idleLock);
+    
+    for (LSThreadParker *parker in idleWorkers)
+        [parker unpark];
+    
+    [_spaceMonitor lock];
+    [_spaceMonitor broadcast];
+    [_spaceMonitor unlock];
+}
+
+- (NSArray<LSInvocation *> *) removeAllInvocations {
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] init];
+    
+    for (NSUInteger lane= LS_INVOCATION_QUEUE_LANES; lane > 0; lane--) {
+        LSInvocation *invocation= nil;
+        while ((invocation= [self pollLane:lane - 1]))
+            [invocations addObject:invocation];
+    }
+    
+    for (LSInvocationDeque *deque in self.localDeques)
+        [invocations addObjectsFromArray:[deque removeAllInvocations]];
+    
+    // Function records have no descriptor to be returned, they are dropped
+    LSFunctionRecord *record= NULL;
+    while ((record= [self pollFunctionRecord])) {
+        if (LSTraceIsEnabled())
+            LSTraceRecordEvent(LSTraceEventTypeCallDiscarded, record, NULL, 0);
+        
+        LSFunctionRecordRelease(record);
+    }
+    
+    [invocations addObjectsFromArray:[self removeAllDelayedInvocations]];
+    
+    return invocations;
+}
+
+- (NSArray<LSInvocation *> *) removeAllDelayedInvocations {
+    NSArray<LSInvocation *> *invocations= nil;
+    
+    pthread_mutex_lock(&_delayedLock);
+    
+    // Heap order is not meaningful to the caller, sort by deadline
+    invocations= [_delayed sortedArrayUsingComparator:^NSComparisonResult(LSInvocation *invocation1, LSInvocation *invocation2) {
+        return (invocation1.deadline < invocation2.deadline) ? NSOrderedAscending : ((invocation1.deadline > invocation2.deadline) ? NSOrderedDescending : NSOrderedSame);
+    }];
+    
+    [_delayed removeAllObjects];
+    atomic_store_explicit(&_delayedCount, 0, memory_order_relaxed);
+    atomic_store_explicit(&_earliestDeadline, UINT64_MAX, memory_order_relaxed);
+    
+    pthread_mutex_unlock(&_delayedLock);
+    
+    return invocations;
+}
+
+- (NSUInteger) countForLane:(NSUInteger)lane {
+    if (lane >= LS_INVOCATION_QUEUE_LANES)
+        return 0;
+    
+    NSUInteger count= atomic_load_explicit(&_laneCounts[lane], memory_order_relaxed);
+    
+    if (lane == LS_INVOCATION_QUEUE_DEFAULT_LANE) {
+        count += atomic_load_explicit(&_functionCount, memory_order_relaxed);
+        
+        for (LSInvocationDeque *deque in self.localDeques)
+            count += deque.count;
+    }
+    
+    return count;
+}
+
+
+#pragma mark -
+#pragma mark Bounded queue
+
+- (BOOL) reserveSlot {
+    if (!_capacity)
+        return YES;
+    
+    size_t reserved= atomic_load_explicit(&_reservedSlots, memory_order_relaxed);
+    while (reserved < _capacity) {
+        if (atomic_compare_exchange_weak_explicit(&_reservedSlots, &reserved, reserved + 1, memory_order_relaxed, memory_order_relaxed))
+            return YES;
+    }
+    
+    return NO;
+}
+
+- (BOOL) reserveSlotWaitingUntilDate:(NSDate *)date {
+    if ([self reserveSlot])
+        return YES;
+    
+    BOOL reserved= NO;
+    
+    [_spaceMonitor lock];
+    
+    atomic_fetch_add_explicit(&_waitingProducers, 1, memory_order_relaxed);
+    
+    while (YES) {
+        
+        // Pairs with the fence in releaseSlot, either the consumer
+        // sees we are waiting or we see the released slot
+        atomic_thread_fence(memory_order_seq_cst);
+        
+        reserved= [self reserveSlot];
+        if (reserved || atomic_load_explicit(&_disposed, memory_order_relaxed))
+            break;
+        
+        if (![_spaceMonitor waitUntilDate:date]) {
+            reserved= [self reserveSlot];
+            break;
+        }
+    }
+    
+    atomic_fetch_sub_explicit(&_waitingProducers, 1, memory_order_relaxed);
+    
+    [_spaceMonitor unlock];
+    
+    return reserved;
+}
+
+- (LSInvocation *) removeOldestInvocationOrFunctionRecord:(LSFunctionRecord **)record {
+    *record= NULL;
+    
+    // The oldest invocation of the least important lane goes first
+    for (NSUInteger lane= 0; lane < LS_INVOCATION_QUEUE_LANES; lane++) {
+        LSInvocation *invocation= [self pollLane:lane];
+        if (invocation)
+            return invocation;
+        
+        // Function records belong to the default lane, after its invocations
+        if ((lane == LS_INVOCATION_QUEUE_DEFAULT_LANE) && (*record= [self pollFunctionRecord]))
+            return nil;
+    }
+    
+    return nil;
+}
+
+
+#pragma mark -
+#pragma mark Work stealing
+
+- (void) registerLocalDeque:(LSInvocationDeque *)deque {
+    @synchronized (self) {
+        self.localDeques= [self.localDeques arrayByAddingObject:deque];
+    }
+}
+
+- (void) unregisterLocalDeque:(LSInvocationDeque *)deque {
+    @synchronized (self) {
+        NSMutableArray<LSInvocationDeque *> *localDeques= [self.localDeques mutableCopy];
+        [localDeques removeObjectIdenticalTo:deque];
+
+        self.localDeques= localDeques;
+    }
+
+    // Invocations left behind go back to the shared buffer
+    NSArray<LSInvocation *> *leftovers= [deque removeAllInvocations];
+    for (LSInvocation *invocation in leftovers) {
+        
+        // They were already accepted, capacity may be exceeded
+        if (_capacity)
+            atomic_fetch_add_explicit(&_reservedSlots, 1, memory_order_relaxed);
+        
+        [self enqueueInvocation:invocation lane:LS_INVOCATION_QUEUE_DEFAULT_LANE];
+    }
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) wakeUpIdleWorker {
+
+    // Pairs with the fence in dequeueInvocationWithLocalDeque:parker:waitingUntilDate:,
+    // either we see the idle thread or the idle thread sees the invocation
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&_idleCount, memory_order_relaxed) == 0)
+        return NO;
+    
+    LSThreadParker *parker= nil;
+
+    pthread_mutex_lock(&_idleLock);
+    
+    // The last parked thread is the most likely to have a warm cache,
+    // while those at the bottom of the stack may retire on timeout
+    parker= _idleWorkers.lastObject;
+    if (parker) {
+        [_idleWorkers removeLastObject];
+        atomic_fetch_sub_explicit(&_idleCount, 1, memory_order_relaxed);
+    }
+    
+    pthread_mutex_unlock(&_idleLock);
+    
+    if (!parker)
+        return NO;
+    
+    // Once popped, the thread is sure to look for invocations
+    [parker unpark];
+
+    return YES;
+}
+
+- (BOOL) removeIdleWorker:(LSThreadParker *)parker {
+    BOOL removed= NO;
+    
+    pthread_mutex_lock(&_idleLock);
+    
+    NSUInteger index= [_idleWorkers indexOfObjectIdenticalTo:parker];
+    if (index != NSNotFound) {
+        [_idleWorkers removeObjectAtIndex:index];
+        atomic_fetch_sub_explicit(&_idleCount, 1, memory_order_relaxed);
+        
+        removed= YES;
+    }
+    
+    pthread_mutex_unlock(&_idleLock);
+    
+    return removed;
+}
+
+- (LSInvocation *) findInvocationWithLocalDeque:(LSInvocationDeque *)deque functionRecord:(LSFunctionRecord **)record {
+    LSInvocation *invocation= nil;
+    *record= NULL;
+    
+    // Delayed invocations come first as soon as they are due
+    if (atomic_load_explicit(&_delayedCount, memory_order_relaxed) > 0) {
+        invocation= [self pollDueInvocation];
+        if (invocation)
+            return invocation;
+    }
+    
+    // Lanes skipped for longer than their aging interval come first, lowest first
+    uint64_t now= 0;
+    for (NSUInteger lane= 0; lane < LS_INVOCATION_QUEUE_LANES - 1; lane++) {
+        uint64_t starvingSince= atomic_load_explicit(&_starvingSince[lane], memory_order_relaxed);
+        if (!starvingSince)
+            continue;
+        
+        if (!now)
+            now= LSMonotonicNanoseconds();
+        
+        if (now - starvingSince < _agingIntervals[lane])
+            continue;
+        
+        invocation= [self pollLane:lane];
+        if (invocation)
+            return invocation;
+    }
+    
+    // Then lanes from the highest to the lowest
+    for (NSUInteger lane= LS_INVOCATION_QUEUE_LANES; lane > 0; lane--) {
+        if (lane - 1 == LS_INVOCATION_QUEUE_DEFAULT_LANE) {
+            
+            // Local deque first, last-in-first-out for cache locality
+            invocation= [deque popInvocation];
+            if (invocation) {
+                [self markLanesBelowAsSkipped:lane - 1];
+                return invocation;
+            }
+            
+            // Function records and invocations take turns, so that neither starves the other
+            BOOL functionsFirst= NO;
+            if (atomic_load_explicit(&_functionCount, memory_order_relaxed) > 0) {
+                functionsFirst= atomic_load_explicit(&_functionTurn, memory_order_relaxed);
+                atomic_store_explicit(&_functionTurn, !functionsFirst, memory_order_relaxed);
+            }
+            
+            if (functionsFirst && (*record= [self pollFunctionRecord])) {
+                [self markLanesBelowAsSkipped:lane - 1];
+                return nil;
+            }
+            
+            invocation= [self pollLane:lane - 1];
+            if (invocation) {
+                [self markLanesBelowAsSkipped:lane - 1];
+                return invocation;
+            }
+            
+            if ((!functionsFirst) && (*record= [self pollFunctionRecord])) {
+                [self markLanesBelowAsSkipped:lane - 1];
+                return nil;
+            }
+            
+            continue;
+        }
+        
+        invocation= [self pollLane:lane - 1];
+        if (invocation) {
+            [self markLanesBelowAsSkipped:lane - 1];
+            return invocation;
+        }
+    }
+
+    if (!_workStealing)
+        return nil;
+
+    return [self stealInvocationForLocalDeque:deque];
+}
+
+- (LSInvocation *) pollLane:(NSUInteger)lane {
+    
+    // Avoid touching the buffer when the lane is empty
+    if (atomic_load_explicit(&_laneCounts[lane], memory_order_relaxed) == 0)
+        return nil;
+    
+    LSInvocation *invocation= [_buffers[lane] removeFirstInvocation];
+    if (!invocation)
+        return nil;
+    
+    atomic_fetch_sub_explicit(&_laneCounts[lane], 1, memory_order_relaxed);
+    atomic_store_explicit(&_starvingSince[lane], 0, memory_order_relaxed);
+    
+    if (_capacity)
+        [self releaseSlot];
+    
+    return invocation;
+}
+
+- (LSFunctionRecord *) pollFunctionRecord {
+    
+    // Avoid taking the lock when there are no records
+    if (atomic_load_explicit(&_functionCount, memory_order_relaxed) == 0)
+        return NULL;
+    
+    pthread_mutex_lock(&_functionLock);
+    
+    LSFunctionRecord *record= _functionHead;
+    if (record) {
+        _functionHead= record->next;
+        if (!_functionHead)
+            _functionTail= NULL;
+        
+        record->next= NULL;
+    }
+    
+    pthread_mutex_unlock(&_functionLock);
+    
+    if (!record)
+        return NULL;
+    
+    atomic_fetch_sub_explicit(&_functionCount, 1, memory_order_relaxed);
+    atomic_store_explicit(&_starvingSince[LS_INVOCATION_QUEUE_DEFAULT_LANE], 0, memory_order_relaxed);
+    
+    if (_capacity)
+        [self releaseSlot];
+    
+    return record;
+}
+
+- (LSInvocation *) pollDueInvocation {
+    uint64_t now= LSMonotonicNanoseconds();
+    
+    // Avoid taking the lock when nothing is due
+    if (atomic_load_explicit(&_earliestDeadline, memory_order_relaxed) > now)
+        return nil;
+    
+    LSInvocation *invocation= nil;
+    uint64_t earliest= UINT64_MAX;
+    
+    pthread_mutex_lock(&_delayedLock);
+    
+    NSUInteger count= _delayed.count;
+    if ((count > 0) && (_delayed[0].deadline <= now)) {
+        invocation= _delayed[0];
+        
+        // Move the last one on top and sift it down
+        [_delayed exchangeObjectAtIndex:0 withObjectAtIndex:count - 1];
+        [_delayed removeLastObject];
+        count--;
+        
+        NSUInteger index= 0;
+        while (YES) {
+            NSUInteger child= (2 * index) + 1;
+            if (child >= count)
+                break;
+            
+            if ((child + 1 < count) && (_delayed[child + 1].deadline < _delayed[child].deadline))
+                child++;
+            
+            if (_delayed[index].deadline <= _delayed[child].deadline)
+                break;
+            
+            [_delayed exchangeObjectAtIndex:index withObjectAtIndex:child];
+            index= child;
+        }
+        
+        if (count > 0)
+            earliest= _delayed[0].deadline;
+        
+        atomic_store_explicit(&_earliestDeadline, earliest, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&_delayedCount, 1, memory_order_relaxed);
+    }
+    
+    pthread_mutex_unlock(&_delayedLock);
+    
+    // More are due at once: spread them over idle threads
+    if (invocation && (earliest <= now))
+        [self wakeUpIdleWorker];
+    
+    return invocation;
+}
+
+- (BOOL) becomeTimekeeper:(LSThreadParker *)parker {
+    BOOL became= NO;
+    
+    pthread_mutex_lock(&_idleLock);
+    
+    if (!_timekeeper) {
+        _timekeeper= parker;
+        became= YES;
+    }
+    
+    pthread_mutex_unlock(&_idleLock);
+    
+    return became;
+}
+
+- (void) resignTimekeeper:(LSThreadParker *)parker {
+    pthread_mutex_lock(&_idleLock);
+    
+    if (_timekeeper == parker)
+        _timekeeper= nil;
+    
+    pthread_mutex_unlock(&_idleLock);
+}
+
+- (void) releaseSlot {
+    [self releaseSlots:1];
+}
+
+- (void) releaseSlots:(NSUInteger)count {
+    atomic_fetch_sub_explicit(&_reservedSlots, count, memory_order_relaxed);
+    
+    // Pairs with the fence in reserveSlotWaitingUntilDate:
+    atomic_thread_fence(memory_order_seq_cst);
+    
+    if (atomic_load_explicit(&_waitingProducers, memory_order_relaxed) > 0) {
+        [_spaceMonitor lock];
+        
+        if (count > 1)
+            [_spaceMonitor broadcast];
+        else
+            [_spaceMonitor signal];
+        
+        [_spaceMonitor unlock];
+    }
+}
+
+- (void) markLanesBelowAsSkipped:(NSUInteger)lane {
+    uint64_t now= 0;
+    
+    for (NSUInteger lower= 0; lower < lane; lower++) {
+        if (atomic_load_explicit(&_laneCounts[lower], memory_order_relaxed) == 0)
+            continue;
+        
+        if (atomic_load_explicit(&_starvingSince[lower], memory_order_relaxed) != 0)
+            continue;
+        
+        if (!now)
+            now= LSMonotonicNanoseconds();
+        
+        // Only the first skip counts
+        uint_fast64_t expected= 0;
+        atomic_compare_exchange_strong_explicit(&_starvingSince[lower], &expected, now, memory_order_relaxed, memory_order_relaxed);
+    }
+}
+
+- (LSInvocation *) stealInvocationForLocalDeque:(LSInvocationDeque *)deque {
+    NSArray<LSInvocationDeque *> *localDeques= self.localDeques;
+    NSUInteger count= localDeques.count;
+    if (count == 0)
+        return nil;
+
+    // Start from a different peer each time, to spread steals
+    NSUInteger start= deque.stealCursor++;
+    for (NSUInteger i= 0; i < count; i++) {
+        LSInvocationDeque *victim= localDeques[(start + i) % count];
+        if (victim == deque)
+            continue;
+
+        // Steal from the head, first-in-first-out
+        LSInvocation *invocation= [victim stealInvocation];
+        if (invocation)
+            return invocation;
+    }
+
+    return nil;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic count;
+
+- (NSUInteger) count {
+    NSUInteger count= 0;
+    
+    for (NSUInteger lane= 0; lane < LS_INVOCATION_QUEUE_LANES; lane++)
+        count += atomic_load_explicit(&_laneCounts[lane], memory_order_relaxed);
+
+    count += atomic_load_explicit(&_functionCount, memory_order_relaxed);
+
+    for (LSInvocationDeque *deque in self.localDeques)
+        count += deque.count;
+
+    return count;
+}
+
+@dynamic delayedCount;
+
+- (NSUInteger) delayedCount {
+    return atomic_load_explicit(&_delayedCount, memory_order_relaxed);
+}
+
+@synthesize workStealing= _workStealing;
+@synthesize capacity= _capacity;
+
+@dynamic disposed;
+
+- (BOOL) disposed {
+    return atomic_load_explicit(&_disposed, memory_order_relaxed);
+}
+
+@synthesize localDeques= _localDeques;
+
+
+@end
@@ -0,0 +1,51 @@
+//
+//  LSInvocationRingBuffer.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSInvocationBuffer.h"
+
+
+/**
+ @brief A lock-free, bounded, multi-producer/multi-consumer invocation buffer. <b>This class should not be used directly</b>.
+ <br/> Invocations are stored in a ring of fixed capacity. If the ring is full, invocations in excess are kept in a
+ locked overflow array, which is drained back into the ring as soon as the ring has free slots.
+ <br/> Invocations are dequeued in FIFO order per producer: an invocation added while another producer is spilling to
+ the overflow may overtake the spilled one. Invocations added by different threads concurrently have no defined order.
+ @see LSInvocationQueue.
+ */
+@interface LSInvocationRingBuffer : NSObject <LSInvocationBuffer>
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly) NSUInteger capacity;
+
+
+@end
@@ -0,0 +1,314 @@
+//
+//  LSInvocationRingBuffer.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSInvocationRingBuffer.h"
+#import "LSInvocation.h"
+
+#import <stdatomic.h>
+#import <pthread.h>
+
+#define CACHE_LINE_SIZE                                       (64)
+#define MIN_CAPACITY                                           (2)
+
+
+#pragma mark -
+#pragma mark Ring buffer data structures
+
+/*
+ * The ring follows the classic bounded MPMC scheme: each cell carries a sequence
+ * number that tells producers and consumers if the cell is free for the current
+ * lap of the ring. Positions are claimed with a CAS on the respective cursor,
+ * so producers and consumers never contend on the same cache line unless the
+ * ring is empty or full.
+ */
+typedef struct {
+    atomic_size_t sequence;
+    void *entry;
+} LSRingBufferCell;
+
+typedef struct {
+    atomic_size_t enqueuePosition;
+    char enqueuePadding[CACHE_LINE_SIZE - sizeof(atomic_size_t)];
+
+    atomic_size_t dequeuePosition;
+    char dequeuePadding[CACHE_LINE_SIZE - sizeof(atomic_size_t)];
+
+    atomic_size_t overflowCount;
+} LSRingBufferCursors;
+
+
+#pragma mark -
+#pragma mark LSInvocationRingBuffer extension
+
+@interface LSInvocationRingBuffer () {
+    NSUInteger _capacity;
+    size_t _mask;
+
+    LSRingBufferCell *_cells;
+    LSRingBufferCursors *_cursors;
+
+    NSMutableArray<LSInvocation *> *_overflow;
+    pthread_mutex_t _overflowLock;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) offerEntry:(void *)entry;
+- (void *) pollEntry;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSInvocationRingBuffer implementation
+
+@implementation LSInvocationRingBuffer
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithCapacity:(NSUInteger)capacity {
+    if ((self = [super init])) {
+
+        // Initialization
+        if (capacity < MIN_CAPACITY)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Ring buffer capacity must be at least 2"
+                                         userInfo:nil];
+
+        // Round capacity up to a power of 2, so that positions can be masked
+        _capacity= MIN_CAPACITY;
+        while (_capacity < capacity)
+            _capacity <<= 1;
+
+        _mask= _capacity - 1;
+
+        _cells= calloc(_capacity, sizeof(LSRingBufferCell));
+        for (size_t i= 0; i < _capacity; i++)
+            atomic_init(&_cells[i].sequence, i);
+
+        void *cursors= NULL;
+        posix_memalign(&cursors, CACHE_LINE_SIZE, sizeof(LSRingBufferCursors));
+        _cursors= cursors;
+
+        atomic_init(&_cursors->enqueuePosition, 0);
+        atomic_init(&_cursors->dequeuePosition, 0);
+        atomic_init(&_cursors->overflowCount, 0);
+
+        _overflow= [[NSMutableArray alloc] init];
+        pthread_mutex_init(&_overflowLock, NULL);
+    }
+
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSInvocationRingBuffer"
+                                 userInfo:nil];
+}
+
+- (void) dealloc {
+
+    // Release invocations still in the ring
+    void *entry= NULL;
+    while ((entry= [self pollEntry]))
+        (void) (__bridge_transfer LSInvocation *) entry;
+
+    free(_cells);
+    free(_cursors);
+
+    pthread_mutex_destroy(&_overflowLock);
+}
+
+
+#pragma mark -
+#pragma mark Buffer operations
+
+- (void) addInvocation:(LSInvocation *)invocation {
+    void *entry= (__bridge_retained void *) invocation;
+
+    // While the overflow is in use new invocations must go there too,
+    // or they would overtake those already waiting in the overflow.
+    // A producer that read a zero count just before another one spilled may still
+    // land in the ring ahead of it: order is guaranteed only per producer
+    if (atomic_load_explicit(&_cursors->overflowCount, memory_order_acquire) == 0) {
+        if ([self offerEntry:entry])
+            return;
+    }
+
+    pthread_mutex_lock(&_overflowLock);
+
+    [_overflow addObject:(__bridge_transfer LSInvocation *) entry];
+    atomic_fetch_add_explicit(&_cursors->overflowCount, 1, memory_order_release);
+
+    pthread_mutex_unlock(&_overflowLock);
+}
+
+- (LSInvocation *) removeFirstInvocation {
+    void *entry= [self pollEntry];
+    if (entry)
+        return (__bridge_transfer LSInvocation *) entry;
+
+    if (atomic_load_explicit(&_cursors->overflowCount, memory_order_acquire) == 0)
+        return nil;
+
+    LSInvocation *invocation= nil;
+
+    pthread_mutex_lock(&_overflowLock);
+
+    NSUInteger count= _overflow.count;
+    if (count > 0) {
+        invocation= _overflow[0];
+
+        // Move as many invocations as possible back to the ring, so that
+        // producers can return to the lock-free path as soon as possible
+        NSUInteger moved= 1;
+        while (moved < count) {
+            void *movedEntry= (__bridge_retained void *) _overflow[moved];
+            if (![self offerEntry:movedEntry]) {
+                (void) (__bridge_transfer LSInvocation *) movedEntry;
+                break;
+            }
+
+            moved++;
+        }
+
+        [_overflow removeObjectsInRange:NSMakeRange(0, moved)];
+        atomic_fetch_sub_explicit(&_cursors->overflowCount, moved, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&_overflowLock);
+
+    return invocation;
+}
+
+- (NSUInteger) removeFirstInvocations:(NSUInteger)maxCount intoBatch:(NSMutableArray<LSInvocation *> *)batch {
+
+    // The ring has no lock to amortize, entries are polled one by one
+    NSUInteger count= 0;
+    while (count < maxCount) {
+        LSInvocation *invocation= [self removeFirstInvocation];
+        if (!invocation)
+            break;
+
+        [batch addObject:invocation];
+        count++;
+    }
+
+    return count;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (BOOL) offerEntry:(void *)entry {
+    size_t position= atomic_load_explicit(&_cursors->enqueuePosition, memory_order_relaxed);
+    LSRingBufferCell *cell= NULL;
+
+    do {
+        cell= &_cells[position & _mask];
+
+        size_t sequence= atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference= (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0) {
+
+            // Cell is free for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&_cursors->enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+
+        } else if (difference < 0) {
+
+            // Cell still holds an entry of the previous lap: ring is full
+            return NO;
+
+        } else
+            position= atomic_load_explicit(&_cursors->enqueuePosition, memory_order_relaxed);
+
+    } while (YES);
+
+    cell->entry= entry;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    return YES;
+}
+
+- (void *) pollEntry {
+    size_t position= atomic_load_explicit(&_cursors->dequeuePosition, memory_order_relaxed);
+    LSRingBufferCell *cell= NULL;
+
+    do {
+        cell= &_cells[position & _mask];
+
+        size_t sequence= atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference= (intptr_t) sequence - (intptr_t) (position + 1);
+
+        if (difference == 0) {
+
+            // Cell has been filled for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&_cursors->dequeuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+
+        } else if (difference < 0) {
+
+            // Cell not yet filled: ring is empty
+            return NULL;
+
+        } else
+            position= atomic_load_explicit(&_cursors->dequeuePosition, memory_order_relaxed);
+
+    } while (YES);
+
+    void *entry= cell->entry;
+    cell->entry= NULL;
+
+    // Make the cell available for the next lap
+    atomic_store_explicit(&cell->sequence, position + _mask + 1, memory_order_release);
+
+    return entry;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize capacity= _capacity;
+
+@dynamic count;
+
+- (NSUInteger) count {
+    size_t dequeuePosition= atomic_load_explicit(&_cursors->dequeuePosition, memory_order_relaxed);
+    size_t enqueuePosition= atomic_load_explicit(&_cursors->enqueuePosition, memory_order_relaxed);
+    size_t overflowCount= atomic_load_explicit(&_cursors->overflowCount, memory_order_relaxed);
+
+    // Cursors are read separately, the count is an estimate while the ring is in use
+    size_t ringCount= (enqueuePosition > dequeuePosition) ? (enqueuePosition - dequeuePosition) : 0;
+
+    return ringCount + overflowCount;
+}
+
+
+@end
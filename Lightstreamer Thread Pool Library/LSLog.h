@@ -28,9 +28,30 @@
 @protocol LSLogDelegate;
 
 
+/**
+ @brief Behavior of asynchronous logging when the buffer of the logging thread is full.
+ */
+typedef NS_ENUM(NSUInteger, LSLogOverflowPolicy) {
+    
+    /**
+     @brief The log line is dropped and counted, the logging thread never waits.
+     */
+    LSLogOverflowPolicyDrop= 0,
+    
+    /**
+     @brief The logging thread waits until the background writer makes room in its buffer.
+     */
+    LSLogOverflowPolicyBlock
+};
+
+
 /**
  @brief LSLog provides a simple logging system with separately enabled sources.
  <br/> Log lines are diverted to the system console (NSLog), unless a log delegate is specified.
+ <br/> By default lines are delivered by the logging thread, serialized by a global lock. In asynchronous mode each thread only
+ formats the message and appends it to a ring buffer of its own, with no locks; a background writer thread builds
+ the lines and delivers them in batches. Lines of the same thread keep their order, lines of different threads are
+ ordered by time within each batch.
  @see LSLogDelegate.
  */
 @interface LSLog : NSObject
@@ -49,6 +70,40 @@
 + (void) setDelegate:(nullable id <LSLogDelegate>)delegate;
 
 
+#pragma mark -
+#pragma mark Asynchronous mode
+
+/**
+ @brief Enables the asynchronous mode. The background writer thread is started the first time, and is never stopped.
+ @param bufferSize The number of lines the buffer of each thread can hold, rounded up to a power of 2.
+ Applies to buffers of threads that have not logged yet in asynchronous mode.
+ @param overflowPolicy What a thread does when its buffer is full.
+ @throws NSException If the buffer size is 0.
+ */
++ (void) enableAsynchronousModeWithBufferSize:(NSUInteger)bufferSize overflowPolicy:(LSLogOverflowPolicy)overflowPolicy;
+
+/**
+ @brief Disables the asynchronous mode. Lines already buffered are delivered before returning.
+ */
++ (void) disableAsynchronousMode;
+
+/**
+ @brief Tells if the asynchronous mode is enabled.
+ */
++ (BOOL) isAsynchronousModeEnabled;
+
+/**
+ @brief Waits until the lines buffered by any thread before the call have been delivered. Returns immediately if the
+ asynchronous mode has never been enabled.
+ */
++ (void) flush;
+
+/**
+ @brief The number of lines dropped because a buffer was full, with <code>LSLogOverflowPolicyDrop</code>.
+ */
++ (uint64_t) droppedLineCount;
+
+
 #pragma mark -
 #pragma mark Source log filtering
 
@@ -20,11 +20,58 @@
 
 #import "LSLog.h"
 #import "LSLogDelegate.h"
+#import "LSThreadParker.h"
+#import "LSMonotonicClock.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
 
 #define LOG_SRC_TIMER_NAME           (@"LSTimerThread")
 #define LOG_SRC_URL_DISPATCHER_NAME  (@"LSURLDispatcher")
 #define LOG_SRC_THREAD_POOL_NAME     (@"LSThreadPool")
 
+#define LOG_WRITER_THREAD_NAME       (@"LSLogWriter")
+#define LOG_DEFAULT_BUFFER_SIZE      (1024)
+#define LOG_BLOCKED_WAIT_INTERVAL    (0.001)
+
+
+#pragma mark -
+#pragma mark Log rings
+
+typedef struct {
+    uint64_t time;
+    int sourceType;
+    const void *source;
+    
+    // Retained NSString, released by the writer
+    void *message;
+} LSLogRecord;
+
+typedef struct LSLogRing {
+    
+    // Guarded by the rings lock
+    struct LSLogRing *next;
+    
+    // Retained NSString, the name of the thread when it first logged
+    void *threadName;
+    
+    NSUInteger mask;
+    
+    // Head is written by the owner thread only, tail by the writer only
+    atomic_size_t head;
+    atomic_size_t tail;
+    
+    // Set when the owner thread exits, the writer frees the ring once drained
+    atomic_bool orphaned;
+    
+    LSLogRecord records[];
+} LSLogRing;
+
+typedef struct {
+    uint64_t time;
+    NSUInteger index;
+} LSLogBatchEntry;
+
 
 #pragma mark -
 #pragma mark LSLog statics
@@ -32,82 +79,339 @@
 static int __enabledSourceTypes= 0;
 static id <LSLogDelegate> __delegate= nil;
 
+static atomic_bool __asynchronous= false;
+static atomic_size_t __bufferSize= LOG_DEFAULT_BUFFER_SIZE;
+static atomic_uint __overflowPolicy= LSLogOverflowPolicyDrop;
+static atomic_uint_fast64_t __droppedLineCount= 0;
 
-#pragma mark -
-#pragma mark LSLog implementation
+static LSLogRing *__rings= NULL;
+static pthread_mutex_t __ringsLock= PTHREAD_MUTEX_INITIALIZER;
 
-@implementation LSLog
+static pthread_key_t __ringKey;
+static pthread_once_t __ringKeyOnce= PTHREAD_ONCE_INIT;
+
+// Created once, before the asynchronous mode is first enabled
+static NSThread *__writer= nil;
+static LSThreadParker *__writerParker= nil;
+static NSCondition *__flushCondition= nil;
+static NSCondition *__spaceCondition= nil;
+
+static atomic_bool __writerParked= false;
+static atomic_int __blockedCount= 0;
+
+static atomic_uint_fast64_t __flushRequested= 0;
+static uint64_t __flushCompleted= 0;
 
 
 #pragma mark -
-#pragma mark Logging
+#pragma mark Line formatting and delivery
 
-+ (void) sourceType:(int)sourceType source:(id)source log:(NSString *)format, ... {
-    if (__enabledSourceTypes & sourceType) {
-        @synchronized ([LSLog class]) {
+static NSString *LSLogSourceName(int sourceType) {
+    switch (sourceType) {
+        case LOG_SRC_TIMER: return LOG_SRC_TIMER_NAME;
+        case LOG_SRC_URL_DISPATCHER: return LOG_SRC_URL_DISPATCHER_NAME;
+        case LOG_SRC_THREAD_POOL: return LOG_SRC_THREAD_POOL_NAME;
+        default: return nil;
+    }
+}
 
-            // Thread name
-            NSThread *thread= [NSThread currentThread];
-            NSString *threadName= (thread.name.length > 0) ? thread.name : [NSString stringWithFormat:@"Thread %p", thread];
-            
-            @try {
+static NSString *LSLogCurrentThreadName(void) {
+    NSThread *thread= [NSThread currentThread];
+    
+    return (thread.name.length > 0) ? thread.name : [NSString stringWithFormat:@"Thread %p", thread];
+}
+
+static NSString *LSLogFormatLine(NSString *threadName, int sourceType, const void *source, NSString *message) {
+    
+    // A source type of 0 denotes a line with no source
+    if (!sourceType)
+        return [NSString stringWithFormat:@"<%@> %@", threadName, message];
+    
+    return [NSString stringWithFormat:@"<%@> %@ %p: %@", threadName, LSLogSourceName(sourceType), source, message];
+}
+
+static void LSLogDeliver(NSArray<NSString *> *lines) {
+    @synchronized ([LSLog class]) {
+        @try {
+            if (!__delegate) {
+                for (NSString *line in lines)
+                    NSLog(@"%@", line);
                 
-                // Source name
-                NSString *sourceName= nil;
-                switch (sourceType) {
-                    case LOG_SRC_TIMER: sourceName= LOG_SRC_TIMER_NAME; break;
-                    case LOG_SRC_URL_DISPATCHER: sourceName= LOG_SRC_URL_DISPATCHER_NAME; break;
-                    case LOG_SRC_THREAD_POOL: sourceName= LOG_SRC_THREAD_POOL_NAME; break;
-                }
-
-                // Variable arguments formatting
-                va_list arguments;
-                va_start(arguments, format);
-                NSString *logMessage= [[NSString alloc] initWithFormat:format arguments:arguments];
-                va_end(arguments);
+            } else if ((lines.count > 1) && [__delegate respondsToSelector:@selector(appendLogLines:)]) {
+                [__delegate appendLogLines:lines];
                 
-                // Logging
-                NSString *logLine= [NSString stringWithFormat:@"<%@> %@ %p: %@", threadName, sourceName, source, logMessage];
-                if (__delegate)
-                    [__delegate appendLogLine:logLine];
-                else
-                    NSLog(@"%@", logLine);
-
-            } @catch (NSException *e) {
-                NSLog(@"<%@> Exception caught while logging with format '%@': %@, reason: '%@', user info: %@", threadName, format, e.name, e.reason, e.userInfo);
+            } else {
+                for (NSString *line in lines)
+                    [__delegate appendLogLine:line];
             }
+            
+        } @catch (NSException *e) {
+            NSLog(@"<%@> Exception caught while delivering %lu log lines: %@, reason: '%@', user info: %@", LSLogCurrentThreadName(), (unsigned long) lines.count, e.name, e.reason, e.userInfo);
         }
     }
 }
 
-+ (void) log:(NSString *)format, ... {
-    @synchronized ([LSLog class]) {
+
+#pragma mark -
+#pragma mark Ring management
+
+static void LSLogRingOrphan(void *value) {
+    LSLogRing *ring= value;
+    
+    // The writer may be parked with the last lines of the thread
+    atomic_store_explicit(&ring->orphaned, true, memory_order_release);
+    [__writerParker unpark];
+}
+
+static void LSLogRingKeyCreate(void) {
+    pthread_key_create(&__ringKey, LSLogRingOrphan);
+}
+
+static inline LSLogRing *LSLogCurrentRing(void) {
+    pthread_once(&__ringKeyOnce, LSLogRingKeyCreate);
+    
+    LSLogRing *ring= pthread_getspecific(__ringKey);
+    if (!ring) {
+        
+        // Once per thread
+        size_t capacity= atomic_load_explicit(&__bufferSize, memory_order_relaxed);
+        ring= calloc(1, sizeof(LSLogRing) + capacity * sizeof(LSLogRecord));
+        if (!ring)
+            return NULL;
+        
+        ring->threadName= (__bridge_retained void *) LSLogCurrentThreadName();
+        ring->mask= capacity - 1;
         
-        // Thread name
-        NSThread *thread= [NSThread currentThread];
-        NSString *threadName= (thread.name.length > 0) ? thread.name : [NSString stringWithFormat:@"Thread %p", thread];
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->orphaned, false);
+        
+        pthread_setspecific(__ringKey, ring);
+        
+        pthread_mutex_lock(&__ringsLock);
+        
+        ring->next= __rings;
+        __rings= ring;
+        
+        pthread_mutex_unlock(&__ringsLock);
+    }
+    
+    return ring;
+}
 
-        @try {
+static BOOL LSLogEnqueue(int sourceType, const void *source, NSString *message) {
+    LSLogRing *ring= LSLogCurrentRing();
+    if (!ring)
+        return NO;
+    
+    size_t head= atomic_load_explicit(&ring->head, memory_order_relaxed);
+    while ((head - atomic_load_explicit(&ring->tail, memory_order_acquire)) > ring->mask) {
+        if (atomic_load_explicit(&__overflowPolicy, memory_order_relaxed) == LSLogOverflowPolicyDrop) {
+            atomic_fetch_add_explicit(&__droppedLineCount, 1, memory_order_relaxed);
+            return YES;
+        }
+        
+        // Wait for the writer to make room, the timeout covers a wakeup racing with the wait
+        atomic_fetch_add_explicit(&__blockedCount, 1, memory_order_seq_cst);
+        [__writerParker unpark];
+        
+        [__spaceCondition lock];
+        [__spaceCondition waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:LOG_BLOCKED_WAIT_INTERVAL]];
+        [__spaceCondition unlock];
+        
+        atomic_fetch_sub_explicit(&__blockedCount, 1, memory_order_relaxed);
+    }
+    
+    LSLogRecord *record= &ring->records[head & ring->mask];
+    record->time= LSMonotonicNanoseconds();
+    record->sourceType= sourceType;
+    record->source= source;
+    record->message= (__bridge_retained void *) message;
+    
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    
+    // Pairs with the fence of the writer before parking: either it sees the line, or the line's thread sees it parked
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&__writerParked, memory_order_relaxed))
+        [__writerParker unpark];
+    
+    return YES;
+}
+
+static void LSLogAppendMessage(int sourceType, const void *source, NSString *message) {
+    
+    // The writer logs synchronously, it can't wait for itself
+    if (atomic_load_explicit(&__asynchronous, memory_order_acquire) && ([NSThread currentThread] != __writer)) {
+        if (LSLogEnqueue(sourceType, source, message))
+            return;
+    }
+    
+    LSLogDeliver(@[LSLogFormatLine(LSLogCurrentThreadName(), sourceType, source, message)]);
+}
+
+static int LSLogCompareBatchEntries(const void *first, const void *second) {
+    const LSLogBatchEntry *a= first;
+    const LSLogBatchEntry *b= second;
+    
+    if (a->time != b->time)
+        return (a->time < b->time) ? -1 : 1;
+    
+    return (a->index < b->index) ? -1 : ((a->index > b->index) ? 1 : 0);
+}
+
+static NSArray<NSString *> *LSLogDrainRings(void) {
+    NSMutableArray<NSString *> *lines= [[NSMutableArray alloc] init];
+    
+    LSLogBatchEntry *entries= NULL;
+    NSUInteger entryCapacity= 0;
+    
+    pthread_mutex_lock(&__ringsLock);
+    
+    LSLogRing **link= &__rings;
+    while (*link) {
+        LSLogRing *ring= *link;
+        
+        // Read before the head, so that an orphaned ring is known to be complete
+        BOOL orphaned= atomic_load_explicit(&ring->orphaned, memory_order_acquire);
+        
+        size_t tail= atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head= atomic_load_explicit(&ring->head, memory_order_acquire);
+        
+        NSString *threadName= (__bridge NSString *) ring->threadName;
+        
+        for (; tail != head; tail++) {
+            LSLogRecord *record= &ring->records[tail & ring->mask];
+            NSString *message= (__bridge_transfer NSString *) record->message;
+            record->message= NULL;
+            
+            if (lines.count == entryCapacity) {
+                entryCapacity= MAX(2 * entryCapacity, 64);
+                entries= realloc(entries, entryCapacity * sizeof(LSLogBatchEntry));
+            }
+            
+            entries[lines.count].time= record->time;
+            entries[lines.count].index= lines.count;
+            
+            [lines addObject:LSLogFormatLine(threadName, record->sourceType, record->source, message)];
+        }
+        
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        
+        if (orphaned) {
+            *link= ring->next;
+            
+            // Hand the thread name back to ARC, which releases it
+            (void) (__bridge_transfer NSString *) ring->threadName;
+            
+            free(ring);
+            
+        } else {
+            link= &ring->next;
+        }
+    }
+    
+    pthread_mutex_unlock(&__ringsLock);
+    
+    // Rings are drained one after the other, lines of different threads are put back in time order
+    NSArray<NSString *> *batch= lines;
+    if (lines.count > 1) {
+        qsort(entries, lines.count, sizeof(LSLogBatchEntry), LSLogCompareBatchEntries);
+        
+        NSMutableArray<NSString *> *sorted= [[NSMutableArray alloc] initWithCapacity:lines.count];
+        for (NSUInteger i= 0; i < lines.count; i++)
+            [sorted addObject:lines[entries[i].index]];
+        
+        batch= sorted;
+    }
+    
+    free(entries);
+    
+    return batch;
+}
+
+static BOOL LSLogRingsPending(void) {
+    BOOL pending= NO;
+    
+    pthread_mutex_lock(&__ringsLock);
+    
+    for (LSLogRing *ring= __rings; ring && (!pending); ring= ring->next) {
+        if (atomic_load_explicit(&ring->orphaned, memory_order_acquire) ||
+            (atomic_load_explicit(&ring->head, memory_order_acquire) != atomic_load_explicit(&ring->tail, memory_order_relaxed)))
+            pending= YES;
+    }
+    
+    pthread_mutex_unlock(&__ringsLock);
+    
+    return pending;
+}
+
+
+#pragma mark -
+#pragma mark LSLog extension
+
+@interface LSLog ()
+
+
+#pragma mark -
+#pragma mark Writer run loop
+
++ (void) writerRunLoop;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSLog implementation
+
+@implementation LSLog
+
+
+#pragma mark -
+#pragma mark Logging
+
++ (void) sourceType:(int)sourceType source:(id)source log:(NSString *)format, ... {
+    if (__enabledSourceTypes & sourceType) {
+        NSString *logMessage= nil;
         
+        @try {
+            
             // Variable arguments formatting
             va_list arguments;
             va_start(arguments, format);
-            NSString *logMessage= [[NSString alloc] initWithFormat:format arguments:arguments];
+            logMessage= [[NSString alloc] initWithFormat:format arguments:arguments];
             va_end(arguments);
             
-            // Logging
-            NSString *logLine= [NSString stringWithFormat:@"<%@> %@", threadName, logMessage];
-            if (__delegate)
-                [__delegate appendLogLine:logLine];
-            else
-                NSLog(@"%@", logLine);
-
         } @catch (NSException *e) {
-            NSLog(@"<%@> Exception caught while logging with format '%@': %@, reason: '%@', user info: %@", threadName, format, e.name, e.reason, e.userInfo);
+            NSLog(@"<%@> Exception caught while logging with format '%@': %@, reason: '%@', user info: %@", LSLogCurrentThreadName(), format, e.name, e.reason, e.userInfo);
+            return;
         }
+        
+        // Logging
+        LSLogAppendMessage(sourceType, (__bridge const void *) source, logMessage);
     }
 }
 
++ (void) log:(NSString *)format, ... {
+    NSString *logMessage= nil;
+    
+    @try {
+        
+        // Variable arguments formatting
+        va_list arguments;
+        va_start(arguments, format);
+        logMessage= [[NSString alloc] initWithFormat:format arguments:arguments];
+        va_end(arguments);
+        
+    } @catch (NSException *e) {
+        NSLog(@"<%@> Exception caught while logging with format '%@': %@, reason: '%@', user info: %@", LSLogCurrentThreadName(), format, e.name, e.reason, e.userInfo);
+        return;
+    }
+    
+    // Logging
+    LSLogAppendMessage(0, NULL, logMessage);
+}
+
 
 #pragma mark -
 #pragma mark Log delegation
@@ -119,6 +423,122 @@ static id <LSLogDelegate> __delegate= nil;
 }
 
 
+#pragma mark -
+#pragma mark Asynchronous mode
+
++ (void) enableAsynchronousModeWithBufferSize:(NSUInteger)bufferSize overflowPolicy:(LSLogOverflowPolicy)overflowPolicy {
+    if (!bufferSize)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Log buffer size must be positive"
+                                     userInfo:nil];
+    
+    // Ring indexes are masked, the size must be a power of 2
+    NSUInteger capacity= 1;
+    while (capacity < bufferSize)
+        capacity <<= 1;
+    
+    @synchronized ([LSLog class]) {
+        atomic_store_explicit(&__bufferSize, capacity, memory_order_relaxed);
+        atomic_store_explicit(&__overflowPolicy, (unsigned int) overflowPolicy, memory_order_relaxed);
+        
+        if (!__writer) {
+            __writerParker= [[LSThreadParker alloc] init];
+            __flushCondition= [[NSCondition alloc] init];
+            __spaceCondition= [[NSCondition alloc] init];
+            
+            __writer= [[NSThread alloc] initWithTarget:self selector:@selector(writerRunLoop) object:nil];
+            __writer.name= LOG_WRITER_THREAD_NAME;
+            
+            [__writer start];
+        }
+        
+        atomic_store_explicit(&__asynchronous, true, memory_order_release);
+    }
+}
+
++ (void) disableAsynchronousMode {
+    atomic_store_explicit(&__asynchronous, false, memory_order_release);
+    
+    [self flush];
+}
+
++ (BOOL) isAsynchronousModeEnabled {
+    return atomic_load_explicit(&__asynchronous, memory_order_acquire);
+}
+
++ (void) flush {
+    NSThread *writer= nil;
+    @synchronized ([LSLog class]) {
+        writer= __writer;
+    }
+    
+    if ((!writer) || ([NSThread currentThread] == writer))
+        return;
+    
+    uint64_t ticket= atomic_fetch_add_explicit(&__flushRequested, 1, memory_order_seq_cst) + 1;
+    [__writerParker unpark];
+    
+    [__flushCondition lock];
+    
+    while (__flushCompleted < ticket)
+        [__flushCondition wait];
+    
+    [__flushCondition unlock];
+}
+
++ (uint64_t) droppedLineCount {
+    return atomic_load_explicit(&__droppedLineCount, memory_order_relaxed);
+}
+
+
+#pragma mark -
+#pragma mark Writer run loop
+
++ (void) writerRunLoop {
+    uint64_t flushCompleted= 0;
+    
+    for (;;) {
+        @autoreleasepool {
+            uint64_t flushRequested= atomic_load_explicit(&__flushRequested, memory_order_acquire);
+            
+            NSArray<NSString *> *batch= LSLogDrainRings();
+            if (batch.count > 0)
+                LSLogDeliver(batch);
+            
+            // Threads waiting for room may proceed
+            if (atomic_load_explicit(&__blockedCount, memory_order_seq_cst) > 0) {
+                [__spaceCondition lock];
+                [__spaceCondition broadcast];
+                [__spaceCondition unlock];
+            }
+            
+            if (flushRequested > flushCompleted) {
+                flushCompleted= flushRequested;
+                
+                [__flushCondition lock];
+                
+                __flushCompleted= flushCompleted;
+                [__flushCondition broadcast];
+                
+                [__flushCondition unlock];
+            }
+            
+            if (batch.count > 0)
+                continue;
+            
+            // Publish the parked flag before checking for lines, pairs with the fence of loggers
+            atomic_store_explicit(&__writerParked, true, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            
+            if ((!LSLogRingsPending()) && (atomic_load_explicit(&__flushRequested, memory_order_acquire) == flushCompleted))
+                [__writerParker parkUntilDate:nil];
+            
+            atomic_store_explicit(&__writerParked, false, memory_order_relaxed);
+        }
+    }
+}
+
+
 #pragma mark -
 #pragma mark Source log filtering
 
@@ -43,4 +43,14 @@
 - (void) appendLogLine:(nonnull NSString *)logLine;
 
 
+@optional
+
+/**
+ @brief Called in asynchronous mode with a batch of log lines, in place of <code>appendLogLine:</code>.
+ Called by the background writer thread only.
+ @param logLines The log lines to be appended, in order.
+ */
+- (void) appendLogLines:(nonnull NSArray<NSString *> *)logLines;
+
+
 @end
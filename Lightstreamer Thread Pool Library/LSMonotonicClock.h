@@ -0,0 +1,37 @@
+//
+//  LSMonotonicClock.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <time.h>
+#import <stdint.h>
+
+
+/**
+ @brief Returns the time of a monotonic clock, in nanoseconds. <b>For internal use only</b>.
+ <br/> Unlike <code>[NSDate date]</code>, the monotonic clock is not affected by changes of the wall clock,
+ hence it is suitable to measure intervals such as queueing delays.
+ */
+static inline uint64_t LSMonotonicNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (((uint64_t) now.tv_sec) * 1000000000ULL) + ((uint64_t) now.tv_nsec);
+}
@@ -0,0 +1,134 @@
+//
+//  LSPartitionedThreadPool.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSThreadPool.h"
+
+
+@class LSThreadPoolConfiguration;
+
+
+/**
+ @brief LSPartitionedThreadPool splits one logical thread pool into partitions, one per NUMA node of the host.
+ <br/> Each partition is an LSThreadPool whose threads may run only on the processors of its node. Calls are scheduled
+ on the partition of the node the scheduling thread is running on, so that they are run close to the memory they
+ likely touch. If the node of the scheduling thread can't be determined, partitions are used in turn.
+ <br/> On hosts with a single node, or on platforms other than Linux, there is a single partition.
+ */
+@interface LSPartitionedThreadPool : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates an LSPartitionedThreadPool with the specified name and configuration.
+ @param name The name of the thread pool. Partitions are named after it, with the index of their node.
+ @param configuration The configuration of each partition, such as its core and maximum size. It is copied.
+ If it specifies a <code>cpuSet</code>, partitions are restricted to it, and nodes with no processors in it are skipped.
+ @return The created thread pool.
+ @throws NSException If the name or configuration are <code>nil</code>, or the configuration is not valid.
+ */
++ (nonnull LSPartitionedThreadPool *) poolWithName:(nonnull NSString *)name configuration:(nonnull LSThreadPoolConfiguration *)configuration;
+
+/**
+ @brief Initializes an LSPartitionedThreadPool with the specified name and configuration.
+ @param name The name of the thread pool. Partitions are named after it, with the index of their node.
+ @param configuration The configuration of each partition, such as its core and maximum size. It is copied.
+ If it specifies a <code>cpuSet</code>, partitions are restricted to it, and nodes with no processors in it are skipped.
+ @throws NSException If the name or configuration are <code>nil</code>, or the configuration is not valid.
+ */
+- (nonnull instancetype) initWithName:(nonnull NSString *)name configuration:(nonnull LSThreadPoolConfiguration *)configuration NS_DESIGNATED_INITIALIZER;
+
+/**
+ @brief Invalid initializer, use <code>initWithName:configuration:</code>.
+ @throws NSException Always.
+ */
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+/**
+ @brief Disposes of all partitions. See <code>dispose</code> of LSThreadPool.
+ */
+- (void) dispose;
+
+/**
+ @brief Shuts down all partitions gracefully. See <code>shutdown</code> of LSThreadPool.
+ */
+- (void) shutdown;
+
+/**
+ @brief Shuts down all partitions immediately. See <code>shutdownNow</code> of LSThreadPool.
+ @return The calls cancelled, of all partitions.
+ */
+- (nonnull NSArray<LSInvocation *> *) shutdownNow;
+
+/**
+ @brief Waits for the threads of all partitions to exit after a shutdown, up to the specified timeout.
+ @return YES if all threads have exited, NO if the timeout expired.
+ */
+- (BOOL) awaitTerminationWithTimeout:(NSTimeInterval)timeout;
+
+
+#pragma mark -
+#pragma mark Invocation scheduling
+
+/**
+ @brief Schedules a call to the specified block on the local partition. See <code>scheduleInvocationForBlock:</code> of LSThreadPool.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block;
+
+/**
+ @brief Schedules a call to the specified target and selector on the local partition. See <code>scheduleInvocationForTarget:selector:</code> of LSThreadPool.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified argument on the local partition.
+ See <code>scheduleInvocationForTarget:selector:withObject:</code> of LSThreadPool.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object;
+
+/**
+ @brief Schedules a call to the specified C function on the local partition. See <code>scheduleFunction:context:</code> of LSThreadPool.
+ */
+- (BOOL) scheduleFunction:(nonnull LSThreadPoolFunction)function context:(nullable void *)context;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The partitions, one per NUMA node in use.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<LSThreadPool *> *partitions;
+
+/**
+ @brief The partition of the node the calling thread is running on.
+ */
+@property (nonatomic, readonly, nonnull) LSThreadPool *localPartition;
+
+/**
+ @brief The number of calls waiting in the queues of all partitions.
+ */
+@property (nonatomic, readonly) NSUInteger queueSize;
+
+
+@end
@@ -0,0 +1,221 @@
+//
+//  LSPartitionedThreadPool.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSPartitionedThreadPool.h"
+#import "LSThreadPoolConfiguration.h"
+#import "LSCPUTopology.h"
+
+#import <stdatomic.h>
+
+
+#pragma mark -
+#pragma mark LSPartitionedThreadPool extension
+
+@interface LSPartitionedThreadPool () {
+    NSArray<LSThreadPool *> *_partitions;
+    
+    // Partition index of each processor, or NSNotFound for processors with no partition
+    NSUInteger *_partitionOfCPU;
+    NSUInteger _cpuCount;
+    
+    atomic_uint _nextPartition;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSPartitionedThreadPool implementation
+
+@implementation LSPartitionedThreadPool
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSPartitionedThreadPool *) poolWithName:(NSString *)name configuration:(LSThreadPoolConfiguration *)configuration {
+    LSPartitionedThreadPool *pool= [[LSPartitionedThreadPool alloc] initWithName:name configuration:configuration];
+    
+    return pool;
+}
+
+- (instancetype) initWithName:(NSString *)name configuration:(LSThreadPoolConfiguration *)configuration {
+    if ((self = [super init])) {
+        
+        // Initialization
+        if ((!name) || (!configuration))
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool name and configuration can't be nil"
+                                         userInfo:nil];
+        
+        NSArray<NSIndexSet *> *nodes= [LSCPUTopology numaNodeCPUs];
+        NSArray<NSNumber *> *nodeIDs= [LSCPUTopology numaNodeIDs];
+        
+        // The last index of an empty set is NSNotFound
+        _cpuCount= 0;
+        for (NSIndexSet *cpus in nodes) {
+            if (cpus.count)
+                _cpuCount= MAX(_cpuCount, cpus.lastIndex + 1);
+        }
+        
+        _partitionOfCPU= malloc(MAX(_cpuCount, 1) * sizeof(NSUInteger));
+        for (NSUInteger cpu= 0; cpu < _cpuCount; cpu++)
+            _partitionOfCPU[cpu]= NSNotFound;
+        
+        NSMutableArray<LSThreadPool *> *partitions= [[NSMutableArray alloc] initWithCapacity:nodes.count];
+        for (NSUInteger node= 0; node < nodes.count; node++) {
+            NSMutableIndexSet *cpus= [nodes[node] mutableCopy];
+            
+            // Restrict the node to the processors of the configuration, if any
+            if (configuration.cpuSet) {
+                NSIndexSet *allowed= configuration.cpuSet;
+                [cpus removeIndexesPassingTest:^BOOL(NSUInteger cpu, BOOL *stop) {
+                    return ![allowed containsIndex:cpu];
+                }];
+            }
+            
+            // A node with no processors to run on gets no partition
+            if (!cpus.count)
+                continue;
+            
+            LSThreadPoolConfiguration *partitionConfiguration= [configuration copy];
+            partitionConfiguration.cpuSet= (nodes.count > 1) ? cpus : configuration.cpuSet;
+            
+            NSUInteger partition= partitions.count;
+            [cpus enumerateIndexesUsingBlock:^(NSUInteger cpu, BOOL *stop) {
+                if (cpu < self->_cpuCount)
+                    self->_partitionOfCPU[cpu]= partition;
+            }];
+            
+            [partitions addObject:[[LSThreadPool alloc] initWithName:[NSString stringWithFormat:@"%@ Node%lu", name, nodeIDs[node].unsignedLongValue]
+                                                       configuration:partitionConfiguration]];
+        }
+        
+        if (!partitions.count)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool CPU set contains no online processor"
+                                         userInfo:@{@"cpuSet": configuration.cpuSet}];
+        
+        _partitions= [partitions copy];
+        
+        atomic_init(&_nextPartition, 0);
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSPartitionedThreadPool"
+                                 userInfo:nil];
+}
+
+- (void) dealloc {
+    free(_partitionOfCPU);
+}
+
+- (void) dispose {
+    for (LSThreadPool *partition in _partitions)
+        [partition dispose];
+}
+
+- (void) shutdown {
+    for (LSThreadPool *partition in _partitions)
+        [partition shutdown];
+}
+
+- (NSArray<LSInvocation *> *) shutdownNow {
+    NSMutableArray<LSInvocation *> *invocations= [[NSMutableArray alloc] init];
+    
+    for (LSThreadPool *partition in _partitions)
+        [invocations addObjectsFromArray:[partition shutdownNow]];
+    
+    return invocations;
+}
+
+- (BOOL) awaitTerminationWithTimeout:(NSTimeInterval)timeout {
+    NSDate *limit= [NSDate dateWithTimeIntervalSinceNow:timeout];
+    
+    for (LSThreadPool *partition in _partitions) {
+        if (![partition awaitTerminationWithTimeout:MAX([limit timeIntervalSinceNow], 0.0)])
+            return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark -
+#pragma mark Invocation scheduling
+
+- (LSInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block {
+    return [self.localPartition scheduleInvocationForBlock:block];
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector {
+    return [self.localPartition scheduleInvocationForTarget:target selector:selector];
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object {
+    return [self.localPartition scheduleInvocationForTarget:target selector:selector withObject:object];
+}
+
+- (BOOL) scheduleFunction:(LSThreadPoolFunction)function context:(void *)context {
+    return [self.localPartition scheduleFunction:function context:context];
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize partitions= _partitions;
+
+@dynamic localPartition;
+
+- (LSThreadPool *) localPartition {
+    if (_partitions.count == 1)
+        return _partitions[0];
+    
+    NSInteger cpu= [LSCPUTopology currentCPU];
+    if ((cpu >= 0) && ((NSUInteger) cpu < _cpuCount)) {
+        NSUInteger partition= _partitionOfCPU[cpu];
+        if (partition != NSNotFound)
+            return _partitions[partition];
+    }
+    
+    // Unknown node, e.g. a processor outside of the CPU set: partitions take turns
+    NSUInteger partition= atomic_fetch_add_explicit(&_nextPartition, 1, memory_order_relaxed) % _partitions.count;
+    return _partitions[partition];
+}
+
+@dynamic queueSize;
+
+- (NSUInteger) queueSize {
+    NSUInteger queueSize= 0;
+    
+    for (LSThreadPool *partition in _partitions)
+        queueSize += partition.queueSize;
+    
+    return queueSize;
+}
+
+
+@end
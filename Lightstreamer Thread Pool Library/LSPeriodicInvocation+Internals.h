@@ -0,0 +1,48 @@
+//
+//  LSPeriodicInvocation+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSPeriodicInvocation.h"
+
+
+#pragma mark -
+#pragma mark LSPeriodicInvocation Internals category
+
+@interface LSPeriodicInvocation (Internals)
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (instancetype) initWithBlock:(LSInvocationBlock)block period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate;
+- (instancetype) initWithTarget:(id)target selector:(SEL)selector period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate;
+
+
+#pragma mark -
+#pragma mark Execution (for internal use only)
+
+/**
+ @brief Computes the deadline of the next run and brings the invocation back to pending.
+ @param end Time the last run ended, on the monotonic clock.
+ @return YES if the invocation must be scheduled again, NO if it has been stopped.
+ */
+- (BOOL) rearmAfterRunEndedAt:(uint64_t)end;
+
+
+@end
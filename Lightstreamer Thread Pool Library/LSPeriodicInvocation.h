@@ -0,0 +1,65 @@
+//
+//  LSPeriodicInvocation.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSInvocation.h"
+
+
+/**
+ @brief LSPeriodicInvocation describes a call scheduled to run repeatedly on an LSThreadPool, at a fixed rate or with a fixed delay.
+ <br/> The same descriptor is reused for each run. Cancelling it takes constant time and stops further runs: if it is waiting
+ for its next run it completes right away, with the cancellation error, otherwise the current run is the last one
+ and it completes when the run ends.
+ */
+@interface LSPeriodicInvocation : LSInvocation
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+/**
+ @brief Stops further runs of the periodic call.
+ @return YES if the periodic call has been stopped, NO if it had already been stopped.
+ */
+- (BOOL) cancel;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The period, in seconds, between the start of two runs (fixed rate) or between the end of a run and the start of the next one (fixed delay).
+ */
+@property (nonatomic, readonly) NSTimeInterval period;
+
+/**
+ @brief If the call runs at a fixed rate, otherwise with a fixed delay.
+ <br/> At a fixed rate, a late run doesn't delay the following ones, which may then run back to back.
+ */
+@property (nonatomic, readonly) BOOL fixedRate;
+
+/**
+ @brief The number of runs completed so far.
+ */
+@property (nonatomic, readonly) NSUInteger executionCount;
+
+
+@end
@@ -0,0 +1,162 @@
+//
+//  LSPeriodicInvocation.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSPeriodicInvocation.h"
+#import "LSPeriodicInvocation+Internals.h"
+#import "LSInvocation+Internals.h"
+
+#import <stdatomic.h>
+
+
+#pragma mark -
+#pragma mark LSPeriodicInvocation extension
+
+@interface LSPeriodicInvocation () {
+    NSTimeInterval _period;
+    uint64_t _periodNanoseconds;
+    BOOL _fixedRate;
+    
+    atomic_bool _stopped;
+    atomic_size_t _executionCount;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (void) setUpWithPeriod:(NSTimeInterval)period fixedRate:(BOOL)fixedRate;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSPeriodicInvocation implementation
+
+@implementation LSPeriodicInvocation
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithBlock:(LSInvocationBlock)block period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate {
+    if ((self = [super initWithBlock:block delay:0.0])) {
+        
+        // Initialization
+        [self setUpWithPeriod:period fixedRate:fixedRate];
+    }
+    
+    return self;
+}
+
+- (instancetype) initWithTarget:(id)target selector:(SEL)selector period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate {
+    if (!selector)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Selector can't be nil"
+                                     userInfo:nil];
+    
+    if ((self = [super initWithTarget:target selector:selector argument:nil delay:0.0])) {
+        
+        // Initialization
+        [self setUpWithPeriod:period fixedRate:fixedRate];
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Execution (for internal use only)
+
+- (BOOL) rearmAfterRunEndedAt:(uint64_t)end {
+    atomic_fetch_add_explicit(&_executionCount, 1, memory_order_relaxed);
+    
+    if (atomic_load_explicit(&_stopped, memory_order_acquire))
+        return NO;
+    
+    self.deadline= _fixedRate ? (self.deadline + _periodNanoseconds) : (end + _periodNanoseconds);
+    
+    if (![self rearm])
+        return NO;
+    
+    // A cancellation during the run may have found us started: discard the next run on its behalf
+    if (atomic_load_explicit(&_stopped, memory_order_acquire)) {
+        [super cancel];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+- (BOOL) cancel {
+    if (atomic_exchange_explicit(&_stopped, true, memory_order_acq_rel))
+        return NO;
+    
+    // If waiting for the next run it is discarded right away, otherwise the current run is the last one
+    [super cancel];
+    
+    return YES;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (void) setUpWithPeriod:(NSTimeInterval)period fixedRate:(BOOL)fixedRate {
+    if (period <= 0.0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Period must be greater than 0"
+                                     userInfo:@{@"period": @(period)}];
+    
+    _period= period;
+    _periodNanoseconds= (uint64_t) (period * 1000000000.0);
+    _fixedRate= fixedRate;
+    
+    atomic_init(&_stopped, false);
+    atomic_init(&_executionCount, 0);
+    
+    self.periodic= YES;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize period= _period;
+@synthesize fixedRate= _fixedRate;
+
+@dynamic executionCount;
+
+- (NSUInteger) executionCount {
+    return atomic_load_explicit(&_executionCount, memory_order_relaxed);
+}
+
+@dynamic cancelled;
+
+- (BOOL) cancelled {
+    return atomic_load_explicit(&_stopped, memory_order_relaxed);
+}
+
+
+@end
@@ -0,0 +1,143 @@
+//
+//  LSSerialExecutor.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+#import "LSInvocation.h"
+
+
+@class LSThreadPool;
+
+
+/**
+ @brief Error domain of errors produced by an LSSerialExecutor.
+ */
+#define LS_SERIAL_EXECUTOR_ERROR_DOMAIN                    (@"LSSerialExecutorDomain")
+
+/**
+ @brief Error code of a call that could not be run because its key could not be scheduled on the thread pool,
+ e.g. because the pool has been disposed of or its queue is full.
+ <br/> The exception raised by the pool, if any, is available in the error's user info, with key <code>LS_SERIAL_EXECUTOR_EXCEPTION_KEY</code>.
+ */
+#define LS_SERIAL_EXECUTOR_ERROR_CODE_NOT_SCHEDULED        (-2001)
+
+/**
+ @brief User info key of the exception that prevented a key from being scheduled.
+ */
+#define LS_SERIAL_EXECUTOR_EXCEPTION_KEY                   (@"LSSerialExecutorException")
+
+
+/**
+ @brief LSSerialExecutor runs calls one at a time per key, in the order they have been scheduled, on the threads of an LSThreadPool.
+ <br/> Calls with different keys run in parallel, sharing the threads of the pool. Calls with the same key never overlap,
+ and each one sees the effects of the previous ones, so state owned by a key needs no further locking.
+ <br/> A key with no pending calls costs neither a thread nor memory: its state is created when a call is scheduled
+ and released when the last call completes.
+ */
+@interface LSSerialExecutor : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates an LSSerialExecutor running its calls on the specified thread pool.
+ @param pool The thread pool where calls are run. It is retained by the executor.
+ @return The created executor.
+ @throws NSException If the pool is <code>nil</code>.
+ */
++ (nonnull LSSerialExecutor *) executorWithPool:(nonnull LSThreadPool *)pool;
+
+/**
+ @brief Initializes an LSSerialExecutor running its calls on the specified thread pool.
+ @param pool The thread pool where calls are run. It is retained by the executor.
+ @throws NSException If the pool is <code>nil</code>.
+ */
+- (nonnull instancetype) initWithPool:(nonnull LSThreadPool *)pool NS_DESIGNATED_INITIALIZER;
+
+/**
+ @brief Invalid initializer, use <code>initWithPool:</code>.
+ @throws NSException Always.
+ */
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+
+#pragma mark -
+#pragma mark Invocation scheduling
+
+/**
+ @brief Schedules a call to the specified block, to be run after any other call previously scheduled with the same key.
+ @param key The key of the call. Keys are compared with <code>isEqual:</code> and are copied.
+ @param block The block to be executed.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion. If the key can't be scheduled on the pool, the call completes with an <code>error</code>.
+ @throws NSException If the key or block are <code>nil</code>.
+ @throws NSException If the key can't be scheduled on the pool and its queue-full policy raises an exception.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForKey:(nonnull id <NSCopying>)key block:(nonnull LSInvocationBlock)block;
+
+/**
+ @brief Schedules a call to the specified target and selector, to be run after any other call previously scheduled with the same key.
+ <br/> The selector (method signature) must have no arguments.
+ @param key The key of the call. Keys are compared with <code>isEqual:</code> and are copied.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion. If the key can't be scheduled on the pool, the call completes with an <code>error</code>.
+ @throws NSException If the key, target or selector are <code>nil</code>.
+ @throws NSException If the key can't be scheduled on the pool and its queue-full policy raises an exception.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForKey:(nonnull id <NSCopying>)key target:(nonnull id)target selector:(nonnull SEL)selector;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified argument, to be run after any other call
+ previously scheduled with the same key.
+ <br/> The selector (method signature) must have exactly one argument.
+ @param key The key of the call. Keys are compared with <code>isEqual:</code> and are copied.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param object The argument of the selector to be called. A <code>nil</code> is accepted.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion. If the key can't be scheduled on the pool, the call completes with an <code>error</code>.
+ @throws NSException If the key, target or selector are <code>nil</code>.
+ @throws NSException If the key can't be scheduled on the pool and its queue-full policy raises an exception.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForKey:(nonnull id <NSCopying>)key target:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The thread pool where calls are run.
+ */
+@property (nonatomic, readonly, nonnull) LSThreadPool *pool;
+
+/**
+ @brief The number of keys with pending calls, i.e. calls scheduled but not yet completed.
+ */
+@property (nonatomic, readonly) NSUInteger activeKeyCount;
+
+/**
+ @brief The number of calls scheduled but not yet started, for all keys.
+ */
+@property (nonatomic, readonly) NSUInteger queueSize;
+
+
+@end
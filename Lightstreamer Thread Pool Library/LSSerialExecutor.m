@@ -0,0 +1,355 @@
+//
+//  LSSerialExecutor.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSSerialExecutor.h"
+#import "LSThreadPool.h"
+#import "LSThreadPool+Internals.h"
+#import "LSInvocation+Internals.h"
+#import "LSLog.h"
+#import "LSLog+Internals.h"
+
+#import <stdatomic.h>
+#import <pthread.h>
+
+#define DRAIN_BATCH_SIZE                                     (8)
+
+
+#pragma mark -
+#pragma mark LSSerialExecutorStrand
+
+/**
+ @brief The pending calls of a key. Exists only while the key has pending calls, and
+ while it exists exactly one drain for it is scheduled on (or running in) the pool.
+ */
+@interface LSSerialExecutorStrand : NSObject
+
+@property (nonatomic, readonly) id <NSCopying> key;
+@property (nonatomic, readonly) NSMutableArray<LSInvocation *> *invocations;
+
+@end
+
+@implementation LSSerialExecutorStrand
+
+- (instancetype) initWithKey:(id <NSCopying>)key {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _key= key;
+        _invocations= [[NSMutableArray alloc] init];
+    }
+    
+    return self;
+}
+
+@synthesize key= _key;
+@synthesize invocations= _invocations;
+
+@end
+
+
+#pragma mark -
+#pragma mark LSSerialExecutor extension
+
+@interface LSSerialExecutor () {
+    LSThreadPool *_pool;
+    
+    NSMutableDictionary<id <NSCopying>, LSSerialExecutorStrand *> *_strands;
+    pthread_mutex_t _lock;
+    
+    atomic_size_t _queueSize;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (LSInvocation *) scheduleInvocation:(LSInvocation *)invocation forKey:(id <NSCopying>)key;
+- (void) scheduleStrand:(LSSerialExecutorStrand *)strand;
+- (BOOL) scheduleStrand:(LSSerialExecutorStrand *)strand deferringInlineDrain:(BOOL)deferInline;
+- (void) drainStrand:(LSSerialExecutorStrand *)strand;
+- (void) rejectStrand:(LSSerialExecutorStrand *)strand withError:(NSError *)error;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSSerialExecutor implementation
+
+@implementation LSSerialExecutor
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSSerialExecutor *) executorWithPool:(LSThreadPool *)pool {
+    LSSerialExecutor *executor= [[LSSerialExecutor alloc] initWithPool:pool];
+    
+    return executor;
+}
+
+- (instancetype) initWithPool:(LSThreadPool *)pool {
+    if ((self = [super init])) {
+        
+        // Initialization
+        if (!pool)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool can't be nil"
+                                         userInfo:nil];
+        
+        _pool= pool;
+        
+        _strands= [[NSMutableDictionary alloc] init];
+        pthread_mutex_init(&_lock, NULL);
+        
+        atomic_init(&_queueSize, 0);
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSSerialExecutor"
+                                 userInfo:nil];
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark -
+#pragma mark Invocation scheduling
+
+- (LSInvocation *) scheduleInvocationForKey:(id <NSCopying>)key block:(LSInvocationBlock)block {
+    if (!block)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Block can't be nil"
+                                     userInfo:nil];
+    
+    return [self scheduleInvocation:[LSInvocation invocationWithBlock:block] forKey:key];
+}
+
+- (LSInvocation *) scheduleInvocationForKey:(id <NSCopying>)key target:(id)target selector:(SEL)selector {
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
+    
+    return [self scheduleInvocation:[LSInvocation invocationWithTarget:target selector:selector] forKey:key];
+}
+
+- (LSInvocation *) scheduleInvocationForKey:(id <NSCopying>)key target:(id)target selector:(SEL)selector withObject:(id)object {
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
+    
+    return [self scheduleInvocation:[LSInvocation invocationWithTarget:target selector:selector argument:object] forKey:key];
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (LSInvocation *) scheduleInvocation:(LSInvocation *)invocation forKey:(id <NSCopying>)key {
+    if (!key)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Key can't be nil"
+                                     userInfo:nil];
+    
+    atomic_fetch_add_explicit(&_queueSize, 1, memory_order_relaxed);
+    
+    LSSerialExecutorStrand *newStrand= nil;
+    
+    pthread_mutex_lock(&_lock);
+    
+    LSSerialExecutorStrand *strand= [_strands objectForKey:key];
+    if (!strand) {
+        newStrand= [[LSSerialExecutorStrand alloc] initWithKey:[key copyWithZone:nil]];
+        [_strands setObject:newStrand forKey:newStrand.key];
+        
+        strand= newStrand;
+    }
+    
+    [strand.invocations addObject:invocation];
+    
+    pthread_mutex_unlock(&_lock);
+    
+    // If the key was idle, its first call has to be scheduled, otherwise
+    // it will be run by the drain already scheduled or running
+    if (newStrand)
+        [self scheduleStrand:newStrand];
+    
+    return invocation;
+}
+
+- (void) scheduleStrand:(LSSerialExecutorStrand *)strand {
+    [self scheduleStrand:strand deferringInlineDrain:NO];
+}
+
+- (BOOL) scheduleStrand:(LSSerialExecutorStrand *)strand deferringInlineDrain:(BOOL)deferInline {
+    pthread_t schedulingThread= pthread_self();
+    __block BOOL scheduling= deferInline;
+    __block BOOL deferred= NO;
+    
+    LSInvocation *drain= [LSInvocation invocationWithBlock:^{
+        
+        // Run by the caller-runs policy from within a drain: leave it to that drain
+        // to loop, rather than recursing once per batch. Other threads never read
+        // the flag, as they fail the thread check first
+        if (pthread_equal(pthread_self(), schedulingThread) && scheduling) {
+            deferred= YES;
+            return;
+        }
+        
+        [self drainStrand:strand];
+    }];
+    
+    // With a bounded queue the drain may be rejected
+    drain.rejectionHandler= ^(NSError *error) {
+        [self rejectStrand:strand withError:error];
+    };
+    
+    @try {
+        
+        // Drains go to the shared queue: on a work stealing pool the local deque
+        // would give the strand straight back to the same thread, with no yield
+        [_pool scheduleInvocation:drain priority:LSThreadPoolPriorityNormal shared:YES];
+        
+    } @catch (NSException *e) {
+        [self rejectStrand:strand withError:[NSError errorWithDomain:LS_SERIAL_EXECUTOR_ERROR_DOMAIN
+                                                                code:LS_SERIAL_EXECUTOR_ERROR_CODE_NOT_SCHEDULED
+                                                            userInfo:@{NSLocalizedDescriptionKey: @"Key could not be scheduled on thread pool",
+                                                                       LS_SERIAL_EXECUTOR_EXCEPTION_KEY: e}]];
+        
+        @throw e;
+    }
+    
+    scheduling= NO;
+    
+    return deferred;
+}
+
+- (void) drainStrand:(LSSerialExecutorStrand *)strand {
+    BOOL drainInline= NO;
+    
+    do {
+        
+        // Run a limited batch, then yield the thread to other keys
+        for (int i= 0; i < DRAIN_BATCH_SIZE; i++) {
+            pthread_mutex_lock(&_lock);
+            
+            LSInvocation *invocation= strand.invocations.firstObject;
+            if (invocation)
+                [strand.invocations removeObjectAtIndex:0];
+            
+            pthread_mutex_unlock(&_lock);
+            
+            // The strand has been rejected in the meantime
+            if (!invocation)
+                return;
+            
+            atomic_fetch_sub_explicit(&_queueSize, 1, memory_order_relaxed);
+            
+            // Cancelled calls are skipped as they come
+            if ([invocation beginPerforming]) {
+                @try {
+                    [invocation perform];
+                    
+                } @catch (NSException *e) {
+                    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"exception caught while running invocation for key %@: %@ (user info: %@)", strand.key, e, e.userInfo];
+                    
+                } @finally {
+                    [invocation completed];
+                }
+            }
+            
+            // Release the key as soon as it has no more pending calls
+            BOOL idle= NO;
+            
+            pthread_mutex_lock(&_lock);
+            
+            if (strand.invocations.count == 0) {
+                if ([_strands objectForKey:strand.key] == strand)
+                    [_strands removeObjectForKey:strand.key];
+                
+                idle= YES;
+            }
+            
+            pthread_mutex_unlock(&_lock);
+            
+            if (idle)
+                return;
+        }
+        
+        // If the pool runs the drain on this very thread, go on here
+        drainInline= [self scheduleStrand:strand deferringInlineDrain:YES];
+        
+    } while (drainInline);
+}
+
+- (void) rejectStrand:(LSSerialExecutorStrand *)strand withError:(NSError *)error {
+    NSArray<LSInvocation *> *invocations= nil;
+    
+    pthread_mutex_lock(&_lock);
+    
+    invocations= [strand.invocations copy];
+    [strand.invocations removeAllObjects];
+    
+    if ([_strands objectForKey:strand.key] == strand)
+        [_strands removeObjectForKey:strand.key];
+    
+    pthread_mutex_unlock(&_lock);
+    
+    atomic_fetch_sub_explicit(&_queueSize, invocations.count, memory_order_relaxed);
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"rejecting %lu invocations for key %@: %@", (unsigned long) invocations.count, strand.key, error];
+    
+    for (LSInvocation *invocation in invocations)
+        [invocation rejectWithError:error];
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize pool= _pool;
+
+@dynamic activeKeyCount;
+
+- (NSUInteger) activeKeyCount {
+    NSUInteger count= 0;
+    
+    pthread_mutex_lock(&_lock);
+    count= _strands.count;
+    pthread_mutex_unlock(&_lock);
+    
+    return count;
+}
+
+@dynamic queueSize;
+
+- (NSUInteger) queueSize {
+    return atomic_load_explicit(&_queueSize, memory_order_relaxed);
+}
+
+
+@end
@@ -0,0 +1,160 @@
+//
+//  LSShardedTimerThread.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSTimerThread.h"
+
+
+/**
+ @brief LSShardedTimerThread spreads delayed calls over a number of LSTimerThread shards, each with its own thread and wheel.
+ <br/> Calls are assigned to a shard by the identity of their owner: the target for target/selector calls, or an owner
+ specified explicitly for blocks. All calls of the same owner end up on the same shard, so that cancellation by target keeps working,
+ while calls of different owners no longer share a thread, a lock and a wheel.
+ @see LSTimerThread.
+ */
+@interface LSShardedTimerThread : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates an LSShardedTimerThread with the specified name and number of shards.
+ @param name The name of the timer threads. Shards are named after it, with their index.
+ @param shardCount The number of shards, i.e. of timer threads.
+ @return The created timer.
+ @throws NSException If the name is <code>nil</code> or the number of shards is 0.
+ */
++ (nonnull LSShardedTimerThread *) timerWithName:(nonnull NSString *)name shardCount:(NSUInteger)shardCount;
+
+/**
+ @brief Initializes an LSShardedTimerThread with the specified name and number of shards.
+ @param name The name of the timer threads. Shards are named after it, with their index.
+ @param shardCount The number of shards, i.e. of timer threads.
+ @throws NSException If the name is <code>nil</code> or the number of shards is 0.
+ */
+- (nonnull instancetype) initWithName:(nonnull NSString *)name shardCount:(NSUInteger)shardCount NS_DESIGNATED_INITIALIZER;
+
+/**
+ @brief Invalid initializer, use <code>initWithName:shardCount:</code>.
+ @throws NSException Always.
+ */
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+/**
+ @brief Stops the threads of all shards. Pending calls are not made.
+ */
+- (void) dispose;
+
+
+#pragma mark -
+#pragma mark Setting and removing timers
+
+/**
+ @brief Returns the shard calls of the specified owner are assigned to.
+ @param owner The owner, compared by identity.
+ @return The shard of the owner.
+ */
+- (nonnull LSTimerThread *) shardForOwner:(nonnull id)owner;
+
+/**
+ @brief Schedules a delayed call of a block on the shard of the specified owner. See <code>performBlock:afterDelay:</code> of LSTimerThread.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay owner:(nonnull id)owner;
+
+/**
+ @brief Schedules a delayed call of a block on the shard of the specified owner, which may be deferred by up to a leeway.
+ See <code>performBlock:afterDelay:leeway:</code> of LSTimerThread.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway owner:(nonnull id)owner;
+
+/**
+ @brief Schedules a delayed call of a target and selector with an argument on the shard of the target.
+ See <code>performSelector:onTarget:withObject:afterDelay:</code> of LSTimerThread.
+ */
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target withObject:(nullable id)argument afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a delayed call of a target and selector on the shard of the target.
+ See <code>performSelector:onTarget:afterDelay:</code> of LSTimerThread.
+ */
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Cancels a previously scheduled call to the specified target and selector and with the specified argument.
+ See <code>cancelPreviousPerformRequestsWithTarget:selector:object:</code> of LSTimerThread.
+ */
+- (void) cancelPreviousPerformRequestsWithTarget:(nonnull id)target selector:(nonnull SEL)selector object:(nullable id)argument;
+
+/**
+ @brief Cancels a previously scheduled call to the specified target and selector with no arguments.
+ See <code>cancelPreviousPerformRequestsWithTarget:selector:</code> of LSTimerThread.
+ */
+- (void) cancelPreviousPerformRequestsWithTarget:(nonnull id)target selector:(nonnull SEL)selector;
+
+/**
+ @brief Cancels any previously scheduled call to the specified target.
+ See <code>cancelPreviousPerformRequestsWithTarget:</code> of LSTimerThread.
+ */
+- (void) cancelPreviousPerformRequestsWithTarget:(nonnull id)target;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The shards, i.e. the timer threads.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<LSTimerThread *> *shards;
+
+/**
+ @brief The thread pool calls of all shards are handed to as they fire. See <code>callbackPool</code> of LSTimerThread.
+ <br/> Reading it returns the pool of the first shard.
+ */
+@property (nonatomic, strong, nullable) LSThreadPool *callbackPool;
+
+/**
+ @brief The number of pending calls of all shards. See <code>pendingCount</code> of LSTimerThread.
+ */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ @brief The number of calls fired by all shards. See <code>firedCount</code> of LSTimerThread.
+ */
+@property (nonatomic, readonly) uint64_t firedCount;
+
+/**
+ @brief The number of calls cancelled on all shards. See <code>cancelledCount</code> of LSTimerThread.
+ */
+@property (nonatomic, readonly) uint64_t cancelledCount;
+
+/**
+ @brief The highest fire lateness of calls of all shards, in seconds. See <code>maxFireLateness</code> of LSTimerThread.
+ */
+@property (nonatomic, readonly) NSTimeInterval maxFireLateness;
+
+/**
+ @brief Histogram of the fire lateness of calls of all shards. See <code>fireLateness</code> of LSTimerThread.
+ */
+@property (nonatomic, readonly, nonnull) LSHistogram *fireLateness;
+
+
+@end
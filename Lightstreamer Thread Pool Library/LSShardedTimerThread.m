@@ -0,0 +1,204 @@
+//
+//  LSShardedTimerThread.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSShardedTimerThread.h"
+#import "LSTimerThread+Internals.h"
+#import "LSHistogram+Internals.h"
+
+
+#pragma mark -
+#pragma mark LSShardedTimerThread extension
+
+@interface LSShardedTimerThread () {
+    NSArray<LSTimerThread *> *_shards;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSShardedTimerThread implementation
+
+@implementation LSShardedTimerThread
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSShardedTimerThread *) timerWithName:(NSString *)name shardCount:(NSUInteger)shardCount {
+    LSShardedTimerThread *timer= [[LSShardedTimerThread alloc] initWithName:name shardCount:shardCount];
+    
+    return timer;
+}
+
+- (instancetype) initWithName:(NSString *)name shardCount:(NSUInteger)shardCount {
+    if ((self = [super init])) {
+        
+        // Initialization
+        if (!name)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Timer thread name can't be nil"
+                                         userInfo:nil];
+        
+        if (!shardCount)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Number of shards must be positive"
+                                         userInfo:nil];
+        
+        NSMutableArray<LSTimerThread *> *shards= [[NSMutableArray alloc] initWithCapacity:shardCount];
+        for (NSUInteger shard= 0; shard < shardCount; shard++)
+            [shards addObject:[[LSTimerThread alloc] initWithName:[NSString stringWithFormat:@"%@ Shard%lu", name, (unsigned long) shard]]];
+        
+        _shards= [shards copy];
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSShardedTimerThread"
+                                 userInfo:nil];
+}
+
+- (void) dispose {
+    for (LSTimerThread *shard in _shards)
+        [shard dispose];
+}
+
+
+#pragma mark -
+#pragma mark Setting and removing timers
+
+- (LSTimerThread *) shardForOwner:(id)owner {
+    if (!owner)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Owner can't be nil"
+                                     userInfo:nil];
+    
+    // Mix the address bits, the lowest ones are always zero due to alignment
+    uint64_t hash= (uint64_t) (uintptr_t) (__bridge void *) owner;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    
+    return _shards[(NSUInteger) (hash % _shards.count)];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay owner:(id)owner {
+    return [[self shardForOwner:owner] performBlock:block afterDelay:delay];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway owner:(id)owner {
+    return [[self shardForOwner:owner] performBlock:block afterDelay:delay leeway:leeway];
+}
+
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target withObject:(id)argument afterDelay:(NSTimeInterval)delay {
+    return [[self shardForOwner:target] performSelector:selector onTarget:target withObject:argument afterDelay:delay];
+}
+
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target afterDelay:(NSTimeInterval)delay {
+    return [[self shardForOwner:target] performSelector:selector onTarget:target afterDelay:delay];
+}
+
+- (void) cancelPreviousPerformRequestsWithTarget:(id)target selector:(SEL)selector object:(id)argument {
+    [[self shardForOwner:target] cancelPreviousPerformRequestsWithTarget:target selector:selector object:argument];
+}
+
+- (void) cancelPreviousPerformRequestsWithTarget:(id)target selector:(SEL)selector {
+    [[self shardForOwner:target] cancelPreviousPerformRequestsWithTarget:target selector:selector];
+}
+
+- (void) cancelPreviousPerformRequestsWithTarget:(id)target {
+    [[self shardForOwner:target] cancelPreviousPerformRequestsWithTarget:target];
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize shards= _shards;
+
+@dynamic callbackPool;
+
+- (LSThreadPool *) callbackPool {
+    return _shards[0].callbackPool;
+}
+
+- (void) setCallbackPool:(LSThreadPool *)callbackPool {
+    for (LSTimerThread *shard in _shards)
+        shard.callbackPool= callbackPool;
+}
+
+@dynamic pendingCount;
+
+- (NSUInteger) pendingCount {
+    NSUInteger pendingCount= 0;
+    for (LSTimerThread *shard in _shards)
+        pendingCount += shard.pendingCount;
+    
+    return pendingCount;
+}
+
+@dynamic firedCount;
+
+- (uint64_t) firedCount {
+    uint64_t firedCount= 0;
+    for (LSTimerThread *shard in _shards)
+        firedCount += shard.firedCount;
+    
+    return firedCount;
+}
+
+@dynamic cancelledCount;
+
+- (uint64_t) cancelledCount {
+    uint64_t cancelledCount= 0;
+    for (LSTimerThread *shard in _shards)
+        cancelledCount += shard.cancelledCount;
+    
+    return cancelledCount;
+}
+
+@dynamic maxFireLateness;
+
+- (NSTimeInterval) maxFireLateness {
+    NSTimeInterval maxFireLateness= 0.0;
+    for (LSTimerThread *shard in _shards)
+        maxFireLateness= MAX(maxFireLateness, shard.maxFireLateness);
+    
+    return maxFireLateness;
+}
+
+@dynamic fireLateness;
+
+- (LSHistogram *) fireLateness {
+    uint64_t bucketCounts[LS_HISTOGRAM_BUCKETS]= { 0 };
+    uint64_t sum= 0, max= 0;
+    
+    for (LSTimerThread *shard in _shards)
+        [shard accumulateFireLatenessBucketCounts:bucketCounts sum:&sum max:&max];
+    
+    return [[LSHistogram alloc] initWithBucketCounts:bucketCounts sum:sum max:max];
+}
+
+
+@end
@@ -0,0 +1,58 @@
+//
+//  LSThreadParker.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief The private wakeup channel of an idle LSThreadPoolThread. <b>This class should not be used directly</b>.
+ <br/> Works like a binary semaphore: an <code>unpark</code> issued before the owner parks makes the next
+ <code>park</code> return immediately, so wakeups can't be lost.
+ @see LSInvocationQueue.
+ */
+@interface LSThreadParker : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) init NS_DESIGNATED_INITIALIZER;
+
+
+#pragma mark -
+#pragma mark Parking (for internal use only)
+
+/**
+ @brief Blocks the calling thread until unparked or until the specified date. A <code>nil</code> date means no timeout.
+ @return YES if the thread has been unparked, NO if the date has been reached.
+ */
+- (BOOL) parkUntilDate:(nullable NSDate *)date;
+
+/**
+ @brief Wakes up the owner thread, or lets its next <code>park</code> return immediately.
+ */
+- (void) unpark;
+
+/**
+ @brief Discards a pending <code>unpark</code>, if any. Used by the owner only.
+ */
+- (void) clearPermit;
+
+
+@end
@@ -0,0 +1,95 @@
+//
+//  LSThreadParker.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSThreadParker.h"
+
+
+#pragma mark -
+#pragma mark LSThreadParker extension
+
+@interface LSThreadParker () {
+    NSCondition *_condition;
+    BOOL _permit;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSThreadParker implementation
+
+@implementation LSThreadParker
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) init {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _condition= [[NSCondition alloc] init];
+        _permit= NO;
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Parking
+
+- (BOOL) parkUntilDate:(NSDate *)date {
+    [_condition lock];
+    
+    // Spurious wakeups are filtered by the permit
+    while (!_permit) {
+        if (!date)
+            [_condition wait];
+        
+        else if (![_condition waitUntilDate:date])
+            break;
+    }
+    
+    BOOL unparked= _permit;
+    _permit= NO;
+    
+    [_condition unlock];
+    
+    return unparked;
+}
+
+- (void) unpark {
+    [_condition lock];
+    
+    _permit= YES;
+    [_condition signal];
+    
+    [_condition unlock];
+}
+
+- (void) clearPermit {
+    [_condition lock];
+    _permit= NO;
+    [_condition unlock];
+}
+
+
+@end
@@ -0,0 +1,51 @@
+//
+//  LSThreadPool+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSThreadPool.h"
+
+
+@class LSThreadPoolThread;
+@class LSPeriodicInvocation;
+
+
+#pragma mark -
+#pragma mark LSThreadPool Internals category
+
+@interface LSThreadPool (Internals)
+
+
+#pragma mark -
+#pragma mark Invocation scheduling (for internal use only)
+
+- (void) scheduleInvocation:(LSInvocation *)invocation priority:(LSThreadPoolPriority)priority;
+- (void) scheduleInvocation:(LSInvocation *)invocation priority:(LSThreadPoolPriority)priority shared:(BOOL)shared;
+- (void) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay;
+
+
+#pragma mark -
+#pragma mark Thread management (for internal use only)
+
+- (BOOL) retireThread:(LSThreadPoolThread *)thread;
+- (void) queueWaitDidExceedTarget;
+- (void) threadDidExit:(LSThreadPoolThread *)thread;
+- (void) periodicInvocationDidRun:(LSPeriodicInvocation *)invocation;
+
+
+@end
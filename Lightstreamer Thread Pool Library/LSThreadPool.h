@@ -21,12 +21,162 @@
 #import <Foundation/Foundation.h>
 
 #import "LSInvocation.h"
+#import "LSPeriodicInvocation.h"
+#import "LSFuture.h"
+
+
+@class LSThreadPoolConfiguration;
+@class LSThreadPoolMetrics;
+
+
+/**
+ @brief Error domain of errors produced by an LSThreadPool.
+ */
+#define LS_THREAD_POOL_ERROR_DOMAIN                        (@"LSThreadPoolDomain")
+
+/**
+ @brief Error code of a call rejected because the queue of the thread pool was full.
+ */
+#define LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL               (-1901)
+
+/**
+ @brief Error code of a queued call dropped to make room for a newer one.
+ */
+#define LS_THREAD_POOL_ERROR_CODE_DROPPED                  (-1902)
+
+
+/**
+ @brief A plain C function that may be scheduled with <code>scheduleFunction:context:</code>.
+ */
+typedef void (*LSThreadPoolFunction)(void * _Nullable context);
+
+
+/**
+ @brief Options that may be specified when creating an LSThreadPool.
+ <br/> Used by <code>initWithName:size:options:</code>.
+ */
+typedef NS_OPTIONS(NSUInteger, LSThreadPoolOptions) {
+
+    /**
+     @brief Default behavior: scheduled calls are stored in an array protected by a lock.
+     */
+    LSThreadPoolOptionNone= 0,
+
+    /**
+     @brief Scheduled calls are stored in a lock-free, multi-producer/multi-consumer ring buffer.
+     <br/> Scheduling and dequeuing calls never contend on a lock, and threads are parked only when the ring is empty.
+     This option is advisable when many threads schedule short calls at a high rate. If the ring is full, calls
+     in excess are stored in a locked overflow until the ring has free slots again. Calls are dequeued in FIFO order per
+     scheduling thread, while calls scheduled concurrently by different threads may be reordered.
+     */
+    LSThreadPoolOptionRingBufferQueue= 1 << 0,
+
+    /**
+     @brief Each thread of the pool owns a local deque, and idle threads steal calls from the deques of other threads.
+     <br/> Calls scheduled from within a running call go to the local deque of the scheduling thread, and are executed
+     by it on a last-in-first-out basis, for better cache locality. Idle threads steal calls from the other threads
+     on a first-in-first-out basis. Calls scheduled from threads not belonging to the pool go to the shared queue.
+     <br/> This option is advisable for recursive, divide-and-conquer algorithms. Note that in this mode the
+     first-in-first-served order is guaranteed only for calls scheduled from outside of the pool.
+     */
+    LSThreadPoolOptionWorkStealing= 1 << 1
+};
+
+
+/**
+ @brief Priority of a call scheduled with an LSThreadPool.
+ <br/> Used by <code>scheduleInvocationForBlock:priority:</code> and the other scheduling methods with a priority.
+ <br/> Threads execute calls of higher priority first. Calls of lower priority that have been waiting while higher
+ priorities are served get aged: after 100 ms (normal priority) or 500 ms (low priority) one of them is executed
+ before any higher priority call, so that lower priorities can't be starved.
+ */
+typedef NS_ENUM(NSUInteger, LSThreadPoolPriority) {
+    
+    /**
+     @brief Low priority, for bulk work that may be delayed.
+     */
+    LSThreadPoolPriorityLow= 0,
+    
+    /**
+     @brief Normal priority, used by scheduling methods with no priority.
+     */
+    LSThreadPoolPriorityNormal,
+    
+    /**
+     @brief High priority, for latency-critical work.
+     */
+    LSThreadPoolPriorityHigh
+};
+
+
+/**
+ @brief Policy to be used when the queue of a bounded LSThreadPool is full.
+ <br/> Specified with the <code>queueFullPolicy</code> of LSThreadPoolConfiguration.
+ */
+typedef NS_ENUM(NSUInteger, LSThreadPoolQueueFullPolicy) {
+    
+    /**
+     @brief If the queue is full an exception is thrown by the scheduling method.
+     */
+    LSThreadPoolQueueFullPolicyThrow= 0,
+    
+    /**
+     @brief If the queue is full the call is rejected: it is not executed and its <code>error</code> is set,
+     with code <code>LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL</code>. Futures fail with the same error.
+     */
+    LSThreadPoolQueueFullPolicyFail,
+    
+    /**
+     @brief If the queue is full the scheduling thread is blocked until a slot is freed, up to the <code>queueFullTimeout</code>
+     of the configuration. If the timeout expires the call is rejected as with <code>LSThreadPoolQueueFullPolicyFail</code>.
+     <br/> Calls scheduled from a thread of the pool itself are executed by the scheduling thread instead, to avoid deadlocks.
+     */
+    LSThreadPoolQueueFullPolicyBlock,
+    
+    /**
+     @brief If the queue is full the call is executed synchronously by the scheduling thread.
+     <br/> This slows down producers to the pace of the pool, without losing calls.
+     */
+    LSThreadPoolQueueFullPolicyCallerRuns,
+    
+    /**
+     @brief If the queue is full the oldest queued call of the lowest priority is dropped to make room for the new one.
+     <br/> The dropped call is rejected with code <code>LS_THREAD_POOL_ERROR_CODE_DROPPED</code>. Calls
+     scheduled with <code>scheduleFunction:context:</code> are dropped after invocations of normal priority.
+     */
+    LSThreadPoolQueueFullPolicyDropOldest
+};
+
+
+/**
+ @brief Scheduling policy of the threads of an LSThreadPool.
+ <br/> Specified with the <code>schedulingPolicy</code> of LSThreadPoolConfiguration.
+ */
+typedef NS_ENUM(NSUInteger, LSThreadPoolSchedulingPolicy) {
+    
+    /**
+     @brief Threads are scheduled as any other thread of the process.
+     */
+    LSThreadPoolSchedulingPolicyDefault= 0,
+    
+    /**
+     @brief Threads run CPU-bound, non-interactive work: <code>SCHED_BATCH</code> on Linux, utility quality of service on Apple platforms.
+     */
+    LSThreadPoolSchedulingPolicyBatch,
+    
+    /**
+     @brief Threads run only when the processor has nothing else to do: <code>SCHED_IDLE</code> on Linux, background quality of service on Apple platforms.
+     */
+    LSThreadPoolSchedulingPolicyIdle
+};
 
 
 /**
  @brief LSThreadPool provides a fixed-size thread pool for use in concurrent operations/algorithms.
- <br/> Threads are created on-demand and recycled up to 10 seconds after a call has been scheduled.
- Every 15 seconds a collector passes and disposes of threads on idle since more than 10 seconds.
+ <br/> Threads are created on-demand, only when no idle thread is available to run a scheduled call.
+ Each scheduled call wakes up at most one idle thread.
+ <br/> Idle threads wait for new calls up to 10 seconds, then retire themselves.
+ <br/> Core size, maximum size, idle timeout and adaptive growth may be specified with an LSThreadPoolConfiguration.
  */
 @interface LSThreadPool : NSObject
 
@@ -44,6 +194,28 @@
  */
 + (nonnull LSThreadPool *) poolWithName:(nonnull NSString *)name size:(NSUInteger)poolSize;
 
+/**
+ @brief Creates an LSThreadPool with the specified name, size and options.
+ @param name The name of the thread pool. Used during logging to diagnose problems.
+ @param poolSize The maximum size of the thread pool. Threads are created on-demand,
+ hence in any moment there may be up to <code>poolSize</code> threads.
+ @param options The options of the thread pool, such as the kind of queue to be used.
+ @return The created thread pool.
+ @throws NSException If the name is <code>nil</code> or the pool size is 0.
+ @see LSThreadPoolOptions.
+ */
++ (nonnull LSThreadPool *) poolWithName:(nonnull NSString *)name size:(NSUInteger)poolSize options:(LSThreadPoolOptions)options;
+
+/**
+ @brief Creates an LSThreadPool with the specified name and configuration.
+ @param name The name of the thread pool. Used during logging to diagnose problems.
+ @param configuration The configuration of the thread pool, such as its core and maximum size. It is copied.
+ @return The created thread pool.
+ @throws NSException If the name or configuration are <code>nil</code>, or the configuration is not valid.
+ @see LSThreadPoolConfiguration.
+ */
++ (nonnull LSThreadPool *) poolWithName:(nonnull NSString *)name configuration:(nonnull LSThreadPoolConfiguration *)configuration;
+
 /**
  @brief Initializes an LSThreadPool with the specified name and size.
  @param name The name of the thread pool, used when logging to diagnose problems.
@@ -51,20 +223,68 @@
  hence in any moment there may be up to <code>poolSize</code> threads.
  @throws NSException If the name is <code>nil</code> or the pool size is 0.
  */
-- (nonnull instancetype) initWithName:(nonnull NSString *)name size:(NSUInteger)poolSize NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype) initWithName:(nonnull NSString *)name size:(NSUInteger)poolSize;
 
 /**
- @brief Invalid initializer, use <code>initWithName:size:</code>.
+ @brief Initializes an LSThreadPool with the specified name, size and options.
+ @param name The name of the thread pool, used when logging to diagnose problems.
+ @param poolSize The maximum size of the thread pool. Threads are created on-demand,
+ hence in any moment there may be up to <code>poolSize</code> threads.
+ @param options The options of the thread pool, such as the kind of queue to be used.
+ @throws NSException If the name is <code>nil</code> or the pool size is 0.
+ @see LSThreadPoolOptions.
+ */
+- (nonnull instancetype) initWithName:(nonnull NSString *)name size:(NSUInteger)poolSize options:(LSThreadPoolOptions)options;
+
+/**
+ @brief Initializes an LSThreadPool with the specified name and configuration.
+ @param name The name of the thread pool, used when logging to diagnose problems.
+ @param configuration The configuration of the thread pool, such as its core and maximum size. It is copied.
+ @throws NSException If the name or configuration are <code>nil</code>, or the configuration is not valid.
+ @see LSThreadPoolConfiguration.
+ */
+- (nonnull instancetype) initWithName:(nonnull NSString *)name configuration:(nonnull LSThreadPoolConfiguration *)configuration NS_DESIGNATED_INITIALIZER;
+
+/**
+ @brief Invalid initializer, use <code>initWithName:size:</code>, <code>initWithName:size:options:</code> or <code>initWithName:configuration:</code>.
  @throws NSException Always.
  */
 - (nonnull instancetype) init NS_UNAVAILABLE;
 
 /**
  @brief Disposes of any active thread and makes the thread pool no more usable.
- <br/> After a call to <code>dispose</code> no more scheduled calls will be accepted.
+ <br/> After a call to <code>dispose</code> no more scheduled calls will be accepted. Equivalent to <code>shutdownNow</code>:
+ calls not yet started are cancelled.
  */
 - (void) dispose;
 
+/**
+ @brief Shuts down the thread pool gracefully: no more scheduled calls will be accepted, while calls already in the queue are run.
+ <br/> Delayed calls not yet due and periodic calls are cancelled. Threads exit once the queue is empty. Use <code>awaitTerminationWithTimeout:</code> to wait for them.
+ */
+- (void) shutdown;
+
+/**
+ @brief Shuts down the thread pool discarding its queue: no more scheduled calls will be accepted, and calls not yet started are cancelled.
+ <br/> Calls being run are not interrupted: threads exit as soon as they are done with them. Use <code>awaitTerminationWithTimeout:</code> to wait for them.
+ @return The calls that have been cancelled, e.g. to be scheduled elsewhere.
+ */
+- (nonnull NSArray<LSInvocation *> *) shutdownNow;
+
+/**
+ @brief Waits for all the threads of a shut down pool to exit, up to the specified timeout.
+ @param timeout The maximum time to wait, in seconds.
+ @return YES if the pool has terminated, NO if the timeout expired or the pool has not been shut down.
+ */
+- (BOOL) awaitTerminationWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ @brief Starts all the core threads of the pool that have not been started yet.
+ <br/> Use it to avoid paying the thread creation latency when the first calls are scheduled.
+ @return The number of threads started.
+ */
+- (NSUInteger) prestartCoreThreads;
+
 
 #pragma mark -
 #pragma mark Invocation scheduling
@@ -78,7 +298,7 @@
  @return A descriptor of the scheduled call.
  <br/> May be used to wait for its completion.
  @throws NSException If the block is <code>nil</code>.
- @throws NSException If the thread pool has already been disposed of.
+ @throws NSException If the thread pool has already been shut down or disposed of.
  */
 - (nonnull LSInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block;
 
@@ -93,7 +313,7 @@
  @return A descriptor of the scheduled call.
  <br/> May be used to wait for its completion.
  @throws NSException If the target or selector are <code>nil</code>.
- @throws NSException If the thread pool has already been disposed of.
+ @throws NSException If the thread pool has already been shut down or disposed of.
  */
 - (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector;
 
@@ -109,10 +329,288 @@
  @return A descriptor of the scheduled call.
  <br/> May be used to wait for its completion.
  @throws NSException If the target or selector are <code>nil</code>.
- @throws NSException If the thread pool has already been disposed of.
+ @throws NSException If the thread pool has already been shut down or disposed of.
  */
 - (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object;
 
+/**
+ @brief Schedules a call to the specified block with the specified priority.
+ <br/> If the current size of the thread pool is less than <code>poolSize</code>, a new thread is
+ created and the call is executed immediately. Otherwise the call is stored in the queue of its priority
+ and will be executed after calls of higher priority, on a first-in-first-served basis.
+ @param block The block to be executed.
+ @param priority The priority of the call.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the block is <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ @see LSThreadPoolPriority.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block priority:(LSThreadPoolPriority)priority;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified priority.
+ <br/> The selector (method signature) must have no arguments.
+ <br/> If the current size of the thread pool is less than <code>poolSize</code>, a new thread is
+ created and the call is executed immediately. Otherwise the call is stored in the queue of its priority
+ and will be executed after calls of higher priority, on a first-in-first-served basis.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param priority The priority of the call.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ @see LSThreadPoolPriority.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector priority:(LSThreadPoolPriority)priority;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified argument and priority.
+ <br/> The selector (method signature) must have exactly one argument.
+ <br/> If the current size of the thread pool is less than <code>poolSize</code>, a new thread is
+ created and the call is executed immediately. Otherwise the call is stored in the queue of its priority
+ and will be executed after calls of higher priority, on a first-in-first-served basis.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param object The argument of the selector to be called. A <code>nil</code> is accepted.
+ @param priority The priority of the call.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ @see LSThreadPoolPriority.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object priority:(LSThreadPoolPriority)priority;
+
+
+#pragma mark -
+#pragma mark Typed invocation scheduling
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified two arguments.
+ <br/> The selector (method signature) must have exactly two object arguments. The method implementation
+ is resolved once, when the call is scheduled.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param object The first argument of the selector to be called. A <code>nil</code> is accepted.
+ @param secondObject The second argument of the selector to be called. A <code>nil</code> is accepted.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object withObject:(nullable id)secondObject;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified integer argument.
+ <br/> The selector (method signature) must have exactly one argument of type <code>NSInteger</code>. The argument
+ is passed as is, with no boxing, and the method implementation is resolved once, when the call is scheduled.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param value The argument of the selector to be called.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withInteger:(NSInteger)value;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified double argument.
+ <br/> The selector (method signature) must have exactly one argument of type <code>double</code> (or <code>NSTimeInterval</code>).
+ The argument is passed as is, with no boxing, and the method implementation is resolved once, when the call is scheduled.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param value The argument of the selector to be called.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withDouble:(double)value;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified pointer argument.
+ <br/> The selector (method signature) must have exactly one argument of a (non-object) pointer type. Memory
+ management of the pointed data is up to the caller. The method implementation is resolved once, when the call is scheduled.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param pointer The argument of the selector to be called. A <code>NULL</code> is accepted.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withPointer:(nullable void *)pointer;
+
+
+#pragma mark -
+#pragma mark Delayed and periodic scheduling
+
+/**
+ @brief Schedules a call to the specified block, to be executed after the specified delay.
+ <br/> Delayed calls are kept by the pool ordered by deadline, and when due are run before any queued call by
+ the first thread looking for work. While delayed calls are pending one idle thread, if any, waits just until the earliest is due,
+ so that no timer thread is involved. Delayed calls don't count toward <code>queueSize</code> nor <code>queueCapacity</code>.
+ @param block The block to be executed.
+ @param delay The delay, in seconds, after which the block is executed. Negative delays are treated as 0.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion, or to cancel it: cancellation takes constant time, the call is just skipped when due.
+ @throws NSException If the block is <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a call to the specified target and selector, to be executed after the specified delay.
+ <br/> The selector (method signature) must have no arguments.
+ <br/> The call is scheduled as with <code>scheduleInvocationForBlock:afterDelay:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param delay The delay, in seconds, after which the selector is called. Negative delays are treated as 0.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion, or to cancel it.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified argument, to be executed after the specified delay.
+ <br/> The selector (method signature) must have exactly one argument.
+ <br/> The call is scheduled as with <code>scheduleInvocationForBlock:afterDelay:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param object The argument of the selector to be called. A <code>nil</code> is accepted.
+ @param delay The delay, in seconds, after which the selector is called. Negative delays are treated as 0.
+ @return A descriptor of the scheduled call.
+ <br/> May be used to wait for its completion, or to cancel it.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a call to the specified block, to be executed repeatedly at a fixed rate after the specified initial delay.
+ <br/> Runs are due every <code>period</code> seconds from the first one. A run is never started before the previous one
+ has ended: late runs are executed back to back until the schedule is caught up.
+ <br/> Each run is dispatched as a delayed call, see <code>scheduleInvocationForBlock:afterDelay:</code>.
+ @param block The block to be executed.
+ @param initialDelay The delay, in seconds, of the first run.
+ @param period The period, in seconds, between the start of two runs.
+ @return A descriptor of the periodic call, which must be cancelled to stop it.
+ @throws NSException If the block is <code>nil</code> or the period is not greater than 0.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSPeriodicInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period;
+
+/**
+ @brief Schedules a call to the specified block, to be executed repeatedly with a fixed delay after the specified initial delay.
+ <br/> Each run is due <code>delay</code> seconds after the end of the previous one.
+ <br/> Each run is dispatched as a delayed call, see <code>scheduleInvocationForBlock:afterDelay:</code>.
+ @param block The block to be executed.
+ @param initialDelay The delay, in seconds, of the first run.
+ @param delay The delay, in seconds, between the end of a run and the start of the next one.
+ @return A descriptor of the periodic call, which must be cancelled to stop it.
+ @throws NSException If the block is <code>nil</code> or the delay is not greater than 0.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSPeriodicInvocation *) scheduleInvocationForBlock:(nonnull LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a call to the specified target and selector, to be executed repeatedly at a fixed rate after the specified initial delay.
+ <br/> The selector (method signature) must have no arguments.
+ <br/> The call is scheduled as with <code>scheduleInvocationForBlock:initialDelay:fixedRate:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param initialDelay The delay, in seconds, of the first run.
+ @param period The period, in seconds, between the start of two runs.
+ @return A descriptor of the periodic call, which must be cancelled to stop it.
+ @throws NSException If the target or selector are <code>nil</code>, or the period is not greater than 0.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSPeriodicInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period;
+
+/**
+ @brief Schedules a call to the specified target and selector, to be executed repeatedly with a fixed delay after the specified initial delay.
+ <br/> The selector (method signature) must have no arguments.
+ <br/> The call is scheduled as with <code>scheduleInvocationForBlock:initialDelay:fixedDelay:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param initialDelay The delay, in seconds, of the first run.
+ @param delay The delay, in seconds, between the end of a run and the start of the next one.
+ @return A descriptor of the periodic call, which must be cancelled to stop it.
+ @throws NSException If the target or selector are <code>nil</code>, or the delay is not greater than 0.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSPeriodicInvocation *) scheduleInvocationForTarget:(nonnull id)target selector:(nonnull SEL)selector initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)delay;
+
+
+#pragma mark -
+#pragma mark Future scheduling
+
+/**
+ @brief Schedules a call to the specified block, returning a future of its result.
+ <br/> The call is scheduled as with <code>scheduleInvocationForBlock:</code>.
+ @param block The block to be executed. Its return value becomes the result of the future.
+ If the block raises an exception, the future fails with an error of domain <code>LS_FUTURE_ERROR_DOMAIN</code>.
+ @return The future of the block's result.
+ <br/> May be used to attach continuations or to wait for its completion.
+ @throws NSException If the block is <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSFuture *) scheduleFutureForBlock:(nonnull LSFutureBlock)block;
+
+/**
+ @brief Schedules a call to the specified target and selector, returning a future of its result.
+ <br/> The selector (method signature) must have no arguments and must return an object.
+ <br/> The call is scheduled as with <code>scheduleInvocationForTarget:selector:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @return The future of the selector's return value.
+ <br/> May be used to attach continuations or to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSFuture *) scheduleFutureForTarget:(nonnull id)target selector:(nonnull SEL)selector;
+
+/**
+ @brief Schedules a call to the specified target and selector with the specified argument, returning a future of its result.
+ <br/> The selector (method signature) must have exactly one argument and must return an object.
+ <br/> The call is scheduled as with <code>scheduleInvocationForTarget:selector:withObject:</code>.
+ @param target The target of the call.
+ @param selector The selector of the target to be called.
+ @param object The argument of the selector to be called. A <code>nil</code> is accepted.
+ @return The future of the selector's return value.
+ <br/> May be used to attach continuations or to wait for its completion.
+ @throws NSException If the target or selector are <code>nil</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ */
+- (nonnull LSFuture *) scheduleFutureForTarget:(nonnull id)target selector:(nonnull SEL)selector withObject:(nullable id)object;
+
+
+#pragma mark -
+#pragma mark Function scheduling
+
+/**
+ @brief Schedules a call to the specified C function with the specified context, with normal priority.
+ <br/> Unlike the other scheduling methods, no object is created: the call is stored in a record taken
+ from a per-thread free list and given back once executed, so that in steady state scheduling allocates nothing.
+ On the other hand, there is no descriptor to wait for completion or to cancel the call. Calls still
+ in the queue when the thread pool is shut down with <code>shutdownNow</code> are dropped.
+ <br/> The queue-full policy applies as usual: with LSThreadPoolQueueFullPolicyCallerRuns the function is
+ called on the caller thread, while with LSThreadPoolQueueFullPolicyDropOldest the oldest queued call is dropped:
+ if it is a function call too, it is discarded silently.
+ @param function The function to be called.
+ @param context The argument passed to the function. Its memory management is up to the caller.
+ @return YES if the call has been scheduled or executed on the caller thread, NO if it has been rejected because the queue is full.
+ @throws NSException If the function is <code>NULL</code>.
+ @throws NSException If the thread pool has already been shut down or disposed of.
+ @throws NSException If the queue is full and the queue-full policy is LSThreadPoolQueueFullPolicyThrow.
+ */
+- (BOOL) scheduleFunction:(nonnull LSThreadPoolFunction)function context:(nullable void *)context;
+
 
 #pragma mark -
 #pragma mark Properties
@@ -122,5 +620,90 @@
  */
 @property (nonatomic, readonly) NSUInteger queueSize;
 
+/**
+ @brief The current size of the scheduled calls queue for the specified priority.
+ @param priority The priority of the scheduled calls.
+ @return The number of scheduled calls of the specified priority waiting to be executed.
+ */
+- (NSUInteger) queueSizeForPriority:(LSThreadPoolPriority)priority;
+
+/**
+ @brief The current number of delayed and periodic calls waiting to be due.
+ <br/> Cancelled calls are counted until their deadline, when they are skipped.
+ */
+@property (nonatomic, readonly) NSUInteger delayedQueueSize;
+
+/**
+ @brief The options specified when the thread pool was initialized.
+ */
+@property (nonatomic, readonly) LSThreadPoolOptions options;
+
+/**
+ @brief A copy of the configuration specified when the thread pool was initialized.
+ <br/> If the pool was initialized with a size, the configuration has that size as maximum size and no core threads.
+ */
+@property (nonatomic, readonly, nonnull) LSThreadPoolConfiguration *configuration;
+
+/**
+ @brief The current number of threads of the pool.
+ */
+@property (nonatomic, readonly) NSUInteger currentSize;
+
+/**
+ @brief If the pool has been shut down or disposed of, and accepts no more scheduled calls.
+ */
+@property (nonatomic, readonly, getter=isShutDown) BOOL shutDown;
+
+/**
+ @brief If the pool has been shut down and all its threads have exited.
+ */
+@property (nonatomic, readonly, getter=isTerminated) BOOL terminated;
+
+/**
+ @brief The maximum number of calls that may wait in the queue, or 0 if the queue is unbounded.
+ <br/> Calls scheduled from within the pool with the <code>LSThreadPoolOptionWorkStealing</code> option go to local deques and are not counted.
+ */
+@property (nonatomic, readonly) NSUInteger queueCapacity;
+
+/**
+ @brief The policy in effect when the queue is full.
+ */
+@property (nonatomic, readonly) LSThreadPoolQueueFullPolicy queueFullPolicy;
+
+/**
+ @brief The number of calls rejected because the queue was full, including those that timed out while blocked
+ and those that caused an exception to be thrown.
+ */
+@property (nonatomic, readonly) NSUInteger rejectedCount;
+
+/**
+ @brief The number of queued calls dropped to make room for newer ones.
+ */
+@property (nonatomic, readonly) NSUInteger droppedCount;
+
+/**
+ @brief The number of calls executed by the scheduling thread because the queue was full.
+ */
+@property (nonatomic, readonly) NSUInteger callerRunsCount;
+
+/**
+ @brief The number of batches of calls threads have taken from the queue, since the pool was created.
+ @see <code>batchSize</code> of LSThreadPoolConfiguration.
+ */
+@property (nonatomic, readonly) uint64_t batchCount;
+
+/**
+ @brief The average number of calls per batch taken from the queue, i.e. the effective batch size. 0 if no batch has been taken yet.
+ @see <code>batchSize</code> of LSThreadPoolConfiguration.
+ */
+@property (nonatomic, readonly) double averageBatchSize;
+
+/**
+ @brief A snapshot of the runtime metrics of the pool, such as histograms of queue wait and execution time.
+ <br/> Metrics are <code>nil</code> unless enabled with the <code>metricsEnabled</code> property of the configuration.
+ @see LSThreadPoolMetrics.
+ */
+@property (nonatomic, readonly, nullable) LSThreadPoolMetrics *metrics;
+
 
 @end
@@ -19,17 +19,36 @@
 //
 
 #import "LSThreadPool.h"
+#import "LSThreadPool+Internals.h"
+#import "LSThreadPoolConfiguration.h"
 #import "LSThreadPoolThread.h"
+#import "LSThreadPoolMetrics.h"
+#import "LSThreadPoolMetrics+Internals.h"
+#import "LSThreadPoolMetricsRecorder.h"
 #import "LSInvocation.h"
 #import "LSInvocation+Internals.h"
-#import "LSTimerThread.h"
+#import "LSPeriodicInvocation.h"
+#import "LSPeriodicInvocation+Internals.h"
+#import "LSFuture.h"
+#import "LSFuture+Internals.h"
+#import "LSInvocationQueue.h"
+#import "LSInvocationDeque.h"
+#import "LSInvocationArrayBuffer.h"
+#import "LSInvocationRingBuffer.h"
+#import "LSFunctionRecord.h"
+#import "LSCPUTopology.h"
+#import "LSMonotonicClock.h"
+#import "LSTrace+Internals.h"
 #import "LSLog.h"
 #import "LSLog+Internals.h"
 
-#define MAX_THREAD_IDLENESS                                (10.0)
-#define THREAD_COLLECTOR_DELAY                             (15.0)
+#import <stdatomic.h>
+
+#define RING_BUFFER_CAPACITY                               (1024)
+#define STACK_SIZE_GRANULARITY                             (4096)
 
 #define LS_THREAD_POOL_DISPOSED_OF                         (@"LSThreadPoolDisposedOf")
+#define LS_THREAD_POOL_QUEUE_FULL                          (@"LSThreadPoolQueueFull")
 
 
 #pragma mark -
@@ -37,28 +56,75 @@
 
 @interface LSThreadPool () {
     NSString *_name;
-    NSUInteger _size;
+    LSThreadPoolConfiguration *_configuration;
+    NSUInteger _coreSize;
+    NSUInteger _maxSize;
+    LSThreadPoolOptions _options;
     
     NSMutableArray<LSThreadPoolThread *> *_threads;
+    atomic_size_t _threadCount;
+    
+    // Equal to max size, unless adaptive growth is enabled
+    atomic_size_t _sizeLimit;
+    NSUInteger _minSizeLimit;
+    BOOL _adaptive;
+    
+    // Growth steps are at least a target queue wait apart
+    uint64_t _growthInterval;
+    atomic_uint_fast64_t _lastGrowthTime;
+    
+    LSInvocationQueue *_invocationQueue;
+    LSThreadPoolQueueFullPolicy _queueFullPolicy;
+    NSTimeInterval _queueFullTimeout;
+    
+    atomic_size_t _rejectedCount;
+    atomic_size_t _droppedCount;
+    atomic_size_t _callerRunsCount;
+    
+    // Metrics of threads no more in the pool are added to a single recorder
+    BOOL _metricsEnabled;
+    atomic_uint_fast64_t _submittedCount;
+    uint64_t _threadsCreatedCount;
+    uint64_t _threadsRetiredCount;
+    LSThreadPoolMetricsRecorder *_exitedMetrics;
     
-    NSMutableArray<LSInvocation *> *_invocationQueue;
-    NSCondition *_monitor;
+    // Batch counters of threads no more in the pool
+    uint64_t _exitedBatchCount;
+    uint64_t _exitedBatchedInvocationCount;
     
     int _nextThreadId;
     BOOL _disposed;
+    
+    NSCondition *_terminationMonitor;
 }
 
 
 #pragma mark -
 #pragma mark Internal
 
-- (void) scheduleInvocation:(LSInvocation *)invocation;
+- (LSThreadPoolThread *) currentPoolThread;
+
+
+#pragma mark -
+#pragma mark Bounded queue
+
+- (BOOL) admitInvocation:(LSInvocation *)invocation;
+- (void) runInvocationOnCallerThread:(LSInvocation *)invocation;
+- (void) rejectInvocation:(LSInvocation *)invocation code:(NSInteger)code;
 
 
 #pragma mark -
 #pragma mark Thread management
 
-- (void) collectIdleThreads;
+- (BOOL) startNewThreadIfBelowSize;
+- (LSThreadPoolThread *) newThread;
+- (NSIndexSet *) cpuSetForThreadNumber:(int)threadNumber;
+
+
+#pragma mark -
+#pragma mark Priority lanes
+
+- (NSUInteger) laneForPriority:(LSThreadPoolPriority)priority;
 
 
 @end
@@ -79,24 +145,115 @@
     return pool;
 }
 
++ (LSThreadPool *) poolWithName:(NSString *)name size:(NSUInteger)poolSize options:(LSThreadPoolOptions)options {
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:name size:poolSize options:options];
+    
+    return pool;
+}
+
++ (LSThreadPool *) poolWithName:(NSString *)name configuration:(LSThreadPoolConfiguration *)configuration {
+    LSThreadPool *pool= [[LSThreadPool alloc] initWithName:name configuration:configuration];
+    
+    return pool;
+}
+
 - (instancetype) initWithName:(NSString *)name size:(NSUInteger)poolSize {
+    return [self initWithName:name size:poolSize options:LSThreadPoolOptionNone];
+}
+
+- (instancetype) initWithName:(NSString *)name size:(NSUInteger)poolSize options:(LSThreadPoolOptions)options {
+    if (!poolSize)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Thread pool name can't be nil and pool size must be greater than 0"
+                                     userInfo:nil];
+
+    LSThreadPoolConfiguration *configuration= [[LSThreadPoolConfiguration alloc] initWithMaxSize:poolSize];
+    configuration.options= options;
+    
+    return [self initWithName:name configuration:configuration];
+}
+
+- (instancetype) initWithName:(NSString *)name configuration:(LSThreadPoolConfiguration *)configuration {
     if ((self = [super init])) {
         
         // Initialization
-        if ((!name) || (!poolSize))
+        if ((!name) || (!configuration))
             @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                           reason:@"Thread pool name can't be nil and pool size must be greater than 0"
+                                           reason:@"Thread pool name and configuration can't be nil"
                                          userInfo:nil];
         
+        if ((!configuration.maxSize) || (configuration.coreSize > configuration.maxSize))
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool max size must be greater than 0 and not less than core size"
+                                         userInfo:@{@"coreSize": @(configuration.coreSize),
+                                                    @"maxSize": @(configuration.maxSize)}];
+        
+        if ((configuration.idleTimeout <= 0.0) || (configuration.targetQueueWait < 0.0))
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool idle timeout must be greater than 0 and target queue wait can't be negative"
+                                         userInfo:@{@"idleTimeout": @(configuration.idleTimeout),
+                                                    @"targetQueueWait": @(configuration.targetQueueWait)}];
+        
+        if (configuration.queueFullTimeout < 0.0)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool queue full timeout can't be negative"
+                                         userInfo:@{@"queueFullTimeout": @(configuration.queueFullTimeout)}];
+        
+        if ((!configuration.batchSize) || (configuration.autoreleaseDrainInterval < 0.0))
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Thread pool batch size must be greater than 0 and autorelease drain interval can't be negative"
+                                         userInfo:@{@"batchSize": @(configuration.batchSize),
+                                                    @"autoreleaseDrainInterval": @(configuration.autoreleaseDrainInterval)}];
+        
         _name= name;
-        _size= poolSize;
+        _configuration= [configuration copy];
+        _coreSize= _configuration.coreSize;
+        _maxSize= _configuration.maxSize;
+        _options= _configuration.options;
+        
+        _threads= [[NSMutableArray alloc] initWithCapacity:_maxSize];
+        atomic_init(&_threadCount, 0);
+        
+        // With adaptive growth, start from the core size and grow only when needed
+        _adaptive= (_configuration.targetQueueWait > 0.0);
+        _minSizeLimit= _adaptive ? MAX(_coreSize, 1) : _maxSize;
+        atomic_init(&_sizeLimit, _minSizeLimit);
+        
+        _growthInterval= (uint64_t) (_configuration.targetQueueWait * 1000000000.0);
+        atomic_init(&_lastGrowthTime, 0);
+        
+        // Choose the queue buffers according to options, one per priority
+        NSMutableArray<id <LSInvocationBuffer>> *buffers= [[NSMutableArray alloc] initWithCapacity:LS_INVOCATION_QUEUE_LANES];
+        for (int i= 0; i < LS_INVOCATION_QUEUE_LANES; i++) {
+            if (_options & LSThreadPoolOptionRingBufferQueue)
+                [buffers addObject:[[LSInvocationRingBuffer alloc] initWithCapacity:RING_BUFFER_CAPACITY]];
+            else
+                [buffers addObject:[[LSInvocationArrayBuffer alloc] init]];
+        }
         
-        _threads= [[NSMutableArray alloc] initWithCapacity:_size];
+        _invocationQueue= [[LSInvocationQueue alloc] initWithBuffers:buffers
+                                                            capacity:_configuration.queueCapacity
+                                                        workStealing:((_options & LSThreadPoolOptionWorkStealing) != 0)];
         
-        _invocationQueue= [[NSMutableArray alloc] init];
-        _monitor= [[NSCondition alloc] init];
+        _queueFullPolicy= _configuration.queueFullPolicy;
+        _queueFullTimeout= _configuration.queueFullTimeout;
+        
+        atomic_init(&_rejectedCount, 0);
+        atomic_init(&_droppedCount, 0);
+        atomic_init(&_callerRunsCount, 0);
+        
+        _metricsEnabled= _configuration.metricsEnabled;
+        atomic_init(&_submittedCount, 0);
+        _threadsCreatedCount= 0;
+        _threadsRetiredCount= 0;
+        _exitedMetrics= _metricsEnabled ? [[LSThreadPoolMetricsRecorder alloc] init] : nil;
+        
+        _exitedBatchCount= 0;
+        _exitedBatchedInvocationCount= 0;
         
         _nextThreadId= 1;
+        
+        _terminationMonitor= [[NSCondition alloc] init];
     }
     
     return self;
@@ -109,18 +266,94 @@
 }
 
 - (void) dispose {
-    _disposed= YES;
+    [self shutdownNow];
+}
 
+- (void) shutdown {
     @synchronized (self) {
-        for (LSThreadPoolThread *thread in _threads)
+        if (_disposed)
+            return;
+        
+        _disposed= YES;
+    }
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"shutting down pool %@, %lu calls left to run", _name, (unsigned long) _invocationQueue.count];
+    
+    // Delayed calls not yet due would keep threads waiting: they are cancelled
+    for (LSInvocation *invocation in [_invocationQueue removeAllDelayedInvocations])
+        [invocation cancel];
+    
+    // Threads keep on running queued calls, and exit when the queue is empty
+    [_invocationQueue dispose];
+}
+
+- (NSArray<LSInvocation *> *) shutdownNow {
+    NSMutableArray<LSInvocation *> *notStarted= [[NSMutableArray alloc] init];
+    
+    @synchronized (self) {
+        _disposed= YES;
+        
+        // Threads exit as soon as they are done with the current call,
+        // calls of their batches not yet started are taken back
+        for (LSThreadPoolThread *thread in _threads) {
             [thread dispose];
+            
+            [notStarted addObjectsFromArray:[thread removeBatchedInvocations]];
+        }
+    }
+    
+    [_invocationQueue dispose];
+    
+    [notStarted addObjectsFromArray:[_invocationQueue removeAllInvocations]];
+    
+    // Calls not yet started are cancelled, so that nobody waits for them in vain
+    NSMutableArray<LSInvocation *> *cancelled= [[NSMutableArray alloc] init];
+    for (LSInvocation *invocation in notStarted) {
+        if ([invocation cancel])
+            [cancelled addObject:invocation];
+    }
+    
+    if (cancelled.count > 0)
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"shut down pool %@, cancelled %lu calls", _name, (unsigned long) cancelled.count];
+    
+    return cancelled;
+}
 
-        [_threads removeAllObjects];
+- (BOOL) awaitTerminationWithTimeout:(NSTimeInterval)timeout {
+    NSDate *limit= [NSDate dateWithTimeIntervalSinceNow:timeout];
+    BOOL terminated= NO;
+    
+    // Check under the monitor lock, or the broadcast of the last thread may be lost
+    [_terminationMonitor lock];
+    
+    while (!(terminated= self.terminated)) {
+        if (![_terminationMonitor waitUntilDate:limit]) {
+            terminated= self.terminated;
+            break;
+        }
     }
+    
+    [_terminationMonitor unlock];
+    
+    return terminated;
+}
 
-    [_monitor lock];
-    [_monitor broadcast];
-    [_monitor unlock];
+- (NSUInteger) prestartCoreThreads {
+    NSUInteger started= 0;
+    
+    while (YES) {
+        @synchronized (self) {
+            if (_threads.count >= _coreSize)
+                break;
+        }
+        
+        if (![self startNewThreadIfBelowSize])
+            break;
+        
+        started++;
+    }
+    
+    return started;
 }
 
 - (void) dealloc {
@@ -132,115 +365,634 @@
 #pragma mark Invocation scheduling
 
 - (LSInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block {
+    return [self scheduleInvocationForBlock:block priority:LSThreadPoolPriorityNormal];
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector {
+    return [self scheduleInvocationForTarget:target selector:selector priority:LSThreadPoolPriorityNormal];
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object {
+    return [self scheduleInvocationForTarget:target selector:selector withObject:object priority:LSThreadPoolPriorityNormal];
+}
+
+- (LSInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block priority:(LSThreadPoolPriority)priority {
     LSInvocation *invocation= [LSInvocation invocationWithBlock:block];
     
-    [self scheduleInvocation:invocation];
+    [self scheduleInvocation:invocation priority:priority];
     return invocation;
 }
 
-- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector {
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector priority:(LSThreadPoolPriority)priority {
     LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector];
     
-    [self scheduleInvocation:invocation];
+    [self scheduleInvocation:invocation priority:priority];
     return invocation;
 }
 
-- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object {
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object priority:(LSThreadPoolPriority)priority {
     LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:object];
     
-    [self scheduleInvocation:invocation];
+    [self scheduleInvocation:invocation priority:priority];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object withObject:(id)secondObject {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:object secondArgument:secondObject];
+    
+    [self scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withInteger:(NSInteger)value {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector integerArgument:value];
+    
+    [self scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withDouble:(double)value {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector doubleArgument:value];
+    
+    [self scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withPointer:(void *)pointer {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector pointerArgument:pointer];
+    
+    [self scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
     return invocation;
 }
 
 
+#pragma mark -
+#pragma mark Delayed and periodic scheduling
+
+- (LSInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay {
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:block];
+    
+    [self scheduleInvocation:invocation afterDelay:delay];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector afterDelay:(NSTimeInterval)delay {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector];
+    
+    [self scheduleInvocation:invocation afterDelay:delay];
+    return invocation;
+}
+
+- (LSInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector withObject:(id)object afterDelay:(NSTimeInterval)delay {
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:object];
+    
+    [self scheduleInvocation:invocation afterDelay:delay];
+    return invocation;
+}
+
+- (LSPeriodicInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period {
+    LSPeriodicInvocation *invocation= [[LSPeriodicInvocation alloc] initWithBlock:block period:period fixedRate:YES];
+    
+    [self scheduleInvocation:invocation afterDelay:initialDelay];
+    return invocation;
+}
+
+- (LSPeriodicInvocation *) scheduleInvocationForBlock:(LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)delay {
+    LSPeriodicInvocation *invocation= [[LSPeriodicInvocation alloc] initWithBlock:block period:delay fixedRate:NO];
+    
+    [self scheduleInvocation:invocation afterDelay:initialDelay];
+    return invocation;
+}
+
+- (LSPeriodicInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period {
+    LSPeriodicInvocation *invocation= [[LSPeriodicInvocation alloc] initWithTarget:target selector:selector period:period fixedRate:YES];
+    
+    [self scheduleInvocation:invocation afterDelay:initialDelay];
+    return invocation;
+}
+
+- (LSPeriodicInvocation *) scheduleInvocationForTarget:(id)target selector:(SEL)selector initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)delay {
+    LSPeriodicInvocation *invocation= [[LSPeriodicInvocation alloc] initWithTarget:target selector:selector period:delay fixedRate:NO];
+    
+    [self scheduleInvocation:invocation afterDelay:initialDelay];
+    return invocation;
+}
+
+
+#pragma mark -
+#pragma mark Future scheduling
+
+- (LSFuture *) scheduleFutureForBlock:(LSFutureBlock)block {
+    if (!block)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Block can't be nil"
+                                     userInfo:nil];
+    
+    LSFuture *future= [LSFuture future];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:^{
+        [future completeWithBlock:block];
+    }];
+    
+    // With a bounded queue the invocation may be rejected
+    invocation.rejectionHandler= ^(NSError *error) {
+        [future failWithError:error];
+    };
+    
+    [self scheduleInvocation:invocation priority:LSThreadPoolPriorityNormal];
+    
+    return future;
+}
+
+- (LSFuture *) scheduleFutureForTarget:(id)target selector:(SEL)selector {
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
+    
+    // Find method implementation once, the block calls it directly
+    IMP imp= [target methodForSelector:selector];
+    
+    return [self scheduleFutureForBlock:^id {
+        id (*func)(id, SEL)= (void *) imp;
+        return func(target, selector);
+    }];
+}
+
+- (LSFuture *) scheduleFutureForTarget:(id)target selector:(SEL)selector withObject:(id)object {
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
+    
+    // Find method implementation once, the block calls it directly
+    IMP imp= [target methodForSelector:selector];
+    
+    return [self scheduleFutureForBlock:^id {
+        id (*func)(id, SEL, id)= (void *) imp;
+        return func(target, selector, object);
+    }];
+}
+
+
+#pragma mark -
+#pragma mark Function scheduling
+
+- (BOOL) scheduleFunction:(LSThreadPoolFunction)function context:(void *)context {
+    if (!function)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Function can't be NULL"
+                                     userInfo:nil];
+    
+    if (_disposed)
+        @throw [NSException exceptionWithName:LS_THREAD_POOL_DISPOSED_OF
+                                       reason:@"Can't schedule function: thread pool has already been shut down or disposed of"
+                                     userInfo:@{@"threadPoolName": _name}];
+    
+    if (_metricsEnabled)
+        atomic_fetch_add_explicit(&_submittedCount, 1, memory_order_relaxed);
+    
+    if (![_invocationQueue reserveSlot]) {
+        
+        // Queue full: this is the slow path anyway, so policies are applied to an invocation wrapping the call
+        LSInvocation *invocation= [LSInvocation invocationWithBlock:^{
+            function(context);
+        }];
+        
+        if (![self admitInvocation:invocation])
+            return (invocation.error == nil);
+    }
+    
+    LSFunctionRecord *record= LSFunctionRecordAcquire();
+    record->function= function;
+    record->context= context;
+    
+    // Track the queue wait, needed for adaptive growth and metrics
+    if (_adaptive || _metricsEnabled)
+        record->enqueueTime= LSMonotonicNanoseconds();
+    
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeCallEnqueued, record, NULL, (uint64_t) (uintptr_t) function);
+    
+    // Add record to queue, a parked thread is woken up if there's one
+    if ([_invocationQueue enqueueFunctionRecord:record])
+        return YES;
+    
+    // No parked thread: if there's room, create a new one
+    if (atomic_load_explicit(&_threadCount, memory_order_relaxed) < atomic_load_explicit(&_sizeLimit, memory_order_relaxed))
+        [self startNewThreadIfBelowSize];
+    
+    return YES;
+}
+
+
 #pragma mark -
 #pragma mark Internals
 
-- (void) scheduleInvocation:(LSInvocation *)invocation {
+- (void) scheduleInvocation:(LSInvocation *)invocation priority:(LSThreadPoolPriority)priority {
+    [self scheduleInvocation:invocation priority:priority shared:NO];
+}
+
+- (void) scheduleInvocation:(LSInvocation *)invocation priority:(LSThreadPoolPriority)priority shared:(BOOL)shared {
+    if (priority > LSThreadPoolPriorityHigh)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Invalid priority"
+                                     userInfo:@{@"priority": @(priority)}];
+    
     if (_disposed)
         @throw [NSException exceptionWithName:LS_THREAD_POOL_DISPOSED_OF
-                                       reason:@"Can't schedule invocation: thread pool has already been disposed"
+                                       reason:@"Can't schedule invocation: thread pool has already been shut down or disposed of"
                                      userInfo:@{@"threadPoolName": _name}];
     
-    NSUInteger poolSize= 0;
-    LSThreadPoolThread *newThread= nil;
-    @synchronized (self) {
+    if (_metricsEnabled)
+        atomic_fetch_add_explicit(&_submittedCount, 1, memory_order_relaxed);
+    
+    // With work stealing, invocations of normal priority scheduled by one of our threads go to its local deque,
+    // unless they must be visible to all threads
+    LSInvocationDeque *localDeque= nil;
+    if ((_options & LSThreadPoolOptionWorkStealing) && (priority == LSThreadPoolPriorityNormal) && (!shared))
+        localDeque= [self currentPoolThread].localDeque;
+    
+    // Local deques are not bounded, the shared queue may be
+    if ((!localDeque) && (![self admitInvocation:invocation]))
+        return;
+    
+    // Track the queue wait, needed for adaptive growth and metrics
+    if (_adaptive || _metricsEnabled)
+        invocation.enqueueTime= LSMonotonicNanoseconds();
+    
+    if (LSTraceIsEnabled()) {
+        LSTraceRecordEvent(LSTraceEventTypeCallEnqueued, (__bridge const void *) invocation, LSTraceNameForInvocation(invocation), 0);
+        invocation.enqueueTraced= YES;
+    }
+    
+    // Add invocation to queue, a parked thread is woken up if there's one
+    BOOL wokenUp= NO;
+    if (localDeque)
+        wokenUp= [_invocationQueue enqueueInvocation:invocation toLocalDeque:localDeque];
+    else
+        wokenUp= [_invocationQueue enqueueInvocation:invocation lane:[self laneForPriority:priority]];
+    
+    if (wokenUp)
+        return;
+    
+    // No parked thread: if there's room, create a new one
+    if (atomic_load_explicit(&_threadCount, memory_order_relaxed) < atomic_load_explicit(&_sizeLimit, memory_order_relaxed))
+        [self startNewThreadIfBelowSize];
+}
 
-        // Check if there's a free thread
-        BOOL freeThread= NO;
-        for (LSThreadPoolThread *thread in _threads) {
-            if (!(thread.working)) {
-                freeThread= YES;
-                break;
+- (void) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay {
+    if (_disposed)
+        @throw [NSException exceptionWithName:LS_THREAD_POOL_DISPOSED_OF
+                                       reason:@"Can't schedule invocation: thread pool has already been shut down or disposed of"
+                                     userInfo:@{@"threadPoolName": _name}];
+    
+    if (_metricsEnabled)
+        atomic_fetch_add_explicit(&_submittedCount, 1, memory_order_relaxed);
+    
+    invocation.deadline= LSMonotonicNanoseconds() + ((delay > 0.0) ? (uint64_t) (delay * 1000000000.0) : 0);
+    
+    // The queue wait of a delayed invocation is its lateness
+    if (_adaptive || _metricsEnabled)
+        invocation.enqueueTime= invocation.deadline;
+    
+    if (LSTraceIsEnabled()) {
+        LSTraceRecordEvent(LSTraceEventTypeCallEnqueued, (__bridge const void *) invocation, LSTraceNameForInvocation(invocation), invocation.deadline);
+        invocation.enqueueTraced= YES;
+    }
+    
+    // Add invocation to delayed ones, the timekeeper is woken up if its deadline is the earliest
+    [_invocationQueue enqueueDelayedInvocation:invocation];
+    
+    // Delayed invocations just need a thread to keep time, they don't start a new thread each
+    if (atomic_load_explicit(&_threadCount, memory_order_relaxed) == 0)
+        [self startNewThreadIfBelowSize];
+}
+
+- (LSThreadPoolThread *) currentPoolThread {
+    LSThreadPoolThread *currentThread= (LSThreadPoolThread *) [NSThread currentThread];
+    
+    if ([currentThread isKindOfClass:[LSThreadPoolThread class]] && (currentThread.queue == _invocationQueue))
+        return currentThread;
+    
+    return nil;
+}
+
+
+#pragma mark -
+#pragma mark Bounded queue
+
+- (BOOL) admitInvocation:(LSInvocation *)invocation {
+    if ([_invocationQueue reserveSlot])
+        return YES;
+    
+    switch (_queueFullPolicy) {
+        case LSThreadPoolQueueFullPolicyFail:
+            [self rejectInvocation:invocation code:LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL];
+            return NO;
+            
+        case LSThreadPoolQueueFullPolicyBlock: {
+            
+            // Blocking one of our threads may lead to a deadlock
+            if ([self currentPoolThread]) {
+                [self runInvocationOnCallerThread:invocation];
+                return NO;
             }
+            
+            NSDate *limit= (_queueFullTimeout > 0.0) ? [NSDate dateWithTimeIntervalSinceNow:_queueFullTimeout] : [NSDate distantFuture];
+            if ([_invocationQueue reserveSlotWaitingUntilDate:limit])
+                return YES;
+            
+            [self rejectInvocation:invocation code:LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL];
+            return NO;
         }
-        
-        if ((!freeThread) && (_threads.count < _size)) {
             
-            // No free threads, create a new one
-            newThread= [[LSThreadPoolThread alloc] initWithPool:self
-                                                           name:[NSString stringWithFormat:@"%@ Thread%d", _name, _nextThreadId]
-                                                          queue:_invocationQueue
-                                                   queueMonitor:_monitor];
+        case LSThreadPoolQueueFullPolicyCallerRuns:
+            [self runInvocationOnCallerThread:invocation];
+            return NO;
             
-            _nextThreadId++;
+        case LSThreadPoolQueueFullPolicyDropOldest:
+            while (YES) {
+                LSFunctionRecord *record= NULL;
+                LSInvocation *oldest= [_invocationQueue removeOldestInvocationOrFunctionRecord:&record];
+                if ((!oldest) && (!record)) {
+                    
+                    // Slots are reserved but not filled yet, nothing to drop
+                    [self rejectInvocation:invocation code:LS_THREAD_POOL_ERROR_CODE_QUEUE_FULL];
+                    return NO;
+                }
+                
+                atomic_fetch_add_explicit(&_droppedCount, 1, memory_order_relaxed);
+                
+                if (record) {
+                    
+                    // Function records have no descriptor to be notified, they are just recycled
+                    if (LSTraceIsEnabled())
+                        LSTraceRecordEvent(LSTraceEventTypeCallDiscarded, record, NULL, 0);
+                    
+                    LSFunctionRecordRelease(record);
+                    
+                } else {
+                    [oldest rejectWithError:[NSError errorWithDomain:LS_THREAD_POOL_ERROR_DOMAIN
+                                                                code:LS_THREAD_POOL_ERROR_CODE_DROPPED
+                                                            userInfo:@{NSLocalizedDescriptionKey: @"Call dropped to make room for a newer one"}]];
+                }
+                
+                if ([_invocationQueue reserveSlot])
+                    return YES;
+            }
             
-            [_threads addObject:newThread];
+        default:
+            atomic_fetch_add_explicit(&_rejectedCount, 1, memory_order_relaxed);
             
-            poolSize= _threads.count;
-        }
+            @throw [NSException exceptionWithName:LS_THREAD_POOL_QUEUE_FULL
+                                           reason:@"Can't schedule invocation: thread pool queue is full"
+                                         userInfo:@{@"threadPoolName": _name,
+                                                    @"queueCapacity": @(_invocationQueue.capacity)}];
     }
-    
-    if (newThread)
-        [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"created new thread for pool %@, pool size is now: %lu", _name, (unsigned long) poolSize];
+}
 
-    // Add invocation to queue
-    [_monitor lock];
+- (void) runInvocationOnCallerThread:(LSInvocation *)invocation {
+    if (![invocation beginPerforming])
+        return;
     
-    [_invocationQueue addObject:invocation];
+    atomic_fetch_add_explicit(&_callerRunsCount, 1, memory_order_relaxed);
     
-    [_monitor signal];
-    [_monitor unlock];
-    
-    // Start the thread
-    if (newThread)
-        [newThread start];
+    @try {
+        [invocation perform];
+        
+    } @catch (NSException *e) {
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"exception caught while performing invocation on caller thread for pool %@: %@ (user info: %@)", _name, e, e.userInfo];
+        
+    } @finally {
+        [invocation completed];
+    }
+}
 
-    // Reschedule thread collector
-    [[LSTimerThread sharedTimer] cancelPreviousPerformRequestsWithTarget:self selector:@selector(collectIdleThreads)];
-    [[LSTimerThread sharedTimer] performSelector:@selector(collectIdleThreads) onTarget:self afterDelay:THREAD_COLLECTOR_DELAY];
+- (void) rejectInvocation:(LSInvocation *)invocation code:(NSInteger)code {
+    atomic_fetch_add_explicit(&_rejectedCount, 1, memory_order_relaxed);
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"invocation rejected by pool %@, queue is full", _name];
+    
+    [invocation rejectWithError:[NSError errorWithDomain:LS_THREAD_POOL_ERROR_DOMAIN
+                                                    code:code
+                                                userInfo:@{NSLocalizedDescriptionKey: @"Thread pool queue is full"}]];
 }
 
 
 #pragma mark -
 #pragma mark Thread management
 
-- (void) collectIdleThreads {
+- (BOOL) startNewThreadIfBelowSize {
+    NSUInteger poolSize= 0;
+    LSThreadPoolThread *newThread= nil;
+    @synchronized (self) {
+        if (_disposed || (_threads.count >= atomic_load_explicit(&_sizeLimit, memory_order_relaxed)))
+            return NO;
+        
+        newThread= [self newThread];
+        
+        [_threads addObject:newThread];
+        _threadsCreatedCount++;
+        
+        poolSize= _threads.count;
+        atomic_store_explicit(&_threadCount, poolSize, memory_order_relaxed);
+    }
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"created new thread for pool %@, pool size is now: %lu", _name, (unsigned long) poolSize];
+    
+    [newThread start];
+    
+    return YES;
+}
+
+- (LSThreadPoolThread *) newThread {
+    LSThreadPoolThread *thread= [[LSThreadPoolThread alloc] initWithPool:self
+                                                                    name:[NSString stringWithFormat:@"%@ Thread%d", _name, _nextThreadId]
+                                                                   queue:_invocationQueue
+                                                             idleTimeout:_configuration.idleTimeout
+                                                         targetQueueWait:_configuration.targetQueueWait];
+    
+    if (_metricsEnabled)
+        thread.metricsRecorder= [[LSThreadPoolMetricsRecorder alloc] init];
+    
+    thread.batchSize= _configuration.batchSize;
+    thread.autoreleaseDrainInterval= _configuration.autoreleaseDrainInterval;
+    
+    // NSThread requires the stack size to be a multiple of 4 KB
+    if (_configuration.stackSize)
+        thread.stackSize= ((_configuration.stackSize + STACK_SIZE_GRANULARITY - 1) / STACK_SIZE_GRANULARITY) * STACK_SIZE_GRANULARITY;
+    
+    thread.cpuSet= [self cpuSetForThreadNumber:_nextThreadId];
+    thread.schedulingPolicy= _configuration.schedulingPolicy;
+    thread.niceValue= _configuration.niceValue;
+    
+    _nextThreadId++;
+    
+    return thread;
+}
+
+- (NSIndexSet *) cpuSetForThreadNumber:(int)threadNumber {
+    if (!_configuration.pinsThreadsToCPUs)
+        return _configuration.cpuSet;
+    
+    NSIndexSet *cpus= _configuration.cpuSet.count ? _configuration.cpuSet : [LSCPUTopology onlineCPUs];
+    
+    // Threads are pinned to processors in turn, wrapping around if there are more threads than processors
+    NSUInteger position= (NSUInteger) (threadNumber - 1) % cpus.count;
+    NSUInteger cpu= cpus.firstIndex;
+    for (NSUInteger i= 0; i < position; i++)
+        cpu= [cpus indexGreaterThanIndex:cpu];
+    
+    return [NSIndexSet indexSetWithIndex:cpu];
+}
 
-    // Collect idle threads
+- (BOOL) retireThread:(LSThreadPoolThread *)thread {
     NSUInteger poolSize= 0;
     @synchronized (self) {
-        NSTimeInterval now= [NSDate date].timeIntervalSinceReferenceDate;
         
-        NSMutableArray<LSThreadPoolThread *> *toBeCollected= [[NSMutableArray alloc] init];
-        for (LSThreadPoolThread *thread in _threads) {
-            if ((!(thread.working)) && ((now - thread.lastActivity) > MAX_THREAD_IDLENESS)) {
-                [thread dispose];
-                
-                [toBeCollected addObject:thread];
-            }
+        // Core threads are never retired
+        if (_threads.count <= _coreSize)
+            return NO;
+        
+        atomic_fetch_sub_explicit(&_threadCount, 1, memory_order_relaxed);
+        
+        // Pairs with the fence in the queue's enqueue: either the scheduling
+        // thread sees the room for a new thread, or we see its invocation
+        atomic_thread_fence(memory_order_seq_cst);
+        
+        // The last thread also stays as long as delayed invocations are pending
+        if ((_invocationQueue.count > 0) || ((_threads.count == 1) && (_invocationQueue.delayedCount > 0))) {
+            atomic_fetch_add_explicit(&_threadCount, 1, memory_order_relaxed);
+            return NO;
         }
         
-        [_threads removeObjectsInArray:toBeCollected];
+        [_threads removeObjectIdenticalTo:thread];
+        _threadsRetiredCount++;
+        
+        // The thread won't record anything more
+        if (thread.metricsRecorder)
+            [_exitedMetrics addRecorder:thread.metricsRecorder];
+        
+        _exitedBatchCount += thread.batchCount;
+        _exitedBatchedInvocationCount += thread.batchedInvocationCount;
         
         poolSize= _threads.count;
+        
+        // Shrink the adaptive limit along with the pool
+        if (_adaptive)
+            atomic_store_explicit(&_sizeLimit, MAX(poolSize, _minSizeLimit), memory_order_relaxed);
+    }
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"retired idle thread %@ of pool %@, pool size is now: %lu", thread.name, _name, (unsigned long) poolSize];
+    
+    return YES;
+}
+
+- (void) queueWaitDidExceedTarget {
+    if (!_adaptive)
+        return;
+    
+    // Under overload every call exceeds the target: once at max size, or within
+    // the growth interval, return without taking the pool lock
+    if (atomic_load_explicit(&_sizeLimit, memory_order_relaxed) >= _maxSize)
+        return;
+    
+    // Give the last thread added the time to show its effect on the queue wait,
+    // only one of the threads that get past the interval check may grow the pool
+    uint64_t now= LSMonotonicNanoseconds();
+    uint_fast64_t lastGrowthTime= atomic_load_explicit(&_lastGrowthTime, memory_order_relaxed);
+    if ((now - lastGrowthTime < _growthInterval) ||
+        !atomic_compare_exchange_strong_explicit(&_lastGrowthTime, &lastGrowthTime, now, memory_order_relaxed, memory_order_relaxed))
+        return;
+    
+    NSUInteger sizeLimit= 0;
+    @synchronized (self) {
+        sizeLimit= atomic_load_explicit(&_sizeLimit, memory_order_relaxed);
+        
+        // Grow only when the current limit has been reached
+        if ((sizeLimit >= _maxSize) || (_threads.count < sizeLimit))
+            return;
+        
+        sizeLimit++;
+        atomic_store_explicit(&_sizeLimit, sizeLimit, memory_order_relaxed);
+    }
+    
+    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"queue wait exceeded target on pool %@, size limit is now: %lu", _name, (unsigned long) sizeLimit];
+    
+    [self startNewThreadIfBelowSize];
+}
+
+- (void) threadDidExit:(LSThreadPoolThread *)thread {
+    @synchronized (self) {
+        
+        // Retired threads have already been removed
+        NSUInteger index= [_threads indexOfObjectIdenticalTo:thread];
+        if (index != NSNotFound) {
+            [_threads removeObjectAtIndex:index];
+            atomic_store_explicit(&_threadCount, _threads.count, memory_order_relaxed);
+            
+            if (thread.metricsRecorder)
+                [_exitedMetrics addRecorder:thread.metricsRecorder];
+            
+            _exitedBatchCount += thread.batchCount;
+            _exitedBatchedInvocationCount += thread.batchedInvocationCount;
+        }
     }
     
-    [LSLog sourceType:LOG_SRC_THREAD_POOL source:self log:@"collected threads for pool %@, pool size is now: %lu", _name, (unsigned long) poolSize];
+    if (!_disposed)
+        return;
     
-    // Schedule new executions if there are still threads operating
-    if (poolSize > 0)
-        [[LSTimerThread sharedTimer] performSelector:@selector(collectIdleThreads) onTarget:self afterDelay:THREAD_COLLECTOR_DELAY];
+    // Wake up threads waiting for termination, if any
+    [_terminationMonitor lock];
+    [_terminationMonitor broadcast];
+    [_terminationMonitor unlock];
+}
+
+
+- (void) periodicInvocationDidRun:(LSPeriodicInvocation *)invocation {
+    
+    // Once shut down, the run just ended is the last one
+    if (_disposed)
+        [invocation cancel];
+    
+    if (![invocation rearmAfterRunEndedAt:LSMonotonicNanoseconds()]) {
+        [invocation completed];
+        return;
+    }
+    
+    if (_adaptive || _metricsEnabled)
+        invocation.enqueueTime= invocation.deadline;
+    
+    if (LSTraceIsEnabled()) {
+        LSTraceRecordEvent(LSTraceEventTypeCallEnqueued, (__bridge const void *) invocation, LSTraceNameForInvocation(invocation), invocation.deadline);
+        invocation.enqueueTraced= YES;
+    }
+    
+    [_invocationQueue enqueueDelayedInvocation:invocation];
+    
+    // The pool may have been shut down in the meantime, after removing delayed invocations
+    if (_disposed) {
+        for (LSInvocation *delayed in [_invocationQueue removeAllDelayedInvocations])
+            [delayed cancel];
+    }
+}
+
+
+#pragma mark -
+#pragma mark Priority lanes
+
+- (NSUInteger) laneForPriority:(LSThreadPoolPriority)priority {
+    switch (priority) {
+        case LSThreadPoolPriorityLow:
+            return 0;
+            
+        case LSThreadPoolPriorityHigh:
+            return LS_INVOCATION_QUEUE_LANES - 1;
+            
+        default:
+            return LS_INVOCATION_QUEUE_DEFAULT_LANE;
+    }
 }
 
 
@@ -250,13 +1002,122 @@
 @dynamic queueSize;
 
 - (NSUInteger) queueSize {
-    @try {
-        [_monitor lock];
+    return _invocationQueue.count;
+}
+
+- (NSUInteger) queueSizeForPriority:(LSThreadPoolPriority)priority {
+    return [_invocationQueue countForLane:[self laneForPriority:priority]];
+}
+
+@dynamic delayedQueueSize;
+
+- (NSUInteger) delayedQueueSize {
+    return _invocationQueue.delayedCount;
+}
+
+@synthesize options= _options;
+
+@dynamic shutDown;
+
+- (BOOL) isShutDown {
+    @synchronized (self) {
+        return _disposed;
+    }
+}
+
+@dynamic terminated;
+
+- (BOOL) isTerminated {
+    @synchronized (self) {
+        return _disposed && (_threads.count == 0);
+    }
+}
+
+@dynamic metrics;
+
+- (LSThreadPoolMetrics *) metrics {
+    if (!_metricsEnabled)
+        return nil;
+    
+    @synchronized (self) {
+        NSMutableArray<LSThreadPoolMetricsRecorder *> *recorders= [[NSMutableArray alloc] initWithCapacity:_threads.count + 1];
+        [recorders addObject:_exitedMetrics];
         
-        return _invocationQueue.count;
+        for (LSThreadPoolThread *thread in _threads)
+            [recorders addObject:thread.metricsRecorder];
+        
+        return [[LSThreadPoolMetrics alloc] initWithRecorders:recorders
+                                               submittedCount:atomic_load_explicit(&_submittedCount, memory_order_relaxed)
+                                          threadsCreatedCount:_threadsCreatedCount
+                                          threadsRetiredCount:_threadsRetiredCount
+                                                  currentSize:_threads.count
+                                                    queueSize:_invocationQueue.count];
+    }
+}
 
-    } @finally {
-        [_monitor unlock];
+@dynamic configuration;
+
+- (LSThreadPoolConfiguration *) configuration {
+    return [_configuration copy];
+}
+
+@dynamic currentSize;
+
+- (NSUInteger) currentSize {
+    return atomic_load_explicit(&_threadCount, memory_order_relaxed);
+}
+
+@dynamic queueCapacity;
+
+- (NSUInteger) queueCapacity {
+    return _invocationQueue.capacity;
+}
+
+@synthesize queueFullPolicy= _queueFullPolicy;
+
+@dynamic rejectedCount;
+
+- (NSUInteger) rejectedCount {
+    return atomic_load_explicit(&_rejectedCount, memory_order_relaxed);
+}
+
+@dynamic droppedCount;
+
+- (NSUInteger) droppedCount {
+    return atomic_load_explicit(&_droppedCount, memory_order_relaxed);
+}
+
+@dynamic callerRunsCount;
+
+- (NSUInteger) callerRunsCount {
+    return atomic_load_explicit(&_callerRunsCount, memory_order_relaxed);
+}
+
+@dynamic batchCount;
+
+- (uint64_t) batchCount {
+    @synchronized (self) {
+        uint64_t batchCount= _exitedBatchCount;
+        for (LSThreadPoolThread *thread in _threads)
+            batchCount += thread.batchCount;
+        
+        return batchCount;
+    }
+}
+
+@dynamic averageBatchSize;
+
+- (double) averageBatchSize {
+    @synchronized (self) {
+        uint64_t batchCount= _exitedBatchCount;
+        uint64_t batchedInvocationCount= _exitedBatchedInvocationCount;
+        
+        for (LSThreadPoolThread *thread in _threads) {
+            batchCount += thread.batchCount;
+            batchedInvocationCount += thread.batchedInvocationCount;
+        }
+        
+        return batchCount ? ((double) batchedInvocationCount / (double) batchCount) : 0.0;
     }
 }
 
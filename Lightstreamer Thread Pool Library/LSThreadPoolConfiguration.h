@@ -0,0 +1,180 @@
+//
+//  LSThreadPoolConfiguration.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "LSThreadPool.h"
+
+
+/**
+ @brief LSThreadPoolConfiguration collects the sizing and behavior parameters of an LSThreadPool.
+ <br/> Used by <code>initWithName:configuration:</code>. The configuration is copied when the pool is
+ initialized, hence later changes have no effect on the pool.
+ <br/> The pool keeps at least <code>coreSize</code> threads once they are created (see <code>prestartCoreThreads</code>),
+ and creates threads on-demand up to <code>maxSize</code>. Threads in excess of the core size retire themselves after
+ <code>idleTimeout</code> seconds of idleness.
+ <br/> If <code>queueCapacity</code> is greater than 0, the queue is bounded and the <code>queueFullPolicy</code> applies
+ when it is full.
+ <br/> If <code>targetQueueWait</code> is greater than 0, the pool is adaptive: it starts with a size limit equal to
+ the core size (or 1), and raises the limit, up to <code>maxSize</code>, only when a call has waited in the queue
+ longer than the target, by one thread per target queue wait at most. The limit is lowered again as idle threads retire.
+ */
+@interface LSThreadPoolConfiguration : NSObject <NSCopying>
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates a configuration with the specified maximum size and default values for other parameters.
+ @param maxSize The maximum size of the thread pool.
+ @return The created configuration.
+ */
++ (nonnull LSThreadPoolConfiguration *) configurationWithMaxSize:(NSUInteger)maxSize;
+
+/**
+ @brief Initializes a configuration with the specified maximum size and default values for other parameters:
+ a core size of 0, an idle timeout of 10 seconds, no options and no adaptive growth.
+ @param maxSize The maximum size of the thread pool.
+ */
+- (nonnull instancetype) initWithMaxSize:(NSUInteger)maxSize NS_DESIGNATED_INITIALIZER;
+
+/**
+ @brief Initializes a configuration with a maximum size of 1 and default values for other parameters.
+ */
+- (nonnull instancetype) init;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The number of threads that are never retired, once created. Must not be greater than <code>maxSize</code>.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSUInteger coreSize;
+
+/**
+ @brief The maximum number of threads of the pool. Must be greater than 0.
+ */
+@property (nonatomic, assign) NSUInteger maxSize;
+
+/**
+ @brief The time, in seconds, a thread in excess of the core size waits for new calls before retiring. Must be greater than 0.
+ <br/> Default is 10 seconds.
+ */
+@property (nonatomic, assign) NSTimeInterval idleTimeout;
+
+/**
+ @brief The options of the thread pool, such as the kind of queue to be used.
+ <br/> Default is <code>LSThreadPoolOptionNone</code>.
+ @see LSThreadPoolOptions.
+ */
+@property (nonatomic, assign) LSThreadPoolOptions options;
+
+/**
+ @brief The target queue wait, in seconds, for adaptive growth. If 0, adaptive growth is disabled.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSTimeInterval targetQueueWait;
+
+/**
+ @brief The maximum number of calls that may wait in the queue. If 0, the queue is unbounded.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSUInteger queueCapacity;
+
+/**
+ @brief The policy to be used when the queue is full.
+ <br/> Default is <code>LSThreadPoolQueueFullPolicyThrow</code>.
+ @see LSThreadPoolQueueFullPolicy.
+ */
+@property (nonatomic, assign) LSThreadPoolQueueFullPolicy queueFullPolicy;
+
+/**
+ @brief With <code>LSThreadPoolQueueFullPolicyBlock</code>, the maximum time, in seconds, a scheduling thread is blocked
+ waiting for a free slot. If 0, it waits indefinitely.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSTimeInterval queueFullTimeout;
+
+/**
+ @brief If enabled, threads of the pool collect counters and histograms of queue wait and execution time, available with the <code>metrics</code> property of the pool.
+ <br/> When disabled, no clock is read and nothing is counted on behalf of metrics.
+ <br/> Default is NO.
+ @see LSThreadPoolMetrics.
+ */
+@property (nonatomic, assign) BOOL metricsEnabled;
+
+/**
+ @brief The maximum number of calls a thread takes from the queue at once. Must be at least 1.
+ <br/> When the queue is deep, a thread takes more calls of the same priority with a single lock round-trip, but never
+ more than its fair share (the queued calls divided by the threads of the pool), so that other threads are not starved.
+ <br/> Default is 1, i.e. calls are taken one at a time.
+ */
+@property (nonatomic, assign) NSUInteger batchSize;
+
+/**
+ @brief The time budget, in seconds, of the autorelease pool of each thread. If 0, the autorelease pool is drained
+ after each batch of calls (i.e. after each call, if <code>batchSize</code> is 1).
+ <br/> If greater than 0, the autorelease pool is kept across batches and drained once the budget expires, or when
+ the thread runs out of calls. Objects autoreleased by calls live longer, so keep it short.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSTimeInterval autoreleaseDrainInterval;
+
+/**
+ @brief The stack size, in bytes, of the threads of the pool. It is rounded up to a multiple of 4 KB. If 0, the system default is used.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSUInteger stackSize;
+
+/**
+ @brief The processors threads of the pool may run on. If <code>nil</code>, threads may run on any processor.
+ <br/> Supported on Linux only, ignored on other platforms.
+ <br/> Default is <code>nil</code>.
+ */
+@property (nonatomic, copy, nullable) NSIndexSet *cpuSet;
+
+/**
+ @brief If enabled, each thread of the pool is pinned to a single processor, taken in turn from <code>cpuSet</code> (or from
+ all online processors, if not set), so that threads don't migrate across processors.
+ <br/> Supported on Linux only, ignored on other platforms.
+ <br/> Default is NO.
+ */
+@property (nonatomic, assign) BOOL pinsThreadsToCPUs;
+
+/**
+ @brief The scheduling policy of the threads of the pool.
+ <br/> Default is <code>LSThreadPoolSchedulingPolicyDefault</code>.
+ @see LSThreadPoolSchedulingPolicy.
+ */
+@property (nonatomic, assign) LSThreadPoolSchedulingPolicy schedulingPolicy;
+
+/**
+ @brief The nice value of the threads of the pool, from -20 (highest priority) to 19 (lowest). Negative values usually
+ require privileges. If 0, the nice value of the process is kept.
+ <br/> Supported on Linux only, where nice values are per thread, ignored on other platforms.
+ <br/> Default is 0.
+ */
+@property (nonatomic, assign) NSInteger niceValue;
+
+
+@end
@@ -0,0 +1,117 @@
+//
+//  LSThreadPoolConfiguration.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSThreadPoolConfiguration.h"
+
+#define DEFAULT_IDLE_TIMEOUT                               (10.0)
+
+
+#pragma mark -
+#pragma mark LSThreadPoolConfiguration implementation
+
+@implementation LSThreadPoolConfiguration
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSThreadPoolConfiguration *) configurationWithMaxSize:(NSUInteger)maxSize {
+    LSThreadPoolConfiguration *configuration= [[LSThreadPoolConfiguration alloc] initWithMaxSize:maxSize];
+    
+    return configuration;
+}
+
+- (instancetype) initWithMaxSize:(NSUInteger)maxSize {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _coreSize= 0;
+        _maxSize= maxSize;
+        _idleTimeout= DEFAULT_IDLE_TIMEOUT;
+        _options= LSThreadPoolOptionNone;
+        _targetQueueWait= 0.0;
+        _queueCapacity= 0;
+        _queueFullPolicy= LSThreadPoolQueueFullPolicyThrow;
+        _queueFullTimeout= 0.0;
+        _metricsEnabled= NO;
+        _batchSize= 1;
+        _autoreleaseDrainInterval= 0.0;
+        _stackSize= 0;
+        _cpuSet= nil;
+        _pinsThreadsToCPUs= NO;
+        _schedulingPolicy= LSThreadPoolSchedulingPolicyDefault;
+        _niceValue= 0;
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    return [self initWithMaxSize:1];
+}
+
+
+#pragma mark -
+#pragma mark NSCopying
+
+- (id) copyWithZone:(NSZone *)zone {
+    LSThreadPoolConfiguration *copy= [[LSThreadPoolConfiguration allocWithZone:zone] initWithMaxSize:_maxSize];
+    copy.coreSize= _coreSize;
+    copy.idleTimeout= _idleTimeout;
+    copy.options= _options;
+    copy.targetQueueWait= _targetQueueWait;
+    copy.queueCapacity= _queueCapacity;
+    copy.queueFullPolicy= _queueFullPolicy;
+    copy.queueFullTimeout= _queueFullTimeout;
+    copy.metricsEnabled= _metricsEnabled;
+    copy.batchSize= _batchSize;
+    copy.autoreleaseDrainInterval= _autoreleaseDrainInterval;
+    copy.stackSize= _stackSize;
+    copy.cpuSet= _cpuSet;
+    copy.pinsThreadsToCPUs= _pinsThreadsToCPUs;
+    copy.schedulingPolicy= _schedulingPolicy;
+    copy.niceValue= _niceValue;
+    
+    return copy;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize coreSize= _coreSize;
+@synthesize maxSize= _maxSize;
+@synthesize idleTimeout= _idleTimeout;
+@synthesize options= _options;
+@synthesize targetQueueWait= _targetQueueWait;
+@synthesize queueCapacity= _queueCapacity;
+@synthesize queueFullPolicy= _queueFullPolicy;
+@synthesize queueFullTimeout= _queueFullTimeout;
+@synthesize metricsEnabled= _metricsEnabled;
+@synthesize batchSize= _batchSize;
+@synthesize autoreleaseDrainInterval= _autoreleaseDrainInterval;
+@synthesize stackSize= _stackSize;
+@synthesize cpuSet= _cpuSet;
+@synthesize pinsThreadsToCPUs= _pinsThreadsToCPUs;
+@synthesize schedulingPolicy= _schedulingPolicy;
+@synthesize niceValue= _niceValue;
+
+
+@end
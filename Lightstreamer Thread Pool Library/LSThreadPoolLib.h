@@ -19,10 +19,21 @@
 //
 
 #import "LSThreadPool.h"
+#import "LSThreadPoolConfiguration.h"
+#import "LSThreadPoolMetrics.h"
+#import "LSHistogram.h"
 #import "LSInvocation.h"
+#import "LSPeriodicInvocation.h"
+#import "LSFuture.h"
+#import "LSSerialExecutor.h"
+#import "LSPartitionedThreadPool.h"
 #import "LSURLDispatcher.h"
 #import "LSURLDispatchDelegate.h"
 #import "LSURLDispatchOperation.h"
 #import "LSTimerThread.h"
+#import "LSTimerToken.h"
+#import "LSTimerGroup.h"
+#import "LSShardedTimerThread.h"
 #import "LSLog.h"
 #import "LSLogDelegate.h"
+#import "LSTrace.h"
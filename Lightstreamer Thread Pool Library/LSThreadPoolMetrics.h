@@ -0,0 +1,90 @@
+//
+//  LSThreadPoolMetrics.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+#import "LSHistogram.h"
+
+
+/**
+ @brief LSThreadPoolMetrics is an immutable snapshot of the runtime metrics of an LSThreadPool.
+ <br/> Metrics are collected only if enabled with the <code>metricsEnabled</code> property of LSThreadPoolConfiguration.
+ Each thread of the pool collects its own counters and histograms, which are aggregated when the snapshot is taken;
+ metrics of retired threads are retained.
+ <br/> Comparing the queue wait with the execution time tells whether slowness comes from queueing or from the
+ calls themselves; a queue wait growing while the pool is at its maximum size denotes thread starvation.
+ @see LSThreadPool.
+ */
+@interface LSThreadPoolMetrics : NSObject
+
+
+#pragma mark -
+#pragma mark Counters
+
+/**
+ @brief The number of calls scheduled on the pool, including those later rejected or dropped.
+ */
+@property (nonatomic, readonly) uint64_t submittedCount;
+
+/**
+ @brief The number of calls executed by the threads of the pool that completed normally.
+ */
+@property (nonatomic, readonly) uint64_t completedCount;
+
+/**
+ @brief The number of calls executed by the threads of the pool that raised an exception.
+ */
+@property (nonatomic, readonly) uint64_t failedCount;
+
+/**
+ @brief The number of threads created since the pool was initialized.
+ */
+@property (nonatomic, readonly) uint64_t threadsCreatedCount;
+
+/**
+ @brief The number of threads that retired due to idleness since the pool was initialized.
+ */
+@property (nonatomic, readonly) uint64_t threadsRetiredCount;
+
+/**
+ @brief The number of threads of the pool when the snapshot was taken.
+ */
+@property (nonatomic, readonly) NSUInteger currentSize;
+
+/**
+ @brief The number of calls waiting in the queue when the snapshot was taken.
+ */
+@property (nonatomic, readonly) NSUInteger queueSize;
+
+
+#pragma mark -
+#pragma mark Histograms
+
+/**
+ @brief Histogram of the time calls waited from scheduling to the start of their execution.
+ */
+@property (nonatomic, readonly, nonnull) LSHistogram *queueWait;
+
+/**
+ @brief Histogram of the execution time of calls, including those that raised an exception.
+ */
+@property (nonatomic, readonly, nonnull) LSHistogram *executionTime;
+
+
+@end
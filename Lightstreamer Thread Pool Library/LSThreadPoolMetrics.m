@@ -0,0 +1,110 @@
+//
+//  LSThreadPoolMetrics.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSThreadPoolMetrics.h"
+#import "LSThreadPoolMetrics+Internals.h"
+#import "LSThreadPoolMetricsRecorder.h"
+#import "LSHistogram+Internals.h"
+
+
+#pragma mark -
+#pragma mark LSThreadPoolMetrics extension
+
+@interface LSThreadPoolMetrics () {
+    uint64_t _submittedCount;
+    uint64_t _completedCount;
+    uint64_t _failedCount;
+    uint64_t _threadsCreatedCount;
+    uint64_t _threadsRetiredCount;
+    
+    NSUInteger _currentSize;
+    NSUInteger _queueSize;
+    
+    LSHistogram *_queueWait;
+    LSHistogram *_executionTime;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSThreadPoolMetrics implementation
+
+@implementation LSThreadPoolMetrics
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithRecorders:(NSArray<LSThreadPoolMetricsRecorder *> *)recorders
+                    submittedCount:(uint64_t)submittedCount
+               threadsCreatedCount:(uint64_t)threadsCreatedCount
+               threadsRetiredCount:(uint64_t)threadsRetiredCount
+                       currentSize:(NSUInteger)currentSize
+                         queueSize:(NSUInteger)queueSize {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _submittedCount= submittedCount;
+        _threadsCreatedCount= threadsCreatedCount;
+        _threadsRetiredCount= threadsRetiredCount;
+        _currentSize= currentSize;
+        _queueSize= queueSize;
+        
+        // Aggregate per-thread metrics
+        uint64_t queueWaitCounts[LS_HISTOGRAM_BUCKETS]= { 0 };
+        uint64_t queueWaitSum= 0, queueWaitMax= 0;
+        uint64_t executionTimeCounts[LS_HISTOGRAM_BUCKETS]= { 0 };
+        uint64_t executionTimeSum= 0, executionTimeMax= 0;
+        
+        _completedCount= 0;
+        _failedCount= 0;
+        
+        for (LSThreadPoolMetricsRecorder *recorder in recorders) {
+            [recorder accumulateQueueWaitBucketCounts:queueWaitCounts sum:&queueWaitSum max:&queueWaitMax];
+            [recorder accumulateExecutionTimeBucketCounts:executionTimeCounts sum:&executionTimeSum max:&executionTimeMax];
+            
+            _completedCount += recorder.completedCount;
+            _failedCount += recorder.failedCount;
+        }
+        
+        _queueWait= [[LSHistogram alloc] initWithBucketCounts:queueWaitCounts sum:queueWaitSum max:queueWaitMax];
+        _executionTime= [[LSHistogram alloc] initWithBucketCounts:executionTimeCounts sum:executionTimeSum max:executionTimeMax];
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize submittedCount= _submittedCount;
+@synthesize completedCount= _completedCount;
+@synthesize failedCount= _failedCount;
+@synthesize threadsCreatedCount= _threadsCreatedCount;
+@synthesize threadsRetiredCount= _threadsRetiredCount;
+@synthesize currentSize= _currentSize;
+@synthesize queueSize= _queueSize;
+@synthesize queueWait= _queueWait;
+@synthesize executionTime= _executionTime;
+
+
+@end
@@ -0,0 +1,70 @@
+//
+//  LSThreadPoolMetricsRecorder.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import <Foundation/Foundation.h>
+
+
+@class LSHistogram;
+
+
+/**
+ @brief Collects the metrics of a single LSThreadPoolThread. <b>This class should not be used directly</b>.
+ <br/> Recording methods must be called by the owner thread only: counters are updated with plain relaxed
+ loads and stores, with no read-modify-write, and may be read at any time by other threads.
+ @see LSThreadPoolMetrics.
+ */
+@interface LSThreadPoolMetricsRecorder : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) init NS_DESIGNATED_INITIALIZER;
+
+
+#pragma mark -
+#pragma mark Recording (for internal use only)
+
+- (void) recordQueueWait:(uint64_t)nanoseconds;
+- (void) recordExecutionTime:(uint64_t)nanoseconds failed:(BOOL)failed;
+
+/**
+ @brief Adds the metrics of another recorder to this one. The caller must serialize calls on the same receiver.
+ */
+- (void) addRecorder:(nonnull LSThreadPoolMetricsRecorder *)recorder;
+
+
+#pragma mark -
+#pragma mark Snapshot (for internal use only)
+
+/**
+ @brief Adds the current bucket counts of the queue wait histogram to <code>bucketCounts</code>, and its sum and maximum to <code>sum</code> and <code>max</code>.
+ */
+- (void) accumulateQueueWaitBucketCounts:(nonnull uint64_t *)bucketCounts sum:(nonnull uint64_t *)sum max:(nonnull uint64_t *)max;
+- (void) accumulateExecutionTimeBucketCounts:(nonnull uint64_t *)bucketCounts sum:(nonnull uint64_t *)sum max:(nonnull uint64_t *)max;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly) uint64_t completedCount;
+@property (nonatomic, readonly) uint64_t failedCount;
+
+
+@end
@@ -0,0 +1,167 @@
+//
+//  LSThreadPoolMetricsRecorder.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+#import "LSThreadPoolMetricsRecorder.h"
+#import "LSHistogram.h"
+
+#import <stdatomic.h>
+
+
+#pragma mark -
+#pragma mark Histogram counters
+
+typedef struct {
+    atomic_uint_fast64_t buckets[LS_HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t max;
+} LSHistogramCounters;
+
+// Single writer: a load and a store are enough, and avoid the cost of an atomic read-modify-write
+static inline void LSCounterAdd(atomic_uint_fast64_t *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void LSHistogramCountersRecord(LSHistogramCounters *counters, uint64_t value) {
+    LSCounterAdd(&counters->buckets[LSHistogramBucketForValue(value)], 1);
+    LSCounterAdd(&counters->sum, value);
+    
+    if (value > atomic_load_explicit(&counters->max, memory_order_relaxed))
+        atomic_store_explicit(&counters->max, value, memory_order_relaxed);
+}
+
+static inline void LSHistogramCountersAdd(LSHistogramCounters *counters, LSHistogramCounters *other) {
+    for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++)
+        LSCounterAdd(&counters->buckets[bucket], atomic_load_explicit(&other->buckets[bucket], memory_order_relaxed));
+    
+    LSCounterAdd(&counters->sum, atomic_load_explicit(&other->sum, memory_order_relaxed));
+    
+    uint64_t max= atomic_load_explicit(&other->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&counters->max, memory_order_relaxed))
+        atomic_store_explicit(&counters->max, max, memory_order_relaxed);
+}
+
+static inline void LSHistogramCountersAccumulate(LSHistogramCounters *counters, uint64_t *bucketCounts, uint64_t *sum, uint64_t *max) {
+    for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++)
+        bucketCounts[bucket] += atomic_load_explicit(&counters->buckets[bucket], memory_order_relaxed);
+    
+    *sum += atomic_load_explicit(&counters->sum, memory_order_relaxed);
+    *max= MAX(*max, atomic_load_explicit(&counters->max, memory_order_relaxed));
+}
+
+
+#pragma mark -
+#pragma mark LSThreadPoolMetricsRecorder extension
+
+@interface LSThreadPoolMetricsRecorder () {
+    LSHistogramCounters _queueWait;
+    LSHistogramCounters _executionTime;
+    
+    atomic_uint_fast64_t _completedCount;
+    atomic_uint_fast64_t _failedCount;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSThreadPoolMetricsRecorder implementation
+
+@implementation LSThreadPoolMetricsRecorder
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) init {
+    if ((self = [super init])) {
+        
+        // Initialization
+        for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++) {
+            atomic_init(&_queueWait.buckets[bucket], 0);
+            atomic_init(&_executionTime.buckets[bucket], 0);
+        }
+        
+        atomic_init(&_queueWait.sum, 0);
+        atomic_init(&_queueWait.max, 0);
+        atomic_init(&_executionTime.sum, 0);
+        atomic_init(&_executionTime.max, 0);
+        
+        atomic_init(&_completedCount, 0);
+        atomic_init(&_failedCount, 0);
+    }
+    
+    return self;
+}
+
+
+#pragma mark -
+#pragma mark Recording
+
+- (void) recordQueueWait:(uint64_t)nanoseconds {
+    LSHistogramCountersRecord(&_queueWait, nanoseconds);
+}
+
+- (void) recordExecutionTime:(uint64_t)nanoseconds failed:(BOOL)failed {
+    LSHistogramCountersRecord(&_executionTime, nanoseconds);
+    
+    if (failed)
+        LSCounterAdd(&_failedCount, 1);
+    else
+        LSCounterAdd(&_completedCount, 1);
+}
+
+- (void) addRecorder:(LSThreadPoolMetricsRecorder *)recorder {
+    LSHistogramCountersAdd(&_queueWait, &recorder->_queueWait);
+    LSHistogramCountersAdd(&_executionTime, &recorder->_executionTime);
+    
+    LSCounterAdd(&_completedCount, recorder.completedCount);
+    LSCounterAdd(&_failedCount, recorder.failedCount);
+}
+
+
+#pragma mark -
+#pragma mark Snapshot
+
+- (void) accumulateQueueWaitBucketCounts:(uint64_t *)bucketCounts sum:(uint64_t *)sum max:(uint64_t *)max {
+    LSHistogramCountersAccumulate(&_queueWait, bucketCounts, sum, max);
+}
+
+- (void) accumulateExecutionTimeBucketCounts:(uint64_t *)bucketCounts sum:(uint64_t *)sum max:(uint64_t *)max {
+    LSHistogramCountersAccumulate(&_executionTime, bucketCounts, sum, max);
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic completedCount;
+
+- (uint64_t) completedCount {
+    return atomic_load_explicit(&_completedCount, memory_order_relaxed);
+}
+
+@dynamic failedCount;
+
+- (uint64_t) failedCount {
+    return atomic_load_explicit(&_failedCount, memory_order_relaxed);
+}
+
+
+@end
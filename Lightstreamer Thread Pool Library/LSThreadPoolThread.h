@@ -20,13 +20,20 @@
 
 #import <Foundation/Foundation.h>
 
+#import "LSThreadPool.h"
+
 
-@class LSThreadPool;
 @class LSInvocation;
+@class LSInvocationQueue;
+@class LSInvocationDeque;
+@class LSThreadPoolMetricsRecorder;
 
 
 /**
  @brief A thread of an LSThreadPool. <b>This class should not be used directly</b>.
+ <br/> When no invocations are available the thread spins briefly, then parks on its own LSThreadParker
+ until a producer wakes it up. If it stays idle for longer than its idle timeout, it asks the pool to be
+ retired and exits; if the pool refuses, e.g. for core threads, it parks with no timeout until there's work.
  @see LSThreadPool.
  */
 @interface LSThreadPoolThread : NSThread
@@ -35,18 +42,46 @@
 #pragma mark -
 #pragma mark Initialization (for internal use only)
 
-- (instancetype) initWithPool:(LSThreadPool *)pool name:(NSString *)name queue:(NSMutableArray<LSInvocation *> *)queue queueMonitor:(NSCondition *)queueMonitor NS_DESIGNATED_INITIALIZER;
+- (instancetype) initWithPool:(LSThreadPool *)pool name:(NSString *)name queue:(LSInvocationQueue *)queue idleTimeout:(NSTimeInterval)idleTimeout targetQueueWait:(NSTimeInterval)targetQueueWait NS_DESIGNATED_INITIALIZER;
 
 - (instancetype) init NS_UNAVAILABLE;
 
 - (void) dispose;
 
+/**
+ @brief Removes the invocations of the current batch not yet started, so that they are not run after a <code>shutdownNow</code>.
+ Must be called after <code>dispose</code>, so that no new batch is taken.
+ */
+- (NSArray<LSInvocation *> *) removeBatchedInvocations;
+
 
 #pragma mark -
 #pragma mark Properties (for internal use only)
 
-@property (nonatomic, readonly) BOOL working;
 @property (nonatomic, readonly) NSTimeInterval lastActivity;
 
+@property (nonatomic, readonly, weak) LSInvocationQueue *queue;
+@property (nonatomic, readonly) LSInvocationDeque *localDeque;
+
+/**
+ @brief Set by the pool before the thread is started, only if metrics are enabled.
+ */
+@property (nonatomic, strong) LSThreadPoolMetricsRecorder *metricsRecorder;
+
+/**
+ @brief Set by the pool before the thread is started. See the same properties of LSThreadPoolConfiguration.
+ */
+@property (nonatomic, assign) NSUInteger batchSize;
+@property (nonatomic, assign) NSTimeInterval autoreleaseDrainInterval;
+@property (nonatomic, copy) NSIndexSet *cpuSet;
+@property (nonatomic, assign) LSThreadPoolSchedulingPolicy schedulingPolicy;
+@property (nonatomic, assign) NSInteger niceValue;
+
+/**
+ @brief Number of batches taken from the queue, and of calls they contained, since the thread started.
+ */
+@property (nonatomic, readonly) uint64_t batchCount;
+@property (nonatomic, readonly) uint64_t batchedInvocationCount;
+
 
 @end
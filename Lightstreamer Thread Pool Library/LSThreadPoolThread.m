@@ -18,27 +18,82 @@
 //  limitations under the License.
 //
 
+// Needed for pthread_setaffinity_np, must come before any system header
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #import "LSThreadPoolThread.h"
+#import "LSThreadPool.h"
+#import "LSThreadPool+Internals.h"
 #import "LSInvocation.h"
+#import "LSInvocation+Internals.h"
+#import "LSInvocationQueue.h"
+#import "LSInvocationDeque.h"
+#import "LSThreadParker.h"
+#import "LSFunctionRecord.h"
+#import "LSThreadPoolMetricsRecorder.h"
+#import "LSMonotonicClock.h"
+#import "LSTrace+Internals.h"
 #import "LSLog.h"
 #import "LSLog+Internals.h"
 
+#import <stdatomic.h>
+#import <pthread.h>
+
+#if defined(__linux__)
+#import <sched.h>
+#import <unistd.h>
+#import <sys/resource.h>
+#import <sys/syscall.h>
+#endif
+
 
 #pragma mark -
 #pragma mark LSThreadPoolThread extension
 
 @interface LSThreadPoolThread () {
     LSThreadPool * __weak _pool;
-    NSMutableArray<LSInvocation *> * __weak _queue;
-    NSCondition * __weak _queueMonitor;
+    LSInvocationQueue * __weak _queue;
+    LSInvocationDeque *_localDeque;
+    LSThreadParker *_parker;
+    LSThreadPoolMetricsRecorder *_metricsRecorder;
     
-    NSTimeInterval _loopInterval;
+    NSTimeInterval _idleTimeout;
+    uint64_t _targetQueueWait;
     NSTimeInterval _lastActivity;
     BOOL _running;
-    BOOL _working;
+    
+    // Placement, applied by the thread itself when it starts
+    NSIndexSet *_cpuSet;
+    LSThreadPoolSchedulingPolicy _schedulingPolicy;
+    NSInteger _niceValue;
+    
+    // Reused for each batch, so that batching allocates nothing; the batch
+    // and its index are guarded by the lock, as shutdownNow may take them back
+    NSMutableArray<LSInvocation *> *_batch;
+    NSUInteger _batchIndex;
+    pthread_mutex_t _batchLock;
+    NSUInteger _batchSize;
+    uint64_t _autoreleaseDrainInterval;
+    
+    // Written by this thread only, read by the pool
+    atomic_uint_fast64_t _batchCount;
+    atomic_uint_fast64_t _batchedInvocationCount;
 }
 
 
+#pragma mark -
+#pragma mark Internals
+
+- (void) applyPlacement;
+- (BOOL) runNextBatchFromQueue:(LSInvocationQueue *)queue mayRetire:(BOOL *)mayRetire idle:(BOOL *)idle;
+- (BOOL) performInvocation:(LSInvocation *)invocation;
+- (void) performFunctionRecord:(LSFunctionRecord *)record;
+- (void) countBatchOfSize:(NSUInteger)size;
+- (LSInvocation *) nextBatchedInvocation;
+
+
 @end
 
 
@@ -51,26 +106,26 @@
 #pragma mark -
 #pragma mark Initialization
 
-- (instancetype) initWithPool:(LSThreadPool *)pool name:(NSString *)name queue:(NSMutableArray<LSInvocation *> *)queue queueMonitor:(NSCondition *)queueMonitor {
+- (instancetype) initWithPool:(LSThreadPool *)pool name:(NSString *)name queue:(LSInvocationQueue *)queue idleTimeout:(NSTimeInterval)idleTimeout targetQueueWait:(NSTimeInterval)targetQueueWait {
     if ((self = [super init])) {
         
         // Initialization
         _pool= pool;
         _queue= queue;
-        _queueMonitor= queueMonitor;
+        _idleTimeout= idleTimeout;
+        _targetQueueWait= (uint64_t) (targetQueueWait * 1000000000.0);
         
         self.name= name;
         
-        // Use a random loop time to avoid periodic delays
-        int random= 0;
-        int result= SecRandomCopyBytes(kSecRandomDefault, sizeof(random), (uint8_t *) &random);
-        if (result == 0)
-            _loopInterval= 0.5 + ((double) (ABS(random) % 1000)) / 1000.0;
-        else
-            _loopInterval= 1.3;
-        
+        _lastActivity= [NSDate date].timeIntervalSinceReferenceDate;
         _running= YES;
-        _working= YES;
+        
+        _batchIndex= 0;
+        pthread_mutex_init(&_batchLock, NULL);
+        _batchSize= 1;
+        _autoreleaseDrainInterval= 0;
+        atomic_init(&_batchCount, 0);
+        atomic_init(&_batchedInvocationCount, 0);
     }
     
     return self;
@@ -84,12 +139,30 @@
 
 - (void) dealloc {
     [self dispose];
+    
+    pthread_mutex_destroy(&_batchLock);
 }
 
 - (void) dispose {
     _running= NO;
 }
 
+- (NSArray<LSInvocation *> *) removeBatchedInvocations {
+    NSArray<LSInvocation *> *invocations= nil;
+    
+    pthread_mutex_lock(&_batchLock);
+    
+    NSRange range= NSMakeRange(_batchIndex, _batch.count - _batchIndex);
+    if (range.length > 0) {
+        invocations= [_batch subarrayWithRange:range];
+        [_batch removeObjectsInRange:range];
+    }
+    
+    pthread_mutex_unlock(&_batchLock);
+    
+    return invocations ?: @[];
+}
+
 
 #pragma mark -
 #pragma mark Thread run loop
@@ -97,86 +170,374 @@
 - (void) main {
     @autoreleasepool {
     
-        // Local retain: they could be released while the thread is running
-        NSString *name= self.name;
-        NSMutableArray<LSInvocation *> *queue= _queue;
-        NSCondition *monitor= _queueMonitor;
+        // Local retain: it could be released while the thread is running
+        LSInvocationQueue *queue= _queue;
+        
+        [self applyPlacement];
+        
+        _parker= [[LSThreadParker alloc] init];
+        _batch= [[NSMutableArray alloc] initWithCapacity:_batchSize];
+        
+        // Cleared when the pool refuses to retire us, so that
+        // we then park with no timeout until there's work to do
+        BOOL mayRetire= YES;
+        
+        // With work stealing, invocations scheduled by this thread go to its local deque
+        if (queue.workStealing) {
+            _localDeque= [[LSInvocationDeque alloc] init];
+            
+            [queue registerLocalDeque:_localDeque];
+        }
         
         @try {
-            while (_running) {
+            BOOL exiting= NO;
+            while (_running && (!exiting)) {
                 @autoreleasepool {
-                    LSInvocation *invocation= nil;
-                    @try {
-                        [monitor lock];
-                        
-                        if (queue.count == 0) {
-                            _working= NO;
-
-                            [monitor waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:_loopInterval]];
-                            
-                            _working= YES;
-                        }
-                        
-                        if (queue.count > 0) {
-                            invocation= queue[0];
-                            
-                            [queue removeObjectAtIndex:0];
-                        }
+                    
+                    // The autorelease pool is drained after each batch, or
+                    // once its time budget expires if one is configured
+                    uint64_t drainTime= _autoreleaseDrainInterval ? LSMonotonicNanoseconds() + _autoreleaseDrainInterval : 0;
+                    BOOL idle= NO;
+                    
+                    do {
+                        exiting= ![self runNextBatchFromQueue:queue mayRetire:&mayRetire idle:&idle];
                         
-                        [monitor unlock];
-                        
-                        if (invocation) {
-                            @try {
-                                if (invocation.target) {
-                                    if (invocation.argument) {
-                                        
-                                        // Find method implementation and call it
-                                        IMP imp= [invocation.target methodForSelector:invocation.selector];
-                                        void (*func)(id, SEL, id)= (void *) imp;
-                                        func(invocation.target, invocation.selector, invocation.argument);
-
-                                    } else {
-                                        
-                                        // Find method implementation and call it
-                                        IMP imp= [invocation.target methodForSelector:invocation.selector];
-                                        void (*func)(id, SEL)= (void *) imp;
-                                        func(invocation.target, invocation.selector);
-                                    }
-
-                                } else if (invocation.block) {
-                                    invocation.block();
-                                }
-                                
-                            } @catch (NSException *ee) {
-                                [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"exception caught while performing invocation on thread pool %@: %@ (user info: %@)", name, ee, ee.userInfo];
-                            }
-                            
-                            _lastActivity= [NSDate date].timeIntervalSinceReferenceDate;
-                        }
-                        
-                    } @catch (NSException *e) {
-                        [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"exception caught while running thread pool %@: %@ (user info: %@)", name, e, e.userInfo];
-                        
-                    } @finally {
-                        invocation= nil;
-                    }
+                    } while (_running && (!exiting) && (!idle) && drainTime && (LSMonotonicNanoseconds() < drainTime));
                 }
             }
             
         } @finally {
-            name= nil;
+            if (_localDeque)
+                [queue unregisterLocalDeque:_localDeque];
+            
+            LSThreadPool *pool= _pool;
+            [pool threadDidExit:self];
+            
             queue= nil;
-            monitor= nil;
         }
     }
 }
 
 
+#pragma mark -
+#pragma mark Internals
+
+- (void) applyPlacement {
+#if defined(__linux__)
+    if (_cpuSet.count) {
+        __block cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        
+        [_cpuSet enumerateIndexesUsingBlock:^(NSUInteger cpu, BOOL *stop) {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpus);
+        }];
+        
+        int result= pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result)
+            [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"could not set CPU affinity of thread %@: error %d", self.name, result];
+    }
+    
+    if (_schedulingPolicy != LSThreadPoolSchedulingPolicyDefault) {
+        struct sched_param param;
+        param.sched_priority= 0;
+        
+        int result= pthread_setschedparam(pthread_self(), (_schedulingPolicy == LSThreadPoolSchedulingPolicyBatch) ? SCHED_BATCH : SCHED_IDLE, &param);
+        if (result)
+            [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"could not set scheduling policy of thread %@: error %d", self.name, result];
+    }
+    
+    // On Linux the nice value belongs to the thread, not to the process
+    if (_niceValue) {
+        if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), (int) _niceValue))
+            [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"could not set nice value of thread %@: error %d", self.name, errno];
+    }
+    
+#elif defined(__APPLE__)
+    
+    // CPU sets and nice values are not available per thread, the scheduling policy maps to a quality of service
+    if (_schedulingPolicy != LSThreadPoolSchedulingPolicyDefault)
+        pthread_set_qos_class_self_np((_schedulingPolicy == LSThreadPoolSchedulingPolicyBatch) ? QOS_CLASS_UTILITY : QOS_CLASS_BACKGROUND, 0);
+#endif
+}
+
+- (BOOL) runNextBatchFromQueue:(LSInvocationQueue *)queue mayRetire:(BOOL *)mayRetire idle:(BOOL *)idle {
+    LSInvocation *invocation= nil;
+    LSFunctionRecord *record= NULL;
+    *idle= NO;
+    
+    @try {
+        invocation= [queue dequeueInvocationWithLocalDeque:_localDeque functionRecord:&record];
+        
+        if ((!invocation) && (!record)) {
+            
+            // Park until an invocation is available or the idle timeout expires,
+            // with no timeout at all if the pool already refused to retire us
+            invocation= [queue dequeueInvocationWithLocalDeque:_localDeque
+                                                functionRecord:&record
+                                                        parker:_parker
+                                              waitingUntilDate:(*mayRetire ? [NSDate dateWithTimeIntervalSinceReferenceDate:_lastActivity + _idleTimeout] : nil)];
+        }
+        
+        if (record) {
+            [self performFunctionRecord:record];
+            record= NULL;
+            
+            [self countBatchOfSize:1];
+            
+            _lastActivity= [NSDate date].timeIntervalSinceReferenceDate;
+            *mayRetire= YES;
+            return YES;
+        }
+        
+        if (!invocation) {
+            *idle= YES;
+            
+            // Queue disposed of by a shutdown: exit as soon as it's drained
+            if (queue.disposed)
+                return NO;
+            
+            if (_running && *mayRetire &&
+                ([NSDate date].timeIntervalSinceReferenceDate - _lastActivity >= _idleTimeout)) {
+                
+                // Idle for too long: the pool refuses for core threads, or
+                // if invocations have been queued in the meantime
+                LSThreadPool *pool= _pool;
+                if ((!pool) || [pool retireThread:self])
+                    return NO;
+                
+                *mayRetire= NO;
+            }
+            
+            return YES;
+        }
+        
+        // With a deep queue, take more invocations with a single round-trip
+        NSUInteger batchCount= 0;
+        if (_batchSize > 1) {
+            LSThreadPool *pool= _pool;
+            NSUInteger threadCount= pool.currentSize;
+            
+            pthread_mutex_lock(&_batchLock);
+            
+            // Once disposed of, calls still queued are left to shutdownNow to cancel
+            if (_running)
+                [queue dequeueInvocationsIntoBatch:_batch maxCount:_batchSize - 1 threadCount:threadCount];
+            
+            _batchIndex= 0;
+            batchCount= _batch.count;
+            
+            pthread_mutex_unlock(&_batchLock);
+        }
+        
+        [self countBatchOfSize:1 + batchCount];
+        
+        // Cancelled invocations are skipped as they come
+        BOOL performed= [self performInvocation:invocation];
+        invocation= nil;
+        
+        // Batched invocations are taken one at a time, as shutdownNow may take back those left
+        LSInvocation *batched= nil;
+        while ((batched= [self nextBatchedInvocation]))
+            performed |= [self performInvocation:batched];
+        
+        if (performed) {
+            _lastActivity= [NSDate date].timeIntervalSinceReferenceDate;
+            *mayRetire= YES;
+        }
+        
+    } @catch (NSException *e) {
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"exception caught while running thread pool %@: %@ (user info: %@)", self.name, e, e.userInfo];
+        
+    } @finally {
+        invocation= nil;
+        
+        if (_batchSize > 1) {
+            pthread_mutex_lock(&_batchLock);
+            
+            [_batch removeAllObjects];
+            _batchIndex= 0;
+            
+            pthread_mutex_unlock(&_batchLock);
+        }
+    }
+    
+    return YES;
+}
+
+- (LSInvocation *) nextBatchedInvocation {
+    if (_batchSize <= 1)
+        return nil;
+    
+    LSInvocation *invocation= nil;
+    
+    pthread_mutex_lock(&_batchLock);
+    
+    if (_batchIndex < _batch.count) {
+        invocation= _batch[_batchIndex];
+        _batchIndex++;
+    }
+    
+    pthread_mutex_unlock(&_batchLock);
+    
+    return invocation;
+}
+
+- (BOOL) performInvocation:(LSInvocation *)invocation {
+    if (![invocation beginPerforming])
+        return NO;
+    
+    if (_targetQueueWait && invocation.enqueueTime) {
+        
+        // Ask the pool to grow if the invocation waited too long
+        uint64_t queueWait= LSMonotonicNanoseconds() - invocation.enqueueTime;
+        if (queueWait > _targetQueueWait) {
+            LSThreadPool *pool= _pool;
+            [pool queueWaitDidExceedTarget];
+        }
+    }
+    
+    uint64_t start= 0;
+    BOOL failed= NO;
+    
+    if (_metricsRecorder) {
+        start= LSMonotonicNanoseconds();
+        
+        if (invocation.enqueueTime)
+            [_metricsRecorder recordQueueWait:start - invocation.enqueueTime];
+    }
+    
+    // The name is looked up once, finish is traced even if tracing stops meanwhile
+    const char *traceName= NULL;
+    if (LSTraceIsEnabled()) {
+        traceName= LSTraceNameForInvocation(invocation);
+        LSTraceRecordEvent(LSTraceEventTypeCallStarted, (__bridge const void *) invocation, traceName, 0);
+    }
+    
+    @try {
+        [invocation perform];
+        
+    } @catch (NSException *ee) {
+        failed= YES;
+        
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"exception caught while performing invocation on thread pool %@: %@ (user info: %@)", self.name, ee, ee.userInfo];
+        
+    } @finally {
+        if (_metricsRecorder)
+            [_metricsRecorder recordExecutionTime:LSMonotonicNanoseconds() - start failed:failed];
+        
+        if (traceName)
+            LSTraceRecordEvent(LSTraceEventTypeCallFinished, (__bridge const void *) invocation, traceName, 0);
+        
+        // A periodic invocation is rescheduled, unless stopped
+        LSThreadPool *pool= _pool;
+        if (invocation.periodic && pool) {
+            [pool periodicInvocationDidRun:(LSPeriodicInvocation *) invocation];
+            
+        } else {
+            
+            // Wake up threads waiting for completion, if any
+            [invocation completed];
+        }
+    }
+    
+    return YES;
+}
+
+- (void) performFunctionRecord:(LSFunctionRecord *)record {
+
+    uint64_t start= 0;
+    BOOL failed= NO;
+    
+    if (_targetQueueWait || _metricsRecorder)
+        start= LSMonotonicNanoseconds();
+    
+    if (_targetQueueWait && record->enqueueTime && (start - record->enqueueTime > _targetQueueWait)) {
+        
+        // Ask the pool to grow if the call waited too long
+        LSThreadPool *pool= _pool;
+        [pool queueWaitDidExceedTarget];
+    }
+    
+    if (_metricsRecorder && record->enqueueTime)
+        [_metricsRecorder recordQueueWait:start - record->enqueueTime];
+    
+    BOOL traced= LSTraceIsEnabled();
+    if (traced)
+        LSTraceRecordEvent(LSTraceEventTypeCallStarted, record, NULL, (uint64_t) (uintptr_t) record->function);
+    
+    @try {
+        record->function(record->context);
+        
+    } @catch (NSException *ee) {
+        failed= YES;
+        
+        [LSLog sourceType:LOG_SRC_THREAD_POOL source:_pool log:@"exception caught while performing function on thread pool %@: %@ (user info: %@)", self.name, ee, ee.userInfo];
+        
+    } @finally {
+        if (_metricsRecorder)
+            [_metricsRecorder recordExecutionTime:LSMonotonicNanoseconds() - start failed:failed];
+        
+        if (traced)
+            LSTraceRecordEvent(LSTraceEventTypeCallFinished, record, NULL, (uint64_t) (uintptr_t) record->function);
+        
+        // Back to the free list of this thread
+        LSFunctionRecordRelease(record);
+    }
+}
+
+
+- (void) countBatchOfSize:(NSUInteger)size {
+    
+    // Single writer: a relaxed load and store is enough, no need for an atomic increment
+    atomic_store_explicit(&_batchCount, atomic_load_explicit(&_batchCount, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&_batchedInvocationCount, atomic_load_explicit(&_batchedInvocationCount, memory_order_relaxed) + size, memory_order_relaxed);
+}
+
+
 #pragma mark -
 #pragma mark Properties
 
-@synthesize working= _working;
 @synthesize lastActivity= _lastActivity;
+@synthesize queue= _queue;
+@synthesize localDeque= _localDeque;
+@synthesize metricsRecorder= _metricsRecorder;
+
+@dynamic batchSize;
+
+- (NSUInteger) batchSize {
+    return _batchSize;
+}
+
+- (void) setBatchSize:(NSUInteger)batchSize {
+    _batchSize= MAX(batchSize, 1);
+}
+
+@dynamic autoreleaseDrainInterval;
+
+- (NSTimeInterval) autoreleaseDrainInterval {
+    return _autoreleaseDrainInterval / 1000000000.0;
+}
+
+- (void) setAutoreleaseDrainInterval:(NSTimeInterval)autoreleaseDrainInterval {
+    _autoreleaseDrainInterval= (uint64_t) (autoreleaseDrainInterval * 1000000000.0);
+}
+
+@synthesize cpuSet= _cpuSet;
+@synthesize schedulingPolicy= _schedulingPolicy;
+@synthesize niceValue= _niceValue;
+
+@dynamic batchCount;
+
+- (uint64_t) batchCount {
+    return atomic_load_explicit(&_batchCount, memory_order_relaxed);
+}
+
+@dynamic batchedInvocationCount;
+
+- (uint64_t) batchedInvocationCount {
+    return atomic_load_explicit(&_batchedInvocationCount, memory_order_relaxed);
+}
 
 
 @end
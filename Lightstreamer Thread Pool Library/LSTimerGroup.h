@@ -0,0 +1,63 @@
+//
+//  LSTimerGroup.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief LSTimerGroup collects delayed calls scheduled on one or more LSTimerThread, so that they can be cancelled all at once,
+ e.g. all the timeouts of a session being torn down.
+ <br/> Calls join the group when scheduled and leave it when they fire or are cancelled, each in constant time.
+ @see LSTimerThread.
+ */
+@interface LSTimerGroup : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization
+
+/**
+ @brief Creates an empty LSTimerGroup.
+ @return The created group.
+ */
++ (nonnull LSTimerGroup *) group;
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+/**
+ @brief Cancels all the delayed calls of the group that have not fired yet.
+ <br/> The group may still be used to schedule more calls.
+ @return The number of calls cancelled.
+ */
+- (NSUInteger) cancel;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The number of delayed calls of the group that have neither fired nor been cancelled.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+
+@end
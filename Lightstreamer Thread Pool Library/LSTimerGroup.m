@@ -0,0 +1,178 @@
+//
+//  LSTimerGroup.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimerGroup.h"
+#import "LSTimerGroup+Internals.h"
+#import "LSTimerToken.h"
+#import "LSTimerToken+Internals.h"
+
+#import <pthread.h>
+
+
+#pragma mark -
+#pragma mark LSTimerGroup extension
+
+@interface LSTimerGroup () {
+    
+    // Intrusive list of the pending timers of the group
+    LSTimerToken *_head;
+    NSUInteger _count;
+    
+    // Taken after the lock of a timer thread, never before
+    pthread_mutex_t _lock;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSTimerGroup implementation
+
+@implementation LSTimerGroup
+
+
+#pragma mark -
+#pragma mark Initialization
+
++ (LSTimerGroup *) group {
+    LSTimerGroup *group= [[LSTimerGroup alloc] init];
+    
+    return group;
+}
+
+- (instancetype) init {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _head= nil;
+        _count= 0;
+        
+        pthread_mutex_init(&_lock, NULL);
+    }
+    
+    return self;
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+- (NSUInteger) cancel {
+    NSMutableArray<LSTimerToken *> *timers= [[NSMutableArray alloc] init];
+    
+    pthread_mutex_lock(&_lock);
+    
+    // Detach the whole list, timers are cancelled outside of the lock
+    LSTimerToken *timer= _head;
+    _head= nil;
+    _count= 0;
+    
+    while (timer) {
+        LSTimerToken *next= timer.groupNext;
+        
+        timer.groupNext= nil;
+        timer.groupPrevious= nil;
+        timer.inGroup= NO;
+        
+        [timers addObject:timer];
+        timer= next;
+    }
+    
+    pthread_mutex_unlock(&_lock);
+    
+    NSUInteger cancelled= 0;
+    for (LSTimerToken *detached in timers) {
+        if ([detached cancel])
+            cancelled++;
+    }
+    
+    return cancelled;
+}
+
+
+#pragma mark -
+#pragma mark Membership (for internal use only)
+
+- (void) addTimer:(LSTimerToken *)timer {
+    pthread_mutex_lock(&_lock);
+    
+    timer.groupPrevious= nil;
+    timer.groupNext= _head;
+    
+    if (_head)
+        _head.groupPrevious= timer;
+    
+    _head= timer;
+    _count++;
+    
+    timer.inGroup= YES;
+    
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void) removeTimer:(LSTimerToken *)timer {
+    pthread_mutex_lock(&_lock);
+    
+    // May have been detached by a concurrent cancellation of the group
+    if (timer.inGroup) {
+        LSTimerToken *previous= timer.groupPrevious;
+        LSTimerToken *next= timer.groupNext;
+        
+        if (next)
+            next.groupPrevious= previous;
+        
+        if (previous)
+            previous.groupNext= next;
+        else
+            _head= next;
+        
+        timer.groupNext= nil;
+        timer.groupPrevious= nil;
+        timer.inGroup= NO;
+        
+        _count--;
+    }
+    
+    pthread_mutex_unlock(&_lock);
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic count;
+
+- (NSUInteger) count {
+    NSUInteger count= 0;
+    
+    pthread_mutex_lock(&_lock);
+    count= _count;
+    pthread_mutex_unlock(&_lock);
+    
+    return count;
+}
+
+
+@end
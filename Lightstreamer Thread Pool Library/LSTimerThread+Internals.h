@@ -0,0 +1,52 @@
+//
+//  LSTimerThread+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimerThread.h"
+
+
+@class LSTimerToken;
+
+
+#pragma mark -
+#pragma mark LSTimerThread Internals category
+
+@interface LSTimerThread (Internals)
+
+
+#pragma mark -
+#pragma mark Removing timers (for internal use only)
+
+/**
+ @brief Removes the timer from the wheel, if it has not fired yet. Called by LSTimerToken.
+ @return YES if the timer has been cancelled, NO if it had already fired or been cancelled.
+ */
+- (BOOL) cancelTimer:(nonnull LSTimerToken *)timer;
+
+
+#pragma mark -
+#pragma mark Statistics (for internal use only)
+
+/**
+ @brief Adds the current bucket counts of the fire lateness histogram to <code>bucketCounts</code>, and its sum and maximum to <code>sum</code> and <code>max</code>.
+ */
+- (void) accumulateFireLatenessBucketCounts:(nonnull uint64_t *)bucketCounts sum:(nonnull uint64_t *)sum max:(nonnull uint64_t *)max;
+
+
+@end
@@ -21,12 +21,25 @@
 #import <Foundation/Foundation.h>
 
 #import "LSInvocation.h"
+#import "LSTimerToken.h"
+#import "LSTimerGroup.h"
+#import "LSHistogram.h"
+
+
+@class LSThreadPool;
 
 
 /**
  @brief LSTimerThread is a singleton object that provides services to perform delayed calls of any target/selector
  without requiring a run loop on the main thread.
- <br/> A specific thread is started and shared, with an appropriate run loop, to make the delayed calls.
+ <br/> A specific thread is started and shared to make the delayed calls. Timers are kept in a hierarchical timing wheel
+ driven by the monotonic clock, with a resolution of 1 ms: setting and cancelling a timer take constant time, and the thread
+ sleeps until the next non-empty slot of the wheel. Changes of the wall clock don't affect timers.
+ <br/> Each scheduled call returns an LSTimerToken, which may be used to cancel it in constant time. Calls may also
+ be scheduled within an LSTimerGroup, to cancel them all at once. Cancellation by target only looks at the timers of that target.
+ <br/> By default calls are made on the timer thread itself, so a slow call delays all the others. With a <code>callbackPool</code>
+ the timer thread only tracks deadlines, and hands the calls to the pool as they fire.
+ @see LSShardedTimerThread.
  */
 @interface LSTimerThread : NSObject
 
@@ -65,6 +78,12 @@
  */
 - (nonnull instancetype) init NS_UNAVAILABLE;
 
+/**
+ @brief Stops the timer thread. Pending calls are not made.
+ <br/> Use the class method <code>dispose</code> for the singleton.
+ */
+- (void) dispose;
+
 
 #pragma mark -
 #pragma mark Setting and removing timers
@@ -73,9 +92,10 @@
  @brief Schedules a delayed call of a block.
  @param block The block to be executed.
  @param delay Delay of the call, expressed as seconds.
+ @return The token of the delayed call, which may be used to cancel it.
  @throws NSException If the block is <code>nil</code>.
  */
-- (void) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay;
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay;
 
 /**
  @brief Schedules a delayed call of a target and selector with an argument.
@@ -84,9 +104,10 @@
  @param target Target (object) to be called.
  @param argument Single argument (parameter) of the selector. A <code>nil</code> is accepted.
  @param delay Delay of the call, expressed as seconds.
+ @return The token of the delayed call, which may be used to cancel it.
  @throws NSException If the target or selector are <code>nil</code>.
  */
-- (void) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target withObject:(nullable id)argument afterDelay:(NSTimeInterval)delay;
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target withObject:(nullable id)argument afterDelay:(NSTimeInterval)delay;
 
 /**
  @brief Schedules a delayed call of a target and selector with an argument.
@@ -94,9 +115,95 @@
  @param selector Selector (method signature) to be called.
  @param target Target (object) to be called.
  @param delay Delay of the call, expressed as seconds.
+ @return The token of the delayed call, which may be used to cancel it.
  @throws NSException If the target or selector are <code>nil</code>.
  */
-- (void) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target afterDelay:(NSTimeInterval)delay;
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target afterDelay:(NSTimeInterval)delay;
+
+/**
+ @brief Schedules a delayed call of a block within a group.
+ @param block The block to be executed.
+ @param delay Delay of the call, expressed as seconds.
+ @param group The group the call belongs to, which may be used to cancel it along with the other calls of the group.
+ @return The token of the delayed call, which may be used to cancel it.
+ @throws NSException If the block or the group are <code>nil</code>.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay group:(nonnull LSTimerGroup *)group;
+
+/**
+ @brief Schedules a delayed call of a target and selector with an argument within a group.
+ <br/> The selector (method signature) must have exactly one argument.
+ @param selector Selector (method signature) to be called.
+ @param target Target (object) to be called.
+ @param argument Single argument (parameter) of the selector. A <code>nil</code> is accepted.
+ @param delay Delay of the call, expressed as seconds.
+ @param group The group the call belongs to, which may be used to cancel it along with the other calls of the group.
+ @return The token of the delayed call, which may be used to cancel it.
+ @throws NSException If the target, selector or group are <code>nil</code>.
+ */
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target withObject:(nullable id)argument afterDelay:(NSTimeInterval)delay group:(nonnull LSTimerGroup *)group;
+
+/**
+ @brief Schedules a delayed call of a block, which may be deferred by up to a leeway.
+ <br/> Calls whose leeways overlap are fired together with a single wakeup of the thread.
+ @param block The block to be executed.
+ @param delay Delay of the call, expressed as seconds.
+ @param leeway Maximum time the call may be deferred beyond its delay, expressed as seconds.
+ @return The token of the delayed call, which may be used to cancel it.
+ @throws NSException If the block is <code>nil</code>.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway;
+
+/**
+ @brief Schedules a repeating call of a block at a fixed rate.
+ <br/> Runs follow the original schedule, i.e. the initial delay plus a multiple of the period, so that no drift accumulates.
+ Runs missed because the thread was late, e.g. due to a slow call, are skipped, not made up in a burst.
+ @param block The block to be executed.
+ @param initialDelay Delay of the first call, expressed as seconds.
+ @param period Period between the scheduled times of two consecutive calls, expressed as seconds.
+ @param leeway Maximum time each call may be deferred beyond its scheduled time, expressed as seconds.
+ @return The token of the repeating call, which may be used to stop it.
+ @throws NSException If the block is <code>nil</code> or the period is not positive.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period leeway:(NSTimeInterval)leeway;
+
+/**
+ @brief Schedules a repeating call of a block with a fixed delay.
+ <br/> Each run is scheduled the period after the end of the previous one.
+ @param block The block to be executed.
+ @param initialDelay Delay of the first call, expressed as seconds.
+ @param period Delay between the end of a call and the next one, expressed as seconds.
+ @param leeway Maximum time each call may be deferred beyond its scheduled time, expressed as seconds.
+ @return The token of the repeating call, which may be used to stop it.
+ @throws NSException If the block is <code>nil</code> or the period is not positive.
+ */
+- (nonnull LSTimerToken *) performBlock:(nonnull LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)period leeway:(NSTimeInterval)leeway;
+
+/**
+ @brief Schedules a repeating call of a target and selector at a fixed rate.
+ <br/> The selector (method signature) must have no arguments. Runs follow the original schedule, and runs missed are skipped.
+ @param selector Selector (method signature) to be called.
+ @param target Target (object) to be called.
+ @param initialDelay Delay of the first call, expressed as seconds.
+ @param period Period between the scheduled times of two consecutive calls, expressed as seconds.
+ @param leeway Maximum time each call may be deferred beyond its scheduled time, expressed as seconds.
+ @return The token of the repeating call, which may be used to stop it.
+ @throws NSException If the target or selector are <code>nil</code> or the period is not positive.
+ */
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period leeway:(NSTimeInterval)leeway;
+
+/**
+ @brief Schedules a repeating call of a target and selector with a fixed delay.
+ <br/> The selector (method signature) must have no arguments. Each run is scheduled the period after the end of the previous one.
+ @param selector Selector (method signature) to be called.
+ @param target Target (object) to be called.
+ @param initialDelay Delay of the first call, expressed as seconds.
+ @param period Delay between the end of a call and the next one, expressed as seconds.
+ @param leeway Maximum time each call may be deferred beyond its scheduled time, expressed as seconds.
+ @return The token of the repeating call, which may be used to stop it.
+ @throws NSException If the target or selector are <code>nil</code> or the period is not positive.
+ */
+- (nonnull LSTimerToken *) performSelector:(nonnull SEL)selector onTarget:(nonnull id)target initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)period leeway:(NSTimeInterval)leeway;
 
 /**
  @brief Cancels a previously scheduled call to the specified target and selector and with the specified argument.
@@ -128,4 +235,50 @@
 - (void) cancelPreviousPerformRequestsWithTarget:(nonnull id)target;
 
 
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The number of times the thread has woken up to fire calls, or because an earlier call has been set.
+ */
+@property (nonatomic, readonly) NSUInteger wakeUpCount;
+
+/**
+ @brief The thread pool calls are handed to as they fire, or <code>nil</code> to make them on the timer thread. Default is <code>nil</code>.
+ <br/> With a pool, runs of a repeating call are set again by the pool thread once the call is over, as on the timer
+ thread: a fixed delay is counted from the end of the previous run, and runs never overlap. If the pool rejects a call,
+ e.g. because it has been shut down, the call is made on the timer thread. If the pool drops or cancels a queued call,
+ e.g. with a bounded queue or with <code>shutdownNow</code>, a one-shot call is made on the dropping thread, while a run
+ of a repeating call is skipped.
+ */
+@property (nonatomic, strong, nullable) LSThreadPool *callbackPool;
+
+/**
+ @brief The number of calls scheduled and not yet fired or cancelled. Repeating calls are counted until cancelled.
+ */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ @brief The number of calls fired since the thread was created. Each run of a repeating call is counted.
+ */
+@property (nonatomic, readonly) uint64_t firedCount;
+
+/**
+ @brief The number of calls cancelled since the thread was created, by token, by group or by target.
+ */
+@property (nonatomic, readonly) uint64_t cancelledCount;
+
+/**
+ @brief The highest fire lateness of calls since the thread was created, in seconds. Cheaper than a snapshot of <code>fireLateness</code>.
+ */
+@property (nonatomic, readonly) NSTimeInterval maxFireLateness;
+
+/**
+ @brief Histogram of the fire lateness of calls, i.e. the time from their deadline to the start of their execution.
+ <br/> It includes the time spent waiting for the timer thread or the callback pool, and any leeway used to coalesce calls.
+ Each access takes a new snapshot.
+ */
+@property (nonatomic, readonly, nonnull) LSHistogram *fireLateness;
+
+
 @end
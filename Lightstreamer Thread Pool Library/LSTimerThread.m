@@ -19,10 +19,26 @@
 //
 
 #import "LSTimerThread.h"
+#import "LSTimerThread+Internals.h"
+#import "LSTimerToken.h"
+#import "LSTimerToken+Internals.h"
+#import "LSTimerGroup.h"
+#import "LSTimerGroup+Internals.h"
+#import "LSTimingWheel.h"
 #import "LSInvocation.h"
 #import "LSInvocation+Internals.h"
+#import "LSMonotonicClock.h"
+#import "LSThreadPool.h"
+#import "LSThreadPool+Internals.h"
+#import "LSHistogram.h"
+#import "LSHistogram+Internals.h"
 #import "LSLog.h"
 #import "LSLog+Internals.h"
+#import "LSTrace+Internals.h"
+
+#import <stdatomic.h>
+
+#define TIMER_TICK_NSECS                                 (1000000ULL)
 
 
 #pragma mark -
@@ -31,23 +47,53 @@
 @interface LSTimerThread () {
     NSThread *_thread;
     BOOL _running;
+    
+    // Guards the wheel and the target index, and parks the thread
+    NSCondition *_monitor;
+    LSTimingWheel *_wheel;
+    
+    // First timer of each target, with an identity key
+    NSMapTable<id, LSTimerToken *> *_timersByTarget;
+    
+    // Time the thread is parked until, UINT64_MAX if parked indefinitely, 0 if running
+    uint64_t _wakeUpTime;
+    
+    atomic_size_t _wakeUpCount;
+    
+    // Read by the thread with the lock held
+    LSThreadPool *_callbackPool;
+    
+    // Changed with the lock held, read anytime
+    atomic_size_t _pendingCount;
+    atomic_uint_fast64_t _firedCount;
+    atomic_uint_fast64_t _cancelledCount;
+    
+    // Recorded by whichever thread makes the call
+    atomic_uint_fast64_t _latenessBuckets[LS_HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t _latenessSum;
+    atomic_uint_fast64_t _latenessMax;
 }
 
 
 #pragma mark -
-#pragma mark Setting and removing timers on timer thread
+#pragma mark Setting and removing timers
 
-- (void) threadPerformDelayedInvocation:(LSInvocation *)invocation;
-- (void) threadCancelPreviousDelayedPerformWithInfo:(LSInvocation *)invocation;
+- (LSTimerToken *) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay group:(LSTimerGroup *)group;
+- (LSTimerToken *) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate group:(LSTimerGroup *)group;
+- (void) removeCancelledTimer:(LSTimerToken *)timer;
+- (void) cancelTimersWithTarget:(id)target selector:(SEL)selector argument:(id)argument matchingArgument:(BOOL)matchingArgument;
 
-- (void) threadPerformBlockInvocation:(LSInvocation *)invocation;
+- (void) linkTimerToTarget:(LSTimerToken *)timer;
+- (void) unlinkTimerFromTarget:(LSTimerToken *)timer;
 
 
 #pragma mark -
 #pragma mark Thread run loop
 
 - (void) threadRunLoop;
-- (void) threadHeartBeat;
+
+- (void) performTimer:(LSTimerToken *)timer deadline:(uint64_t)deadline;
+- (void) rearmTimer:(LSTimerToken *)timer afterTime:(uint64_t)time;
 
 - (void) stopThread;
 
@@ -88,7 +134,7 @@ static LSTimerThread *__sharedTimer= nil;
     
     @synchronized ([LSTimerThread class]) {
         if (__sharedTimer) {
-            [__sharedTimer stopThread];
+            [__sharedTimer dispose];
             
             __sharedTimer= nil;
         }
@@ -110,6 +156,23 @@ static LSTimerThread *__sharedTimer= nil;
 
         _running= YES;
         
+        _monitor= [[NSCondition alloc] init];
+        _wheel= [[LSTimingWheel alloc] initWithTickNanoseconds:TIMER_TICK_NSECS];
+        _timersByTarget= [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+                                               valueOptions:NSPointerFunctionsStrongMemory];
+        _wakeUpTime= 0;
+        atomic_init(&_wakeUpCount, 0);
+        
+        atomic_init(&_pendingCount, 0);
+        atomic_init(&_firedCount, 0);
+        atomic_init(&_cancelledCount, 0);
+        
+        for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++)
+            atomic_init(&_latenessBuckets[bucket], 0);
+        
+        atomic_init(&_latenessSum, 0);
+        atomic_init(&_latenessMax, 0);
+        
         _thread= [[NSThread alloc] initWithTarget:self selector:@selector(threadRunLoop) object:nil];
         _thread.name= name;
         
@@ -125,68 +188,338 @@ static LSTimerThread *__sharedTimer= nil;
                                  userInfo:nil];
 }
 
+- (void) dispose {
+    [self stopThread];
+}
+
 
 #pragma mark -
 #pragma mark Setting and removing timers
 
-- (void) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay {
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay {
     LSInvocation *invocation= [LSInvocation invocationWithBlock:block delay:delay];
     
-    [self performSelector:@selector(threadPerformDelayedInvocation:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    return [self scheduleInvocation:invocation afterDelay:delay group:nil];
 }
 
-- (void) performSelector:(SEL)selector onTarget:(id)target withObject:(id)argument afterDelay:(NSTimeInterval)delay {
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target withObject:(id)argument afterDelay:(NSTimeInterval)delay {
     LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:argument delay:delay];
     
-    [self performSelector:@selector(threadPerformDelayedInvocation:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    return [self scheduleInvocation:invocation afterDelay:delay group:nil];
 }
 
-- (void) performSelector:(SEL)selector onTarget:(id)target afterDelay:(NSTimeInterval)delay {
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target afterDelay:(NSTimeInterval)delay {
     LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector delay:delay];
     
-    [self performSelector:@selector(threadPerformDelayedInvocation:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    return [self scheduleInvocation:invocation afterDelay:delay group:nil];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay group:(LSTimerGroup *)group {
+    if (!group)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Group can't be nil"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:block delay:delay];
+    
+    return [self scheduleInvocation:invocation afterDelay:delay group:group];
+}
+
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target withObject:(id)argument afterDelay:(NSTimeInterval)delay group:(LSTimerGroup *)group {
+    if (!group)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Group can't be nil"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:argument delay:delay];
+    
+    return [self scheduleInvocation:invocation afterDelay:delay group:group];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway {
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:block delay:delay];
+    
+    return [self scheduleInvocation:invocation afterDelay:delay leeway:leeway period:0.0 fixedRate:NO group:nil];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period leeway:(NSTimeInterval)leeway {
+    if (period <= 0.0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Period must be positive"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:block delay:initialDelay];
+    
+    return [self scheduleInvocation:invocation afterDelay:initialDelay leeway:leeway period:period fixedRate:YES group:nil];
+}
+
+- (LSTimerToken *) performBlock:(LSInvocationBlock)block initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)period leeway:(NSTimeInterval)leeway {
+    if (period <= 0.0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Period must be positive"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithBlock:block delay:initialDelay];
+    
+    return [self scheduleInvocation:invocation afterDelay:initialDelay leeway:leeway period:period fixedRate:NO group:nil];
+}
+
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target initialDelay:(NSTimeInterval)initialDelay fixedRate:(NSTimeInterval)period leeway:(NSTimeInterval)leeway {
+    if (period <= 0.0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Period must be positive"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector delay:initialDelay];
+    
+    return [self scheduleInvocation:invocation afterDelay:initialDelay leeway:leeway period:period fixedRate:YES group:nil];
+}
+
+- (LSTimerToken *) performSelector:(SEL)selector onTarget:(id)target initialDelay:(NSTimeInterval)initialDelay fixedDelay:(NSTimeInterval)period leeway:(NSTimeInterval)leeway {
+    if (period <= 0.0)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Period must be positive"
+                                     userInfo:nil];
+    
+    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector delay:initialDelay];
+    
+    return [self scheduleInvocation:invocation afterDelay:initialDelay leeway:leeway period:period fixedRate:NO group:nil];
 }
 
 - (void) cancelPreviousPerformRequestsWithTarget:(id)target selector:(SEL)selector object:(id)argument {
-    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector argument:argument];
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
     
-    [self performSelector:@selector(threadCancelPreviousDelayedPerformWithInfo:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    [self cancelTimersWithTarget:target selector:selector argument:argument matchingArgument:YES];
 }
 
 - (void) cancelPreviousPerformRequestsWithTarget:(id)target selector:(SEL)selector {
-    LSInvocation *invocation= [LSInvocation invocationWithTarget:target selector:selector];
+    if ((!target) || (!selector))
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target and selector can't be nil"
+                                     userInfo:nil];
     
-    [self performSelector:@selector(threadCancelPreviousDelayedPerformWithInfo:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    [self cancelTimersWithTarget:target selector:selector argument:nil matchingArgument:YES];
 }
 
 - (void) cancelPreviousPerformRequestsWithTarget:(id)target {
-    LSInvocation *invocation= [LSInvocation invocationWithTarget:target];
+    if (!target)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Target can't be nil"
+                                     userInfo:nil];
     
-    [self performSelector:@selector(threadCancelPreviousDelayedPerformWithInfo:) onThread:_thread withObject:invocation waitUntilDone:NO];
+    [self cancelTimersWithTarget:target selector:nil argument:nil matchingArgument:NO];
 }
 
 
 #pragma mark -
-#pragma mark Setting and removing timers on timer thread
+#pragma mark Setting and removing timers (internals)
 
-- (void) threadPerformDelayedInvocation:(LSInvocation *)invocation {
-    if (invocation.block)
-        [self performSelector:@selector(threadPerformBlockInvocation:) withObject:invocation afterDelay:invocation.delay];
-    else
-        [invocation.target performSelector:invocation.selector withObject:invocation.argument afterDelay:invocation.delay];
+- (LSTimerToken *) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay group:(LSTimerGroup *)group {
+    return [self scheduleInvocation:invocation afterDelay:delay leeway:0.0 period:0.0 fixedRate:NO group:group];
+}
+
+- (LSTimerToken *) scheduleInvocation:(LSInvocation *)invocation afterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway period:(NSTimeInterval)period fixedRate:(BOOL)fixedRate group:(LSTimerGroup *)group {
+    uint64_t deadline= LSMonotonicNanoseconds() + ((delay > 0.0) ? (uint64_t) (delay * 1000000000.0) : 0);
+    LSTimerToken *timer= [[LSTimerToken alloc] initWithInvocation:invocation
+                                                         deadline:deadline
+                                                           leeway:((leeway > 0.0) ? (uint64_t) (leeway * 1000000000.0) : 0)
+                                                           period:((period > 0.0) ? (uint64_t) (period * 1000000000.0) : 0)
+                                                        fixedRate:fixedRate
+                                                      timerThread:self
+                                                            group:group];
+    
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeTimerScheduled, (__bridge const void *) timer, LSTraceNameForInvocation(invocation), deadline);
+    
+    [_monitor lock];
+    
+    [_wheel addTimer:timer];
+    atomic_fetch_add_explicit(&_pendingCount, 1, memory_order_relaxed);
+    
+    if (invocation.target)
+        [self linkTimerToTarget:timer];
+    
+    if (group)
+        [group addTimer:timer];
+    
+    // Wake up the thread only if it is parked beyond the new deadline
+    if (deadline < _wakeUpTime)
+        [_monitor signal];
+    
+    [_monitor unlock];
+    
+    return timer;
 }
 
-- (void) threadCancelPreviousDelayedPerformWithInfo:(LSInvocation *)invocation {
-    if (invocation.selector) {
-        [NSObject cancelPreviousPerformRequestsWithTarget:invocation.target selector:invocation.selector object:invocation.argument];
+- (void) removeCancelledTimer:(LSTimerToken *)timer {
+    [_wheel removeTimer:timer];
+    
+    atomic_fetch_sub_explicit(&_pendingCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_cancelledCount, 1, memory_order_relaxed);
+    
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeTimerCancelled, (__bridge const void *) timer, NULL, 0);
+    
+    if (timer.invocation.target)
+        [self unlinkTimerFromTarget:timer];
+    
+    [timer.group removeTimer:timer];
+}
+
+- (void) cancelTimersWithTarget:(id)target selector:(SEL)selector argument:(id)argument matchingArgument:(BOOL)matchingArgument {
+    [_monitor lock];
+    
+    // Only timers of the same target are looked at
+    LSTimerToken *timer= [_timersByTarget objectForKey:target];
+    while (timer) {
+        LSTimerToken *next= timer.targetNext;
+        LSInvocation *invocation= timer.invocation;
+        
+        BOOL matches= YES;
+        if (selector && (invocation.selector != selector))
+            matches= NO;
+        
+        if (matches && matchingArgument && (invocation.argument != argument) && (![invocation.argument isEqual:argument]))
+            matches= NO;
+        
+        if (matches && [timer markCancelled])
+            [self removeCancelledTimer:timer];
+        
+        timer= next;
+    }
+    
+    [_monitor unlock];
+}
+
+- (void) linkTimerToTarget:(LSTimerToken *)timer {
+    id target= timer.invocation.target;
+    LSTimerToken *head= [_timersByTarget objectForKey:target];
+    
+    timer.targetPrevious= nil;
+    timer.targetNext= head;
+    
+    if (head)
+        head.targetPrevious= timer;
+    
+    [_timersByTarget setObject:timer forKey:target];
+}
+
+- (void) unlinkTimerFromTarget:(LSTimerToken *)timer {
+    id target= timer.invocation.target;
+    
+    LSTimerToken *previous= timer.targetPrevious;
+    LSTimerToken *next= timer.targetNext;
+    
+    if (next)
+        next.targetPrevious= previous;
+    
+    if (previous) {
+        previous.targetNext= next;
+        
+    } else if (next) {
+        [_timersByTarget setObject:next forKey:target];
         
     } else {
-        [NSObject cancelPreviousPerformRequestsWithTarget:invocation.target];
+        [_timersByTarget removeObjectForKey:target];
     }
+    
+    timer.targetNext= nil;
+    timer.targetPrevious= nil;
+}
+
+
+#pragma mark -
+#pragma mark Removing timers (for internal use only)
+
+- (BOOL) cancelTimer:(LSTimerToken *)timer {
+    BOOL cancelled= NO;
+    
+    [_monitor lock];
+    
+    // The state is changed only with the lock held, so it can't fire meanwhile
+    cancelled= [timer markCancelled];
+    if (cancelled)
+        [self removeCancelledTimer:timer];
+    
+    [_monitor unlock];
+    
+    return cancelled;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic wakeUpCount;
+
+- (NSUInteger) wakeUpCount {
+    return atomic_load_explicit(&_wakeUpCount, memory_order_relaxed);
+}
+
+@dynamic callbackPool;
+
+- (LSThreadPool *) callbackPool {
+    [_monitor lock];
+    LSThreadPool *callbackPool= _callbackPool;
+    [_monitor unlock];
+    
+    return callbackPool;
+}
+
+- (void) setCallbackPool:(LSThreadPool *)callbackPool {
+    [_monitor lock];
+    _callbackPool= callbackPool;
+    [_monitor unlock];
+}
+
+@dynamic pendingCount;
+
+- (NSUInteger) pendingCount {
+    return atomic_load_explicit(&_pendingCount, memory_order_relaxed);
+}
+
+@dynamic firedCount;
+
+- (uint64_t) firedCount {
+    return atomic_load_explicit(&_firedCount, memory_order_relaxed);
 }
 
-- (void) threadPerformBlockInvocation:(LSInvocation *)invocation {
-    invocation.block();
+@dynamic cancelledCount;
+
+- (uint64_t) cancelledCount {
+    return atomic_load_explicit(&_cancelledCount, memory_order_relaxed);
+}
+
+@dynamic maxFireLateness;
+
+- (NSTimeInterval) maxFireLateness {
+    return ((double) atomic_load_explicit(&_latenessMax, memory_order_relaxed)) / 1000000000.0;
+}
+
+@dynamic fireLateness;
+
+- (LSHistogram *) fireLateness {
+    uint64_t bucketCounts[LS_HISTOGRAM_BUCKETS]= { 0 };
+    uint64_t sum= 0, max= 0;
+    
+    [self accumulateFireLatenessBucketCounts:bucketCounts sum:&sum max:&max];
+    
+    return [[LSHistogram alloc] initWithBucketCounts:bucketCounts sum:sum max:max];
+}
+
+
+#pragma mark -
+#pragma mark Statistics (for internal use only)
+
+- (void) accumulateFireLatenessBucketCounts:(uint64_t *)bucketCounts sum:(uint64_t *)sum max:(uint64_t *)max {
+    for (NSUInteger bucket= 0; bucket < LS_HISTOGRAM_BUCKETS; bucket++)
+        bucketCounts[bucket] += atomic_load_explicit(&_latenessBuckets[bucket], memory_order_relaxed);
+    
+    *sum += atomic_load_explicit(&_latenessSum, memory_order_relaxed);
+    *max= MAX(*max, atomic_load_explicit(&_latenessMax, memory_order_relaxed));
 }
 
 
@@ -195,43 +528,170 @@ static LSTimerThread *__sharedTimer= nil;
 
 - (void) threadRunLoop {
     @autoreleasepool {
-        NSRunLoop *loop= [NSRunLoop currentRunLoop];
-        
         [LSLog sourceType:LOG_SRC_TIMER source:self log:@"thread started"];
         
-        do {
-            @autoreleasepool {
-                NSTimer *timer= [NSTimer timerWithTimeInterval:5.3 target:self selector:@selector(threadHeartBeat) userInfo:nil repeats:NO];
-                @try {
-                    [loop addTimer:timer forMode:NSDefaultRunLoopMode];
+        NSMutableArray<LSTimerToken *> *expiredTimers= [[NSMutableArray alloc] init];
+        NSMutableArray<LSTimerToken *> *performedTimers= [[NSMutableArray alloc] init];
+        
+        [_monitor lock];
+        
+        while (_running) {
+            [_wheel advanceToTime:LSMonotonicNanoseconds() expiredTimers:expiredTimers];
+            
+            if (expiredTimers.count > 0) {
+                for (LSTimerToken *timer in expiredTimers) {
+                    [timer markFired];
+                    atomic_fetch_add_explicit(&_firedCount, 1, memory_order_relaxed);
                     
-                    BOOL ok= [loop runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:4.7]];
-                    if (!ok) {
-                        
-                        // Should never happen, but just in case avoid CPU starvation
-                        [NSThread sleepForTimeInterval:0.1];
-                    }
+                    // Repeating timers stay linked and pending until cancelled
+                    if (timer.repeating)
+                        continue;
                     
-                    [timer invalidate];
+                    atomic_fetch_sub_explicit(&_pendingCount, 1, memory_order_relaxed);
                     
-                } @catch (NSException *e) {
-                    [LSLog sourceType:LOG_SRC_TIMER source:self log:@"exception caught while running thread: %@ (user info: %@)", e, e.userInfo];
+                    if (timer.invocation.target)
+                        [self unlinkTimerFromTarget:timer];
+                    
+                    [timer.group removeTimer:timer];
+                }
+                
+                // Calls are made outside of the lock, so that they may set or cancel timers
+                LSThreadPool *callbackPool= _callbackPool;
+                [_monitor unlock];
+                
+                for (LSTimerToken *timer in expiredTimers) {
+                    uint64_t deadline= timer.deadline;
+                    
+                    if (callbackPool) {
+                        @try {
+                            
+                            // A repeating timer is set again by the pool thread once the call is over,
+                            // so that runs never overlap and a fixed delay is counted from the end
+                            LSInvocation *call= [LSInvocation invocationWithBlock:^{
+                                [self performTimer:timer deadline:deadline];
+                                
+                                if (timer.repeating) {
+                                    [self->_monitor lock];
+                                    [self rearmTimer:timer afterTime:LSMonotonicNanoseconds()];
+                                    [self->_monitor unlock];
+                                }
+                            }];
+                            
+                            // A run of a repeating timer dropped or cancelled by the pool is skipped, as if missed,
+                            // while a one-shot timer has no further run: it is made on the rejecting thread
+                            if (timer.repeating) {
+                                call.rejectionHandler= ^(NSError *error) {
+                                    [self->_monitor lock];
+                                    [self rearmTimer:timer afterTime:LSMonotonicNanoseconds()];
+                                    [self->_monitor unlock];
+                                };
+                                
+                            } else {
+                                call.rejectionHandler= ^(NSError *error) {
+                                    [self performTimer:timer deadline:deadline];
+                                };
+                            }
+                            
+                            [callbackPool scheduleInvocation:call priority:LSThreadPoolPriorityNormal];
+                            continue;
+                            
+                        } @catch (NSException *e) {
+                            [LSLog sourceType:LOG_SRC_TIMER source:self log:@"callback pool rejected call, making it on timer thread: %@", e];
+                        }
+                    }
+                    
+                    [self performTimer:timer deadline:deadline];
+                    [performedTimers addObject:timer];
                 }
+                
+                [_monitor lock];
+                
+                // Set the next run of repeating timers made on this thread
+                uint64_t now= LSMonotonicNanoseconds();
+                for (LSTimerToken *timer in performedTimers)
+                    [self rearmTimer:timer afterTime:now];
+                
+                [expiredTimers removeAllObjects];
+                [performedTimers removeAllObjects];
+                continue;
             }
             
-        } while (_running);
+            // Park until the next non-empty slot of the wheel, or until a new earlier timer is set
+            uint64_t nextEventTime= _wheel.nextEventTime;
+            _wakeUpTime= nextEventTime;
+            
+            if (nextEventTime == UINT64_MAX) {
+                [_monitor wait];
+                
+            } else {
+                uint64_t now= LSMonotonicNanoseconds();
+                if (nextEventTime > now)
+                    [_monitor waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:((double) (nextEventTime - now)) / 1000000000.0]];
+            }
+            
+            _wakeUpTime= 0;
+            atomic_fetch_add_explicit(&_wakeUpCount, 1, memory_order_relaxed);
+        }
+        
+        [_monitor unlock];
         
         [LSLog sourceType:LOG_SRC_TIMER source:self log:@"thread stopped"];
     }
 }
 
-- (void) threadHeartBeat {
+- (void) rearmTimer:(LSTimerToken *)timer afterTime:(uint64_t)time {
     
-    // Dummy method to keep the run loop busy
+    // Called with the monitor locked, a timer cancelled meanwhile is not set again
+    if ((!timer.repeating) || timer.cancelled)
+        return;
+    
+    [timer advanceDeadlineAfterTime:time];
+    [_wheel addTimer:timer];
+    
+    // Traced after the fire of the previous run, so that runs don't overlap in the trace
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeTimerScheduled, (__bridge const void *) timer, LSTraceNameForInvocation(timer.invocation), timer.deadline);
+    
+    // When set from a pool thread, the timer thread may be parked beyond the new deadline
+    if (timer.deadline < _wakeUpTime)
+        [_monitor signal];
 }
 
+- (void) performTimer:(LSTimerToken *)timer deadline:(uint64_t)deadline {
+    uint64_t now= LSMonotonicNanoseconds();
+    uint64_t lateness= (now > deadline) ? (now - deadline) : 0;
+    
+    // Many threads may record at once, when calls are made on a pool
+    atomic_fetch_add_explicit(&_latenessBuckets[LSHistogramBucketForValue(lateness)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_latenessSum, lateness, memory_order_relaxed);
+    
+    uint64_t max= atomic_load_explicit(&_latenessMax, memory_order_relaxed);
+    while ((lateness > max) && (!atomic_compare_exchange_weak_explicit(&_latenessMax, &max, lateness, memory_order_relaxed, memory_order_relaxed)));
+    
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeTimerFired, (__bridge const void *) timer, LSTraceNameForInvocation(timer.invocation), lateness);
+    
+    @autoreleasepool {
+        @try {
+            [timer.invocation perform];
+            
+        } @catch (NSException *e) {
+            [LSLog sourceType:LOG_SRC_TIMER source:self log:@"exception caught while running thread: %@ (user info: %@)", e, e.userInfo];
+        }
+    }
+}
+
+
+#pragma mark -
+#pragma mark Thread management
+
 - (void) stopThread {
+    [_monitor lock];
+    
     _running= NO;
+    [_monitor signal];
+    
+    [_monitor unlock];
     
     _thread= nil;
 }
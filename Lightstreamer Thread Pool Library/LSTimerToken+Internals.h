@@ -0,0 +1,107 @@
+//
+//  LSTimerToken+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimerToken.h"
+#import "LSInvocation.h"
+
+
+@class LSTimerThread;
+
+
+#pragma mark -
+#pragma mark LSTimerToken Internals category
+
+@interface LSTimerToken (Internals)
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) initWithInvocation:(nonnull LSInvocation *)invocation deadline:(uint64_t)deadline timerThread:(nonnull LSTimerThread *)timerThread group:(nullable LSTimerGroup *)group;
+- (nonnull instancetype) initWithInvocation:(nonnull LSInvocation *)invocation deadline:(uint64_t)deadline leeway:(uint64_t)leeway period:(uint64_t)period fixedRate:(BOOL)fixedRate timerThread:(nonnull LSTimerThread *)timerThread group:(nullable LSTimerGroup *)group;
+
+
+#pragma mark -
+#pragma mark State changes (for internal use only)
+
+/**
+ @brief Marks the timer as fired or cancelled. Called by the timer thread, with its lock held.
+ <br/> A repeating timer stays pending when fired.
+ @return YES if the timer was pending, NO otherwise.
+ */
+- (BOOL) markFired;
+- (BOOL) markCancelled;
+
+/**
+ @brief Moves the deadline of a repeating timer to its next run: the next period of the original schedule
+ after the specified time if at a fixed rate, missing the runs already past, or the specified time plus the period if with a fixed delay.
+ */
+- (void) advanceDeadlineAfterTime:(uint64_t)time;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+@property (nonatomic, readonly, nonnull) LSInvocation *invocation;
+
+/**
+ @brief Time the timer is due, on the monotonic clock.
+ */
+@property (nonatomic, readonly) uint64_t deadline;
+
+/**
+ @brief Leeway and period, in nanoseconds.
+ */
+@property (nonatomic, readonly) uint64_t leewayNanoseconds;
+@property (nonatomic, readonly) uint64_t periodNanoseconds;
+
+/**
+ @brief Position in the timing wheel: tick of expiration, level and slot.
+ */
+@property (nonatomic, assign) uint64_t expirationTick;
+@property (nonatomic, assign) NSUInteger level;
+@property (nonatomic, assign) NSUInteger slot;
+
+/**
+ @brief If the timer is linked in the timing wheel.
+ */
+@property (nonatomic, assign) BOOL scheduled;
+
+/**
+ @brief Links of the slot list, owned by the timing wheel.
+ */
+@property (nonatomic, strong, nullable) LSTimerToken *wheelNext;
+@property (nonatomic, unsafe_unretained, nullable) LSTimerToken *wheelPrevious;
+
+/**
+ @brief Links of the target list, owned by the timer thread.
+ */
+@property (nonatomic, strong, nullable) LSTimerToken *targetNext;
+@property (nonatomic, unsafe_unretained, nullable) LSTimerToken *targetPrevious;
+
+/**
+ @brief Links of the group list and membership, owned by the group.
+ */
+@property (nonatomic, strong, nullable) LSTimerToken *groupNext;
+@property (nonatomic, unsafe_unretained, nullable) LSTimerToken *groupPrevious;
+@property (nonatomic, assign) BOOL inGroup;
+
+
+@end
@@ -0,0 +1,91 @@
+//
+//  LSTimerToken.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSTimerGroup;
+
+
+/**
+ @brief LSTimerToken is the handle of a delayed call scheduled on an LSTimerThread.
+ <br/> Each scheduled call has its own token, even if identical to another one, and cancelling it takes constant time.
+ <br/> The token of a repeating call stays the same for all its runs.
+ @see LSTimerThread.
+ */
+@interface LSTimerToken : NSObject
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+/**
+ @brief Cancels the delayed call, if it has not fired yet. A repeating call is stopped: a run already firing is not affected, but no more runs follow.
+ @return YES if the call has been cancelled, NO if it had already fired (or was firing) or had already been cancelled.
+ For a repeating call, NO only if it had already been cancelled.
+ */
+- (BOOL) cancel;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief If the delayed call has fired, i.e. it has been or is being executed. For a repeating call, if it has fired at least once.
+ */
+@property (nonatomic, readonly, getter=hasFired) BOOL fired;
+
+/**
+ @brief The number of times the delayed call has fired: at most 1 unless it is repeating.
+ */
+@property (nonatomic, readonly) NSUInteger fireCount;
+
+/**
+ @brief If the delayed call is repeating, at a fixed rate or with a fixed delay.
+ */
+@property (nonatomic, readonly, getter=isRepeating) BOOL repeating;
+
+/**
+ @brief The period of a repeating call, in seconds, or 0 if it is not repeating.
+ */
+@property (nonatomic, readonly) NSTimeInterval period;
+
+/**
+ @brief If the repeating call runs at a fixed rate, otherwise with a fixed delay.
+ */
+@property (nonatomic, readonly) BOOL fixedRate;
+
+/**
+ @brief The time after its deadline, in seconds, the call may be deferred to in order to fire along with other calls.
+ */
+@property (nonatomic, readonly) NSTimeInterval leeway;
+
+/**
+ @brief If the delayed call has been cancelled, by itself or by its group.
+ */
+@property (nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ @brief The group the delayed call belongs to, if any.
+ */
+@property (nonatomic, readonly, nullable) LSTimerGroup *group;
+
+
+@end
@@ -0,0 +1,229 @@
+//
+//  LSTimerToken.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimerToken.h"
+#import "LSTimerToken+Internals.h"
+#import "LSTimerThread.h"
+#import "LSTimerThread+Internals.h"
+#import "LSTimerGroup.h"
+
+#import <stdatomic.h>
+
+#define TIMER_STATE_PENDING                                (0)
+#define TIMER_STATE_FIRED                                  (1)
+#define TIMER_STATE_CANCELLED                              (2)
+
+
+#pragma mark -
+#pragma mark LSTimerToken extension
+
+@interface LSTimerToken () {
+    LSInvocation *_invocation;
+    uint64_t _deadline;
+    uint64_t _leewayNanoseconds;
+    uint64_t _periodNanoseconds;
+    BOOL _fixedRate;
+    
+    LSTimerThread * __weak _timerThread;
+    LSTimerGroup *_group;
+    
+    // Changed only with the lock of the timer thread held, read anytime
+    atomic_int _state;
+    atomic_size_t _fireCount;
+    
+    uint64_t _expirationTick;
+    NSUInteger _level;
+    NSUInteger _slot;
+    BOOL _scheduled;
+    
+    LSTimerToken *_wheelNext;
+    LSTimerToken * __unsafe_unretained _wheelPrevious;
+    
+    LSTimerToken *_targetNext;
+    LSTimerToken * __unsafe_unretained _targetPrevious;
+    
+    LSTimerToken *_groupNext;
+    LSTimerToken * __unsafe_unretained _groupPrevious;
+    BOOL _inGroup;
+}
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSTimerToken implementation
+
+@implementation LSTimerToken
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithInvocation:(LSInvocation *)invocation deadline:(uint64_t)deadline timerThread:(LSTimerThread *)timerThread group:(LSTimerGroup *)group {
+    return [self initWithInvocation:invocation deadline:deadline leeway:0 period:0 fixedRate:NO timerThread:timerThread group:group];
+}
+
+- (instancetype) initWithInvocation:(LSInvocation *)invocation deadline:(uint64_t)deadline leeway:(uint64_t)leeway period:(uint64_t)period fixedRate:(BOOL)fixedRate timerThread:(LSTimerThread *)timerThread group:(LSTimerGroup *)group {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _invocation= invocation;
+        _deadline= deadline;
+        _leewayNanoseconds= leeway;
+        _periodNanoseconds= period;
+        _fixedRate= fixedRate;
+        
+        _timerThread= timerThread;
+        _group= group;
+        
+        atomic_init(&_state, TIMER_STATE_PENDING);
+        atomic_init(&_fireCount, 0);
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSTimerToken"
+                                 userInfo:nil];
+}
+
+
+#pragma mark -
+#pragma mark Cancellation
+
+- (BOOL) cancel {
+    
+    // Avoid bothering the timer thread for a timer that is already done
+    if (atomic_load_explicit(&_state, memory_order_acquire) != TIMER_STATE_PENDING)
+        return NO;
+    
+    LSTimerThread *timerThread= _timerThread;
+    if (!timerThread)
+        return NO;
+    
+    return [timerThread cancelTimer:self];
+}
+
+
+#pragma mark -
+#pragma mark State changes (for internal use only)
+
+- (BOOL) markFired {
+    atomic_fetch_add_explicit(&_fireCount, 1, memory_order_relaxed);
+    
+    // A repeating timer is done only when cancelled
+    if (_periodNanoseconds)
+        return (atomic_load_explicit(&_state, memory_order_acquire) == TIMER_STATE_PENDING);
+    
+    int expected= TIMER_STATE_PENDING;
+    
+    return atomic_compare_exchange_strong_explicit(&_state, &expected, TIMER_STATE_FIRED, memory_order_acq_rel, memory_order_acquire);
+}
+
+- (BOOL) markCancelled {
+    int expected= TIMER_STATE_PENDING;
+    
+    return atomic_compare_exchange_strong_explicit(&_state, &expected, TIMER_STATE_CANCELLED, memory_order_acq_rel, memory_order_acquire);
+}
+
+- (void) advanceDeadlineAfterTime:(uint64_t)time {
+    if (!_periodNanoseconds)
+        return;
+    
+    if (!_fixedRate) {
+        _deadline= time + _periodNanoseconds;
+        return;
+    }
+    
+    // Stick to the original schedule, so that no drift accumulates, and skip the runs already missed
+    _deadline += _periodNanoseconds;
+    if (_deadline <= time)
+        _deadline += (((time - _deadline) / _periodNanoseconds) + 1) * _periodNanoseconds;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic fired;
+
+- (BOOL) hasFired {
+    return (atomic_load_explicit(&_fireCount, memory_order_acquire) > 0);
+}
+
+@dynamic fireCount;
+
+- (NSUInteger) fireCount {
+    return atomic_load_explicit(&_fireCount, memory_order_relaxed);
+}
+
+@dynamic repeating;
+
+- (BOOL) isRepeating {
+    return (_periodNanoseconds > 0);
+}
+
+@dynamic period;
+
+- (NSTimeInterval) period {
+    return ((double) _periodNanoseconds) / 1000000000.0;
+}
+
+@synthesize fixedRate= _fixedRate;
+
+@dynamic leeway;
+
+- (NSTimeInterval) leeway {
+    return ((double) _leewayNanoseconds) / 1000000000.0;
+}
+
+@dynamic cancelled;
+
+- (BOOL) isCancelled {
+    return (atomic_load_explicit(&_state, memory_order_acquire) == TIMER_STATE_CANCELLED);
+}
+
+@synthesize group= _group;
+
+@synthesize invocation= _invocation;
+@synthesize deadline= _deadline;
+@synthesize leewayNanoseconds= _leewayNanoseconds;
+@synthesize periodNanoseconds= _periodNanoseconds;
+
+@synthesize expirationTick= _expirationTick;
+@synthesize level= _level;
+@synthesize slot= _slot;
+@synthesize scheduled= _scheduled;
+
+@synthesize wheelNext= _wheelNext;
+@synthesize wheelPrevious= _wheelPrevious;
+
+@synthesize targetNext= _targetNext;
+@synthesize targetPrevious= _targetPrevious;
+
+@synthesize groupNext= _groupNext;
+@synthesize groupPrevious= _groupPrevious;
+@synthesize inGroup= _inGroup;
+
+
+@end
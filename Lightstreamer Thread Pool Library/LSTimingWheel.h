@@ -0,0 +1,86 @@
+//
+//  LSTimingWheel.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSTimerToken;
+
+
+/**
+ @brief A hierarchical timing wheel, used by LSTimerThread to keep its timers. <b>This class should not be used directly</b>.
+ <br/> Time is measured in ticks of the monotonic clock since the wheel was created. The wheel has 4 levels of 256 slots:
+ a timer goes to the level of the highest digit (in base 256) where its expiration tick differs from the current tick,
+ in the slot of that digit. Timers due beyond the range of the wheel go to an overflow list.
+ <br/> Adding and removing a timer take constant time, since slots are intrusive doubly-linked lists. As the wheel
+ advances, slots of upper levels are cascaded to lower levels when their time comes, and slots of level 0 expire.
+ A bitmap of non-empty slots per level lets the wheel jump directly to the next slot to be cascaded or expired.
+ <br/> The wheel is not thread safe, its owner must provide synchronization.
+ @see LSTimerThread.
+ */
+@interface LSTimingWheel : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+/**
+ @brief Initializes the wheel with the specified tick length, starting at the current time of the monotonic clock.
+ */
+- (nonnull instancetype) initWithTickNanoseconds:(uint64_t)tickNanoseconds NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+
+#pragma mark -
+#pragma mark Wheel operations (for internal use only)
+
+/**
+ @brief Adds the timer to the slot of its deadline. Timers already due expire at the next tick.
+ <br/> If the timer has a leeway, its expiration is moved to the tick with most trailing zeros between its deadline and
+ its deadline plus the leeway: timers whose leeways overlap tend to end up in the same slot, and expire with a single wakeup.
+ */
+- (void) addTimer:(nonnull LSTimerToken *)timer;
+
+/**
+ @brief Removes the timer from its slot, if still scheduled.
+ @return YES if the timer has been removed, NO if it was not scheduled.
+ */
+- (BOOL) removeTimer:(nonnull LSTimerToken *)timer;
+
+/**
+ @brief Advances the wheel to the specified time of the monotonic clock, moving the timers expired meanwhile to the array, in order of expiration.
+ */
+- (void) advanceToTime:(uint64_t)time expiredTimers:(nonnull NSMutableArray<LSTimerToken *> *)expiredTimers;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+/**
+ @brief Time of the monotonic clock when the wheel must be advanced next, to cascade or expire its next non-empty slot. <code>UINT64_MAX</code> if the wheel is empty.
+ */
+@property (nonatomic, readonly) uint64_t nextEventTime;
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) uint64_t tickNanoseconds;
+
+
+@end
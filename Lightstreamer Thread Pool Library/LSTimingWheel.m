@@ -0,0 +1,357 @@
+//
+//  LSTimingWheel.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTimingWheel.h"
+#import "LSTimerToken.h"
+#import "LSTimerToken+Internals.h"
+#import "LSMonotonicClock.h"
+
+#define TIMING_WHEEL_LEVELS                                    (4)
+#define TIMING_WHEEL_SLOT_BITS                                 (8)
+#define TIMING_WHEEL_SLOTS                                   (256)
+#define TIMING_WHEEL_SLOT_MASK                      (TIMING_WHEEL_SLOTS - 1)
+#define TIMING_WHEEL_BITMAP_WORDS                   (TIMING_WHEEL_SLOTS / 64)
+
+// Level of timers beyond the range of the wheel
+#define TIMING_WHEEL_OVERFLOW_LEVEL                 (TIMING_WHEEL_LEVELS)
+
+
+static inline NSInteger LSNextOccupiedSlot(const uint64_t *bitmap, NSUInteger after) {
+    NSUInteger start= after + 1;
+    
+    for (NSUInteger word= start / 64; word < TIMING_WHEEL_BITMAP_WORDS; word++) {
+        uint64_t bits= bitmap[word];
+        if (word == start / 64)
+            bits &= (~0ULL << (start % 64));
+        
+        if (bits)
+            return (NSInteger) ((word * 64) + __builtin_ctzll(bits));
+    }
+    
+    return -1;
+}
+
+
+static void LSReleaseTimerList(LSTimerToken *timer) {
+    while (timer) {
+        LSTimerToken *next= timer.wheelNext;
+        timer.wheelNext= nil;
+        timer= next;
+    }
+}
+
+
+#pragma mark -
+#pragma mark LSTimingWheel extension
+
+@interface LSTimingWheel () {
+    uint64_t _tickNanoseconds;
+    uint64_t _startTime;
+    uint64_t _currentTick;
+    
+    LSTimerToken *_slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+    uint64_t _occupied[TIMING_WHEEL_LEVELS][TIMING_WHEEL_BITMAP_WORDS];
+    
+    LSTimerToken *_overflow;
+    
+    NSUInteger _count;
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (void) placeTimer:(LSTimerToken *)timer;
+- (void) unlinkTimer:(LSTimerToken *)timer;
+- (LSTimerToken *) detachSlot:(NSUInteger)slot level:(NSUInteger)level;
+- (uint64_t) nextEventTick;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSTimingWheel implementation
+
+@implementation LSTimingWheel
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithTickNanoseconds:(uint64_t)tickNanoseconds {
+    if ((self = [super init])) {
+        
+        // Initialization
+        if (!tickNanoseconds)
+            @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                           reason:@"Tick length must be greater than 0"
+                                         userInfo:nil];
+        
+        _tickNanoseconds= tickNanoseconds;
+        _startTime= LSMonotonicNanoseconds();
+        _currentTick= 0;
+        
+        memset(_occupied, 0, sizeof(_occupied));
+        
+        _overflow= nil;
+        _count= 0;
+    }
+    
+    return self;
+}
+
+- (void) dealloc {
+    
+    // Break the lists one link at a time, to avoid a deep recursion of releases
+    for (NSUInteger level= 0; level < TIMING_WHEEL_LEVELS; level++) {
+        for (NSUInteger slot= 0; slot < TIMING_WHEEL_SLOTS; slot++)
+            LSReleaseTimerList(_slots[level][slot]);
+    }
+    
+    LSReleaseTimerList(_overflow);
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSTimingWheel"
+                                 userInfo:nil];
+}
+
+
+#pragma mark -
+#pragma mark Wheel operations
+
+- (void) addTimer:(LSTimerToken *)timer {
+    uint64_t deadline= timer.deadline;
+    
+    // Round up, a timer must never expire early
+    uint64_t tick= (deadline > _startTime) ? (((deadline - _startTime) + _tickNanoseconds - 1) / _tickNanoseconds) : 0;
+    
+    // The current slot has already expired
+    if (tick <= _currentTick)
+        tick= _currentTick + 1;
+    
+    // Coalesce with other timers, moving to the most aligned tick within the leeway
+    uint64_t leeway= timer.leewayNanoseconds;
+    if (leeway) {
+        uint64_t latestTick= ((deadline + leeway) > _startTime) ? (((deadline + leeway) - _startTime) / _tickNanoseconds) : 0;
+        
+        if (latestTick > tick) {
+            uint64_t alignmentMask= (1ULL << (63 - __builtin_clzll(tick ^ latestTick))) - 1;
+            tick= latestTick & ~alignmentMask;
+        }
+    }
+    
+    timer.expirationTick= tick;
+    
+    [self placeTimer:timer];
+    _count++;
+}
+
+- (BOOL) removeTimer:(LSTimerToken *)timer {
+    if (!timer.scheduled)
+        return NO;
+    
+    [self unlinkTimer:timer];
+    _count--;
+    
+    return YES;
+}
+
+- (void) advanceToTime:(uint64_t)time expiredTimers:(NSMutableArray<LSTimerToken *> *)expiredTimers {
+    if (time < _startTime)
+        return;
+    
+    uint64_t targetTick= (time - _startTime) / _tickNanoseconds;
+    
+    while (_currentTick < targetTick) {
+        
+        // Jump over empty slots, nothing to cascade or expire there
+        uint64_t nextTick= [self nextEventTick];
+        if (nextTick > targetTick) {
+            _currentTick= targetTick;
+            break;
+        }
+        
+        _currentTick= nextTick;
+        
+        // Cascade from the highest level, so that timers may go down more than one level
+        for (NSUInteger level= TIMING_WHEEL_OVERFLOW_LEVEL; level > 0; level--) {
+            uint64_t lowerMask= (1ULL << (level * TIMING_WHEEL_SLOT_BITS)) - 1;
+            if (_currentTick & lowerMask)
+                continue;
+            
+            NSUInteger slot= (level == TIMING_WHEEL_OVERFLOW_LEVEL) ? 0 : (NSUInteger) ((_currentTick >> (level * TIMING_WHEEL_SLOT_BITS)) & TIMING_WHEEL_SLOT_MASK);
+            
+            LSTimerToken *timer= [self detachSlot:slot level:level];
+            while (timer) {
+                LSTimerToken *next= timer.wheelNext;
+                timer.wheelNext= nil;
+                
+                [self placeTimer:timer];
+                timer= next;
+            }
+        }
+        
+        // Then expire the slot of level 0
+        LSTimerToken *timer= [self detachSlot:(NSUInteger) (_currentTick & TIMING_WHEEL_SLOT_MASK) level:0];
+        while (timer) {
+            LSTimerToken *next= timer.wheelNext;
+            timer.wheelNext= nil;
+            
+            [expiredTimers addObject:timer];
+            _count--;
+            
+            timer= next;
+        }
+    }
+}
+
+
+#pragma mark -
+#pragma mark Internals
+
+- (void) placeTimer:(LSTimerToken *)timer {
+    uint64_t tick= timer.expirationTick;
+    
+    NSUInteger level= 0;
+    NSUInteger slot= 0;
+    
+    if (tick <= _currentTick) {
+        
+        // Cascaded to its very tick: expires with the current slot
+        slot= (NSUInteger) (_currentTick & TIMING_WHEEL_SLOT_MASK);
+        
+    } else {
+        
+        // The level is that of the highest digit that differs from the current tick
+        uint64_t difference= tick ^ _currentTick;
+        level= (NSUInteger) ((63 - __builtin_clzll(difference)) / TIMING_WHEEL_SLOT_BITS);
+        
+        if (level >= TIMING_WHEEL_LEVELS)
+            level= TIMING_WHEEL_OVERFLOW_LEVEL;
+        else
+            slot= (NSUInteger) ((tick >> (level * TIMING_WHEEL_SLOT_BITS)) & TIMING_WHEEL_SLOT_MASK);
+    }
+    
+    LSTimerToken * __strong *head= (level == TIMING_WHEEL_OVERFLOW_LEVEL) ? &_overflow : &_slots[level][slot];
+    
+    timer.level= level;
+    timer.slot= slot;
+    timer.wheelPrevious= nil;
+    timer.wheelNext= *head;
+    
+    if (*head)
+        (*head).wheelPrevious= timer;
+    
+    *head= timer;
+    timer.scheduled= YES;
+    
+    if (level < TIMING_WHEEL_LEVELS)
+        _occupied[level][slot / 64] |= (1ULL << (slot % 64));
+}
+
+- (void) unlinkTimer:(LSTimerToken *)timer {
+    NSUInteger level= timer.level;
+    NSUInteger slot= timer.slot;
+    
+    LSTimerToken * __strong *head= (level == TIMING_WHEEL_OVERFLOW_LEVEL) ? &_overflow : &_slots[level][slot];
+    
+    LSTimerToken *previous= timer.wheelPrevious;
+    LSTimerToken *next= timer.wheelNext;
+    
+    if (next)
+        next.wheelPrevious= previous;
+    
+    if (previous)
+        previous.wheelNext= next;
+    else
+        *head= next;
+    
+    timer.wheelNext= nil;
+    timer.wheelPrevious= nil;
+    timer.scheduled= NO;
+    
+    if ((!*head) && (level < TIMING_WHEEL_LEVELS))
+        _occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+- (LSTimerToken *) detachSlot:(NSUInteger)slot level:(NSUInteger)level {
+    LSTimerToken * __strong *head= (level == TIMING_WHEEL_OVERFLOW_LEVEL) ? &_overflow : &_slots[level][slot];
+    
+    LSTimerToken *timer= *head;
+    *head= nil;
+    
+    if (level < TIMING_WHEEL_LEVELS)
+        _occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+    
+    // Timers of the detached list are no more scheduled, until placed again
+    for (LSTimerToken *unlinked= timer; unlinked; unlinked= unlinked.wheelNext) {
+        unlinked.wheelPrevious= nil;
+        unlinked.scheduled= NO;
+    }
+    
+    return timer;
+}
+
+- (uint64_t) nextEventTick {
+    
+    // Slots of a level are all after the current one, and all before the next slot of the upper level
+    for (NSUInteger level= 0; level < TIMING_WHEEL_LEVELS; level++) {
+        NSUInteger shift= level * TIMING_WHEEL_SLOT_BITS;
+        NSUInteger current= (NSUInteger) ((_currentTick >> shift) & TIMING_WHEEL_SLOT_MASK);
+        
+        NSInteger slot= LSNextOccupiedSlot(_occupied[level], current);
+        if (slot < 0)
+            continue;
+        
+        uint64_t upperBits= (_currentTick >> (shift + TIMING_WHEEL_SLOT_BITS)) << (shift + TIMING_WHEEL_SLOT_BITS);
+        return upperBits | (((uint64_t) slot) << shift);
+    }
+    
+    // Timers in overflow are reconsidered when the whole wheel wraps
+    if (_overflow) {
+        NSUInteger shift= TIMING_WHEEL_LEVELS * TIMING_WHEEL_SLOT_BITS;
+        return ((_currentTick >> shift) + 1) << shift;
+    }
+    
+    return UINT64_MAX;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@dynamic nextEventTime;
+
+- (uint64_t) nextEventTime {
+    uint64_t tick= [self nextEventTick];
+    if (tick == UINT64_MAX)
+        return UINT64_MAX;
+    
+    return _startTime + (tick * _tickNanoseconds);
+}
+
+@synthesize count= _count;
+@synthesize tickNanoseconds= _tickNanoseconds;
+
+
+@end
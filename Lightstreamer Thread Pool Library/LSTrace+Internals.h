@@ -0,0 +1,98 @@
+//
+//  LSTrace+Internals.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTrace.h"
+
+#import <stdint.h>
+#import <stdatomic.h>
+
+
+@class LSInvocation;
+
+
+/**
+ @brief Types of trace events. <b>For internal use only</b>.
+ */
+typedef NS_ENUM(uint32_t, LSTraceEventType) {
+    
+    // Object is the invocation or function record, name its selector, argument the function or,
+    // if not 0, the due time of a delayed call. A call rejected, dropped or cancelled once enqueued is discarded
+    LSTraceEventTypeCallEnqueued= 1,
+    LSTraceEventTypeCallStarted,
+    LSTraceEventTypeCallFinished,
+    LSTraceEventTypeCallDiscarded,
+    
+    // Object is the timer token, name its selector, argument the deadline when scheduled or the lateness when fired
+    LSTraceEventTypeTimerScheduled,
+    LSTraceEventTypeTimerFired,
+    LSTraceEventTypeTimerCancelled,
+    
+    // Object is the dispatch operation, name its interned end-point, argument the status code of a response,
+    // the length of data or the outcome when finished
+    LSTraceEventTypeOperationQueued,
+    LSTraceEventTypeOperationStarted,
+    LSTraceEventTypeOperationResponse,
+    LSTraceEventTypeOperationData,
+    LSTraceEventTypeOperationFinished
+};
+
+/**
+ @brief Outcomes of a finished dispatch operation, used as argument of its trace event. <b>For internal use only</b>.
+ */
+typedef NS_ENUM(uint64_t, LSTraceOperationOutcome) {
+    LSTraceOperationOutcomeCompleted= 0,
+    LSTraceOperationOutcomeFailed,
+    LSTraceOperationOutcomeCancelled,
+    LSTraceOperationOutcomeTimedOut
+};
+
+
+/**
+ @brief Set while tracing is on. <b>For internal use only</b>, use <code>LSTraceIsEnabled()</code>.
+ */
+extern atomic_bool LSTraceEnabledFlag;
+
+/**
+ @brief Tells if tracing is on. <b>For internal use only</b>.
+ <br/> Call sites check it before computing the arguments of an event, so that tracing costs a single load when off.
+ */
+static inline BOOL LSTraceIsEnabled(void) {
+    return atomic_load_explicit(&LSTraceEnabledFlag, memory_order_relaxed);
+}
+
+/**
+ @brief Appends an event to the buffer of the calling thread. <b>For internal use only</b>.
+ @param type The type of the event.
+ @param object The object the event refers to, used to match events of the same call, timer or operation.
+ @param name A C string that must outlive the trace, such as a selector name or an interned string, or NULL.
+ @param argument A value whose meaning depends on the type.
+ */
+void LSTraceRecordEvent(LSTraceEventType type, const void *object, const char *name, uint64_t argument);
+
+/**
+ @brief Returns a C string with the same content of the given string, that lives as long as the process. <b>For internal use only</b>.
+ <br/> Meant for a small set of recurring strings, such as end-points: interned strings are never freed.
+ */
+const char *LSTraceInternString(NSString *string);
+
+/**
+ @brief Returns the name of a scheduled call to be used in trace events: its selector name, or "block". <b>For internal use only</b>.
+ */
+const char *LSTraceNameForInvocation(LSInvocation *invocation);
@@ -0,0 +1,104 @@
+//
+//  LSTrace.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ @brief LSTrace records structured events of thread pools, timer threads and URL dispatch operations, and exports them
+ in the Chrome trace event format, to be opened with Perfetto or <code>chrome://tracing</code>.
+ <br/> Tracing is off by default and costs a single relaxed load per event when off. When on, each thread appends compact
+ binary events with a monotonic timestamp to a buffer of its own, with no locks. Recorded events are: <ul>
+ <li>for LSThreadPool, enqueue, start and finish of each scheduled call;
+ <li>for LSTimerThread, schedule, fire and cancel of each timer;
+ <li>for LSURLDispatchOperation, queued, started, response, data and finished of each request.
+ </ul> Buffers do not wrap: once a thread's buffer is full, its further events are dropped and counted, so that the
+ beginning of a trace is always complete. Buffers survive their threads, and can be exported at any time.
+ */
+@interface LSTrace : NSObject
+
+
+#pragma mark -
+#pragma mark Tracing control
+
+/**
+ @brief Starts a new trace, with a default buffer of 16384 events per thread. Events of a previous trace are discarded.
+ */
++ (void) startTracing;
+
+/**
+ @brief Starts a new trace. Events of a previous trace are discarded.
+ @param bufferSize The number of events the buffer of each thread can hold.
+ @throws NSException If the buffer size is 0.
+ */
++ (void) startTracingWithBufferSize:(NSUInteger)bufferSize;
+
+/**
+ @brief Stops tracing. Events recorded so far are kept until the next trace is started, or until <code>clear</code> is called.
+ */
++ (void) stopTracing;
+
+/**
+ @brief Tells if tracing is on.
+ */
++ (BOOL) isTracing;
+
+/**
+ @brief Discards recorded events and frees the buffers of threads that have exited.
+ */
++ (void) clear;
+
+
+#pragma mark -
+#pragma mark Export
+
+/**
+ @brief Exports recorded events as a Chrome trace, in JSON object format.
+ <br/> Scheduled calls are shown as slices on the threads that run them, preceded by an asynchronous "queued" slice that
+ spans their queue wait. Timers and URL requests are shown as asynchronous slices from schedule to fire or cancel, and from
+ queued to finished, respectively.
+ @return The UTF-8 encoded JSON of the trace.
+ */
++ (nonnull NSData *) chromeTraceData;
+
+/**
+ @brief Exports recorded events as a Chrome trace to a file.
+ @param path The path of the file to be written.
+ @param error Set to the reason of the failure, if the file could not be written.
+ @return YES if the file has been written.
+ */
++ (BOOL) writeChromeTraceToFile:(nonnull NSString *)path error:(NSError * _Nullable __autoreleasing * _Nullable)error;
+
+
+#pragma mark -
+#pragma mark Properties
+
+/**
+ @brief The number of events recorded in the current trace.
+ */
++ (NSUInteger) eventCount;
+
+/**
+ @brief The number of events dropped in the current trace because a thread's buffer was full.
+ */
++ (uint64_t) droppedEventCount;
+
+
+@end
@@ -0,0 +1,524 @@
+//
+//  LSTrace.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSTrace.h"
+#import "LSTrace+Internals.h"
+#import "LSInvocation.h"
+#import "LSMonotonicClock.h"
+
+#import <objc/runtime.h>
+#import <pthread.h>
+#import <unistd.h>
+#import <dlfcn.h>
+
+#define TRACE_DEFAULT_BUFFER_SIZE             (16384)
+#define TRACE_MAX_NAME_LENGTH                 (256)
+#define TRACE_MAX_LINE_LENGTH                 (1024)
+
+
+#pragma mark -
+#pragma mark Trace buffers
+
+typedef struct {
+    uint64_t time;
+    const void *object;
+    const char *name;
+    uint64_t argument;
+    LSTraceEventType type;
+} LSTraceEvent;
+
+typedef struct LSTraceBuffer {
+    
+    // Guarded by the buffers lock
+    struct LSTraceBuffer *next;
+    
+    // Retained NSString, the name of the thread when it first traced
+    void *threadName;
+    NSUInteger threadIndex;
+    
+    NSUInteger capacity;
+    
+    // Written by the owner thread only: events below the count are never modified
+    // until the owner sees a new generation and starts over
+    atomic_uint_fast64_t generation;
+    atomic_size_t count;
+    
+    // Set when the owner thread exits or replaces the buffer, the buffer is freed by the next clear
+    atomic_bool exited;
+    
+    LSTraceEvent events[];
+} LSTraceBuffer;
+
+
+#pragma mark -
+#pragma mark LSTrace statics
+
+atomic_bool LSTraceEnabledFlag= false;
+
+static atomic_size_t __bufferSize= TRACE_DEFAULT_BUFFER_SIZE;
+static atomic_uint_fast64_t __droppedEventCount= 0;
+
+// Changed with the buffers lock held, so that it can't change during an export
+static atomic_uint_fast64_t __generation= 1;
+static uint64_t __startTime= 0;
+
+static LSTraceBuffer *__buffers= NULL;
+static NSUInteger __nextThreadIndex= 1;
+static pthread_mutex_t __buffersLock= PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t __bufferKey;
+static pthread_once_t __bufferKeyOnce= PTHREAD_ONCE_INIT;
+
+static NSMutableDictionary<NSString *, NSValue *> *__internedStrings= nil;
+static pthread_mutex_t __internedStringsLock= PTHREAD_MUTEX_INITIALIZER;
+
+
+#pragma mark -
+#pragma mark Buffer management
+
+static void LSTraceBufferExit(void *value) {
+    LSTraceBuffer *buffer= value;
+    
+    // Events stay available for export, the buffer is freed by the next clear
+    atomic_store_explicit(&buffer->exited, true, memory_order_release);
+}
+
+static void LSTraceBufferKeyCreate(void) {
+    pthread_key_create(&__bufferKey, LSTraceBufferExit);
+}
+
+static NSString *LSTraceCurrentThreadName(void) {
+    NSThread *thread= [NSThread currentThread];
+    
+    return (thread.name.length > 0) ? thread.name : [NSString stringWithFormat:@"Thread %p", thread];
+}
+
+static LSTraceBuffer *LSTraceBufferCreate(uint64_t generation) {
+    size_t capacity= atomic_load_explicit(&__bufferSize, memory_order_relaxed);
+    
+    LSTraceBuffer *buffer= calloc(1, sizeof(LSTraceBuffer) + capacity * sizeof(LSTraceEvent));
+    if (!buffer)
+        return NULL;
+    
+    buffer->threadName= (__bridge_retained void *) LSTraceCurrentThreadName();
+    buffer->capacity= capacity;
+    
+    atomic_init(&buffer->generation, generation);
+    atomic_init(&buffer->count, 0);
+    atomic_init(&buffer->exited, false);
+    
+    pthread_mutex_lock(&__buffersLock);
+    
+    buffer->threadIndex= __nextThreadIndex++;
+    buffer->next= __buffers;
+    __buffers= buffer;
+    
+    pthread_mutex_unlock(&__buffersLock);
+    
+    pthread_setspecific(__bufferKey, buffer);
+    
+    return buffer;
+}
+
+static inline LSTraceBuffer *LSTraceCurrentBuffer(void) {
+    pthread_once(&__bufferKeyOnce, LSTraceBufferKeyCreate);
+    
+    uint64_t generation= atomic_load_explicit(&__generation, memory_order_acquire);
+    
+    LSTraceBuffer *buffer= pthread_getspecific(__bufferKey);
+    if (!buffer)
+        return LSTraceBufferCreate(generation);
+    
+    if (atomic_load_explicit(&buffer->generation, memory_order_relaxed) != generation) {
+        
+        // A new trace has started: the buffer is replaced if its size has changed, reused otherwise
+        if (buffer->capacity != atomic_load_explicit(&__bufferSize, memory_order_relaxed)) {
+            atomic_store_explicit(&buffer->exited, true, memory_order_release);
+            
+            return LSTraceBufferCreate(generation);
+        }
+        
+        // The count is reset before the generation is published, so that an export
+        // that sees the new generation never sees events of the old one
+        atomic_store_explicit(&buffer->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&buffer->generation, generation, memory_order_release);
+    }
+    
+    return buffer;
+}
+
+static void LSTraceBufferFree(LSTraceBuffer *buffer) {
+    
+    // Hand the thread name back to ARC, which releases it
+    (void) (__bridge_transfer NSString *) buffer->threadName;
+    
+    free(buffer);
+}
+
+
+#pragma mark -
+#pragma mark Event recording
+
+void LSTraceRecordEvent(LSTraceEventType type, const void *object, const char *name, uint64_t argument) {
+    LSTraceBuffer *buffer= LSTraceCurrentBuffer();
+    if (!buffer)
+        return;
+    
+    size_t count= atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (count == buffer->capacity) {
+        atomic_fetch_add_explicit(&__droppedEventCount, 1, memory_order_relaxed);
+        return;
+    }
+    
+    LSTraceEvent *event= &buffer->events[count];
+    event->time= LSMonotonicNanoseconds();
+    event->object= object;
+    event->name= name;
+    event->argument= argument;
+    event->type= type;
+    
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+const char *LSTraceInternString(NSString *string) {
+    pthread_mutex_lock(&__internedStringsLock);
+    
+    if (!__internedStrings)
+        __internedStrings= [[NSMutableDictionary alloc] init];
+    
+    NSValue *value= __internedStrings[string];
+    if (!value) {
+        char *interned= strdup(string.UTF8String ?: "");
+        
+        value= [NSValue valueWithPointer:interned];
+        __internedStrings[[string copy]]= value;
+    }
+    
+    pthread_mutex_unlock(&__internedStringsLock);
+    
+    return value.pointerValue;
+}
+
+const char *LSTraceNameForInvocation(LSInvocation *invocation) {
+    SEL selector= invocation.selector;
+    
+    return selector ? sel_getName(selector) : "block";
+}
+
+
+#pragma mark -
+#pragma mark JSON formatting
+
+static void LSTraceEscape(const char *string, char *escaped) {
+    size_t length= 0;
+    
+    for (const char *c= string; *c && (length < TRACE_MAX_NAME_LENGTH - 2); c++) {
+        
+        // Control characters have no place in names, they are just skipped
+        if ((unsigned char) *c < 0x20)
+            continue;
+        
+        if ((*c == '"') || (*c == '\\'))
+            escaped[length++]= '\\';
+        
+        escaped[length++]= *c;
+    }
+    
+    escaped[length]= '\0';
+}
+
+static void LSTraceAppendLine(NSMutableData *json, BOOL *first, const char *format, ...) {
+    char line[TRACE_MAX_LINE_LENGTH];
+    
+    va_list arguments;
+    va_start(arguments, format);
+    int length= vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+    
+    if (length <= 0)
+        return;
+    
+    if (!(*first))
+        [json appendBytes:",\n" length:2];
+    
+    [json appendBytes:line length:MIN((size_t) length, sizeof(line) - 1)];
+    *first= NO;
+}
+
+static const char *LSTraceOutcomeName(uint64_t outcome) {
+    switch (outcome) {
+        case LSTraceOperationOutcomeCompleted: return "completed";
+        case LSTraceOperationOutcomeFailed: return "failed";
+        case LSTraceOperationOutcomeCancelled: return "cancelled";
+        case LSTraceOperationOutcomeTimedOut: return "timed out";
+        default: return "unknown";
+    }
+}
+
+static void LSTraceFunctionName(uint64_t function, char *escaped) {
+    Dl_info info;
+    
+    if (dladdr((const void *) (uintptr_t) function, &info) && info.dli_sname) {
+        LSTraceEscape(info.dli_sname, escaped);
+        
+    } else {
+        snprintf(escaped, TRACE_MAX_NAME_LENGTH, "function 0x%llx", (unsigned long long) function);
+    }
+}
+
+static void LSTraceAppendEvent(NSMutableData *json, BOOL *first, const LSTraceEvent *event, int pid, NSUInteger tid) {
+    char name[TRACE_MAX_NAME_LENGTH];
+    
+    // Calls without a name are functions, whose address is in the argument
+    if (event->name)
+        LSTraceEscape(event->name, name);
+    else if ((event->type >= LSTraceEventTypeCallEnqueued) && (event->type <= LSTraceEventTypeCallFinished))
+        LSTraceFunctionName(event->argument, name);
+    else
+        name[0]= '\0';
+    
+    double ts= ((double) ((int64_t) (event->time - __startTime))) / 1000.0;
+    unsigned long long id= (unsigned long long) (uintptr_t) event->object;
+    unsigned long t= (unsigned long) tid;
+    
+    switch (event->type) {
+        case LSTraceEventTypeCallEnqueued: {
+            
+            // The queue wait of a delayed call starts when it is due
+            if (event->name && event->argument)
+                ts= ((double) ((int64_t) (event->argument - __startTime))) / 1000.0;
+            
+            LSTraceAppendLine(json, first, "{\"name\":\"queued\",\"cat\":\"call\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"call\":\"%s\"}}",
+                              id, ts, pid, t, name);
+            break;
+        }
+            
+        case LSTraceEventTypeCallStarted:
+            LSTraceAppendLine(json, first, "{\"name\":\"queued\",\"cat\":\"call\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              id, ts, pid, t);
+            LSTraceAppendLine(json, first, "{\"name\":\"%s\",\"cat\":\"call\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              name, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeCallFinished:
+            LSTraceAppendLine(json, first, "{\"name\":\"%s\",\"cat\":\"call\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              name, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeCallDiscarded:
+            LSTraceAppendLine(json, first, "{\"name\":\"queued\",\"cat\":\"call\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"rejected\":true}}",
+                              id, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeTimerScheduled:
+            LSTraceAppendLine(json, first, "{\"name\":\"pending\",\"cat\":\"timer\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"callback\":\"%s\",\"delay_us\":%.3f}}",
+                              id, ts, pid, t, name, ((double) ((int64_t) (event->argument - event->time))) / 1000.0);
+            break;
+            
+        case LSTraceEventTypeTimerFired:
+            LSTraceAppendLine(json, first, "{\"name\":\"pending\",\"cat\":\"timer\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"lateness_us\":%.3f}}",
+                              id, ts, pid, t, ((double) event->argument) / 1000.0);
+            LSTraceAppendLine(json, first, "{\"name\":\"%s\",\"cat\":\"timer\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              name, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeTimerCancelled:
+            LSTraceAppendLine(json, first, "{\"name\":\"pending\",\"cat\":\"timer\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"cancelled\":true}}",
+                              id, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeOperationQueued:
+            LSTraceAppendLine(json, first, "{\"name\":\"request\",\"cat\":\"url\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"endpoint\":\"%s\"}}",
+                              id, ts, pid, t, name);
+            LSTraceAppendLine(json, first, "{\"name\":\"queued\",\"cat\":\"url\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              id, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeOperationStarted:
+            LSTraceAppendLine(json, first, "{\"name\":\"queued\",\"cat\":\"url\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                              id, ts, pid, t);
+            break;
+            
+        case LSTraceEventTypeOperationResponse:
+            LSTraceAppendLine(json, first, "{\"name\":\"response\",\"cat\":\"url\",\"ph\":\"n\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"status\":%llu}}",
+                              id, ts, pid, t, (unsigned long long) event->argument);
+            break;
+            
+        case LSTraceEventTypeOperationData:
+            LSTraceAppendLine(json, first, "{\"name\":\"data\",\"cat\":\"url\",\"ph\":\"n\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"bytes\":%llu}}",
+                              id, ts, pid, t, (unsigned long long) event->argument);
+            break;
+            
+        case LSTraceEventTypeOperationFinished:
+            LSTraceAppendLine(json, first, "{\"name\":\"request\",\"cat\":\"url\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"outcome\":\"%s\"}}",
+                              id, ts, pid, t, LSTraceOutcomeName(event->argument));
+            break;
+    }
+}
+
+
+#pragma mark -
+#pragma mark LSTrace implementation
+
+@implementation LSTrace
+
+
+#pragma mark -
+#pragma mark Tracing control
+
++ (void) startTracing {
+    [LSTrace startTracingWithBufferSize:TRACE_DEFAULT_BUFFER_SIZE];
+}
+
++ (void) startTracingWithBufferSize:(NSUInteger)bufferSize {
+    if (!bufferSize)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Trace buffer size must be positive"
+                                     userInfo:nil];
+    
+    pthread_mutex_lock(&__buffersLock);
+    
+    atomic_store_explicit(&__bufferSize, bufferSize, memory_order_relaxed);
+    atomic_store_explicit(&__droppedEventCount, 0, memory_order_relaxed);
+    
+    // Threads start over at their next event, replacing their buffer if its size differs
+    __startTime= LSMonotonicNanoseconds();
+    atomic_fetch_add_explicit(&__generation, 1, memory_order_release);
+    
+    pthread_mutex_unlock(&__buffersLock);
+    
+    atomic_store_explicit(&LSTraceEnabledFlag, true, memory_order_relaxed);
+}
+
++ (void) stopTracing {
+    atomic_store_explicit(&LSTraceEnabledFlag, false, memory_order_relaxed);
+}
+
++ (BOOL) isTracing {
+    return LSTraceIsEnabled();
+}
+
++ (void) clear {
+    pthread_mutex_lock(&__buffersLock);
+    
+    atomic_store_explicit(&__droppedEventCount, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&__generation, 1, memory_order_release);
+    
+    // Exited threads won't touch their buffers anymore
+    LSTraceBuffer **link= &__buffers;
+    while (*link) {
+        LSTraceBuffer *buffer= *link;
+        
+        if (atomic_load_explicit(&buffer->exited, memory_order_acquire)) {
+            *link= buffer->next;
+            
+            LSTraceBufferFree(buffer);
+            
+        } else {
+            link= &buffer->next;
+        }
+    }
+    
+    pthread_mutex_unlock(&__buffersLock);
+}
+
+
+#pragma mark -
+#pragma mark Export
+
++ (NSData *) chromeTraceData {
+    NSMutableData *json= [[NSMutableData alloc] init];
+    BOOL first= YES;
+    
+    int pid= getpid();
+    char name[TRACE_MAX_NAME_LENGTH];
+    
+    const char *header= "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    [json appendBytes:header length:strlen(header)];
+    
+    LSTraceEscape([NSProcessInfo processInfo].processName.UTF8String ?: "", name);
+    LSTraceAppendLine(json, &first, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"%s\"}}", pid, name);
+    
+    // The generation can't change while the lock is held: buffers of the current
+    // generation may only grow, and their events below the count are immutable
+    pthread_mutex_lock(&__buffersLock);
+    
+    uint64_t generation= atomic_load_explicit(&__generation, memory_order_acquire);
+    
+    for (LSTraceBuffer *buffer= __buffers; buffer; buffer= buffer->next) {
+        if (atomic_load_explicit(&buffer->generation, memory_order_acquire) != generation)
+            continue;
+        
+        size_t count= atomic_load_explicit(&buffer->count, memory_order_acquire);
+        if (!count)
+            continue;
+        
+        LSTraceEscape(((__bridge NSString *) buffer->threadName).UTF8String ?: "", name);
+        LSTraceAppendLine(json, &first, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                          pid, (unsigned long) buffer->threadIndex, name);
+        
+        for (size_t i= 0; i < count; i++)
+            LSTraceAppendEvent(json, &first, &buffer->events[i], pid, buffer->threadIndex);
+    }
+    
+    pthread_mutex_unlock(&__buffersLock);
+    
+    const char *footer= "\n]}\n";
+    [json appendBytes:footer length:strlen(footer)];
+    
+    return json;
+}
+
++ (BOOL) writeChromeTraceToFile:(NSString *)path error:(NSError * __autoreleasing *)error {
+    if (!path)
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:@"Path can't be nil"
+                                     userInfo:nil];
+    
+    return [[LSTrace chromeTraceData] writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
++ (NSUInteger) eventCount {
+    NSUInteger eventCount= 0;
+    
+    pthread_mutex_lock(&__buffersLock);
+    
+    uint64_t generation= atomic_load_explicit(&__generation, memory_order_acquire);
+    
+    for (LSTraceBuffer *buffer= __buffers; buffer; buffer= buffer->next) {
+        if (atomic_load_explicit(&buffer->generation, memory_order_acquire) == generation)
+            eventCount += atomic_load_explicit(&buffer->count, memory_order_acquire);
+    }
+    
+    pthread_mutex_unlock(&__buffersLock);
+    
+    return eventCount;
+}
+
++ (uint64_t) droppedEventCount {
+    return atomic_load_explicit(&__droppedEventCount, memory_order_relaxed);
+}
+
+
+@end
@@ -22,6 +22,7 @@
 
 
 @class LSURLDispatcher;
+@class LSURLEndPoint;
 
 
 #pragma mark -
@@ -33,7 +34,7 @@
 #pragma mark -
 #pragma mark Initialization (for internal use only)
 
-- (instancetype) initWithDispatcher:(LSURLDispatcher *)dispatcher session:(NSURLSession *)session request:(NSURLRequest *)request endPoint:(NSString *)endPoint delegate:(id <LSURLDispatchDelegate>)delegate gatherData:(BOOL)gatherData isLong:(BOOL)isLong;
+- (instancetype) initWithDispatcher:(LSURLDispatcher *)dispatcher session:(NSURLSession *)session request:(NSURLRequest *)request endPoint:(LSURLEndPoint *)endPoint delegate:(id <LSURLDispatchDelegate>)delegate gatherData:(BOOL)gatherData isLong:(BOOL)isLong;
 
 
 #pragma mark -
@@ -44,6 +45,21 @@
 - (void) fail;
 
 
+#pragma mark -
+#pragma mark Admission (for internal use only)
+
+/**
+ @brief Set for synchronous operations only: signalled by the dispatcher when the operation obtains a connection,
+ so that the calling thread can start it.
+ */
+@property (nonatomic, strong) dispatch_semaphore_t admissionSemaphore;
+
+/**
+ @brief The interned end-point of the operation, holding its connection and long running request counts.
+ */
+@property (nonatomic, readonly) LSURLEndPoint *urlEndPoint;
+
+
 #pragma mark -
 #pragma mark Events for NSURLSessionTask (for internal use only)
 
@@ -37,6 +37,7 @@
 
 /**
  @brief Cancels the URL request operation, freeing the connection.
+ <br/> If the operation is still waiting for a free connection, it is removed from the queue of its end-point and never started.
  */
 - (void) cancel;
 
@@ -22,8 +22,10 @@
 #import "LSURLDispatchOperation+Internals.h"
 #import "LSURLDispatcher.h"
 #import "LSURLDispatcher+Internals.h"
+#import "LSURLEndPoint.h"
 #import "LSLog.h"
 #import "LSLog+Internals.h"
+#import "LSTrace+Internals.h"
 
 #define ERROR_DOMAIN                          (@"LSURLDispatcherDomain")
 
@@ -39,6 +41,7 @@
     
     NSURLRequest *_request;
     NSString *_endPoint;
+    LSURLEndPoint *_urlEndPoint;
     id <LSURLDispatchDelegate> _delegate;
     BOOL _gathedData;
     BOOL _isLong;
@@ -56,12 +59,15 @@
     
     NSURLSession * __weak _session;
     NSURLSessionDataTask *_task;
+    
+    dispatch_semaphore_t _admissionSemaphore;
 }
 
 
 #pragma mark -
 #pragma mark Internal non-threaded operations
 
+- (void) pendingDidCancel;
 - (void) timeout;
 
 
@@ -77,7 +83,7 @@
 #pragma mark -
 #pragma mark Initialization
 
-- (instancetype) initWithDispatcher:(LSURLDispatcher *)dispatcher session:(NSURLSession *)session request:(NSURLRequest *)request endPoint:(NSString *)endPoint delegate:(id <LSURLDispatchDelegate>)delegate gatherData:(BOOL)gatherData isLong:(BOOL)isLong {
+- (instancetype) initWithDispatcher:(LSURLDispatcher *)dispatcher session:(NSURLSession *)session request:(NSURLRequest *)request endPoint:(LSURLEndPoint *)endPoint delegate:(id <LSURLDispatchDelegate>)delegate gatherData:(BOOL)gatherData isLong:(BOOL)isLong {
     if ((self = [super init])) {
         
         // Initialization
@@ -85,18 +91,22 @@
         
         _session= session;
         _request= request;
-        _endPoint= endPoint;
+        _endPoint= endPoint.name;
+        _urlEndPoint= endPoint;
         _delegate= delegate;
         _gathedData= gatherData;
         _isLong= isLong;
         
         _waitForCompletion= [[NSCondition alloc] init];
         
-        NSString *queueName= [NSString stringWithFormat:@"LSURLDispatchOperation Notification Queue for %@", endPoint];
+        NSString *queueName= [NSString stringWithFormat:@"LSURLDispatchOperation Notification Queue for %@", _endPoint];
         _notificationQueue= dispatch_queue_create([queueName cStringUsingEncoding:NSUTF8StringEncoding], DISPATCH_QUEUE_SERIAL);
         
-        queueName= [NSString stringWithFormat:@"LSURLDispatchOperation Timeout Queue for %@", endPoint];
+        queueName= [NSString stringWithFormat:@"LSURLDispatchOperation Timeout Queue for %@", _endPoint];
         _timeoutQueue= dispatch_queue_create([queueName cStringUsingEncoding:NSUTF8StringEncoding], DISPATCH_QUEUE_SERIAL);
+        
+        if (LSTraceIsEnabled())
+            LSTraceRecordEvent(LSTraceEventTypeOperationQueued, (__bridge const void *) self, endPoint.traceName, 0);
     }
     
     return self;
@@ -107,6 +117,9 @@
 #pragma mark Execution
 
 - (void) start {
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationStarted, (__bridge const void *) self, NULL, 0);
+    
     if (_gathedData)
         _data= [[NSMutableData alloc] init];
     
@@ -146,6 +159,9 @@
         
         [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"connection of operation %p for end-point: %@ failed due to nil task returned by session", self, _endPoint];
         
+        if (LSTraceIsEnabled())
+            LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeFailed);
+        
         // Cancel the timeout timer
         dispatch_block_cancel(_timeoutBlock);
         
@@ -199,6 +215,9 @@
     
     [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"connection of operation %p for end-point: %@ failed due to no connection available", self, _endPoint];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeFailed);
+    
     // Schedule call to delegate
     dispatch_async(_notificationQueue, ^{
         @try {
@@ -215,20 +234,29 @@
     
     @synchronized (self) {
         
-        // Avoid wasting time if the task has been cancelled or is already finished
-        if (!_task)
-            return;
-        
-        // Release the task strong reference
+        // Release the task strong reference, if not cancelled or finished already
         oldTask= _task;
         _task= nil;
     }
     
+    if (!oldTask) {
+        
+        // The operation may be waiting for a free connection: if so it's removed from its queue,
+        // otherwise it has been cancelled or is already finished, or it's just being started
+        if ([_dispatcher cancelPendingOperation:self])
+            [self pendingDidCancel];
+        
+        return;
+    }
+    
     // Cancel connection
     [oldTask cancel];
     
     [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"task of operation %p for end-point: %@ cancelled", self, _endPoint];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeCancelled);
+    
     // Cancel the timeout timer
     dispatch_block_cancel(_timeoutBlock);
 
@@ -251,6 +279,23 @@
     [_dispatcher operation:self didFinishWithTask:oldTask];
 }
 
+- (void) pendingDidCancel {
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"pending operation %p for end-point: %@ cancelled", self, _endPoint];
+    
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeCancelled);
+    
+    // Schedule call to delegate
+    dispatch_async(_notificationQueue, ^{
+        @try {
+            [self->_delegate dispatchOperationDidFinish:self];
+            
+        } @catch (NSException *e) {
+            [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self->_dispatcher log:@"connection of operation %p for end-point: %@ caught exception while notifying finish to delegate: %@, reason: '%@'\nCall stack:%@", self, self->_endPoint, e.name, e.reason, e.callStackSymbols];
+        }
+    });
+}
+
 - (void) timeout {
     NSURLSessionDataTask *oldTask= nil;
     
@@ -270,6 +315,9 @@
     
     [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"task of operation %p for end-point: %@ timed out", self, _endPoint];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeTimedOut);
+    
     // Compose the error
     NSError *error= [[NSError alloc] initWithDomain:NSURLErrorDomain
                                                code:NSURLErrorTimedOut
@@ -337,6 +385,10 @@
     
     _response= response;
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationResponse, (__bridge const void *) self, NULL,
+                           [response isKindOfClass:[NSHTTPURLResponse class]] ? (uint64_t) ((NSHTTPURLResponse *) response).statusCode : 0);
+    
     // Truncate current data buffer
     _data.length= 0;
     
@@ -366,6 +418,9 @@
     
     [_data appendData:data];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationData, (__bridge const void *) self, NULL, data.length);
+    
     // Schedule call to delegate
     dispatch_async(_notificationQueue, ^{
         @try {
@@ -396,6 +451,9 @@
     
     [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"connection of operation %p for end-point: %@ failed with error: %@", self, _endPoint, error];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeFailed);
+    
     // Cancel the timeout timer
     dispatch_block_cancel(_timeoutBlock);
     
@@ -434,6 +492,9 @@
     
     [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:_dispatcher log:@"connection of operation %p for end-point: %@ finished loading", self, _endPoint];
     
+    if (LSTraceIsEnabled())
+        LSTraceRecordEvent(LSTraceEventTypeOperationFinished, (__bridge const void *) self, NULL, LSTraceOperationOutcomeCompleted);
+    
     // Cancel the timeout timer
     dispatch_block_cancel(_timeoutBlock);
 
@@ -464,6 +525,9 @@
 @synthesize endPoint= _endPoint;
 @synthesize isLong= _isLong;
 
+@synthesize admissionSemaphore= _admissionSemaphore;
+@synthesize urlEndPoint= _urlEndPoint;
+
 @synthesize response= _response;
 @synthesize error= _error;
 @synthesize data= _data;
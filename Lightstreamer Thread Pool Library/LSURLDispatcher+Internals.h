@@ -21,6 +21,9 @@
 #import "LSURLDispatcher.h"
 
 
+@class LSURLEndPoint;
+
+
 #pragma mark -
 #pragma mark LSURLDispatcher Internals category
 
@@ -33,10 +36,18 @@
 - (void) dispose;
 
 
+#pragma mark -
+#pragma mark End-point lookup (for internal use only)
+
+- (LSURLEndPoint *) endPointForURL:(NSURL *)url;
+- (LSURLEndPoint *) endPointForHost:(NSString *)host port:(int)port;
+
+
 #pragma mark -
 #pragma mark Operation synchronization (for internal use only)
 
-- (void) connectionDidFreeForEndPoint:(NSString *)endPoint;
+- (void) connectionDidFreeForEndPoint:(LSURLEndPoint *)endPoint;
+- (BOOL) cancelPendingOperation:(LSURLDispatchOperation *)dispatchOp;
 
 
 #pragma mark -
@@ -22,12 +22,18 @@
 #import "LSURLDispatchOperation.h"
 #import "LSURLDispatchOperation+Internals.h"
 #import "LSURLAuthenticationChallengeSender.h"
+#import "LSURLEndPoint.h"
 #import "LSLog.h"
 #import "LSLog+Internals.h"
 
+#import <pthread.h>
+
 #define MAX_THREAD_IDLENESS                                (10.0)
 #define THREAD_COLLECTOR_DELAY                             (15.0)
 
+#define END_POINT_SHARD_COUNT                              (16)
+#define TASK_SHARD_COUNT                                   (16)
+
 #define LS_TOO_MANY_LONG_RUNNING_REQUESTS                   (@"LSTooManyLongRunningRequests")
 
 
@@ -35,29 +41,36 @@
 #pragma mark LSURLDispatcher extension
 
 @interface LSURLDispatcher () {
-    NSMutableDictionary<NSString *, dispatch_queue_t> *_decouplingQueuesByEndPoint;
-
-    NSMutableDictionary<NSString *, NSNumber *> *_connectionCountsByEndPoint;
-    NSMutableDictionary<NSString *, NSNumber *> *_longRequestCountsByEndPoint;
+    
+    // Interned end-points, sharded by host and port, each shard guarded by its lock
+    NSMutableDictionary<NSString *, NSMutableArray<LSURLEndPoint *> *> *_endPointsByHost[END_POINT_SHARD_COUNT];
+    pthread_mutex_t _endPointLocks[END_POINT_SHARD_COUNT];
     
     NSUInteger _maxRequestsPerEndPoint;
     NSUInteger _maxLongRunningRequestsPerEndPoint;
     
-    NSCondition *_waitForFreeConnection;
-    
     NSURLSession *_session;
-    NSMutableDictionary<NSNumber *, LSURLDispatchOperation *> *_operationsByTask;
+    
+    // Operation-task map, sharded by task identifier, each shard guarded by its lock
+    NSMutableDictionary<NSNumber *, LSURLDispatchOperation *> *_operationsByTask[TASK_SHARD_COUNT];
+    pthread_mutex_t _operationLocks[TASK_SHARD_COUNT];
 }
 
 
+#pragma mark -
+#pragma mark Operation admission
+
+- (BOOL) admitOperation:(LSURLDispatchOperation *)dispatchOp;
+- (void) startAdmittedOperation:(LSURLDispatchOperation *)dispatchOp;
+- (void) longRequestDidFinishForEndPoint:(LSURLEndPoint *)endPoint;
+
+
 #pragma mark -
 #pragma mark Internal methods
 
-- (NSUInteger) countOfRunningLongRequestsToEndPoint:(NSString *)endPoint;
+- (LSURLDispatchOperation *) operationForTask:(NSURLSessionTask *)task;
 
-- (NSString *) endPointForURL:(NSURL *)url;
-- (NSString *) endPointForRequest:(NSURLRequest *)request;
-- (NSString *) endPointForHost:(NSString *)host port:(int)port;
+- (LSURLEndPoint *) endPointForRequest:(NSURLRequest *)request;
 
 
 @end
@@ -124,16 +137,14 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                          userInfo:nil];
         
         // Initialization
-        _decouplingQueuesByEndPoint= [[NSMutableDictionary alloc] init];
-        
-        _connectionCountsByEndPoint= [[NSMutableDictionary alloc] init];
-        _longRequestCountsByEndPoint= [[NSMutableDictionary alloc] init];
+        for (NSUInteger i= 0; i < END_POINT_SHARD_COUNT; i++) {
+            _endPointsByHost[i]= [[NSMutableDictionary alloc] init];
+            pthread_mutex_init(&_endPointLocks[i], NULL);
+        }
         
         _maxRequestsPerEndPoint= maxRequestsPerEndPoint;
         _maxLongRunningRequestsPerEndPoint= maxLongRunningRequestsPerEndPoint;
         
-        _waitForFreeConnection= [[NSCondition alloc] init];
-        
         // Initialize the session
         NSURLSessionConfiguration *config= [NSURLSessionConfiguration defaultSessionConfiguration];
         config.HTTPMaximumConnectionsPerHost= _maxRequestsPerEndPoint;
@@ -141,7 +152,10 @@ static LSURLDispatcher *__sharedDispatcher= nil;
         _session= [NSURLSession sessionWithConfiguration:config delegate:self delegateQueue:nil];
         
         // Initialize the operation-task map
-        _operationsByTask= [[NSMutableDictionary alloc] init];
+        for (NSUInteger i= 0; i < TASK_SHARD_COUNT; i++) {
+            _operationsByTask[i]= [[NSMutableDictionary alloc] init];
+            pthread_mutex_init(&_operationLocks[i], NULL);
+        }
     }
     
     return self;
@@ -155,6 +169,14 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     [_session invalidateAndCancel];
 }
 
+- (void) dealloc {
+    for (NSUInteger i= 0; i < END_POINT_SHARD_COUNT; i++)
+        pthread_mutex_destroy(&_endPointLocks[i]);
+    
+    for (NSUInteger i= 0; i < TASK_SHARD_COUNT; i++)
+        pthread_mutex_destroy(&_operationLocks[i]);
+}
+
 
 #pragma mark -
 #pragma mark URL request dispatching and checking
@@ -165,19 +187,23 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Request can't be nil"
                                      userInfo:nil];
 
-    NSString *endPoint= [self endPointForRequest:request];
-    
-    // Wait for a free connection
-    [self waitForFreeConnectionForEndPoint:endPoint];
+    LSURLEndPoint *endPoint= [self endPointForRequest:request];
     
     LSURLDispatchOperation *dispatchOp= [[LSURLDispatchOperation alloc] initWithDispatcher:self session:_session request:request endPoint:endPoint delegate:delegate gatherData:YES isLong:NO];
+    
+    // The calling thread is the only one waiting, on a semaphore of its own that is
+    // signalled when the operation gets to the head of the queue of its end-point
+    dispatchOp.admissionSemaphore= dispatch_semaphore_create(0);
+    
+    if (![self admitOperation:dispatchOp])
+        dispatch_semaphore_wait(dispatchOp.admissionSemaphore, DISPATCH_TIME_FOREVER);
 
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"starting synchronous operation %p for end-point %@", dispatchOp, endPoint];
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"starting synchronous operation %p for end-point %@", dispatchOp, endPoint.name];
 
     // Start the operation
     [dispatchOp startAndWaitForCompletion];
 
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"synchronous operation %p for end-point %@ finished", dispatchOp, endPoint];
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"synchronous operation %p for end-point %@ finished", dispatchOp, endPoint.name];
 
     if (response)
         *response= [dispatchOp.response copy];
@@ -194,34 +220,16 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Request and/or delegate can't be nil"
                                      userInfo:nil];
 
-    NSString *endPoint= [self endPointForRequest:request];
+    LSURLEndPoint *endPoint= [self endPointForRequest:request];
     
     LSURLDispatchOperation *dispatchOp= [[LSURLDispatchOperation alloc] initWithDispatcher:self session:_session request:request endPoint:endPoint delegate:delegate gatherData:NO isLong:NO];
     
-    // Get the decoupling queue for this end-point
-    dispatch_queue_t queue= nil;
-    @synchronized (_decouplingQueuesByEndPoint) {
-        queue= _decouplingQueuesByEndPoint[endPoint];
-        if (!queue) {
-            NSString *queueName= [NSString stringWithFormat:@"LSURLDispatcher Decoupling Queue for %@", endPoint];
-            queue= dispatch_queue_create([queueName cStringUsingEncoding:NSUTF8StringEncoding], DISPATCH_QUEUE_SERIAL);
-            
-            _decouplingQueuesByEndPoint[endPoint]= queue;
-        }
-    }
-    
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"scheduling short operation: %p for end-point: %@", dispatchOp, endPoint];
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"scheduling short operation: %p for end-point: %@", dispatchOp, endPoint.name];
     
-    // Schedule the operation with the queue
-    dispatch_async(queue, ^{
-        
-        // Wait for a free connection
-        [self waitForFreeConnectionForEndPoint:endPoint];
-
-        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"starting short operation: %p for end-point: %@", dispatchOp, endPoint];
-        
-        [dispatchOp start];
-    });
+    // Start the operation if there's a free connection, otherwise it is
+    // started when a connection of its end-point is freed
+    if ([self admitOperation:dispatchOp])
+        [self startAdmittedOperation:dispatchOp];
     
     return dispatchOp;
 }
@@ -236,75 +244,47 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Request and/or delegate can't be nil"
                                      userInfo:nil];
 
-    NSString *endPoint= [self endPointForRequest:request];
+    LSURLEndPoint *endPoint= [self endPointForRequest:request];
     LSURLDispatchOperation *dispatchOp= [[LSURLDispatchOperation alloc] initWithDispatcher:self session:_session request:request endPoint:endPoint delegate:delegate gatherData:NO isLong:YES];
 
-    // Check if there's room for another long running request
+    // Check if there's room for another long running request, and count it
     NSUInteger count= 0;
-    @synchronized (_longRequestCountsByEndPoint) {
-        count= _longRequestCountsByEndPoint[endPoint].unsignedIntegerValue;
-        
-        if (count >= _maxLongRunningRequestsPerEndPoint) {
-            switch (policy) {
-                case LSLongRequestLimitExceededPolicyThrow:
-                    
-                    // Throw exception
-                    @throw [NSException exceptionWithName:LS_TOO_MANY_LONG_RUNNING_REQUESTS
-                                                   reason:@"Maximum number of concurrent long requests reached for end-point"
-                                                 userInfo:@{@"endPoint": endPoint,
-                                                            @"count": @(count)}];
-                    
-                case LSLongRequestLimitExceededPolicyFail:
-                    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"failing long operation: %p for end-point: %@", dispatchOp, endPoint];
-                    
-                    // Fail and return the request
-                    [dispatchOp fail];
-                    return dispatchOp;
-                    
-                case LSLongRequestLimitExceededPolicyEnqueue:
-                    
-                    // Enqueue the request as nothing was wrong
-                    break;
-                    
-                default:
-                    @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                                   reason:@"Invalid policy"
-                                                 userInfo:nil];
-            }
-        }
-
-        // Update long running request count
-        count++;
-
-        _longRequestCountsByEndPoint[endPoint]= @(count);
-    }
-    
-    // Get the decoupling queue for this end-point
-    dispatch_queue_t queue= nil;
-    @synchronized (_decouplingQueuesByEndPoint) {
-        queue= _decouplingQueuesByEndPoint[endPoint];
-        if (!queue) {
-            NSString *queueName= [NSString stringWithFormat:@"LSURLDispatcher Decoupling Queue for %@", endPoint];
-            queue= dispatch_queue_create([queueName cStringUsingEncoding:NSUTF8StringEncoding], DISPATCH_QUEUE_SERIAL);
-            
-            _decouplingQueuesByEndPoint[endPoint]= queue;
+    if (![endPoint acquireLongRequestWithLimit:_maxLongRunningRequestsPerEndPoint count:&count]) {
+        switch (policy) {
+            case LSLongRequestLimitExceededPolicyThrow:
+                
+                // Throw exception
+                @throw [NSException exceptionWithName:LS_TOO_MANY_LONG_RUNNING_REQUESTS
+                                               reason:@"Maximum number of concurrent long requests reached for end-point"
+                                             userInfo:@{@"endPoint": endPoint.name,
+                                                        @"count": @(count)}];
+                
+            case LSLongRequestLimitExceededPolicyFail:
+                [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"failing long operation: %p for end-point: %@", dispatchOp, endPoint.name];
+                
+                // Fail and return the request
+                [dispatchOp fail];
+                return dispatchOp;
+                
+            case LSLongRequestLimitExceededPolicyEnqueue:
+                
+                // Enqueue the request as nothing was wrong
+                count= [endPoint addLongRequest];
+                break;
+                
+            default:
+                @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                               reason:@"Invalid policy"
+                                             userInfo:nil];
         }
     }
     
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"scheduling long operation: %p for end-point: %@", dispatchOp, endPoint];
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"scheduling long operation: %p for end-point: %@, long running request count: %lu", dispatchOp, endPoint.name, (unsigned long) count];
     
-    // Schedule the operation with the queue
-    dispatch_async(queue, ^{
-        
-        // Wait for a free connection
-        [self waitForFreeConnectionForEndPoint:endPoint];
-
-        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"starting long operation: %p for end-point: %@", dispatchOp, endPoint];
-        
-        [dispatchOp start];
-        
-        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"long running request count: %lu", (unsigned long) count];
-    });
+    // Start the operation if there's a free connection, otherwise it is
+    // started when a connection of its end-point is freed
+    if ([self admitOperation:dispatchOp])
+        [self startAdmittedOperation:dispatchOp];
 
     return dispatchOp;
 }
@@ -315,10 +295,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Request can't be nil"
                                      userInfo:nil];
 
-    NSString *endPoint= [self endPointForRequest:request];
+    LSURLEndPoint *endPoint= [self endPointForRequest:request];
     
-    NSUInteger count= [self countOfRunningLongRequestsToEndPoint:endPoint];
-    return (count < _maxLongRunningRequestsPerEndPoint);
+    return (endPoint.longRequestCount < _maxLongRunningRequestsPerEndPoint);
 }
 
 - (BOOL) isLongRequestAllowedToURL:(NSURL *)url {
@@ -327,10 +306,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"URL can't be nil"
                                      userInfo:nil];
 
-    NSString *endPoint= [self endPointForURL:url];
+    LSURLEndPoint *endPoint= [self endPointForURL:url];
     
-    NSUInteger count= [self countOfRunningLongRequestsToEndPoint:endPoint];
-    return (count < _maxLongRunningRequestsPerEndPoint);
+    return (endPoint.longRequestCount < _maxLongRunningRequestsPerEndPoint);
 }
 
 - (BOOL) isLongRequestAllowedToHost:(NSString *)host port:(int)port {
@@ -339,10 +317,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Host can't be nil"
                                      userInfo:nil];
     
-    NSString *endPoint= [self endPointForHost:host port:port];
+    LSURLEndPoint *endPoint= [self endPointForHost:host port:port];
 
-    NSUInteger count= [self countOfRunningLongRequestsToEndPoint:endPoint];
-    return (count < _maxLongRunningRequestsPerEndPoint);
+    return (endPoint.longRequestCount < _maxLongRunningRequestsPerEndPoint);
 }
 
 - (NSUInteger) countOfRunningLongRequestsToURL:(nonnull NSURL *)url {
@@ -351,8 +328,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"URL can't be nil"
                                      userInfo:nil];
     
-    NSString *endPoint= [self endPointForURL:url];
-    return [self countOfRunningLongRequestsToEndPoint:endPoint];
+    LSURLEndPoint *endPoint= [self endPointForURL:url];
+    
+    return endPoint.longRequestCount;
 }
 
 - (NSUInteger) countOfRunningLongRequestsToHost:(nonnull NSString *)host port:(int)port {
@@ -361,9 +339,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
                                        reason:@"Host can't be nil"
                                      userInfo:nil];
     
-    NSString *endPoint= [self endPointForHost:host port:port];
+    LSURLEndPoint *endPoint= [self endPointForHost:host port:port];
     
-    return [self countOfRunningLongRequestsToEndPoint:endPoint];
+    return endPoint.longRequestCount;
 }
 
 
@@ -397,56 +375,32 @@ static LSURLDispatcher *__sharedDispatcher= nil;
 #pragma mark -
 #pragma mark Operation synchronization (for internal use only)
 
-- (void) waitForFreeConnectionForEndPoint:(NSString *)endPoint {
-    NSUInteger connectionCount= 0;
+- (void) connectionDidFreeForEndPoint:(LSURLEndPoint *)endPoint {
     
-    do {
-        @synchronized (_connectionCountsByEndPoint) {
-            
-            // Retrieve current connection count
-            NSNumber *connectionCountNumber= _connectionCountsByEndPoint[endPoint];
-            connectionCount= connectionCountNumber.unsignedIntegerValue;
-                
-            // Check if we have to wait
-            if (connectionCount < _maxRequestsPerEndPoint) {
-                connectionCount++;
-                
-                _connectionCountsByEndPoint[endPoint]= @(connectionCount);
-                break;
-            }
-        }
+    // If an operation is waiting, the connection passes to it and the count doesn't change
+    LSURLDispatchOperation *nextOp= [endPoint releaseConnectionWithLimit:_maxRequestsPerEndPoint];
+    if (nextOp) {
+        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"passed a free connection for end-point: %@ to pending operation: %p", endPoint.name, nextOp];
         
-        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"waiting for a free connection for end-point: %@...", endPoint];
-
-        // If we've got here, we have to wait for a free connection and retry
-        [_waitForFreeConnection lock];
-        [_waitForFreeConnection wait];
-        [_waitForFreeConnection unlock];
-
-    } while (YES);
+        [self startAdmittedOperation:nextOp];
+        return;
+    }
     
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"obtained a free connection for end-point: %@, connection count is now: %lu (max %lu)", endPoint, (unsigned long) connectionCount, (unsigned long) _maxRequestsPerEndPoint];
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"freed a connection for end-point: %@, connection count is now: %lu (max %lu)", endPoint.name, (unsigned long) endPoint.connectionCount, (unsigned long) _maxRequestsPerEndPoint];
 }
 
-- (void) connectionDidFreeForEndPoint:(NSString *)endPoint {
-    NSUInteger connectionCount= 0;
+- (BOOL) cancelPendingOperation:(LSURLDispatchOperation *)dispatchOp {
+    LSURLEndPoint *endPoint= dispatchOp.urlEndPoint;
+    if (![endPoint removePendingOperation:dispatchOp])
+        return NO;
     
-    @synchronized (_connectionCountsByEndPoint) {
-        
-        // Retrieve current connection count
-        NSNumber *connectionCountNumber= _connectionCountsByEndPoint[endPoint];
-        connectionCount= connectionCountNumber.unsignedIntegerValue;
-        
-        connectionCount--;
-        _connectionCountsByEndPoint[endPoint]= @(connectionCount);
-    }
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"removed pending operation: %p for end-point: %@", dispatchOp, endPoint.name];
     
-    // Signal there's a free connection
-    [_waitForFreeConnection lock];
-    [_waitForFreeConnection signal];
-    [_waitForFreeConnection unlock];
+    // A pending operation holds no connection, but a long one is already counted
+    if (dispatchOp.isLong)
+        [self longRequestDidFinishForEndPoint:endPoint];
     
-    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"freed a connection for end-point: %@, connection count is now: %lu (max %lu)", endPoint, (unsigned long) connectionCount, (unsigned long) _maxRequestsPerEndPoint];
+    return YES;
 }
 
 
@@ -454,35 +408,80 @@ static LSURLDispatcher *__sharedDispatcher= nil;
 #pragma mark Operation notifications (for internal use only)
 
 - (void) operation:(LSURLDispatchOperation *)dispatchOp didStartWithTask:(NSURLSessionDataTask *)task {
+    NSUInteger shard= task.taskIdentifier & (TASK_SHARD_COUNT - 1);
     
     // Store the operation-task association for use during the event dispatch
-    @synchronized (_operationsByTask) {
-        _operationsByTask[@(task.taskIdentifier)]= dispatchOp;
-    }
+    pthread_mutex_lock(&_operationLocks[shard]);
+    
+    _operationsByTask[shard][@(task.taskIdentifier)]= dispatchOp;
+    
+    pthread_mutex_unlock(&_operationLocks[shard]);
 }
 
 - (void) operation:(LSURLDispatchOperation *)dispatchOp didFinishWithTask:(NSURLSessionDataTask *)task {
-    if (dispatchOp.isLong) {
-        
-        // Update long running request count
-        NSUInteger count= 0;
-        @synchronized (_longRequestCountsByEndPoint) {
-            count= _longRequestCountsByEndPoint[dispatchOp.endPoint].unsignedIntegerValue;
-            count--;
-            
-            _longRequestCountsByEndPoint[dispatchOp.endPoint]= @(count);
-        }
-        
-        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"long running request count: %lu", (unsigned long) count];
-    }
+    LSURLEndPoint *endPoint= dispatchOp.urlEndPoint;
+    if (dispatchOp.isLong)
+        [self longRequestDidFinishForEndPoint:endPoint];
 
     // Mark the connection as free
-    [self connectionDidFreeForEndPoint:dispatchOp.endPoint];
+    [self connectionDidFreeForEndPoint:endPoint];
+    
+    NSUInteger shard= task.taskIdentifier & (TASK_SHARD_COUNT - 1);
     
     // Clear the operation-task association
-    @synchronized (_operationsByTask) {
-        [_operationsByTask removeObjectForKey:@(task.taskIdentifier)];
+    pthread_mutex_lock(&_operationLocks[shard]);
+    
+    [_operationsByTask[shard] removeObjectForKey:@(task.taskIdentifier)];
+    
+    pthread_mutex_unlock(&_operationLocks[shard]);
+}
+
+
+#pragma mark -
+#pragma mark Operation admission
+
+- (BOOL) admitOperation:(LSURLDispatchOperation *)dispatchOp {
+    LSURLEndPoint *endPoint= dispatchOp.urlEndPoint;
+    
+    if ([endPoint acquireConnectionWithLimit:_maxRequestsPerEndPoint]) {
+        [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"obtained a free connection for end-point: %@, connection count is now: %lu (max %lu)", endPoint.name, (unsigned long) endPoint.connectionCount, (unsigned long) _maxRequestsPerEndPoint];
+        
+        return YES;
     }
+    
+    // No free connection: the operation waits its turn in the queue of its end-point,
+    // no thread is kept waiting with it
+    LSURLDispatchOperation *nextOp= [endPoint enqueuePendingOperation:dispatchOp limit:_maxRequestsPerEndPoint];
+    
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"operation: %p waiting for a free connection for end-point: %@, pending operations: %lu", dispatchOp, endPoint.name, (unsigned long) endPoint.pendingCount];
+    
+    // A connection has been freed meanwhile, it goes to the first operation waiting
+    if (nextOp)
+        [self startAdmittedOperation:nextOp];
+    
+    return NO;
+}
+
+- (void) startAdmittedOperation:(LSURLDispatchOperation *)dispatchOp {
+    
+    // A synchronous operation is started by its calling thread
+    dispatch_semaphore_t admissionSemaphore= dispatchOp.admissionSemaphore;
+    if (admissionSemaphore) {
+        dispatch_semaphore_signal(admissionSemaphore);
+        return;
+    }
+    
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"starting %@ operation: %p for end-point: %@", (dispatchOp.isLong ? @"long" : @"short"), dispatchOp, dispatchOp.endPoint];
+    
+    [dispatchOp start];
+}
+
+- (void) longRequestDidFinishForEndPoint:(LSURLEndPoint *)endPoint {
+    
+    // Update long running request count
+    NSUInteger count= [endPoint releaseLongRequest];
+    
+    [LSLog sourceType:LOG_SRC_URL_DISPATCHER source:self log:@"long running request count: %lu", (unsigned long) count];
 }
 
 
@@ -494,13 +493,10 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition disposition, NSURLCredential * __nullable credential))completionHandler {
     
     // Retrieve corresponding dispatch operation
-    LSURLDispatchOperation *dispatchOp= nil;
-    @synchronized (_operationsByTask) {
-        dispatchOp= _operationsByTask[@(task.taskIdentifier)];
-        if (!dispatchOp) {
-            completionHandler(NSURLSessionAuthChallengeCancelAuthenticationChallenge, nil);
-            return;
-        }
+    LSURLDispatchOperation *dispatchOp= [self operationForTask:task];
+    if (!dispatchOp) {
+        completionHandler(NSURLSessionAuthChallengeCancelAuthenticationChallenge, nil);
+        return;
     }
     
     // Wrap the sender and call event on the operation
@@ -516,12 +512,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     didCompleteWithError:(nullable NSError *)error {
     
     // Retrieve corresponding dispatch operation
-    LSURLDispatchOperation *dispatchOp= nil;
-    @synchronized (_operationsByTask) {
-        dispatchOp= _operationsByTask[@(task.taskIdentifier)];
-        if (!dispatchOp)
-            return;
-    }
+    LSURLDispatchOperation *dispatchOp= [self operationForTask:task];
+    if (!dispatchOp)
+        return;
     
     // Call corresponding event on the operation
     if (error)
@@ -535,13 +528,10 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     completionHandler:(void (^)(NSURLSessionResponseDisposition disposition))completionHandler {
     
     // Retrieve corresponding dispatch operation
-    LSURLDispatchOperation *dispatchOp= nil;
-    @synchronized (_operationsByTask) {
-        dispatchOp= _operationsByTask[@(dataTask.taskIdentifier)];
-        if (!dispatchOp) {
-            completionHandler(NSURLSessionResponseCancel);
-            return;
-        }
+    LSURLDispatchOperation *dispatchOp= [self operationForTask:dataTask];
+    if (!dispatchOp) {
+        completionHandler(NSURLSessionResponseCancel);
+        return;
     }
     
     // Call event on the operation
@@ -555,12 +545,9 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     didReceiveData:(NSData *)data {
     
     // Retrieve corresponding dispatch operation
-    LSURLDispatchOperation *dispatchOp= nil;
-    @synchronized (_operationsByTask) {
-        dispatchOp= _operationsByTask[@(dataTask.taskIdentifier)];
-        if (!dispatchOp)
-            return;
-    }
+    LSURLDispatchOperation *dispatchOp= [self operationForTask:dataTask];
+    if (!dispatchOp)
+        return;
     
     // Call event on the operation
     [dispatchOp taskDidReceiveData:data];
@@ -570,17 +557,20 @@ static LSURLDispatcher *__sharedDispatcher= nil;
 #pragma mark -
 #pragma mark Internal methods
 
-- (NSUInteger) countOfRunningLongRequestsToEndPoint:(NSString *)endPoint {
-    NSUInteger count= 0;
+- (LSURLDispatchOperation *) operationForTask:(NSURLSessionTask *)task {
+    NSUInteger shard= task.taskIdentifier & (TASK_SHARD_COUNT - 1);
     
-    @synchronized (_longRequestCountsByEndPoint) {
-        count= _longRequestCountsByEndPoint[endPoint].unsignedIntegerValue;
-    }
+    // Callbacks of different tasks mostly take different locks, so that they don't serialize
+    pthread_mutex_lock(&_operationLocks[shard]);
+    
+    LSURLDispatchOperation *dispatchOp= _operationsByTask[shard][@(task.taskIdentifier)];
     
-    return count;
+    pthread_mutex_unlock(&_operationLocks[shard]);
+    
+    return dispatchOp;
 }
 
-- (NSString *) endPointForURL:(NSURL *)url {
+- (LSURLEndPoint *) endPointForURL:(NSURL *)url {
     int port= url.port.intValue;
     if (!port)
         port= ([url.scheme isEqualToString:@"https"] ? 443 : 80);
@@ -588,12 +578,39 @@ static LSURLDispatcher *__sharedDispatcher= nil;
     return [self endPointForHost:url.host port:port];
 }
 
-- (NSString *) endPointForRequest:(NSURLRequest *)request {
+- (LSURLEndPoint *) endPointForRequest:(NSURLRequest *)request {
     return [self endPointForURL:request.URL];
 }
 
-- (NSString *) endPointForHost:(NSString *)host port:(int)port {
-    NSString *endPoint= [NSString stringWithFormat:@"%@:%d", host, port];
+- (LSURLEndPoint *) endPointForHost:(NSString *)host port:(int)port {
+    NSString *hostKey= host ?: @"";
+    NSUInteger shard= (hostKey.hash ^ ((NSUInteger) port * 31)) & (END_POINT_SHARD_COUNT - 1);
+    
+    LSURLEndPoint *endPoint= nil;
+    
+    // End-points are looked up by host and port, the name is composed only once when the end-point is interned
+    pthread_mutex_lock(&_endPointLocks[shard]);
+    
+    NSMutableArray<LSURLEndPoint *> *endPoints= _endPointsByHost[shard][hostKey];
+    for (LSURLEndPoint *candidate in endPoints) {
+        if (candidate.port == port) {
+            endPoint= candidate;
+            break;
+        }
+    }
+    
+    if (!endPoint) {
+        endPoint= [[LSURLEndPoint alloc] initWithHost:hostKey port:port];
+        
+        if (!endPoints) {
+            endPoints= [[NSMutableArray alloc] init];
+            _endPointsByHost[shard][hostKey]= endPoints;
+        }
+        
+        [endPoints addObject:endPoint];
+    }
+    
+    pthread_mutex_unlock(&_endPointLocks[shard]);
     
     return endPoint;
 }
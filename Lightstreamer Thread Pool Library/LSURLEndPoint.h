@@ -0,0 +1,121 @@
+//
+//  LSURLEndPoint.h
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class LSURLDispatchOperation;
+
+
+/**
+ @brief State of an end-point of LSURLDispatcher: its connection and long running request counts, and the queue of its
+ operations waiting for a free connection. <b>This class should not be used directly</b>.
+ <br/> Instances are interned by the dispatcher, one per end-point, and resolved once per request. Counts are atomic:
+ obtaining and freeing a connection takes no locks as long as no operation is waiting. The queue has a lock of its own,
+ so that end-points never contend with each other.
+ @see LSURLDispatcher.
+ */
+@interface LSURLEndPoint : NSObject
+
+
+#pragma mark -
+#pragma mark Initialization (for internal use only)
+
+- (nonnull instancetype) initWithHost:(nonnull NSString *)host port:(int)port NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype) init NS_UNAVAILABLE;
+
+
+#pragma mark -
+#pragma mark Connection admission (for internal use only)
+
+/**
+ @brief Obtains a connection, if the count is below the limit and no operation is waiting.
+ @return YES if the connection has been obtained.
+ */
+- (BOOL) acquireConnectionWithLimit:(NSUInteger)limit;
+
+/**
+ @brief Appends the operation to the queue of operations waiting for a free connection.
+ <br/> A connection may have been freed meanwhile: in that case it is obtained on behalf of the first operation of the queue,
+ which is returned and must be started by the caller. It may be the same operation just enqueued.
+ @return The operation to be started, or nil.
+ */
+- (nullable LSURLDispatchOperation *) enqueuePendingOperation:(nonnull LSURLDispatchOperation *)dispatchOp limit:(NSUInteger)limit;
+
+/**
+ @brief Frees a connection. If an operation is waiting, the connection passes directly to the first one of the queue,
+ which is returned and must be started by the caller.
+ @return The operation to be started, or nil.
+ */
+- (nullable LSURLDispatchOperation *) releaseConnectionWithLimit:(NSUInteger)limit;
+
+/**
+ @brief Removes the operation from the queue of operations waiting for a free connection.
+ @return YES if the operation was waiting and has been removed.
+ */
+- (BOOL) removePendingOperation:(nonnull LSURLDispatchOperation *)dispatchOp;
+
+
+#pragma mark -
+#pragma mark Long running requests (for internal use only)
+
+/**
+ @brief Counts a new long running request, if the count is below the limit.
+ @param count Set to the count, after the increment if it succeeded.
+ @return YES if the request has been counted.
+ */
+- (BOOL) acquireLongRequestWithLimit:(NSUInteger)limit count:(nonnull NSUInteger *)count;
+
+/**
+ @brief Counts a new long running request regardless of the limit.
+ @return The count after the increment.
+ */
+- (NSUInteger) addLongRequest;
+
+/**
+ @brief Uncounts a finished long running request.
+ @return The count after the decrement.
+ */
+- (NSUInteger) releaseLongRequest;
+
+
+#pragma mark -
+#pragma mark Properties (for internal use only)
+
+/**
+ @brief The end-point, expressed as "host:port".
+ */
+@property (nonatomic, readonly, nonnull) NSString *name;
+
+@property (nonatomic, readonly, nonnull) NSString *host;
+@property (nonatomic, readonly) int port;
+
+/**
+ @brief The name, interned for trace events.
+ */
+@property (nonatomic, readonly, nonnull) const char *traceName;
+
+@property (nonatomic, readonly) NSUInteger connectionCount;
+@property (nonatomic, readonly) NSUInteger longRequestCount;
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+
+@end
@@ -0,0 +1,263 @@
+//
+//  LSURLEndPoint.m
+//  Lightstreamer Thread Pool Library
+//
+//  Created by Gianluca Bertani on 16/10/26.
+//  Copyright (c) Lightstreamer Srl
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "LSURLEndPoint.h"
+#import "LSURLDispatchOperation.h"
+#import "LSTrace+Internals.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
+
+
+#pragma mark -
+#pragma mark LSURLEndPoint extension
+
+@interface LSURLEndPoint () {
+    NSString *_name;
+    NSString *_host;
+    int _port;
+    const char *_traceName;
+    
+    atomic_size_t _connectionCount;
+    atomic_size_t _longRequestCount;
+    
+    // The queue is guarded by its lock, its count is mirrored for lock-free checks
+    NSMutableArray<LSURLDispatchOperation *> *_pendingOps;
+    pthread_mutex_t _pendingLock;
+    atomic_size_t _pendingCount;
+}
+
+
+#pragma mark -
+#pragma mark Internal methods
+
+- (BOOL) tryAcquireConnectionWithLimit:(NSUInteger)limit;
+- (LSURLDispatchOperation *) dequeuePendingOperation;
+
+
+@end
+
+
+#pragma mark -
+#pragma mark LSURLEndPoint implementation
+
+@implementation LSURLEndPoint
+
+
+#pragma mark -
+#pragma mark Initialization
+
+- (instancetype) initWithHost:(NSString *)host port:(int)port {
+    if ((self = [super init])) {
+        
+        // Initialization
+        _name= [NSString stringWithFormat:@"%@:%d", host, port];
+        _host= [host copy];
+        _port= port;
+        
+        // End-points are few and never freed, the interned name is resolved once
+        _traceName= LSTraceInternString(_name);
+        
+        atomic_init(&_connectionCount, 0);
+        atomic_init(&_longRequestCount, 0);
+        
+        _pendingOps= [[NSMutableArray alloc] init];
+        pthread_mutex_init(&_pendingLock, NULL);
+        atomic_init(&_pendingCount, 0);
+    }
+    
+    return self;
+}
+
+- (instancetype) init {
+    @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                   reason:@"Default initializer must not be used with LSURLEndPoint"
+                                 userInfo:nil];
+}
+
+- (void) dealloc {
+    pthread_mutex_destroy(&_pendingLock);
+}
+
+
+#pragma mark -
+#pragma mark Connection admission
+
+- (BOOL) acquireConnectionWithLimit:(NSUInteger)limit {
+    
+    // Operations already waiting come first
+    if (atomic_load_explicit(&_pendingCount, memory_order_seq_cst) > 0)
+        return NO;
+    
+    return [self tryAcquireConnectionWithLimit:limit];
+}
+
+- (LSURLDispatchOperation *) enqueuePendingOperation:(LSURLDispatchOperation *)dispatchOp limit:(NSUInteger)limit {
+    LSURLDispatchOperation *nextOp= nil;
+    
+    pthread_mutex_lock(&_pendingLock);
+    
+    [_pendingOps addObject:dispatchOp];
+    atomic_fetch_add_explicit(&_pendingCount, 1, memory_order_seq_cst);
+    
+    // Pairs with the check after the decrement in release: either the releasing
+    // thread sees the operation, or the operation sees the connection freed
+    if ([self tryAcquireConnectionWithLimit:limit])
+        nextOp= [self dequeuePendingOperation];
+    
+    pthread_mutex_unlock(&_pendingLock);
+    
+    return nextOp;
+}
+
+- (LSURLDispatchOperation *) releaseConnectionWithLimit:(NSUInteger)limit {
+    LSURLDispatchOperation *nextOp= nil;
+    
+    if (atomic_load_explicit(&_pendingCount, memory_order_seq_cst) > 0) {
+        pthread_mutex_lock(&_pendingLock);
+        
+        // The connection passes to the first operation waiting, the count doesn't change
+        nextOp= [self dequeuePendingOperation];
+        
+        pthread_mutex_unlock(&_pendingLock);
+        
+        if (nextOp)
+            return nextOp;
+    }
+    
+    atomic_fetch_sub_explicit(&_connectionCount, 1, memory_order_seq_cst);
+    
+    // An operation may have been enqueued while the connection was being freed
+    if (atomic_load_explicit(&_pendingCount, memory_order_seq_cst) > 0) {
+        pthread_mutex_lock(&_pendingLock);
+        
+        if (_pendingOps.count && [self tryAcquireConnectionWithLimit:limit])
+            nextOp= [self dequeuePendingOperation];
+        
+        pthread_mutex_unlock(&_pendingLock);
+    }
+    
+    return nextOp;
+}
+
+- (BOOL) removePendingOperation:(LSURLDispatchOperation *)dispatchOp {
+    BOOL removed= NO;
+    
+    pthread_mutex_lock(&_pendingLock);
+    
+    NSUInteger index= [_pendingOps indexOfObjectIdenticalTo:dispatchOp];
+    if (index != NSNotFound) {
+        [_pendingOps removeObjectAtIndex:index];
+        atomic_fetch_sub_explicit(&_pendingCount, 1, memory_order_seq_cst);
+        
+        removed= YES;
+    }
+    
+    pthread_mutex_unlock(&_pendingLock);
+    
+    return removed;
+}
+
+
+#pragma mark -
+#pragma mark Long running requests
+
+- (BOOL) acquireLongRequestWithLimit:(NSUInteger)limit count:(NSUInteger *)count {
+    size_t current= atomic_load_explicit(&_longRequestCount, memory_order_relaxed);
+    
+    do {
+        if (current >= limit) {
+            *count= current;
+            return NO;
+        }
+        
+    } while (!atomic_compare_exchange_weak_explicit(&_longRequestCount, &current, current + 1, memory_order_relaxed, memory_order_relaxed));
+    
+    *count= current + 1;
+    return YES;
+}
+
+- (NSUInteger) addLongRequest {
+    return atomic_fetch_add_explicit(&_longRequestCount, 1, memory_order_relaxed) + 1;
+}
+
+- (NSUInteger) releaseLongRequest {
+    return atomic_fetch_sub_explicit(&_longRequestCount, 1, memory_order_relaxed) - 1;
+}
+
+
+#pragma mark -
+#pragma mark Properties
+
+@synthesize name= _name;
+@synthesize host= _host;
+@synthesize port= _port;
+@synthesize traceName= _traceName;
+
+@dynamic connectionCount;
+
+- (NSUInteger) connectionCount {
+    return atomic_load_explicit(&_connectionCount, memory_order_relaxed);
+}
+
+@dynamic longRequestCount;
+
+- (NSUInteger) longRequestCount {
+    return atomic_load_explicit(&_longRequestCount, memory_order_relaxed);
+}
+
+@dynamic pendingCount;
+
+- (NSUInteger) pendingCount {
+    return atomic_load_explicit(&_pendingCount, memory_order_relaxed);
+}
+
+
+#pragma mark -
+#pragma mark Internal methods
+
+- (BOOL) tryAcquireConnectionWithLimit:(NSUInteger)limit {
+    size_t count= atomic_load_explicit(&_connectionCount, memory_order_seq_cst);
+    
+    do {
+        if (count >= limit)
+            return NO;
+        
+    } while (!atomic_compare_exchange_weak_explicit(&_connectionCount, &count, count + 1, memory_order_seq_cst, memory_order_seq_cst));
+    
+    return YES;
+}
+
+- (LSURLDispatchOperation *) dequeuePendingOperation {
+    
+    // Called with the queue lock held
+    if (!_pendingOps.count)
+        return nil;
+    
+    LSURLDispatchOperation *dispatchOp= _pendingOps.firstObject;
+    [_pendingOps removeObjectAtIndex:0];
+    
+    atomic_fetch_sub_explicit(&_pendingCount, 1, memory_order_seq_cst);
+    
+    return dispatchOp;
+}
+
+
+@end